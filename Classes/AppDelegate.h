@@ -12,16 +12,20 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#import "PersistentMediaListModel.h"
-
 #import <UIKit/UIKit.h>
 
 #import "CVCoreDataController.h"
+#import "PlaybackPositionStore.h"
+#import "LinkValidityCrawler.h"
+#import "TrackURLProbe.h"
 
 @interface AppDelegate : UIResponder<UIApplicationDelegate>
 
 @property(nonatomic, strong) UIWindow *window;
 @property(nonatomic, strong) CVCoreDataController *dataController;
+@property(nonatomic, strong) PlaybackPositionStore *positionStore;
+@property(nonatomic, strong) LinkValidityCrawler *linkCrawler;
+@property(nonatomic, strong) TrackURLProbe *trackProbe;
 
 // Method to get shared instance of the delegate
 + (AppDelegate*) sharedInstance;
@@ -14,6 +14,8 @@
 
 #import "AppDelegate.h"
 #import "CastDeviceController.h"
+#import "SharedDataUtils.h"
+#import "CVLibraryTransfer.h"
 
 #import <AVFoundation/AVFoundation.h>
 
@@ -44,11 +46,50 @@
     
     // initialize core data controller
     self.dataController = [[CVCoreDataController alloc] init];
+    // keep search index in line with records saved while application was not running
+    self.dataController.searchIndex = [[CVSearchIndex alloc] initWithFileURL:[SharedDataUtils pathToSearchIndex]];
+    [[self.dataController updateSearchIndex] continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
+        if (task.faulted) {
+            NSLog(@"Failed to update search index, reason: %@", task.error ?: task.exception);
+        }
+        return nil;
+    }];
+    // move pages of legacy media list into Core Data once, then count records of genres once after
+    // migration to the model with genre counts, so migrated records are counted too
+    CVCoreDataController *dataController = self.dataController;
+    CVLibraryTransfer *transfer = [[CVLibraryTransfer alloc] initWithDataController:dataController];
+    [[[[transfer migrateLegacyMediaList] continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
+        // failed migration is logged by transfer, records it did save still need counts
+        return [dataController updateGenreCountsIfNeeded];
+    }] continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
+        if (task.faulted) {
+            NSLog(@"Failed to count media records by genre, reason: %@", task.error ?: task.exception);
+        }
+        // migrated records know page URL only until their pages are loaded
+        return [transfer completeStubRecords];
+    }] continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
+        if (task.faulted) {
+            NSLog(@"Failed to complete stub media records, reason: %@", task.error ?: task.exception);
+        }
+        return nil;
+    }];
+    // initialize playback positions store, replays positions left by previous run
+    self.positionStore = [[PlaybackPositionStore alloc] initWithJournalURL:[SharedDataUtils pathToPlaybackJournal]
+                                                            dataController:self.dataController];
+    // revalidate links of library in background, resumes where previous run stopped
+    self.linkCrawler = [[LinkValidityCrawler alloc] initWithDataController:self.dataController
+                                                      sessionConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]
+                                                                  stateURL:[SharedDataUtils pathToLinkCrawlerState]];
+    [self.linkCrawler start];
+    // resolve redirects of tracks before playback
+    self.trackProbe = [[TrackURLProbe alloc] initWithDataController:self.dataController
+                                               sessionConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
     
     return YES;
 }
 
 - (void)applicationWillTerminate:(UIApplication *)application {
+    [self.positionStore flush];
     [self.dataController saveContext];
 }
 
@@ -56,8 +97,15 @@
     [self.dataController saveContext];
 }
 
+- (void)applicationWillEnterForeground:(UIApplication *)application {
+    [self.linkCrawler start];
+}
+
 - (void)applicationDidEnterBackground:(UIApplication *)application {
+    [self.linkCrawler stop];
+    [self.positionStore flush];
     [self.dataController saveContext];
+    [self.dataController.searchIndex synchronize];
 }
 
 @end
\ No newline at end of file
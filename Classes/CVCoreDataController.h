@@ -10,20 +10,70 @@
 #import <Bolts/Bolts.h>
 
 #import "ExMedia.h"
+#import "ExMediaTrack.h"
 #import "CVMediaRecordMO.h"
+#import "CVSearchIndex.h"
 
 // The name of error raised when failed to perform Core data Access operation
 static NSString *const kCoreDataAccessErrorName;
 
 /*!
- The core data controller to manage Core Data stack
+ The core data controller to manage Core Data stack. The stack consists of private queue writer context
+ attached to persistent store, main queue view context used by UI and short-lived private queue
+ background contexts. Both view and background contexts are children of the writer, changes saved
+ by background contexts are merged into the view context.
+ 
+ All asynchronous methods run on background contexts and complete their tasks on main queue with
+ managed objects belonging to the view context.
  */
 @interface CVCoreDataController : NSObject
 
-// The managed object context to perform CRUD operations
+// The main queue managed object context to be used by UI
 @property (nonatomic, strong, readonly) NSManagedObjectContext *managedObjectContext;
 // Indicates whether core data stack was already initialized
 @property (nonatomic, assign, readonly) BOOL initialized;
+// The full-text index of media records updated on every save, nil disables search
+@property (nonatomic, strong) CVSearchIndex *searchIndex;
+
+/**
+ Method to create controller of the application store in shared container.
+ */
+- (instancetype) init;
+
+/*!
+ Method to create controller of specified store, e.g. scratch store of tests.
+ 
+ @param storeType The type of persistent store, e.g. NSSQLiteStoreType or NSInMemoryStoreType
+ @param storeURL The location of store, ignored by in-memory store
+ */
+- (instancetype) initWithStoreType: (NSString *)storeType URL: (NSURL *)storeURL NS_DESIGNATED_INITIALIZER;
+
+/**
+ Method to create new private queue context for imports. Changes saved in it are pushed to the writer
+ context and merged into the view context, but not written to store until writer is saved.
+ */
+- (NSManagedObjectContext *) newBackgroundContext;
+
+/*!
+ Method to run block on new background context. The context is saved after block and changes are written
+ to persistent store in background.
+ 
+ @param block The block to run, it may return managed object, array of managed objects or any other
+        object as task result. Returning nil with error set or throwing exception fails the task.
+ @return BFTask completed on main queue with block result, managed objects are converted to objects
+         of view context
+ */
+- (BFTask *) performBackgroundTask: (id (^)(NSManagedObjectContext *context, NSError **error))block;
+
+/*!
+ Method to run long import or export in bounded memory. The block is called repeatedly on single background
+ context until it sets stop. Changes of every pass are saved and written to store, then context is reset,
+ so objects of previous passes are released.
+ 
+ @param block The block processing one batch, returning NO with error set or throwing exception fails the task
+ @return BFTask completed on main queue with number of passes
+ */
+- (BFTask *) performBatchedBackgroundTask: (BOOL (^)(NSManagedObjectContext *context, BOOL *stop, NSError **error))block;
 
 /**
  Method to delete all media tracks associated with record
@@ -37,6 +87,17 @@ static NSString *const kCoreDataAccessErrorName;
                           title: (NSString *) title
                       forRecord: (CVMediaRecordMO *)record;
 
+/*!
+ Method to replace whole list of media tracks of the record in single transaction. Existing tracks with
+ the same URL are kept together with their play time, tracks missing from the list are deleted.
+ 
+ @param tracks The new tracks in order of appearance
+ @param record The media record owning tracks
+ @return BFTask completed with the record when all tracks were written to store
+ */
+- (BFTask *) replaceTracks: (NSArray<ExMediaTrack *> *)tracks
+                 forRecord: (CVMediaRecordMO *)record;
+
 /**
  Method to delete media record asynchronously
  */
@@ -48,8 +109,42 @@ static NSString *const kCoreDataAccessErrorName;
 - (BFTask *) listMediaRecordsAsync;
 
 /**
- Method to save provided media object synchronously
- @return BFTask object encapsulating operation results
+ Method to load media records which belong to all specified genres, e.g. genre and subgenre
+ */
+- (BFTask *) listMediaRecordsInGenresAsync: (NSArray<NSString *> *)genres;
+
+/*!
+ Method to build predicate selecting media records which belong to all specified genres. Genres are
+ matched by object through the genre to record join table, so records with many genres are not multiplied.
+ Must be called on main queue, predicate refers to genres of the view context.
+ 
+ @param genres The names of genres, e.g. genre and subgenre
+ @return The predicate for MediaRecord entity, never matching if some genre is unknown
+ */
+- (NSPredicate *) predicateForRecordsInGenres: (NSArray<NSString *> *)genres;
+
+/**
+ Method to get names of genres from the taxonomy shipped with application
+ */
+- (NSArray<NSString *> *) genreTaxonomy;
+
+/*!
+ Method to read number of media records per genre. Counts are maintained incrementally whenever records
+ are saved or deleted, so no relationships are walked.
+ @return BFTask completed on main queue with counts keyed by genre name, taxonomy genres without records
+         have zero count
+ */
+- (BFTask *) genreCountsAsync;
+
+/*!
+ Method to count records of every genre once, after store was migrated to the model with genre counts.
+ @return BFTask completed with YES if genres were counted
+ */
+- (BFTask *) updateGenreCountsIfNeeded;
+
+/**
+ Method to save provided media object asynchronously
+ @return BFTask object encapsulating operation results, completed after record was written to store
  */
 - (BFTask *) saveWithURL: (NSURL *)mediaURL
                    title: (NSString *)title
@@ -63,10 +158,28 @@ static NSString *const kCoreDataAccessErrorName;
  */
 - (BFTask *) checkItemForURL: (NSURL *)mediaURL;
 
+/*!
+ Method to search media records by words of title, description and track names. Every word of the query
+ matches as prefix.
+ 
+ @param query The search query
+ @param limit The maximal number of records to return
+ @return BFTask completed on main queue with records of view context, the best ranked first
+ */
+- (BFTask *) searchMediaRecords: (NSString *)query limit: (NSUInteger)limit;
+
+/*!
+ Method to bring search index in line with stored records, e.g. records saved by extension or
+ index lost. Only records changed since they were indexed are indexed again.
+ @return BFTask completed with number of indexed records
+ */
+- (BFTask *) updateSearchIndex;
+
 /*!
  Method to synchronize managed obect context with underlying data store. It should be invoked
  upon application lifecycle change events in order to guarantee that everything user changed
- is persisted
+ is persisted. View context is saved into writer context which is then written to store before
+ this method returns.
  */
 - (void) saveContext;
 
@@ -15,71 +15,257 @@
 
 static NSString *const kCoreDataAccessErrorName = @"CoreDataAccessError";
 
+// The store metadata key and version of genre record counts
+static NSString *const kGenreCountsMetadataKey = @"CVGenreCountsVersion";
+static const NSInteger kGenreCountsVersion = 1;
+
+// The weights of record texts in search ranking
+static const NSUInteger kSearchTitleWeight = 4;
+static const NSUInteger kSearchTrackNameWeight = 2;
+static const NSUInteger kSearchDetailsWeight = 1;
+
 @interface CVCoreDataController()
 
 @property (nonatomic, strong, readonly) NSManagedObjectModel *managedObjectModel;
 @property (nonatomic, strong, readonly) NSPersistentStoreCoordinator *persistentStoreCoordinator;
+// The private queue context writing changes to persistent store, parent of all other contexts
+@property (nonatomic, strong, readonly) NSManagedObjectContext *writerContext;
 
 @end
 
-@implementation CVCoreDataController
+@implementation CVCoreDataController {
+    // The object IDs of stored genres keyed by name, shared by all contexts
+    NSMutableDictionary<NSString *, NSManagedObjectID *> *_genreIDs;
+    // The type and location of persistent store
+    NSString *_storeType;
+    NSURL *_storeURL;
+}
+
+@synthesize managedObjectModel=_managedObjectModel, managedObjectContext=_managedObjectContext, persistentStoreCoordinator=_persistentStoreCoordinator, writerContext=_writerContext;
+
+- (instancetype) init {
+    return [self initWithStoreType:NSSQLiteStoreType URL:[SharedDataUtils pathToMediaRecordsDB]];
+}
+
+- (instancetype) initWithStoreType: (NSString *)storeType URL: (NSURL *)storeURL {
+    self = [super init];
+    if (self) {
+        _genreIDs = [NSMutableDictionary dictionary];
+        _storeType = storeType;
+        _storeURL = [storeType isEqualToString:NSInMemoryStoreType] ? nil : storeURL;
+    }
+    return self;
+}
 
-@synthesize managedObjectModel=_managedObjectModel, managedObjectContext=_managedObjectContext, persistentStoreCoordinator=_persistentStoreCoordinator;
+- (void) dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
 
 - (BFTask *) deleteMediaTracksForRecordAsync: (CVMediaRecordMO *)record {
-    BFTask *res = [BFTask taskFromExecutor:[BFExecutor defaultExecutor] withBlock:^id _Nonnull {
-        for (CVMediaTrack *track in record.tracks) {
-            [self.managedObjectContext deleteObject: track];
+    NSManagedObjectID *recordID = [self permanentIDForObject:record];
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        CVMediaRecordMO *localRecord = [context existingObjectWithID:recordID error:error];
+        if (!localRecord) {
+            return nil;
         }
-        // make sure it actually saved
-        [self saveContext];
-        
-        return nil;
+        for (CVMediaTrack *track in localRecord.tracks) {
+            [context deleteObject: track];
+        }
+        return [NSNull null];
     }];
-    return res;
 }
 
 - (BFTask *) createTrackWithURL: (NSURL *)mediaURL
                           title: (NSString *) title
                       forRecord: (CVMediaRecordMO *)record {
-    BFTaskCompletionSource *task = [BFTaskCompletionSource taskCompletionSource];
-    CVMediaTrack *track = [NSEntityDescription insertNewObjectForEntityForName: kMediaTrackEntityName
-                                                        inManagedObjectContext: [self managedObjectContext]];
-    track.address = [mediaURL absoluteString];
-    track.name = title;
-    
-    NSMutableOrderedSet * set = [record mutableOrderedSetValueForKey:@"tracks"];
-    [set addObject:track];
-    
-    // make sure it actually saved
-    [self saveContext];
-    
-    return [task task];
+    NSManagedObjectID *recordID = [self permanentIDForObject:record];
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        CVMediaRecordMO *localRecord = [context existingObjectWithID:recordID error:error];
+        if (!localRecord) {
+            return nil;
+        }
+        CVMediaTrack *track = [NSEntityDescription insertNewObjectForEntityForName: kMediaTrackEntityName
+                                                            inManagedObjectContext: context];
+        track.address = [mediaURL absoluteString];
+        track.name = title;
+        
+        NSMutableOrderedSet * set = [localRecord mutableOrderedSetValueForKey:@"tracks"];
+        [set addObject:track];
+        
+        return track;
+    }];
 }
 
-- (BFTask *)deleteMediaRecordAsync: (CVMediaRecordMO*) record {
-    BFTask *res = [BFTask taskFromExecutor:[BFExecutor defaultExecutor] withBlock:^id _Nonnull {
-        [self.managedObjectContext deleteObject:record];
+- (BFTask *) replaceTracks: (NSArray<ExMediaTrack *> *)tracks
+                 forRecord: (CVMediaRecordMO *)record {
+    NSManagedObjectID *recordID = [self permanentIDForObject:record];
+    // copy values, tracks are not to be touched on background queue
+    NSMutableArray<NSString *> *addresses = [NSMutableArray arrayWithCapacity:tracks.count];
+    NSMutableArray<NSString *> *names = [NSMutableArray arrayWithCapacity:tracks.count];
+    for (ExMediaTrack *track in tracks) {
+        [addresses addObject:[track.url absoluteString] ?: @""];
+        [names addObject:track.name ?: @""];
+    }
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        CVMediaRecordMO *localRecord = [context existingObjectWithID:recordID error:error];
+        if (!localRecord) {
+            return nil;
+        }
+        NSMutableDictionary<NSString *, CVMediaTrack *> *existing = [NSMutableDictionary dictionaryWithCapacity:localRecord.tracks.count];
+        for (CVMediaTrack *track in localRecord.tracks) {
+            if (track.address && !existing[track.address]) {
+                existing[track.address] = track;
+            } else {
+                [context deleteObject:track];
+            }
+        }
         
-        // make sure it actually saved
-        [self saveContext];
+        NSMutableOrderedSet<CVMediaTrack *> *newTracks = [NSMutableOrderedSet orderedSetWithCapacity:addresses.count];
+        for (NSUInteger i = 0; i < addresses.count; i++) {
+            CVMediaTrack *track = existing[addresses[i]];
+            if (track) {
+                [existing removeObjectForKey:addresses[i]];
+            } else {
+                track = [NSEntityDescription insertNewObjectForEntityForName: kMediaTrackEntityName
+                                                      inManagedObjectContext: context];
+                track.address = addresses[i];
+            }
+            if (![track.name isEqualToString:names[i]]) {
+                track.name = names[i];
+            }
+            [newTracks addObject:track];
+        }
+        for (CVMediaTrack *track in [existing allValues]) {
+            [context deleteObject:track];
+        }
+        // single relationship change instead of KVC proxy update per track
+        localRecord.tracks = newTracks;
         
-        return nil;
+        return localRecord;
+    }];
+}
+
+- (BFTask *)deleteMediaRecordAsync: (CVMediaRecordMO*) record {
+    NSManagedObjectID *recordID = [self permanentIDForObject:record];
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        CVMediaRecordMO *localRecord = [context existingObjectWithID:recordID error:error];
+        if (!localRecord) {
+            return nil;
+        }
+        [context deleteObject:localRecord];
+        return [NSNull null];
     }];
-    return res;
 }
 
 - (BFTask *) listMediaRecordsAsync {
-    BFTask *res = [BFTask taskFromExecutor:[BFExecutor defaultExecutor] withBlock:^id _Nonnull {
-        NSError *fetchError;
-        NSArray<CVMediaRecordMO*>* records = [self listMediaRecords:&fetchError];
-        if (!records) {
-            @throw fetchError;
-        } else {
-            return records;
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        return [self listMediaRecordIDsInContext:context predicate:nil error:error];
+    }];
+}
+
+- (BFTask *) listMediaRecordsInGenresAsync: (NSArray<NSString *> *)genres {
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSMutableArray<NSPredicate *> *predicates = [NSMutableArray arrayWithCapacity:genres.count];
+        for (NSString *name in genres) {
+            CVGenreMO *genre = [self findGenreByName:name inContext:context];
+            if (!genre) {
+                return @[];
+            }
+            [predicates addObject:[NSPredicate predicateWithFormat:@"ANY genres == %@", genre]];
         }
+        return [self listMediaRecordIDsInContext:context
+                                       predicate:[NSCompoundPredicate andPredicateWithSubpredicates:predicates]
+                                           error:error];
     }];
-    return res;
+}
+
+- (NSPredicate *) predicateForRecordsInGenres: (NSArray<NSString *> *)genres {
+    NSMutableArray<NSPredicate *> *predicates = [NSMutableArray arrayWithCapacity:genres.count];
+    for (NSString *name in genres) {
+        CVGenreMO *genre = [self findGenreByName:name inContext:self.managedObjectContext];
+        if (!genre) {
+            return [NSPredicate predicateWithValue:NO];
+        }
+        [predicates addObject:[NSPredicate predicateWithFormat:@"ANY genres == %@", genre]];
+    }
+    return [NSCompoundPredicate andPredicateWithSubpredicates:predicates];
+}
+
+- (NSArray<NSString *> *) genreTaxonomy {
+    NSURL *genresURL = [[NSBundle mainBundle] URLForResource:@"genres" withExtension:@"plist"];
+    return genresURL ? [NSArray arrayWithContentsOfURL:genresURL] : @[];
+}
+
+- (BFTask *) genreCountsAsync {
+    NSArray<NSString *> *taxonomy = [self genreTaxonomy];
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kGenreEntityName];
+        [request setResultType:NSDictionaryResultType];
+        [request setPropertiesToFetch:@[@"name", @"recordCount"]];
+        NSArray<NSDictionary *> *rows = [context executeFetchRequest:request error:error];
+        if (!rows) {
+            return nil;
+        }
+        NSMutableDictionary<NSString *, NSNumber *> *counts = [NSMutableDictionary dictionaryWithCapacity:MAX(rows.count, taxonomy.count)];
+        for (NSString *name in taxonomy) {
+            counts[name] = @0;
+        }
+        for (NSDictionary *row in rows) {
+            if (row[@"name"]) {
+                counts[row[@"name"]] = row[@"recordCount"] ?: @0;
+            }
+        }
+        return counts;
+    }];
+}
+
+- (BFTask *) updateGenreCountsIfNeeded {
+    NSManagedObjectContext *writer = self.writerContext;
+    NSPersistentStore *store = [writer.persistentStoreCoordinator.persistentStores firstObject];
+    if (!store || [store.metadata[kGenreCountsMetadataKey] integerValue] == kGenreCountsVersion) {
+        return [BFTask taskWithResult:@NO];
+    }
+    BFTaskCompletionSource *task = [BFTaskCompletionSource taskCompletionSource];
+    // counted on writer queue, so no save of other context slips in between counting and writing
+    [writer performBlock:^{
+        NSError *error = nil;
+        // pending changes are written first, counts are taken from store only
+        [self saveWriterContext];
+        NSArray<CVGenreMO *> *genres = [writer executeFetchRequest:[NSFetchRequest fetchRequestWithEntityName:kGenreEntityName]
+                                                             error:&error];
+        for (CVGenreMO *genre in genres) {
+            NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+            [request setPredicate:[NSPredicate predicateWithFormat:@"ANY genres == %@", genre]];
+            NSUInteger count = [writer countForFetchRequest:request error:&error];
+            if (count == NSNotFound) {
+                genres = nil;
+                break;
+            }
+            // assigned even if equal, the save must happen for metadata to be written
+            genre.recordCount = @(count);
+        }
+        if (genres) {
+            NSMutableDictionary *metadata = [store.metadata mutableCopy];
+            metadata[kGenreCountsMetadataKey] = @(kGenreCountsVersion);
+            [store setMetadata:metadata];
+            // metadata is written to store together with counts
+            if (![writer save:&error]) {
+                genres = nil;
+            }
+        }
+        if (!genres) {
+            NSLog(@"Failed to count media records by genre: %@\n%@", [error localizedDescription], [error userInfo]);
+            [writer rollback];
+        }
+        [self.managedObjectContext performBlock:^{
+            if (genres) {
+                [task setResult:@YES];
+            } else {
+                [task setError:error];
+            }
+        }];
+    }];
+    return [task task];
 }
 
 - (BFTask *) saveWithURL: (NSURL *)mediaURL
@@ -88,64 +274,272 @@ static NSString *const kCoreDataAccessErrorName = @"CoreDataAccessError";
                    genre: (NSString *)genre
                 subGenre: (NSString *)subGenre
             thumbnailURL: (NSURL *)thumbnailURL{
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        // read genre
+        CVGenreMO *genreMO = [self findOrCreateGenre:genre inContext:context];
+        if (!genreMO) {
+            @throw [[NSException alloc]initWithName: kCoreDataAccessErrorName
+                                             reason: [NSString stringWithFormat:@"Failed to find Main Genre info for name: %@", genre]
+                                           userInfo: nil];
+        }
+        CVGenreMO *subGenreMO = [self findOrCreateGenre:subGenre inContext:context];
+        if (!subGenreMO) {
+            @throw [[NSException alloc]initWithName: kCoreDataAccessErrorName
+                                             reason: [NSString stringWithFormat:@"Failed to find Sub Genre info for name: %@", subGenre]
+                                           userInfo: nil];
+        }
+        
+        CVMediaRecordMO *record = [self findRecordByURL:mediaURL inContext:context];
+        if (!record) {
+            // create new media record if not exists
+            record = [NSEntityDescription insertNewObjectForEntityForName: kMediaRecordEntityName
+                                                   inManagedObjectContext: context];
+        }
+        
+        record.dateAdded = [NSDate new];
+        record.title = title;
+        record.details = description;
+        record.pageUrl = [mediaURL absoluteString];
+        record.mimeType = @"video/mp4";
+        record.thumbnailUrl = [thumbnailURL absoluteString];
+        
+        NSMutableOrderedSet * set = [record mutableOrderedSetValueForKey:@"genres"];
+        [set addObjectsFromArray:@[genreMO, subGenreMO]];
+        
+        return record;
+    }];
+}
+
+- (BFTask *) checkItemForURL: (NSURL *)mediaURL {
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        CVMediaRecordMO *record = [self findRecordByURL:mediaURL inContext:context];
+        if (record) {
+            NSLog(@"Record with title: %@ already exists", record.title);
+            return record;
+        } else {
+            NSException *ex = [[NSException alloc]initWithName: kCoreDataAccessErrorName
+                                                        reason: @"Error checking if media record exists"
+                                                      userInfo: nil];
+            @throw ex;
+        }
+    }];
+}
+
+- (BFTask *) searchMediaRecords: (NSString *)query limit: (NSUInteger)limit {
+    CVSearchIndex *index = self.searchIndex;
+    if (!index) {
+        return [BFTask taskWithResult:@[]];
+    }
+    BFExecutor *searchExecutor = [BFExecutor executorWithDispatchQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0)];
+    return [[BFTask taskFromExecutor:searchExecutor withBlock:^id {
+        return [index documentsMatchingQuery:query limit:limit];
+    }] continueWithExecutor:[BFExecutor mainThreadExecutor] withSuccessBlock:^id (BFTask *task) {
+        NSArray<NSString *> *identifiers = task.result;
+        NSMutableArray<NSManagedObjectID *> *recordIDs = [NSMutableArray arrayWithCapacity:identifiers.count];
+        for (NSString *identifier in identifiers) {
+            NSManagedObjectID *recordID = [self.persistentStoreCoordinator managedObjectIDForURIRepresentation:[NSURL URLWithString:identifier]];
+            if (recordID) {
+                [recordIDs addObject:recordID];
+            }
+        }
+        if (recordIDs.count == 0) {
+            return @[];
+        }
+        // single fetch instead of firing fault per record, then restore ranking
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+        [request setPredicate:[NSPredicate predicateWithFormat:@"self IN %@", recordIDs]];
+        [request setReturnsObjectsAsFaults:NO];
+        NSError *error;
+        NSArray<CVMediaRecordMO *> *fetched = [self.managedObjectContext executeFetchRequest:request error:&error];
+        if (!fetched) {
+            return [BFTask taskWithError:error];
+        }
+        NSMutableDictionary<NSManagedObjectID *, CVMediaRecordMO *> *byID = [NSMutableDictionary dictionaryWithCapacity:fetched.count];
+        for (CVMediaRecordMO *record in fetched) {
+            byID[record.objectID] = record;
+        }
+        NSMutableArray<CVMediaRecordMO *> *records = [NSMutableArray arrayWithCapacity:fetched.count];
+        for (NSManagedObjectID *recordID in recordIDs) {
+            if (byID[recordID]) {
+                [records addObject:byID[recordID]];
+            }
+        }
+        return records;
+    }];
+}
+
+- (BFTask *) updateSearchIndex {
+    CVSearchIndex *index = self.searchIndex;
+    if (!index) {
+        return [BFTask taskWithResult:@0];
+    }
+    return [self performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSMutableDictionary<NSString *, NSNumber *> *stamps = [[index documentStamps] mutableCopy];
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+        [request setPropertiesToFetch:@[@"dateAdded"]];
+        [request setFetchBatchSize:500];
+        NSArray<CVMediaRecordMO *> *records = [context executeFetchRequest:request error:error];
+        if (!records) {
+            return nil;
+        }
+        NSUInteger indexed = 0;
+        for (CVMediaRecordMO *record in records) {
+            NSString *identifier = [[record.objectID URIRepresentation] absoluteString];
+            NSNumber *stamp = stamps[identifier];
+            [stamps removeObjectForKey:identifier];
+            if (!stamp || [stamp doubleValue] != [record.dateAdded timeIntervalSinceReferenceDate]) {
+                [self indexRecord:record inIndex:index];
+                indexed++;
+            }
+        }
+        // records deleted while index was not listening
+        for (NSString *identifier in stamps) {
+            [index removeDocument:identifier];
+        }
+        return @(indexed);
+    }];
+}
+
+- (NSManagedObjectContext *) newBackgroundContext {
+    NSManagedObjectContext *writer = [self writerContext];
+    if (!writer) {
+        return nil;
+    }
+    NSManagedObjectContext *context = [[NSManagedObjectContext alloc] initWithConcurrencyType: NSPrivateQueueConcurrencyType];
+    context.parentContext = writer;
+    context.mergePolicy = NSMergeByPropertyObjectTrumpMergePolicy;
+    // background contexts are short-lived, no need to keep undo history
+    context.undoManager = nil;
+    [[NSNotificationCenter defaultCenter] addObserver: self
+                                             selector: @selector(backgroundContextDidSave:)
+                                                 name: NSManagedObjectContextDidSaveNotification
+                                               object: context];
+    return context;
+}
+
+- (BFTask *) performBackgroundTask: (id (^)(NSManagedObjectContext *context, NSError **error))block {
     BFTaskCompletionSource *task = [BFTaskCompletionSource taskCompletionSource];
-    
-    // read genre
-    CVGenreMO *genreMO = [self findOrCreateGenre:genre];
-    if (!genreMO) {
+    NSManagedObjectContext *context = [self newBackgroundContext];
+    if (!context) {
         NSException *ex = [[NSException alloc]initWithName: kCoreDataAccessErrorName
-                                                    reason: [NSString stringWithFormat:@"Failed to find Main Genre info for name: %@", genre]
+                                                    reason: @"Core Data stack is not available"
                                                   userInfo: nil];
         [task setException:ex];
         return [task task];
     }
-    CVGenreMO *subGenreMO = [self findOrCreateGenre:genre];
-    if (!genreMO) {
+    
+    [context performBlock:^{
+        NSError *error = nil;
+        NSException *exception = nil;
+        id result = nil;
+        @try {
+            result = block(context, &error);
+            if (!result && !error) {
+                error = [NSError errorWithDomain: kCoreDataAccessErrorName
+                                            code: NSManagedObjectReferentialIntegrityError
+                                        userInfo: @{NSLocalizedDescriptionKey: @"Failed to access managed object"}];
+            }
+            // inserted objects get permanent IDs before save, so it is safe to pass them to view context
+            if (result && [context hasChanges] &&
+                (![context obtainPermanentIDsForObjects:[[context insertedObjects] allObjects] error:&error] ||
+                 ![context save:&error])) {
+                NSLog(@"Error saving background context: %@\n%@", [error localizedDescription], [error userInfo]);
+                result = nil;
+            }
+        } @catch (NSException *ex) {
+            exception = ex;
+            result = nil;
+        }
+        id resultIDs = [self objectIDsFromResult:result];
+        [[NSNotificationCenter defaultCenter] removeObserver: self
+                                                        name: NSManagedObjectContextDidSaveNotification
+                                                      object: context];
+        [context reset];
+        
+        void (^completeBlock)() = ^{
+            // changes of background context were merged into view context already
+            [self.managedObjectContext performBlock:^{
+                if (exception) {
+                    [task setException:exception];
+                } else if (error) {
+                    [task setError:error];
+                } else {
+                    [task setResult:[self objectsFromIDs:resultIDs inContext:self.managedObjectContext]];
+                }
+            }];
+        };
+        if (exception || error) {
+            completeBlock();
+        } else {
+            [self.writerContext performBlock:^{
+                [self saveWriterContext];
+                completeBlock();
+            }];
+        }
+    }];
+    return [task task];
+}
+
+- (BFTask *) performBatchedBackgroundTask: (BOOL (^)(NSManagedObjectContext *context, BOOL *stop, NSError **error))block {
+    BFTaskCompletionSource *task = [BFTaskCompletionSource taskCompletionSource];
+    NSManagedObjectContext *context = [self newBackgroundContext];
+    if (!context) {
         NSException *ex = [[NSException alloc]initWithName: kCoreDataAccessErrorName
-                                                    reason: [NSString stringWithFormat:@"Failed to find Sub Genre info for name: %@", genre]
+                                                    reason: @"Core Data stack is not available"
                                                   userInfo: nil];
         [task setException:ex];
         return [task task];
     }
     
-    CVMediaRecordMO *record = [self findRecordByURL:mediaURL];
-    if (!record) {
-        // create new media record if not exists
-        record = [NSEntityDescription insertNewObjectForEntityForName: kMediaRecordEntityName
-                                               inManagedObjectContext: [self managedObjectContext]];
-    }
-    
-    record.dateAdded = [NSDate new];
-    record.title = title;
-    record.details = description;
-    record.pageUrl = [mediaURL absoluteString];
-    record.mimeType = @"video/mp4";
-    record.thumbnailUrl = [thumbnailURL absoluteString];
-    
-    NSMutableOrderedSet * set = [record mutableOrderedSetValueForKey:@"genres"];
-    [set addObjectsFromArray:@[genreMO, subGenreMO]];
-    
-    // make sure it actually saved
-    [self saveContext];
-    
-    [task setResult:record];
-    return [task task];
-}
-
-- (BFTask *) checkItemForURL: (NSURL *)mediaURL {
-    BFTask *res = [BFTask taskFromExecutor:[BFExecutor defaultExecutor] withBlock:^id _Nonnull{
-        CVMediaRecordMO *record = [self findRecordByURL:mediaURL];
-        if (record) {
-            NSLog(@"Record with title: %@ already exists", record.title);
-            return record;
-        } else {
-            NSException *ex = [[NSException alloc]initWithName: kCoreDataAccessErrorName
-                                                        reason: @"Error checking if media record exists"
-                                                      userInfo: nil];
-            @throw ex;
+    [context performBlock:^{
+        NSError *error = nil;
+        NSException *exception = nil;
+        NSUInteger passes = 0;
+        BOOL stop = NO;
+        @try {
+            while (!stop && !error) {
+                @autoreleasepool {
+                    if (!block(context, &stop, &error)) {
+                        if (!error) {
+                            error = [NSError errorWithDomain: kCoreDataAccessErrorName
+                                                        code: NSManagedObjectReferentialIntegrityError
+                                                    userInfo: @{NSLocalizedDescriptionKey: @"Failed to access managed object"}];
+                        }
+                        break;
+                    }
+                    passes++;
+                    if ([context hasChanges] &&
+                        (![context obtainPermanentIDsForObjects:[[context insertedObjects] allObjects] error:&error] ||
+                         ![context save:&error])) {
+                        NSLog(@"Error saving background context: %@\n%@", [error localizedDescription], [error userInfo]);
+                        break;
+                    }
+                    // write batch to store, otherwise writer keeps all of them in memory
+                    [self.writerContext performBlockAndWait:^{
+                        [self saveWriterContext];
+                    }];
+                    [context reset];
+                }
+            }
+        } @catch (NSException *ex) {
+            exception = ex;
         }
+        [[NSNotificationCenter defaultCenter] removeObserver: self
+                                                        name: NSManagedObjectContextDidSaveNotification
+                                                      object: context];
+        [context reset];
+        
+        [self.managedObjectContext performBlock:^{
+            if (exception) {
+                [task setException:exception];
+            } else if (error) {
+                [task setError:error];
+            } else {
+                [task setResult:@(passes)];
+            }
+        }];
     }];
-    return res;
+    return [task task];
 }
 
 - (void) saveContext {
@@ -155,27 +549,60 @@ static NSString *const kCoreDataAccessErrorName = @"CoreDataAccessError";
             NSLog(@"Error saving managed objects context: %@\n%@", [error localizedDescription], [error userInfo]);
         }
     }
+    if (_writerContext != nil) {
+        [_writerContext performBlockAndWait:^{
+            [self saveWriterContext];
+        }];
+    }
 }
 
 #pragma mark - Core Data stack
 
 /**
- * Returns the managed object context for the application.
- * If the context doesn't already exist, it is created and bound to the persistent store coordinator for the application.
+ * Returns the main queue managed object context for the application.
+ * If the context doesn't already exist, it is created as a child of the writer context.
  */
 - (NSManagedObjectContext *) managedObjectContext {
     if (_managedObjectContext != nil) {
         return _managedObjectContext;
     }
     
-    NSPersistentStoreCoordinator *coordinator = [self persistentStoreCoordinator];
-    if (coordinator != nil) {
+    NSManagedObjectContext *writer = [self writerContext];
+    if (writer != nil) {
         _managedObjectContext = [[NSManagedObjectContext alloc] initWithConcurrencyType: NSMainQueueConcurrencyType];
-        [_managedObjectContext setPersistentStoreCoordinator: coordinator];
+        [_managedObjectContext setParentContext: writer];
+        [_managedObjectContext setMergePolicy: NSMergeByPropertyObjectTrumpMergePolicy];
+        [[NSNotificationCenter defaultCenter] addObserver: self
+                                                 selector: @selector(viewContextDidSave:)
+                                                     name: NSManagedObjectContextDidSaveNotification
+                                                   object: _managedObjectContext];
     }
     return _managedObjectContext;
 }
 
+/**
+ * Returns the private queue context writing to persistent store.
+ * If the context doesn't already exist, it is created and bound to the persistent store coordinator for the application.
+ */
+- (NSManagedObjectContext *) writerContext {
+    if (_writerContext != nil) {
+        return _writerContext;
+    }
+    
+    NSPersistentStoreCoordinator *coordinator = [self persistentStoreCoordinator];
+    if (coordinator != nil) {
+        _writerContext = [[NSManagedObjectContext alloc] initWithConcurrencyType: NSPrivateQueueConcurrencyType];
+        [_writerContext setPersistentStoreCoordinator: coordinator];
+        [_writerContext setMergePolicy: NSMergeByPropertyObjectTrumpMergePolicy];
+        // every change reaches store through writer, so genre counts are kept in one place
+        [[NSNotificationCenter defaultCenter] addObserver: self
+                                                 selector: @selector(writerContextWillSave:)
+                                                     name: NSManagedObjectContextWillSaveNotification
+                                                   object: _writerContext];
+    }
+    return _writerContext;
+}
+
 /**
  * Returns the managed object model for the application.
  * If the model doesn't already exist, it is created from the application's model.
@@ -198,7 +625,7 @@ static NSString *const kCoreDataAccessErrorName = @"CoreDataAccessError";
         return _persistentStoreCoordinator;
     }
     
-    NSURL *storeURL = [SharedDataUtils pathToMediaRecordsDB];
+    NSURL *storeURL = _storeURL;
     
     /*
      Set up the store.
@@ -206,7 +633,7 @@ static NSString *const kCoreDataAccessErrorName = @"CoreDataAccessError";
      */
     NSFileManager *fileManager = [NSFileManager defaultManager];
     // If the expected store doesn't exist, copy the default store.
-    if (![fileManager fileExistsAtPath:[storeURL path]]) {
+    if ([storeURL isEqual:[SharedDataUtils pathToMediaRecordsDB]] && ![fileManager fileExistsAtPath:[storeURL path]]) {
         NSURL *defaultStoreURL = [[NSBundle mainBundle] URLForResource:kMediaRecordsDBFile withExtension:kMediaRecordsDBFileExtension];
         if (defaultStoreURL) {
             NSError *error;
@@ -222,7 +649,7 @@ static NSString *const kCoreDataAccessErrorName = @"CoreDataAccessError";
     _persistentStoreCoordinator = [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel: [self managedObjectModel]];
     
     NSError *error;
-    if (![_persistentStoreCoordinator addPersistentStoreWithType:NSSQLiteStoreType
+    if (![_persistentStoreCoordinator addPersistentStoreWithType:_storeType
                                                    configuration:nil
                                                              URL:storeURL
                                                          options:options
@@ -235,49 +662,261 @@ static NSString *const kCoreDataAccessErrorName = @"CoreDataAccessError";
 }
 
 #pragma mark - private methods
-- (NSArray<CVMediaRecordMO *>*) listMediaRecords: (NSError **)__autoreleasing error{
+- (void) backgroundContextDidSave: (NSNotification *)notification {
+    // called on background context queue, so saved objects can be read here
+    @synchronized (_genreIDs) {
+        for (NSManagedObject *object in notification.userInfo[NSInsertedObjectsKey]) {
+            if ([object isKindOfClass:[CVGenreMO class]] && !object.objectID.isTemporaryID && [(CVGenreMO *)object name]) {
+                _genreIDs[[(CVGenreMO *)object name]] = object.objectID;
+            }
+        }
+        for (NSManagedObject *object in notification.userInfo[NSDeletedObjectsKey]) {
+            if ([object isKindOfClass:[CVGenreMO class]]) {
+                [_genreIDs removeObjectsForKeys:[_genreIDs allKeysForObject:object.objectID]];
+            }
+        }
+    }
+    [self updateSearchIndexWithSaveNotification:notification];
+    
+    NSManagedObjectContext *context = self.managedObjectContext;
+    [context performBlock:^{
+        [context mergeChangesFromContextDidSaveNotification:notification];
+    }];
+}
+
+- (void) writerContextWillSave: (NSNotification *)notification {
+    [self updateGenreCountsInContext:notification.object];
+}
+
+/**
+ * Applies changes of record genres to genre counts in the same save, must be called on writer queue.
+ * Writer saves are serialized and its committed values are those of store, so every change is counted
+ * exactly once. Counts changed in sibling contexts would overwrite each other on merge.
+ */
+- (void) updateGenreCountsInContext: (NSManagedObjectContext *)context {
+    NSCountedSet<CVGenreMO *> *added = [NSCountedSet set];
+    NSCountedSet<CVGenreMO *> *removed = [NSCountedSet set];
+    for (NSManagedObject *object in context.insertedObjects) {
+        if ([object isKindOfClass:[CVMediaRecordMO class]]) {
+            [added addObjectsFromArray:[[(CVMediaRecordMO *)object genres] array]];
+        }
+    }
+    for (NSManagedObject *object in context.deletedObjects) {
+        if ([object isKindOfClass:[CVMediaRecordMO class]]) {
+            [removed addObjectsFromArray:[[self committedGenresOfRecord:(CVMediaRecordMO *)object] allObjects]];
+        }
+    }
+    for (NSManagedObject *object in context.updatedObjects) {
+        if ([object isKindOfClass:[CVMediaRecordMO class]] && [object changedValues][@"genres"]) {
+            NSSet<CVGenreMO *> *oldGenres = [self committedGenresOfRecord:(CVMediaRecordMO *)object];
+            NSSet<CVGenreMO *> *newGenres = [[(CVMediaRecordMO *)object genres] set];
+            for (CVGenreMO *genre in newGenres) {
+                if (![oldGenres containsObject:genre]) {
+                    [added addObject:genre];
+                }
+            }
+            for (CVGenreMO *genre in oldGenres) {
+                if (![newGenres containsObject:genre]) {
+                    [removed addObject:genre];
+                }
+            }
+        }
+    }
+    NSMutableSet<CVGenreMO *> *genres = [NSMutableSet setWithSet:added];
+    [genres unionSet:removed];
+    for (CVGenreMO *genre in genres) {
+        NSInteger delta = (NSInteger)[added countForObject:genre] - (NSInteger)[removed countForObject:genre];
+        if (delta != 0 && !genre.isDeleted) {
+            genre.recordCount = @(MAX([genre.recordCount integerValue] + delta, 0));
+        }
+    }
+}
+
+- (NSSet<CVGenreMO *> *) committedGenresOfRecord: (CVMediaRecordMO *)record {
+    id genres = [record committedValuesForKeys:@[@"genres"]][@"genres"];
+    if ([genres isKindOfClass:[NSOrderedSet class]]) {
+        return [genres set];
+    } else if ([genres isKindOfClass:[NSSet class]]) {
+        return genres;
+    }
+    return [NSSet set];
+}
+
+- (void) viewContextDidSave: (NSNotification *)notification {
+    [self updateSearchIndexWithSaveNotification:notification];
+}
+
+/**
+ * Indexes records changed by save, must be called on the queue of saved context
+ */
+- (void) updateSearchIndexWithSaveNotification: (NSNotification *)notification {
+    CVSearchIndex *index = self.searchIndex;
+    if (!index) {
+        return;
+    }
+    NSMutableSet<CVMediaRecordMO *> *records = [NSMutableSet set];
+    for (NSString *key in @[NSInsertedObjectsKey, NSUpdatedObjectsKey]) {
+        for (NSManagedObject *object in notification.userInfo[key]) {
+            if ([object isKindOfClass:[CVMediaRecordMO class]]) {
+                [records addObject:(CVMediaRecordMO *)object];
+            } else if ([object isKindOfClass:[CVMediaTrack class]] && [(CVMediaTrack *)object record]) {
+                [records addObject:[(CVMediaTrack *)object record]];
+            }
+        }
+    }
+    for (NSManagedObject *object in notification.userInfo[NSDeletedObjectsKey]) {
+        if ([object isKindOfClass:[CVMediaRecordMO class]]) {
+            [index removeDocument:[[object.objectID URIRepresentation] absoluteString]];
+            [records removeObject:(CVMediaRecordMO *)object];
+        }
+    }
+    for (CVMediaRecordMO *record in records) {
+        if (!record.isDeleted) {
+            [self indexRecord:record inIndex:index];
+        }
+    }
+}
+
+- (void) indexRecord: (CVMediaRecordMO *)record inIndex: (CVSearchIndex *)index {
+    NSMutableDictionary<NSString *, NSNumber *> *texts = [NSMutableDictionary dictionaryWithCapacity:3];
+    NSMutableArray<NSString *> *trackNames = [NSMutableArray arrayWithCapacity:record.tracks.count];
+    for (CVMediaTrack *track in record.tracks) {
+        if (track.name) {
+            [trackNames addObject:track.name];
+        }
+    }
+    NSString *tracksText = [trackNames componentsJoinedByString:@"\n"];
+    for (NSArray *text in @[@[record.details ?: @"", @(kSearchDetailsWeight)],
+                            @[tracksText, @(kSearchTrackNameWeight)],
+                            @[record.title ?: @"", @(kSearchTitleWeight)]]) {
+        // equal texts keep the highest weight
+        texts[text[0]] = @(MAX([texts[text[0]] unsignedIntegerValue], [text[1] unsignedIntegerValue]));
+    }
+    [index indexDocument: [[record.objectID URIRepresentation] absoluteString]
+                   stamp: [record.dateAdded timeIntervalSinceReferenceDate]
+           weightedTexts: texts];
+}
+
+/**
+ * Saves writer context to persistent store, must be called on writer queue
+ */
+- (void) saveWriterContext {
+    NSError *error;
+    if ([_writerContext hasChanges] && ![_writerContext save:&error]) {
+        NSLog(@"Error saving writer context: %@\n%@", [error localizedDescription], [error userInfo]);
+    }
+}
+
+- (NSManagedObjectID *) permanentIDForObject: (NSManagedObject *)object {
+    if (object.objectID.isTemporaryID) {
+        // objects inserted into view context are not known to background contexts before save
+        NSError *error;
+        if (![object.managedObjectContext obtainPermanentIDsForObjects:@[object] error:&error]) {
+            NSLog(@"Failed to obtain permanent ID: %@\n%@", [error localizedDescription], [error userInfo]);
+        }
+        [self saveContext];
+    }
+    return object.objectID;
+}
+
+- (id) objectIDsFromResult: (id)result {
+    if ([result isKindOfClass:[NSManagedObject class]]) {
+        return [(NSManagedObject *)result objectID];
+    } else if ([result isKindOfClass:[NSArray class]]) {
+        NSMutableArray *ids = [NSMutableArray arrayWithCapacity:[result count]];
+        for (id item in result) {
+            [ids addObject:[self objectIDsFromResult:item]];
+        }
+        return ids;
+    }
+    return result;
+}
+
+- (id) objectsFromIDs: (id)ids inContext: (NSManagedObjectContext *)context {
+    if ([ids isKindOfClass:[NSManagedObjectID class]]) {
+        return [context objectWithID:ids];
+    } else if ([ids isKindOfClass:[NSArray class]]) {
+        NSMutableArray *objects = [NSMutableArray arrayWithCapacity:[ids count]];
+        for (id item in ids) {
+            [objects addObject:[self objectsFromIDs:item inContext:context]];
+        }
+        return objects;
+    } else if (ids == [NSNull null]) {
+        return nil;
+    }
+    return ids;
+}
+
+- (NSArray<NSManagedObjectID *>*) listMediaRecordIDsInContext: (NSManagedObjectContext *)context
+                                                     predicate: (NSPredicate *)predicate
+                                                         error: (NSError **)__autoreleasing error{
     NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+    [request setPredicate:predicate];
     NSSortDescriptor *orderByNeverSeen = [NSSortDescriptor sortDescriptorWithKey:@"neverPlayed" ascending:NO];
     NSSortDescriptor *orderByNewestFirst = [NSSortDescriptor sortDescriptorWithKey:@"dateAdded" ascending:NO];
     [request setSortDescriptors:@[orderByNeverSeen, orderByNewestFirst]];
-    NSArray *results = [self.managedObjectContext executeFetchRequest:request error:error];
-    if (!results) {
-        return nil;
-    }
-    return results;
+    // only IDs cross the queue boundary, view context faults records in when needed
+    [request setResultType:NSManagedObjectIDResultType];
+    return [context executeFetchRequest:request error:error];
 }
 
-- (CVMediaRecordMO *) findRecordByURL: (NSURL *) url {
+- (CVMediaRecordMO *) findRecordByURL: (NSURL *) url inContext: (NSManagedObjectContext *)context {
     NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
     [request setPredicate:[NSPredicate predicateWithFormat:@"pageUrl == %@", [url absoluteString]]];
+    // pageUrl is indexed, single row is enough
+    [request setFetchLimit:1];
     NSError *error = nil;
-    NSArray *results = [self.managedObjectContext executeFetchRequest:request error:&error];
+    NSArray *results = [context executeFetchRequest:request error:&error];
     if (!results) {
         NSLog(@"Error checking if media record exists: %@\n%@", [error localizedDescription], [error userInfo]);
         return nil;
     }
-    NSLog(@"Found: %lu records for URL: %@", (unsigned long)[results count], url);
     return [results firstObject];
 }
 
-- (CVGenreMO *) findGenreByName: (NSString *) name {
+- (CVGenreMO *) findGenreByName: (NSString *) name inContext: (NSManagedObjectContext *)context {
+    if (!name) {
+        return nil;
+    }
+    NSManagedObjectID *genreID;
+    @synchronized (_genreIDs) {
+        genreID = _genreIDs[name];
+    }
+    if (genreID) {
+        CVGenreMO *genre = [context existingObjectWithID:genreID error:nil];
+        if (genre && !genre.isDeleted) {
+            return genre;
+        }
+        // deleted meanwhile
+        @synchronized (_genreIDs) {
+            [_genreIDs removeObjectForKey:name];
+        }
+    }
+    
     NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kGenreEntityName];
     [request setPredicate:[NSPredicate predicateWithFormat:@"name == %@", name]];
+    [request setFetchLimit:1];
     NSError *error = nil;
-    NSArray *results = [self.managedObjectContext executeFetchRequest:request error:&error];
+    NSArray *results = [context executeFetchRequest:request error:&error];
     if (!results) {
-        NSLog(@"Error fetching Employee objects: %@\n%@", [error localizedDescription], [error userInfo]);
+        NSLog(@"Error fetching Genre objects: %@\n%@", [error localizedDescription], [error userInfo]);
         return nil;
     }
-    return [results firstObject];
+    CVGenreMO *genre = [results firstObject];
+    if (genre && !genre.objectID.isTemporaryID) {
+        @synchronized (_genreIDs) {
+            _genreIDs[name] = genre.objectID;
+        }
+    }
+    return genre;
 }
 
-- (CVGenreMO *) findOrCreateGenre:(NSString *) name {
-    CVGenreMO *genre = [self findGenreByName:name];
+- (CVGenreMO *) findOrCreateGenre:(NSString *) name inContext: (NSManagedObjectContext *)context {
+    CVGenreMO *genre = [self findGenreByName:name inContext:context];
     if (!genre) {
         // create new genre record
         genre = [NSEntityDescription insertNewObjectForEntityForName: kGenreEntityName
-                                              inManagedObjectContext: [self managedObjectContext]];
+                                              inManagedObjectContext: context];
         genre.name = name;
     }
     return genre;
@@ -16,6 +16,7 @@ NS_ASSUME_NONNULL_BEGIN
 @interface CVGenreMO (CoreDataProperties)
 
 @property (nullable, nonatomic, retain) NSString *name;
+@property (nullable, nonatomic, retain) NSNumber *recordCount;
 @property (nullable, nonatomic, retain) NSSet<CVMediaRecordMO *> *records;
 
 @end
@@ -14,6 +14,7 @@
 @implementation CVGenreMO (CoreDataProperties)
 
 @dynamic name;
+@dynamic recordCount;
 @dynamic records;
 
 @end
@@ -0,0 +1,70 @@
+//
+//  CVLibraryTransfer.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+#import <Bolts/Bolts.h>
+
+#import "CVCoreDataController.h"
+#import "ExMediaLoader.h"
+#import "PlaybackPositionStore.h"
+
+/**
+ * The bulk import and export of media library. Library is written as newline delimited JSON: the header
+ * line followed by one line per media record with its genres, tracks and play positions, e.g.
+ *
+ *   {"format":"castvideos-library","version":1}
+ *   {"pageUrl":"...","title":"...","dateAdded":1476700000,"genres":["Drama"],"tracks":[{"name":"...","address":"...","playTime":12.5}]}
+ *
+ * Files are streamed and processed in batches on background context, so memory use does not depend
+ * on library size. Imported records are matched by page URL, tracks by address.
+ *
+ * Records known by page URL only, e.g. migrated from legacy media list, are stubs: their title is the
+ * page URL and thumbnail URL is empty until they are completed from their pages.
+ */
+@interface CVLibraryTransfer : NSObject
+
+// The number of records processed by single batch, 500 by default
+@property (nonatomic, assign) NSUInteger batchSize;
+// The loader of pages of stub records, the shared loader by default
+@property (nonatomic, strong) ExMediaLoader *__nonnull mediaLoader;
+// The store of playback positions flushed before export, so pending positions are exported too
+@property (nonatomic, strong) PlaybackPositionStore *__nullable positionStore;
+
+/*!
+ Creates transfer working with specified data controller
+ */
+- (instancetype __nonnull) initWithDataController: (CVCoreDataController *__nonnull)dataController;
+
+/*!
+ Writes all media records to file, existing file is replaced. Positions pending in position store are
+ written to Core Data first, export fails if they could not be written. Must be called from main queue.
+ @return BFTask completed on main queue with number of exported records
+ */
+- (BFTask *__nonnull) exportToURL: (NSURL *__nonnull)fileURL;
+
+/*!
+ Reads media records from file. Records with known page URL are updated with values present in file,
+ the others are inserted. Malformed lines are skipped.
+ @return BFTask completed on main queue with number of imported records
+ */
+- (BFTask *__nonnull) importFromURL: (NSURL *__nonnull)fileURL;
+
+/*!
+ Moves page URLs of legacy media list into Core Data once, list file is renamed afterwards. Pages keep
+ their order and are stored as stub records. Pages already stored are left untouched.
+ @return BFTask completed on main queue with number of migrated records
+ */
+- (BFTask *__nonnull) migrateLegacyMediaList;
+
+/*!
+ Loads pages of stub records and sets their title, description and thumbnail. Few pages are loaded at
+ once. Records which pages failed to load or have no thumbnail stay stubs for the next run.
+ @return BFTask completed on main queue with number of completed records
+ */
+- (BFTask *__nonnull) completeStubRecords;
+
+@end
@@ -0,0 +1,607 @@
+//
+//  CVLibraryTransfer.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "CVLibraryTransfer.h"
+
+#import "SharedDataUtils.h"
+#import "CVMediaRecordMO+CoreDataProperties.h"
+#import "CVGenreMO+CoreDataProperties.h"
+#import "CVMediaTrack+CoreDataProperties.h"
+#import "CVMediaTrack.h"
+#import "ExMedia.h"
+
+// The library file header
+static NSString *const kLibraryFormat = @"castvideos-library";
+static const NSInteger kLibraryVersion = 1;
+// The error domain of library transfer
+static NSString *const kLibraryTransferErrorDomain = @"CVLibraryTransferError";
+// The default number of records per batch
+static const NSUInteger kDefaultBatchSize = 500;
+// The size of chunk read from file at once
+static const NSUInteger kReadChunkSize = 64 * 1024;
+// The default MIME type of imported records
+static NSString *const kDefaultMimeType = @"video/mp4";
+// The thumbnail URL of stub record
+static NSString *const kStubThumbnailUrl = @"";
+// The number of stub record pages loaded at once
+static const NSUInteger kStubLoadConcurrency = 4;
+
+static NSString *StringValue(id value) {
+    return [value isKindOfClass:[NSString class]] ? value : nil;
+}
+
+static NSNumber *NumberValue(id value) {
+    return [value isKindOfClass:[NSNumber class]] ? value : nil;
+}
+
+/**
+ * Reads file line by line keeping only the current chunk in memory
+ */
+@interface CVLineReader : NSObject
+
+// The error of underlying stream if reading failed
+@property (nonatomic, strong, readonly) NSError *error;
+
+- (instancetype) initWithURL:(NSURL *)url;
+
+/*!
+ Returns the next line without line terminator or nil at the end of file
+ */
+- (NSData *) nextLine;
+
+- (void) close;
+
+@end
+
+@implementation CVLineReader {
+    NSInputStream *_stream;
+    // The bytes read but not returned yet, starting at offset
+    NSMutableData *_buffer;
+    NSUInteger _offset;
+    BOOL _endOfStream;
+}
+
+- (instancetype) initWithURL:(NSURL *)url {
+    self = [super init];
+    if (self) {
+        _stream = [NSInputStream inputStreamWithURL:url];
+        [_stream open];
+        _buffer = [NSMutableData dataWithCapacity:kReadChunkSize];
+    }
+    return self;
+}
+
+- (NSError *) error {
+    return _stream ? _stream.streamError : [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadNoSuchFileError userInfo:nil];
+}
+
+- (NSData *) nextLine {
+    while (YES) {
+        const uint8_t *bytes = _buffer.bytes;
+        NSUInteger length = _buffer.length;
+        const uint8_t *newline = length > _offset ? memchr(bytes + _offset, '\n', length - _offset) : NULL;
+        if (newline) {
+            NSUInteger end = newline - bytes;
+            NSData *line = [_buffer subdataWithRange:NSMakeRange(_offset, end - _offset)];
+            _offset = end + 1;
+            return line;
+        }
+        if (_endOfStream) {
+            if (_offset < length) {
+                // the last line without terminator
+                NSData *line = [_buffer subdataWithRange:NSMakeRange(_offset, length - _offset)];
+                _offset = length;
+                return line;
+            }
+            return nil;
+        }
+        // drop returned lines and read the next chunk
+        [_buffer replaceBytesInRange:NSMakeRange(0, _offset) withBytes:NULL length:0];
+        _offset = 0;
+        length = _buffer.length;
+        [_buffer setLength:length + kReadChunkSize];
+        NSInteger read = [_stream read:(uint8_t *)_buffer.mutableBytes + length maxLength:kReadChunkSize];
+        [_buffer setLength:length + MAX(read, 0)];
+        if (read <= 0) {
+            _endOfStream = YES;
+        }
+    }
+}
+
+- (void) close {
+    [_stream close];
+}
+
+@end
+
+@implementation CVLibraryTransfer {
+    CVCoreDataController *_dataController;
+}
+
+- (instancetype) initWithDataController: (CVCoreDataController *)dataController {
+    self = [super init];
+    if (self) {
+        _dataController = dataController;
+        _batchSize = kDefaultBatchSize;
+        _mediaLoader = [ExMediaLoader sharedLoader];
+    }
+    return self;
+}
+
+- (BFTask *) exportToURL: (NSURL *)fileURL {
+    BFTask *flushed = self.positionStore ? [self.positionStore flush] : [BFTask taskWithResult:nil];
+    return [flushed continueWithBlock:^id (BFTask *task) {
+        if (task.faulted) {
+            NSLog(@"Failed to write playback positions before export, reason: %@", task.error ?: task.exception);
+            return task;
+        }
+        return [self exportRecordsToURL:fileURL];
+    }];
+}
+
+- (BFTask *) importFromURL: (NSURL *)fileURL {
+    CVLineReader *reader = [[CVLineReader alloc] initWithURL:fileURL];
+    NSUInteger batchSize = MAX(self.batchSize, 1);
+    CFAbsoluteTime started = CFAbsoluteTimeGetCurrent();
+    __block NSUInteger imported = 0;
+    __block NSUInteger skipped = 0;
+    return [[_dataController performBatchedBackgroundTask:^BOOL (NSManagedObjectContext *context, BOOL *stop, NSError **error) {
+        NSMutableArray<NSDictionary *> *items = [NSMutableArray arrayWithCapacity:batchSize];
+        NSData *line = nil;
+        while (items.count < batchSize && (line = [reader nextLine])) {
+            if (line.length == 0) {
+                continue;
+            }
+            id item = [NSJSONSerialization JSONObjectWithData:line options:0 error:nil];
+            if (![item isKindOfClass:[NSDictionary class]]) {
+                skipped++;
+            } else if (item[@"format"]) {
+                if (![kLibraryFormat isEqual:item[@"format"]] || [NumberValue(item[@"version"]) integerValue] > kLibraryVersion) {
+                    *error = [NSError errorWithDomain: kLibraryTransferErrorDomain
+                                                 code: NSFileReadCorruptFileError
+                                             userInfo: @{NSLocalizedDescriptionKey: @"Unsupported media library file format"}];
+                    return NO;
+                }
+            } else if (!StringValue(item[@"pageUrl"])) {
+                skipped++;
+            } else {
+                [items addObject:item];
+            }
+        }
+        if (!line) {
+            if (reader.error) {
+                *error = reader.error;
+                return NO;
+            }
+            *stop = YES;
+        }
+        NSUInteger count = [self storeItems:items updateExisting:YES inContext:context error:error];
+        if (count == NSNotFound) {
+            return NO;
+        }
+        imported += count;
+        return YES;
+    }] continueWithBlock:^id (BFTask *task) {
+        [reader close];
+        if (task.faulted) {
+            NSLog(@"Failed to import media library from: %@, reason: %@", fileURL, task.error ?: task.exception);
+            return task;
+        }
+        CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - started;
+        NSLog(@"Imported %lu media records in %.2f s, %.0f records/s, %lu malformed lines skipped",
+              (unsigned long)imported, elapsed, imported / MAX(elapsed, 0.001), (unsigned long)skipped);
+        return @(imported);
+    }];
+}
+
+- (BFTask *) migrateLegacyMediaList {
+    NSURL *listURL = [SharedDataUtils pathToMediaFile];
+    NSArray *urls = listURL ? [NSArray arrayWithContentsOfURL:listURL] : nil;
+    if (urls.count == 0) {
+        return [BFTask taskWithResult:@0];
+    }
+    // legacy list is ordered oldest first
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    NSMutableArray<NSDictionary *> *items = [NSMutableArray arrayWithCapacity:urls.count];
+    [urls enumerateObjectsUsingBlock:^(id url, NSUInteger idx, BOOL *stop) {
+        if (StringValue(url)) {
+            [items addObject:@{@"pageUrl": url, @"dateAdded": @(now - (NSTimeInterval)(urls.count - idx))}];
+        }
+    }];
+
+    NSUInteger batchSize = MAX(self.batchSize, 1);
+    __block NSUInteger position = 0;
+    __block NSUInteger migrated = 0;
+    return [[_dataController performBatchedBackgroundTask:^BOOL (NSManagedObjectContext *context, BOOL *stop, NSError **error) {
+        NSRange range = NSMakeRange(position, MIN(batchSize, items.count - position));
+        NSUInteger count = [self storeItems:[items subarrayWithRange:range] updateExisting:NO inContext:context error:error];
+        if (count == NSNotFound) {
+            return NO;
+        }
+        migrated += count;
+        position = NSMaxRange(range);
+        *stop = position >= items.count;
+        return YES;
+    }] continueWithBlock:^id (BFTask *task) {
+        if (task.faulted) {
+            NSLog(@"Failed to migrate legacy media list, reason: %@", task.error ?: task.exception);
+            return task;
+        }
+        // keep the list aside instead of deleting, so it is not migrated again
+        NSURL *migratedURL = [listURL URLByAppendingPathExtension:@"migrated"];
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        NSError *error;
+        [fileManager removeItemAtURL:migratedURL error:nil];
+        if (![fileManager moveItemAtURL:listURL toURL:migratedURL error:&error]) {
+            NSLog(@"Failed to rename migrated media list, reason: %@", error);
+        }
+        NSLog(@"Migrated %lu of %lu legacy media list pages", (unsigned long)migrated, (unsigned long)urls.count);
+        return @(migrated);
+    }];
+}
+
+- (BFTask *) completeStubRecords {
+    ExMediaLoader *loader = self.mediaLoader;
+    return [[_dataController performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+        [request setPredicate:[NSPredicate predicateWithFormat:@"thumbnailUrl == %@", kStubThumbnailUrl]];
+        [request setSortDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"dateAdded" ascending:NO]]];
+        [request setResultType:NSDictionaryResultType];
+        [request setPropertiesToFetch:@[@"pageUrl"]];
+        NSArray<NSDictionary *> *rows = [context executeFetchRequest:request error:error];
+        return rows ? [rows valueForKey:@"pageUrl"] : nil;
+    }] continueWithSuccessBlock:^id (BFTask *task) {
+        NSArray<NSString *> *urls = task.result;
+        if (urls.count == 0) {
+            return @0;
+        }
+        // every lane loads its pages one after another
+        NSUInteger laneCount = MIN(kStubLoadConcurrency, urls.count);
+        NSMutableArray<BFTask *> *lanes = [NSMutableArray arrayWithCapacity:laneCount];
+        __block NSUInteger completed = 0;
+        for (NSUInteger lane = 0; lane < laneCount; lane++) {
+            BFTask *chain = [BFTask taskWithResult:nil];
+            for (NSUInteger i = lane; i < urls.count; i += laneCount) {
+                NSString *url = urls[i];
+                chain = [chain continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *previous) {
+                    return [[self completeStubRecordWithURL:url loader:loader] continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *stored) {
+                        if ([stored.result boolValue]) {
+                            completed++;
+                        }
+                        return nil;
+                    }];
+                }];
+            }
+            [lanes addObject:chain];
+        }
+        return [[BFTask taskForCompletionOfAllTasks:lanes] continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *all) {
+            NSLog(@"Completed %lu of %lu stub media records", (unsigned long)completed, (unsigned long)urls.count);
+            return @(completed);
+        }];
+    }];
+}
+
+#pragma mark - private
+
+/**
+ * Streams records stored in Core Data to file by batches
+ */
+- (BFTask *) exportRecordsToURL: (NSURL *)fileURL {
+    NSOutputStream *stream = [NSOutputStream outputStreamWithURL:fileURL append:NO];
+    [stream open];
+    NSUInteger batchSize = MAX(self.batchSize, 1);
+    CFAbsoluteTime started = CFAbsoluteTimeGetCurrent();
+    __block NSArray<NSManagedObjectID *> *recordIDs = nil;
+    __block NSUInteger position = 0;
+    return [[_dataController performBatchedBackgroundTask:^BOOL (NSManagedObjectContext *context, BOOL *stop, NSError **error) {
+        if (!recordIDs) {
+            // only IDs of the whole library are kept, records are fetched by batches
+            NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+            [request setSortDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"dateAdded" ascending:YES]]];
+            [request setResultType:NSManagedObjectIDResultType];
+            recordIDs = [context executeFetchRequest:request error:error];
+            if (!recordIDs || ![self writeObject:@{@"format": kLibraryFormat, @"version": @(kLibraryVersion)}
+                                        toStream:stream
+                                           error:error]) {
+                return NO;
+            }
+        }
+        NSRange range = NSMakeRange(position, MIN(batchSize, recordIDs.count - position));
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+        [request setPredicate:[NSPredicate predicateWithFormat:@"self IN %@", [recordIDs subarrayWithRange:range]]];
+        [request setSortDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"dateAdded" ascending:YES]]];
+        [request setRelationshipKeyPathsForPrefetching:@[@"genres", @"tracks"]];
+        NSArray<CVMediaRecordMO *> *records = [context executeFetchRequest:request error:error];
+        if (!records) {
+            return NO;
+        }
+        for (CVMediaRecordMO *record in records) {
+            if (![self writeObject:[self itemFromRecord:record] toStream:stream error:error]) {
+                return NO;
+            }
+        }
+        position = NSMaxRange(range);
+        *stop = position >= recordIDs.count;
+        return YES;
+    }] continueWithBlock:^id (BFTask *task) {
+        [stream close];
+        if (task.faulted) {
+            NSLog(@"Failed to export media library to: %@, reason: %@", fileURL, task.error ?: task.exception);
+            return task;
+        }
+        CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - started;
+        NSLog(@"Exported %lu media records in %.2f s, %.0f records/s",
+              (unsigned long)recordIDs.count, elapsed, recordIDs.count / MAX(elapsed, 0.001));
+        return @(recordIDs.count);
+    }];
+}
+
+/**
+ * Loads page of stub record and completes the record, the returned task never fails and is completed
+ * with YES if record was completed
+ */
+- (BFTask *) completeStubRecordWithURL: (NSString *)url loader: (ExMediaLoader *)loader {
+    NSURL *pageURL = [NSURL URLWithString:url];
+    if (!pageURL) {
+        return [BFTask taskWithResult:@NO];
+    }
+    BFTaskCompletionSource *page = [BFTaskCompletionSource taskCompletionSource];
+    [loader loadMediaFromURL:pageURL withCompletion:^(ExMedia *media, ExMediaLoadMetrics *metrics, NSError *error) {
+        if (media) {
+            [page setResult:media];
+        } else {
+            [page setError:error ?: [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotParseResponse userInfo:nil]];
+        }
+    }];
+    return [[page.task continueWithSuccessBlock:^id (BFTask *task) {
+        ExMedia *media = task.result;
+        NSString *thumbnailUrl = (media.thumbnailURL ?: media.posterURL).absoluteString;
+        if (thumbnailUrl.length == 0) {
+            return @NO;
+        }
+        return [_dataController performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+            NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+            [request setPredicate:[NSPredicate predicateWithFormat:@"pageUrl == %@ AND thumbnailUrl == %@", url, kStubThumbnailUrl]];
+            NSArray<CVMediaRecordMO *> *records = [context executeFetchRequest:request error:error];
+            if (!records) {
+                return nil;
+            }
+            for (CVMediaRecordMO *record in records) {
+                if (media.title.length > 0) {
+                    record.title = media.title;
+                }
+                if (media.descrip.length > 0) {
+                    record.details = media.descrip;
+                }
+                record.thumbnailUrl = thumbnailUrl;
+            }
+            return @(records.count > 0);
+        }];
+    }] continueWithBlock:^id (BFTask *task) {
+        if (task.faulted) {
+            NSLog(@"Failed to complete stub media record: %@, reason: %@", url, task.error ?: task.exception);
+            return @NO;
+        }
+        return @([task.result boolValue]);
+    }];
+}
+
+- (BOOL) writeObject: (id)object toStream: (NSOutputStream *)stream error: (NSError **)error {
+    NSMutableData *data = [[NSJSONSerialization dataWithJSONObject:object options:0 error:error] mutableCopy];
+    if (!data) {
+        return NO;
+    }
+    [data appendBytes:"\n" length:1];
+    const uint8_t *bytes = data.bytes;
+    NSUInteger written = 0;
+    while (written < data.length) {
+        NSInteger result = [stream write:bytes + written maxLength:data.length - written];
+        if (result <= 0) {
+            if (error) {
+                *error = stream.streamError ?: [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:nil];
+            }
+            return NO;
+        }
+        written += result;
+    }
+    return YES;
+}
+
+- (NSDictionary *) itemFromRecord: (CVMediaRecordMO *)record {
+    NSMutableDictionary *item = [NSMutableDictionary dictionaryWithCapacity:10];
+    item[@"pageUrl"] = record.pageUrl;
+    item[@"title"] = record.title;
+    item[@"details"] = record.details;
+    item[@"thumbnailUrl"] = record.thumbnailUrl;
+    item[@"mimeType"] = record.mimeType;
+    item[@"dateAdded"] = record.dateAdded ? @([record.dateAdded timeIntervalSince1970]) : nil;
+    item[@"neverPlayed"] = record.neverPlayed;
+    item[@"valid"] = record.valid;
+
+    NSMutableArray<NSString *> *genres = [NSMutableArray arrayWithCapacity:record.genres.count];
+    for (CVGenreMO *genre in record.genres) {
+        if (genre.name) {
+            [genres addObject:genre.name];
+        }
+    }
+    item[@"genres"] = genres;
+
+    NSMutableArray<NSDictionary *> *tracks = [NSMutableArray arrayWithCapacity:record.tracks.count];
+    for (CVMediaTrack *track in record.tracks) {
+        if (track.address) {
+            [tracks addObject:@{@"name": track.name ?: @"",
+                                @"address": track.address,
+                                @"playTime": track.playTime ?: @0}];
+        }
+    }
+    item[@"tracks"] = tracks;
+    return item;
+}
+
+/**
+ * Inserts or updates records of batch with two fetches in total, returns number of stored records
+ * or NSNotFound if failed
+ */
+- (NSUInteger) storeItems: (NSArray<NSDictionary *> *)items
+           updateExisting: (BOOL)updateExisting
+                inContext: (NSManagedObjectContext *)context
+                    error: (NSError **)error {
+    if (items.count == 0) {
+        return 0;
+    }
+    NSMutableSet<NSString *> *urls = [NSMutableSet setWithCapacity:items.count];
+    NSMutableSet<NSString *> *genreNames = [NSMutableSet set];
+    for (NSDictionary *item in items) {
+        [urls addObject:item[@"pageUrl"]];
+        for (id name in [item[@"genres"] isKindOfClass:[NSArray class]] ? item[@"genres"] : @[]) {
+            if (StringValue(name)) {
+                [genreNames addObject:name];
+            }
+        }
+    }
+
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+    [request setPredicate:[NSPredicate predicateWithFormat:@"pageUrl IN %@", urls]];
+    if (updateExisting) {
+        [request setRelationshipKeyPathsForPrefetching:@[@"tracks"]];
+    }
+    NSArray<CVMediaRecordMO *> *existing = [context executeFetchRequest:request error:error];
+    if (!existing) {
+        return NSNotFound;
+    }
+    NSMutableDictionary<NSString *, CVMediaRecordMO *> *records = [NSMutableDictionary dictionaryWithCapacity:items.count];
+    for (CVMediaRecordMO *record in existing) {
+        records[record.pageUrl] = record;
+    }
+
+    NSMutableDictionary<NSString *, CVGenreMO *> *genres = [NSMutableDictionary dictionaryWithCapacity:genreNames.count];
+    if (genreNames.count > 0) {
+        request = [NSFetchRequest fetchRequestWithEntityName:kGenreEntityName];
+        [request setPredicate:[NSPredicate predicateWithFormat:@"name IN %@", genreNames]];
+        NSArray<CVGenreMO *> *stored = [context executeFetchRequest:request error:error];
+        if (!stored) {
+            return NSNotFound;
+        }
+        for (CVGenreMO *genre in stored) {
+            genres[genre.name] = genre;
+        }
+    }
+
+    NSUInteger count = 0;
+    for (NSDictionary *item in items) {
+        NSString *url = item[@"pageUrl"];
+        CVMediaRecordMO *record = records[url];
+        if (record && !updateExisting) {
+            continue;
+        }
+        if (!record) {
+            record = [NSEntityDescription insertNewObjectForEntityForName: kMediaRecordEntityName
+                                                   inManagedObjectContext: context];
+            record.pageUrl = url;
+            record.title = url;
+            record.thumbnailUrl = kStubThumbnailUrl;
+            record.mimeType = kDefaultMimeType;
+            record.dateAdded = [NSDate date];
+            records[url] = record;
+        }
+        [self applyItem:item toRecord:record genres:genres inContext:context];
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Sets values present in item to record, genres missing from cache are created
+ */
+- (void) applyItem: (NSDictionary *)item
+          toRecord: (CVMediaRecordMO *)record
+            genres: (NSMutableDictionary<NSString *, CVGenreMO *> *)genres
+         inContext: (NSManagedObjectContext *)context {
+    NSString *value;
+    if ((value = StringValue(item[@"title"]))) {
+        record.title = value;
+    }
+    if ((value = StringValue(item[@"details"]))) {
+        record.details = value;
+    }
+    if ((value = StringValue(item[@"thumbnailUrl"]))) {
+        record.thumbnailUrl = value;
+    }
+    if ((value = StringValue(item[@"mimeType"]))) {
+        record.mimeType = value;
+    }
+    NSNumber *number;
+    if ((number = NumberValue(item[@"dateAdded"]))) {
+        record.dateAdded = [NSDate dateWithTimeIntervalSince1970:[number doubleValue]];
+    }
+    if ((number = NumberValue(item[@"neverPlayed"]))) {
+        record.neverPlayed = @([number boolValue]);
+    }
+    if ((number = NumberValue(item[@"valid"]))) {
+        record.valid = @([number boolValue]);
+    }
+
+    if ([item[@"genres"] isKindOfClass:[NSArray class]]) {
+        NSMutableOrderedSet<CVGenreMO *> *recordGenres = [NSMutableOrderedSet orderedSetWithCapacity:[item[@"genres"] count]];
+        for (id name in item[@"genres"]) {
+            if (!StringValue(name)) {
+                continue;
+            }
+            CVGenreMO *genre = genres[name];
+            if (!genre) {
+                genre = [NSEntityDescription insertNewObjectForEntityForName: kGenreEntityName
+                                                      inManagedObjectContext: context];
+                genre.name = name;
+                genres[name] = genre;
+            }
+            [recordGenres addObject:genre];
+        }
+        if (![record.genres isEqualToOrderedSet:recordGenres]) {
+            record.genres = recordGenres;
+        }
+    }
+
+    if ([item[@"tracks"] isKindOfClass:[NSArray class]]) {
+        NSMutableDictionary<NSString *, CVMediaTrack *> *existing = [NSMutableDictionary dictionaryWithCapacity:record.tracks.count];
+        for (CVMediaTrack *track in record.tracks) {
+            if (track.address && !existing[track.address]) {
+                existing[track.address] = track;
+            } else {
+                [context deleteObject:track];
+            }
+        }
+        NSMutableOrderedSet<CVMediaTrack *> *tracks = [NSMutableOrderedSet orderedSetWithCapacity:[item[@"tracks"] count]];
+        for (id trackItem in item[@"tracks"]) {
+            NSString *address = [trackItem isKindOfClass:[NSDictionary class]] ? StringValue(trackItem[@"address"]) : nil;
+            if (!address) {
+                continue;
+            }
+            CVMediaTrack *track = existing[address];
+            if (track) {
+                [existing removeObjectForKey:address];
+            } else {
+                track = [NSEntityDescription insertNewObjectForEntityForName: kMediaTrackEntityName
+                                                      inManagedObjectContext: context];
+                track.address = address;
+                track.name = @"";
+            }
+            if ((value = StringValue(trackItem[@"name"]))) {
+                track.name = value;
+            }
+            if ((number = NumberValue(trackItem[@"playTime"]))) {
+                track.playTime = number;
+            }
+            [tracks addObject:track];
+        }
+        for (CVMediaTrack *track in [existing allValues]) {
+            [context deleteObject:track];
+        }
+        record.tracks = tracks;
+    }
+}
+
+@end
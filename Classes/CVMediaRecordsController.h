@@ -0,0 +1,92 @@
+//
+//  CVMediaRecordsController.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+
+#import "CVMediaRecordMO.h"
+
+@class CVMediaRecordsController;
+
+/**
+ * The type of change of single record in the list
+ */
+typedef NS_ENUM(NSUInteger, CVMediaRecordChangeType) {
+    CVMediaRecordChangeInsert = 1,
+    CVMediaRecordChangeDelete,
+    CVMediaRecordChangeMove,
+    CVMediaRecordChangeUpdate
+};
+
+/**
+ * The delegate receiving row level changes of the records list
+ */
+@protocol CVMediaRecordsControllerDelegate <NSObject>
+
+/*!
+ Called before the batch of changes is reported
+ */
+- (void) recordsControllerWillChangeContent: (CVMediaRecordsController *__nonnull)controller;
+
+/*!
+ Called for every changed record. Indexes of delete, move source and update refer to the list before the
+ batch, indexes of insert and move destination refer to the list after it.
+ */
+- (void) recordsController: (CVMediaRecordsController *__nonnull)controller
+           didChangeRecord: (CVMediaRecordMO *__nonnull)record
+                   atIndex: (NSUInteger)index
+             forChangeType: (CVMediaRecordChangeType)type
+                  newIndex: (NSUInteger)newIndex;
+
+/*!
+ Called after the batch of changes was reported
+ */
+- (void) recordsControllerDidChangeContent: (CVMediaRecordsController *__nonnull)controller;
+
+/*!
+ Called when the whole list was replaced, e.g. after reload
+ */
+- (void) recordsControllerDidReloadContent: (CVMediaRecordsController *__nonnull)controller;
+
+@end
+
+/**
+ * The controller of media records list ordered by never played first and newest first. Records are
+ * loaded by pages using keyset pagination, so the cost of opening the list does not depend on library
+ * size. Changes of the managed object context, including merged background saves, are reported to
+ * delegate as row level inserts, deletes, moves and updates of the loaded records.
+ * It must be used on the queue of its context.
+ */
+@interface CVMediaRecordsController : NSObject
+
+// The delegate to report changes to
+@property (nonatomic, weak) id<CVMediaRecordsControllerDelegate> __nullable delegate;
+// The filter of records, e.g. by genres, takes effect on reload
+@property (nonatomic, strong) NSPredicate *__nullable predicate;
+// The number of records loaded by single page, 50 by default
+@property (nonatomic, assign) NSUInteger pageSize;
+// The loaded records
+@property (nonatomic, strong, readonly) NSArray<CVMediaRecordMO *> *__nonnull records;
+// Indicates whether there are records after the last loaded page
+@property (nonatomic, assign, readonly) BOOL hasMoreRecords;
+
+/*!
+ Creates controller observing specified context
+ */
+- (instancetype __nonnull) initWithManagedObjectContext: (NSManagedObjectContext *__nonnull)context;
+
+/*!
+ Drops loaded records and loads the first page. Delegate receives reload notification.
+ */
+- (BOOL) reload: (NSError *__autoreleasing __nullable *__nullable)error;
+
+/*!
+ Loads the page after the last loaded record. Loaded records are reported to delegate as inserts.
+ */
+- (BOOL) loadNextPage: (NSError *__autoreleasing __nullable *__nullable)error;
+
+@end
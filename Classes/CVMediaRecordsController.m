@@ -0,0 +1,283 @@
+//
+//  CVMediaRecordsController.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "CVMediaRecordsController.h"
+
+// The default number of records in page
+static const NSUInteger kDefaultPageSize = 50;
+
+/**
+ * Compares sort keys of two records: never played first, then newest first
+ */
+static NSComparisonResult CompareRecordKeys(NSArray *keys, NSArray *otherKeys) {
+    NSComparisonResult result = [otherKeys[0] compare:keys[0]];
+    if (result == NSOrderedSame) {
+        result = [otherKeys[1] compare:keys[1]];
+    }
+    return result;
+}
+
+static NSArray *RecordKeys(CVMediaRecordMO *record) {
+    return @[record.neverPlayed ?: @YES, record.dateAdded ?: [NSDate distantPast]];
+}
+
+@implementation CVMediaRecordsController {
+    // The observed context
+    NSManagedObjectContext *_context;
+    // The loaded records in display order
+    NSMutableArray<CVMediaRecordMO *> *_records;
+    // The sort keys of loaded records as they were when last reported
+    NSMutableDictionary<NSManagedObjectID *, NSArray *> *_keys;
+}
+
+- (instancetype) initWithManagedObjectContext: (NSManagedObjectContext *)context {
+    self = [super init];
+    if (self) {
+        _context = context;
+        _pageSize = kDefaultPageSize;
+        _records = [NSMutableArray array];
+        _keys = [NSMutableDictionary dictionary];
+        [[NSNotificationCenter defaultCenter] addObserver: self
+                                                 selector: @selector(contextObjectsDidChange:)
+                                                     name: NSManagedObjectContextObjectsDidChangeNotification
+                                                   object: context];
+    }
+    return self;
+}
+
+- (void) dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (NSArray<CVMediaRecordMO *> *) records {
+    // not copied, it is read by table view for every row
+    return _records;
+}
+
+- (BOOL) reload: (NSError **)error {
+    NSArray<CVMediaRecordMO *> *page = [self fetchPageAfterRecord:nil error:error];
+    if (!page) {
+        return NO;
+    }
+    [_records setArray:page];
+    [_keys removeAllObjects];
+    for (CVMediaRecordMO *record in page) {
+        _keys[record.objectID] = RecordKeys(record);
+    }
+    [self.delegate recordsControllerDidReloadContent:self];
+    return YES;
+}
+
+- (BOOL) loadNextPage: (NSError **)error {
+    if (!self.hasMoreRecords) {
+        return YES;
+    }
+    NSArray<CVMediaRecordMO *> *page = [self fetchPageAfterRecord:[_records lastObject] error:error];
+    if (!page) {
+        return NO;
+    }
+    if (page.count == 0) {
+        return YES;
+    }
+    [self.delegate recordsControllerWillChangeContent:self];
+    for (CVMediaRecordMO *record in page) {
+        _keys[record.objectID] = RecordKeys(record);
+        [_records addObject:record];
+        [self.delegate recordsController: self
+                         didChangeRecord: record
+                                 atIndex: NSNotFound
+                           forChangeType: CVMediaRecordChangeInsert
+                                newIndex: _records.count - 1];
+    }
+    [self.delegate recordsControllerDidChangeContent:self];
+    return YES;
+}
+
+#pragma mark - private
+
+- (NSArray<CVMediaRecordMO *> *) fetchPageAfterRecord: (CVMediaRecordMO *)last error: (NSError **)error {
+    NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+    NSSortDescriptor *orderByNeverSeen = [NSSortDescriptor sortDescriptorWithKey:@"neverPlayed" ascending:NO];
+    NSSortDescriptor *orderByNewestFirst = [NSSortDescriptor sortDescriptorWithKey:@"dateAdded" ascending:NO];
+    [request setSortDescriptors:@[orderByNeverSeen, orderByNewestFirst]];
+
+    NSMutableSet<NSManagedObjectID *> *loadedTies = [NSMutableSet set];
+    NSMutableArray<NSPredicate *> *predicates = [NSMutableArray arrayWithCapacity:2];
+    if (self.predicate) {
+        [predicates addObject:self.predicate];
+    }
+    if (last) {
+        // keyset condition, records sharing the key of the last one are fetched again and skipped
+        NSArray *lastKeys = RecordKeys(last);
+        [predicates addObject:[NSPredicate predicateWithFormat:@"neverPlayed < %@ OR (neverPlayed == %@ AND dateAdded <= %@)",
+                               lastKeys[0], lastKeys[0], lastKeys[1]]];
+        for (CVMediaRecordMO *record in [_records reverseObjectEnumerator]) {
+            if (CompareRecordKeys(RecordKeys(record), lastKeys) != NSOrderedSame) {
+                break;
+            }
+            [loadedTies addObject:record.objectID];
+        }
+    }
+    if (predicates.count > 0) {
+        [request setPredicate:[NSCompoundPredicate andPredicateWithSubpredicates:predicates]];
+    }
+    [request setFetchLimit:self.pageSize + loadedTies.count];
+    [request setFetchBatchSize:self.pageSize];
+
+    NSArray<CVMediaRecordMO *> *results = [_context executeFetchRequest:request error:error];
+    if (!results) {
+        return nil;
+    }
+    _hasMoreRecords = results.count == request.fetchLimit;
+    if (loadedTies.count == 0) {
+        return results;
+    }
+    NSMutableArray<CVMediaRecordMO *> *page = [NSMutableArray arrayWithCapacity:results.count];
+    for (CVMediaRecordMO *record in results) {
+        if (![loadedTies containsObject:record.objectID]) {
+            [page addObject:record];
+        }
+    }
+    return page;
+}
+
+- (void) contextObjectsDidChange: (NSNotification *)notification {
+    NSDictionary *info = notification.userInfo;
+    if (info[NSInvalidatedAllObjectsKey]) {
+        [self reload:nil];
+        return;
+    }
+
+    NSMutableSet<CVMediaRecordMO *> *changed = [NSMutableSet set];
+    NSMutableSet<CVMediaRecordMO *> *removed = [NSMutableSet set];
+    for (NSString *key in @[NSInsertedObjectsKey, NSUpdatedObjectsKey, NSRefreshedObjectsKey]) {
+        for (NSManagedObject *object in info[key]) {
+            if ([object isKindOfClass:[CVMediaRecordMO class]]) {
+                [changed addObject:(CVMediaRecordMO *)object];
+            }
+        }
+    }
+    for (NSString *key in @[NSDeletedObjectsKey, NSInvalidatedObjectsKey]) {
+        for (NSManagedObject *object in info[key]) {
+            if ([object isKindOfClass:[CVMediaRecordMO class]]) {
+                [removed addObject:(CVMediaRecordMO *)object];
+            }
+        }
+    }
+    [changed minusSet:removed];
+    if (self.predicate) {
+        // records no longer matching filter leave the list
+        for (CVMediaRecordMO *record in [changed allObjects]) {
+            if (![self.predicate evaluateWithObject:record]) {
+                [changed removeObject:record];
+                [removed addObject:record];
+            }
+        }
+    }
+    if (changed.count == 0 && removed.count == 0) {
+        return;
+    }
+
+    NSArray<CVMediaRecordMO *> *oldRecords = [_records copy];
+    NSMutableDictionary<NSManagedObjectID *, NSNumber *> *oldIndexes = [NSMutableDictionary dictionaryWithCapacity:oldRecords.count];
+    [oldRecords enumerateObjectsUsingBlock:^(CVMediaRecordMO *record, NSUInteger idx, BOOL *stop) {
+        oldIndexes[record.objectID] = @(idx);
+    }];
+
+    // records which keep their key keep their place, others are placed again
+    NSMutableSet<CVMediaRecordMO *> *moved = [NSMutableSet set];
+    NSMutableSet<CVMediaRecordMO *> *updated = [NSMutableSet set];
+    for (CVMediaRecordMO *record in changed) {
+        NSArray *oldKeys = _keys[record.objectID];
+        if (oldKeys && CompareRecordKeys(oldKeys, RecordKeys(record)) == NSOrderedSame) {
+            [updated addObject:record];
+        } else {
+            [moved addObject:record];
+        }
+    }
+    NSMutableArray<CVMediaRecordMO *> *newRecords = [NSMutableArray arrayWithCapacity:oldRecords.count + moved.count];
+    for (CVMediaRecordMO *record in oldRecords) {
+        if (![removed containsObject:record] && ![moved containsObject:record]) {
+            [newRecords addObject:record];
+        }
+    }
+    NSArray *tailKeys = [newRecords lastObject] ? RecordKeys([newRecords lastObject]) : nil;
+    for (CVMediaRecordMO *record in moved) {
+        NSArray *keys = RecordKeys(record);
+        if (self.hasMoreRecords && (!tailKeys || CompareRecordKeys(keys, tailKeys) == NSOrderedDescending)) {
+            // belongs to the page not loaded yet
+            continue;
+        }
+        NSUInteger index = [newRecords indexOfObject: record
+                                       inSortedRange: NSMakeRange(0, newRecords.count)
+                                             options: NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual
+                                     usingComparator: ^NSComparisonResult(CVMediaRecordMO *obj1, CVMediaRecordMO *obj2) {
+                                         return CompareRecordKeys(RecordKeys(obj1), RecordKeys(obj2));
+                                     }];
+        [newRecords insertObject:record atIndex:index];
+    }
+
+    NSMutableDictionary<NSManagedObjectID *, NSNumber *> *newIndexes = [NSMutableDictionary dictionaryWithCapacity:newRecords.count];
+    [newRecords enumerateObjectsUsingBlock:^(CVMediaRecordMO *record, NSUInteger idx, BOOL *stop) {
+        newIndexes[record.objectID] = @(idx);
+    }];
+
+    [_records setArray:newRecords];
+    [self.delegate recordsControllerWillChangeContent:self];
+    for (CVMediaRecordMO *record in removed) {
+        NSNumber *oldIndex = oldIndexes[record.objectID];
+        [_keys removeObjectForKey:record.objectID];
+        if (oldIndex) {
+            [self.delegate recordsController: self
+                             didChangeRecord: record
+                                     atIndex: [oldIndex unsignedIntegerValue]
+                               forChangeType: CVMediaRecordChangeDelete
+                                    newIndex: NSNotFound];
+        }
+    }
+    for (CVMediaRecordMO *record in updated) {
+        NSNumber *oldIndex = oldIndexes[record.objectID];
+        if (oldIndex) {
+            [self.delegate recordsController: self
+                             didChangeRecord: record
+                                     atIndex: [oldIndex unsignedIntegerValue]
+                               forChangeType: CVMediaRecordChangeUpdate
+                                    newIndex: [newIndexes[record.objectID] unsignedIntegerValue]];
+        }
+    }
+    for (CVMediaRecordMO *record in moved) {
+        NSNumber *oldIndex = oldIndexes[record.objectID];
+        NSNumber *newIndex = newIndexes[record.objectID];
+        if (newIndex) {
+            _keys[record.objectID] = RecordKeys(record);
+        } else {
+            [_keys removeObjectForKey:record.objectID];
+        }
+        if (oldIndex && newIndex) {
+            [self.delegate recordsController: self
+                             didChangeRecord: record
+                                     atIndex: [oldIndex unsignedIntegerValue]
+                               forChangeType: CVMediaRecordChangeMove
+                                    newIndex: [newIndex unsignedIntegerValue]];
+        } else if (oldIndex) {
+            [self.delegate recordsController: self
+                             didChangeRecord: record
+                                     atIndex: [oldIndex unsignedIntegerValue]
+                               forChangeType: CVMediaRecordChangeDelete
+                                    newIndex: NSNotFound];
+        } else if (newIndex) {
+            [self.delegate recordsController: self
+                             didChangeRecord: record
+                                     atIndex: NSNotFound
+                               forChangeType: CVMediaRecordChangeInsert
+                                    newIndex: [newIndex unsignedIntegerValue]];
+        }
+    }
+    [self.delegate recordsControllerDidChangeContent:self];
+}
+
+@end
@@ -18,6 +18,10 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nullable, nonatomic, retain) NSString *name;
 @property (nullable, nonatomic, retain) NSString *address;
 @property (nullable, nonatomic, retain) NSNumber *playTime;
+@property (nullable, nonatomic, retain) NSString *resolvedAddress;
+@property (nullable, nonatomic, retain) NSDate *resolvedExpiry;
+@property (nullable, nonatomic, retain) NSNumber *contentLength;
+@property (nullable, nonatomic, retain) NSString *contentType;
 @property (nullable, nonatomic, retain) CVMediaRecordMO *record;
 
 @end
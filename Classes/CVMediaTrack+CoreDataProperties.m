@@ -16,6 +16,10 @@
 @dynamic name;
 @dynamic address;
 @dynamic playTime;
+@dynamic resolvedAddress;
+@dynamic resolvedExpiry;
+@dynamic contentLength;
+@dynamic contentType;
 @dynamic record;
 
 @end
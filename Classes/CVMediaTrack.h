@@ -22,6 +22,21 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSURL *) trackURL;
 
+/**
+ Method to get URL to start playback with: final URL of redirects while it is fresh, otherwise track address
+ */
+- (NSURL *) playbackURL;
+
+/**
+ Checks whether final URL of redirects was resolved and not expired yet
+ */
+- (BOOL) hasFreshResolvedURL;
+
+/**
+ Checks whether specified stream ID refers to this track, by address or resolved URL
+ */
+- (BOOL) matchesStreamID: (NSString *)streamID;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -17,4 +17,17 @@ NSString* const kMediaTrackEntityName = @"MediaTrack";
     return [NSURL URLWithString:self.address];
 }
 
+- (NSURL *) playbackURL {
+    NSURL *resolvedURL = [self hasFreshResolvedURL] ? [NSURL URLWithString:self.resolvedAddress] : nil;
+    return resolvedURL ?: [self trackURL];
+}
+
+- (BOOL) hasFreshResolvedURL {
+    return self.resolvedAddress && [self.resolvedExpiry timeIntervalSinceNow] > 0;
+}
+
+- (BOOL) matchesStreamID: (NSString *)streamID {
+    return [self.address isEqualToString:streamID] || [self.resolvedAddress isEqualToString:streamID];
+}
+
 @end
@@ -0,0 +1,71 @@
+//
+//  CVSearchIndex.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The persisted inverted index of words for full-text prefix search. Words are folded to lower case
+ * without diacritics, Cyrillic 'ё' is folded to 'е' while 'й' is kept distinct. Every document is
+ * indexed with weighted texts, the document matches query when every query word is a prefix of some
+ * of its words and documents are ranked by sum of weights of matched words, exact matches count double.
+ *
+ * Index is kept in memory, loaded in background on creation and written to file shortly after
+ * changes. All methods are thread safe.
+ */
+@interface CVSearchIndex : NSObject
+
+// The number of indexed documents
+@property (nonatomic, assign, readonly) NSUInteger documentCount;
+// The number of distinct indexed words
+@property (nonatomic, assign, readonly) NSUInteger wordCount;
+
+/*!
+ Creates index persisted at specified location, index file is loaded in background.
+ */
+- (instancetype __nonnull) initWithFileURL:(NSURL *__nonnull)fileURL;
+
+/*!
+ Splits text into folded words used as index keys.
+ */
++ (NSArray<NSString *> *__nonnull) wordsFromString:(NSString *__nullable)string;
+
+/*!
+ Indexes document replacing its previous content.
+
+ @param identifier The document identifier
+ @param stamp The modification stamp of the document, used to detect stale documents
+ @param weightedTexts The texts of the document mapped to weights of their words
+ */
+- (void) indexDocument:(NSString *__nonnull)identifier
+                 stamp:(NSTimeInterval)stamp
+         weightedTexts:(NSDictionary<NSString *, NSNumber *> *__nonnull)weightedTexts;
+
+/*!
+ Removes document from index.
+ */
+- (void) removeDocument:(NSString *__nonnull)identifier;
+
+/*!
+ Returns modification stamps of indexed documents keyed by identifier.
+ */
+- (NSDictionary<NSString *, NSNumber *> *__nonnull) documentStamps;
+
+/*!
+ Finds documents matching all words of the query as prefixes.
+
+ @param query The search query
+ @param limit The maximal number of results
+ @return The identifiers of matched documents, the best ranked first
+ */
+- (NSArray<NSString *> *__nonnull) documentsMatchingQuery:(NSString *__nonnull)query limit:(NSUInteger)limit;
+
+/*!
+ Writes index to file if it was changed since last write.
+ */
+- (void) synchronize;
+
+@end
@@ -0,0 +1,393 @@
+//
+//  CVSearchIndex.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "CVSearchIndex.h"
+
+// The index file header
+static const uint32_t kSearchIndexMagic = 0x49535845; // 'EXSI'
+static const uint32_t kSearchIndexVersion = 1;
+// The delay of index write after change
+static const NSTimeInterval kSearchIndexWriteDelay = 5.0;
+// The placeholder keeping Cyrillic short i from diacritic folding
+static NSString *const kShortIPlaceholder = @"\uE000";
+
+@implementation CVSearchIndex {
+    // The index file location
+    NSURL *_fileURL;
+    // The serial queue guarding index state
+    dispatch_queue_t _queue;
+    // The internal document numbers keyed by identifier
+    NSMutableDictionary<NSString *, NSNumber *> *_documentNumbers;
+    // The identifiers keyed by document number
+    NSMutableDictionary<NSNumber *, NSString *> *_identifiers;
+    // The modification stamps keyed by document number
+    NSMutableDictionary<NSNumber *, NSNumber *> *_stamps;
+    // The weights of documents keyed by word and document number
+    NSMutableDictionary<NSString *, NSMutableDictionary<NSNumber *, NSNumber *> *> *_postings;
+    // The words of document keyed by document number, used to remove document
+    NSMutableDictionary<NSNumber *, NSArray<NSString *> *> *_documentWords;
+    // The sorted words for prefix lookup, nil when words changed
+    NSArray<NSString *> *_sortedWords;
+    // The next document number
+    uint32_t _nextNumber;
+    // Indicates whether index has changes not written to file
+    BOOL _dirty;
+    BOOL _writeScheduled;
+}
+
+- (instancetype) initWithFileURL:(NSURL *)fileURL {
+    self = [super init];
+    if (self) {
+        _fileURL = fileURL;
+        _queue = dispatch_queue_create("CVSearchIndex", DISPATCH_QUEUE_SERIAL);
+        _documentNumbers = [NSMutableDictionary dictionary];
+        _identifiers = [NSMutableDictionary dictionary];
+        _stamps = [NSMutableDictionary dictionary];
+        _postings = [NSMutableDictionary dictionary];
+        _documentWords = [NSMutableDictionary dictionary];
+        dispatch_async(_queue, ^{
+            if (![self readIndex]) {
+                [self clearIndex];
+            }
+        });
+    }
+    return self;
+}
+
++ (NSArray<NSString *> *) wordsFromString:(NSString *)string {
+    if (string.length == 0) {
+        return @[];
+    }
+    NSLocale *locale = [NSLocale localeWithLocaleIdentifier:@"ru"];
+    NSString *folded = [string lowercaseStringWithLocale:locale];
+    folded = [folded stringByReplacingOccurrencesOfString:@"ё" withString:@"е"];
+    folded = [folded stringByReplacingOccurrencesOfString:@"й" withString:kShortIPlaceholder];
+    folded = [folded stringByFoldingWithOptions:NSDiacriticInsensitiveSearch | NSWidthInsensitiveSearch locale:locale];
+    folded = [folded stringByReplacingOccurrencesOfString:kShortIPlaceholder withString:@"й"];
+
+    NSMutableArray<NSString *> *words = [NSMutableArray array];
+    [folded enumerateSubstringsInRange:NSMakeRange(0, folded.length)
+                               options:NSStringEnumerationByWords | NSStringEnumerationLocalized
+                            usingBlock:^(NSString *word, NSRange wordRange, NSRange enclosingRange, BOOL *stop) {
+                                if (word.length > 0) {
+                                    [words addObject:word];
+                                }
+                            }];
+    return words;
+}
+
+- (NSUInteger) documentCount {
+    __block NSUInteger count;
+    dispatch_sync(_queue, ^{
+        count = _documentNumbers.count;
+    });
+    return count;
+}
+
+- (NSUInteger) wordCount {
+    __block NSUInteger count;
+    dispatch_sync(_queue, ^{
+        count = _postings.count;
+    });
+    return count;
+}
+
+- (void) indexDocument:(NSString *)identifier
+                 stamp:(NSTimeInterval)stamp
+         weightedTexts:(NSDictionary<NSString *, NSNumber *> *)weightedTexts {
+    // tokenize on caller thread, index queue only merges
+    NSMutableDictionary<NSString *, NSNumber *> *weights = [NSMutableDictionary dictionary];
+    [weightedTexts enumerateKeysAndObjectsUsingBlock:^(NSString *text, NSNumber *weight, BOOL *stop) {
+        for (NSString *word in [CVSearchIndex wordsFromString:text]) {
+            weights[word] = @(MAX([weights[word] unsignedIntValue], [weight unsignedIntValue]));
+        }
+    }];
+    dispatch_async(_queue, ^{
+        NSNumber *number = _documentNumbers[identifier];
+        if (number) {
+            [self removeWordsOfDocument:number];
+        } else {
+            number = @(_nextNumber++);
+            _documentNumbers[identifier] = number;
+            _identifiers[number] = identifier;
+        }
+        _stamps[number] = @(stamp);
+        [weights enumerateKeysAndObjectsUsingBlock:^(NSString *word, NSNumber *weight, BOOL *stop) {
+            [self addWord:word weight:weight toDocument:number];
+        }];
+        _documentWords[number] = [weights allKeys];
+        [self scheduleWrite];
+    });
+}
+
+- (void) removeDocument:(NSString *)identifier {
+    dispatch_async(_queue, ^{
+        NSNumber *number = _documentNumbers[identifier];
+        if (!number) {
+            return;
+        }
+        [self removeWordsOfDocument:number];
+        [_documentNumbers removeObjectForKey:identifier];
+        [_identifiers removeObjectForKey:number];
+        [_stamps removeObjectForKey:number];
+        [self scheduleWrite];
+    });
+}
+
+- (NSDictionary<NSString *, NSNumber *> *) documentStamps {
+    __block NSMutableDictionary<NSString *, NSNumber *> *stamps;
+    dispatch_sync(_queue, ^{
+        stamps = [NSMutableDictionary dictionaryWithCapacity:_documentNumbers.count];
+        [_documentNumbers enumerateKeysAndObjectsUsingBlock:^(NSString *identifier, NSNumber *number, BOOL *stop) {
+            stamps[identifier] = _stamps[number];
+        }];
+    });
+    return stamps;
+}
+
+- (NSArray<NSString *> *) documentsMatchingQuery:(NSString *)query limit:(NSUInteger)limit {
+    NSArray<NSString *> *queryWords = [[NSOrderedSet orderedSetWithArray:[CVSearchIndex wordsFromString:query]] array];
+    if (queryWords.count == 0 || limit == 0) {
+        return @[];
+    }
+    __block NSArray<NSString *> *results;
+    dispatch_sync(_queue, ^{
+        if (!_sortedWords) {
+            _sortedWords = [[_postings allKeys] sortedArrayUsingComparator:^NSComparisonResult(NSString *word1, NSString *word2) {
+                return [word1 compare:word2 options:NSLiteralSearch];
+            }];
+        }
+        NSMutableDictionary<NSNumber *, NSNumber *> *scores = nil;
+        for (NSString *queryWord in queryWords) {
+            NSDictionary<NSNumber *, NSNumber *> *wordScores = [self scoresForPrefix:queryWord];
+            if (!scores) {
+                scores = [wordScores mutableCopy];
+            } else {
+                // every query word must match
+                NSMutableDictionary<NSNumber *, NSNumber *> *matched = [NSMutableDictionary dictionaryWithCapacity:scores.count];
+                [scores enumerateKeysAndObjectsUsingBlock:^(NSNumber *number, NSNumber *score, BOOL *stop) {
+                    NSNumber *wordScore = wordScores[number];
+                    if (wordScore) {
+                        matched[number] = @([score unsignedIntValue] + [wordScore unsignedIntValue]);
+                    }
+                }];
+                scores = matched;
+            }
+            if (scores.count == 0) {
+                break;
+            }
+        }
+        NSArray<NSNumber *> *ranked = [scores keysSortedByValueUsingComparator:^NSComparisonResult(NSNumber *score1, NSNumber *score2) {
+            return [score2 compare:score1];
+        }];
+        NSMutableArray<NSString *> *identifiers = [NSMutableArray arrayWithCapacity:MIN(limit, ranked.count)];
+        for (NSNumber *number in ranked) {
+            if (identifiers.count == limit) {
+                break;
+            }
+            [identifiers addObject:_identifiers[number]];
+        }
+        results = identifiers;
+    });
+    return results;
+}
+
+- (void) synchronize {
+    dispatch_sync(_queue, ^{
+        [self writeIndex];
+    });
+}
+
+#pragma mark - private
+
+// All private methods must be called on index queue
+
+- (NSDictionary<NSNumber *, NSNumber *> *) scoresForPrefix:(NSString *)prefix {
+    NSUInteger index = [_sortedWords indexOfObject: prefix
+                                     inSortedRange: NSMakeRange(0, _sortedWords.count)
+                                           options: NSBinarySearchingInsertionIndex | NSBinarySearchingFirstEqual
+                                   usingComparator: ^NSComparisonResult(NSString *word1, NSString *word2) {
+                                       return [word1 compare:word2 options:NSLiteralSearch];
+                                   }];
+    NSMutableDictionary<NSNumber *, NSNumber *> *scores = [NSMutableDictionary dictionary];
+    for (; index < _sortedWords.count; index++) {
+        NSString *word = _sortedWords[index];
+        if (![word hasPrefix:prefix]) {
+            break;
+        }
+        BOOL exact = word.length == prefix.length;
+        [_postings[word] enumerateKeysAndObjectsUsingBlock:^(NSNumber *number, NSNumber *weight, BOOL *stop) {
+            unsigned int score = [weight unsignedIntValue] * (exact ? 2 : 1);
+            if (score > [scores[number] unsignedIntValue]) {
+                scores[number] = @(score);
+            }
+        }];
+    }
+    return scores;
+}
+
+- (void) addWord:(NSString *)word weight:(NSNumber *)weight toDocument:(NSNumber *)number {
+    NSMutableDictionary<NSNumber *, NSNumber *> *documents = _postings[word];
+    if (!documents) {
+        documents = [NSMutableDictionary dictionary];
+        _postings[word] = documents;
+        _sortedWords = nil;
+    }
+    documents[number] = weight;
+}
+
+- (void) removeWordsOfDocument:(NSNumber *)number {
+    for (NSString *word in _documentWords[number]) {
+        NSMutableDictionary<NSNumber *, NSNumber *> *documents = _postings[word];
+        [documents removeObjectForKey:number];
+        if (documents.count == 0) {
+            [_postings removeObjectForKey:word];
+            _sortedWords = nil;
+        }
+    }
+    [_documentWords removeObjectForKey:number];
+}
+
+- (void) clearIndex {
+    [_documentNumbers removeAllObjects];
+    [_identifiers removeAllObjects];
+    [_stamps removeAllObjects];
+    [_postings removeAllObjects];
+    [_documentWords removeAllObjects];
+    _sortedWords = nil;
+    _nextNumber = 0;
+}
+
+- (void) scheduleWrite {
+    _dirty = YES;
+    if (_writeScheduled) {
+        return;
+    }
+    _writeScheduled = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kSearchIndexWriteDelay * NSEC_PER_SEC)), _queue, ^{
+        _writeScheduled = NO;
+        [self writeIndex];
+    });
+}
+
+/*
+ * The index file layout, all numbers in host byte order:
+ *   uint32 magic, uint32 version, uint32 document count, uint32 word count
+ *   documents: uint32 number, double stamp, uint16 identifier length, identifier UTF-8
+ *   words: uint16 word length, word UTF-8, uint32 posting count, postings of uint32 number and uint32 weight
+ */
+- (void) writeIndex {
+    if (!_dirty) {
+        return;
+    }
+    _dirty = NO;
+    NSMutableData *data = [NSMutableData data];
+    uint32_t header[4] = {kSearchIndexMagic, kSearchIndexVersion, (uint32_t)_documentNumbers.count, (uint32_t)_postings.count};
+    [data appendBytes:header length:sizeof(header)];
+    [_documentNumbers enumerateKeysAndObjectsUsingBlock:^(NSString *identifier, NSNumber *number, BOOL *stop) {
+        uint32_t value = [number unsignedIntValue];
+        double stamp = [_stamps[number] doubleValue];
+        NSData *bytes = [identifier dataUsingEncoding:NSUTF8StringEncoding];
+        uint16_t length = (uint16_t)MIN(bytes.length, UINT16_MAX);
+        [data appendBytes:&value length:sizeof(value)];
+        [data appendBytes:&stamp length:sizeof(stamp)];
+        [data appendBytes:&length length:sizeof(length)];
+        [data appendBytes:bytes.bytes length:length];
+    }];
+    [_postings enumerateKeysAndObjectsUsingBlock:^(NSString *word, NSDictionary<NSNumber *, NSNumber *> *documents, BOOL *stop) {
+        NSData *bytes = [word dataUsingEncoding:NSUTF8StringEncoding];
+        uint16_t length = (uint16_t)MIN(bytes.length, UINT16_MAX);
+        uint32_t count = (uint32_t)documents.count;
+        [data appendBytes:&length length:sizeof(length)];
+        [data appendBytes:bytes.bytes length:length];
+        [data appendBytes:&count length:sizeof(count)];
+        [documents enumerateKeysAndObjectsUsingBlock:^(NSNumber *number, NSNumber *weight, BOOL *stop) {
+            uint32_t posting[2] = {[number unsignedIntValue], [weight unsignedIntValue]};
+            [data appendBytes:posting length:sizeof(posting)];
+        }];
+    }];
+    NSError *error;
+    if (![data writeToURL:_fileURL options:NSDataWritingAtomic error:&error]) {
+        NSLog(@"Failed to write search index, reason: %@", error);
+    }
+}
+
+- (BOOL) readIndex {
+    NSData *data = [NSData dataWithContentsOfURL:_fileURL];
+    if (!data) {
+        return NO;
+    }
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    __block NSUInteger offset = 0;
+    BOOL (^read)(void *, NSUInteger) = ^BOOL(void *value, NSUInteger size) {
+        if (offset + size > length) {
+            return NO;
+        }
+        memcpy(value, bytes + offset, size);
+        offset += size;
+        return YES;
+    };
+
+    uint32_t header[4];
+    if (!read(header, sizeof(header)) || header[0] != kSearchIndexMagic || header[1] != kSearchIndexVersion) {
+        NSLog(@"Search index is corrupted or outdated, it will be rebuilt");
+        return NO;
+    }
+    NSMutableDictionary<NSNumber *, NSMutableArray<NSString *> *> *documentWords = [NSMutableDictionary dictionary];
+    for (uint32_t i = 0; i < header[2]; i++) {
+        uint32_t number;
+        double stamp;
+        uint16_t identifierLength;
+        if (!read(&number, sizeof(number)) || !read(&stamp, sizeof(stamp)) ||
+            !read(&identifierLength, sizeof(identifierLength)) || offset + identifierLength > length) {
+            [self clearIndex];
+            return NO;
+        }
+        NSString *identifier = [[NSString alloc] initWithBytes:bytes + offset length:identifierLength encoding:NSUTF8StringEncoding];
+        offset += identifierLength;
+        if (!identifier) {
+            continue;
+        }
+        _documentNumbers[identifier] = @(number);
+        _identifiers[@(number)] = identifier;
+        _stamps[@(number)] = @(stamp);
+        documentWords[@(number)] = [NSMutableArray array];
+        _nextNumber = MAX(_nextNumber, number + 1);
+    }
+    for (uint32_t i = 0; i < header[3]; i++) {
+        uint16_t wordLength;
+        uint32_t count;
+        if (!read(&wordLength, sizeof(wordLength)) || offset + wordLength > length) {
+            [self clearIndex];
+            return NO;
+        }
+        NSString *word = [[NSString alloc] initWithBytes:bytes + offset length:wordLength encoding:NSUTF8StringEncoding];
+        offset += wordLength;
+        if (!read(&count, sizeof(count)) || offset + (NSUInteger)count * 2 * sizeof(uint32_t) > length) {
+            [self clearIndex];
+            return NO;
+        }
+        NSMutableDictionary<NSNumber *, NSNumber *> *documents = [NSMutableDictionary dictionaryWithCapacity:count];
+        for (uint32_t j = 0; j < count; j++) {
+            uint32_t posting[2];
+            read(posting, sizeof(posting));
+            NSMutableArray<NSString *> *words = documentWords[@(posting[0])];
+            if (word && words) {
+                documents[@(posting[0])] = @(posting[1]);
+                [words addObject:word];
+            }
+        }
+        if (documents.count > 0) {
+            _postings[word] = documents;
+        }
+    }
+    [_documentWords setDictionary:documentWords];
+    return YES;
+}
+
+@end
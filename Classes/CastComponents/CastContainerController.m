@@ -147,9 +147,7 @@ static const NSInteger kCastContainerMiniViewDisplayHeight = 45;
       NSString *posterURL = [_upNextItem.mediaInformation.metadata
                              stringForKey:kCastComponentPosterURL];
       if (posterURL) {
-        UIImage *image =
-        [UIImage imageWithData:
-         [SimpleImageFetcher getDataFromImageURL:[NSURL URLWithString:posterURL]]];
+        UIImage *image = [SimpleImageFetcher getImageFromURL:[NSURL URLWithString:posterURL]];
 
         dispatch_async(dispatch_get_main_queue(), ^{
           NSLog(@"Loaded thumbnail image");
@@ -277,7 +275,7 @@ static const NSInteger kCastContainerMiniViewDisplayHeight = 45;
 
   // Load thumbnail asynchronously.
   dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-    UIImage *newImage = [UIImage imageWithData:[SimpleImageFetcher getDataFromImageURL:img.URL]];
+    UIImage *newImage = [SimpleImageFetcher getImageFromURL:img.URL];
 
     dispatch_async(dispatch_get_main_queue(), ^{
       self.imageUrl = img.URL;
@@ -16,6 +16,8 @@
 #import <GoogleCast/GCKDeviceScanner.h>
 #import <GoogleCast/GCKMediaStatus.h>
 
+#import "CastQueueMirror.h"
+
 @class GCKDevice;
 @class GCKDeviceManager;
 @class GCKMediaControlChannel;
@@ -49,6 +51,13 @@ extern NSString * const kCastViewController;
  */
 - (void)didUpdateQueueForDevice:(GCKDevice *)device;
 
+/**
+ * Called when the mirror of the connected device's queue changed.
+ *
+ * @param changes The changes of queue rows and current item since the previous update.
+ */
+- (void)didUpdateQueueWithChanges:(CastQueueChangeSet *)changes;
+
 /**
  *  Called when the next item in a queue starts preloading.
  *
@@ -116,6 +125,11 @@ extern NSString * const kCastViewController;
  */
 @property(nonatomic, readonly) GCKMediaQueueItem *preloadingItem;
 
+/**
+ *  The local copy of the connected device's queue, kept up to date from media status.
+ */
+@property(nonatomic, readonly) CastQueueMirror *queueMirror;
+
 /**
  *  Helper accessor for the media player state of the media on the device.
  */
@@ -182,6 +196,21 @@ extern NSString * const kCastViewController;
  */
 - (void)mediaAddToQueue:(GCKMediaInformation *)media;
 
+/**
+ *  "Play All" the specified list of GCKMediaInformation. This will replace any current queue
+ *  with the list and start playing its first item. Short list is sent as single queue load
+ *  request, long list is loaded by chunks: the first chunk replaces the queue and the rest is
+ *  appended one chunk at a time after the receiver confirmed the previous one.
+ *
+ *  @param media The list of GCKMediaInformation to play.
+ *  @param playPosition The position to start the first item from.
+ *  @param completion The block called when the receiver confirmed the whole queue or any request
+ *  failed, with the time since the call.
+ */
+- (void)mediaPlayAll:(NSArray<GCKMediaInformation *> *)media
+        playPosition:(NSTimeInterval)playPosition
+          completion:(void (^)(NSTimeInterval elapsed, NSError *error))completion;
+
 /**
  *  Enable Cast enhancing of a controller by returning a UIBarButtonItem to show the queue
  *  status. Signals that a view controller is being used to present the UI.
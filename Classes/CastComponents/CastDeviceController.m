@@ -34,6 +34,12 @@ static NSString * const kDeviceTableViewController = @"deviceTableViewController
  */
 static NSInteger const kPreloadTime = 30;
 
+/**
+ *  Constant for the maximal number of items sent to the receiver in single queue request, so
+ *  the message of long series stays well below the size limit of the Cast channel.
+ */
+static NSUInteger const kQueueChunkSize = 20;
+
 /**
  *  Constant for the storyboard ID for the expanded view Cast controller.
  */
@@ -87,6 +93,16 @@ GCKMediaControlChannelDelegate
  */
 @property(nonatomic) RepeatingTimerManager *streamPositionUpdateTimer;
 
+/**
+ *  The handlers of sent queue requests waiting for the receiver, keyed by request ID.
+ */
+@property(nonatomic) NSMutableDictionary<NSNumber *, void (^)(NSError *)> *pendingQueueRequests;
+
+/**
+ *  The counter of "Play All" loads, chunks of replaced load are not sent anymore.
+ */
+@property(nonatomic) NSUInteger queueLoadGeneration;
+
 @end
 
 @implementation CastDeviceController
@@ -112,6 +128,9 @@ GCKMediaControlChannelDelegate
         
         // Load the storyboard for the Cast component UI.
         self.storyboard = [UIStoryboard storyboardWithName:@"CastComponents" bundle:nil];
+        
+        self.pendingQueueRequests = [NSMutableDictionary dictionary];
+        _queueMirror = [[CastQueueMirror alloc] init];
     }
     return self;
 }
@@ -304,6 +323,8 @@ GCKMediaControlChannelDelegate
     
     _mediaInformation = nil;
     self.lastContentID = nil;
+    [self failPendingQueueRequestsWithCode:GCKErrorCodeDisconnected];
+    [self updateQueueMirrorWithStatus:nil];
     [self updateCastIconButtonStates];
     
     [[NSNotificationCenter defaultCenter]
@@ -395,6 +416,8 @@ GCKMediaControlChannelDelegate
     }
     
     self.lastContentID = _mediaInformation.contentID;
+    // current item changes with status, not with queue
+    [self updateQueueMirrorWithStatus:mediaControlChannel.mediaStatus];
     
     [[NSNotificationCenter defaultCenter] postNotificationName:kCastMediaStatusChangeNotification
                                                         object:self];
@@ -409,6 +432,7 @@ GCKMediaControlChannelDelegate
 
 - (void)mediaControlChannelDidUpdateQueue:(GCKMediaControlChannel *)mediaControlChannel {
     NSLog(@"Media control channel queue changed");
+    [self updateQueueMirrorWithStatus:mediaControlChannel.mediaStatus];
     
     [[NSNotificationCenter defaultCenter] postNotificationName:kCastQueueUpdatedNotification
                                                         object:self];
@@ -418,6 +442,29 @@ GCKMediaControlChannelDelegate
     }
 }
 
+- (void)mediaControlChannel:(GCKMediaControlChannel *)mediaControlChannel
+   requestDidCompleteWithID:(NSInteger)requestID {
+    [self completeQueueRequest:requestID withError:nil];
+}
+
+- (void)mediaControlChannel:(GCKMediaControlChannel *)mediaControlChannel
+       requestDidFailWithID:(NSInteger)requestID
+                      error:(NSError *)error {
+    [self completeQueueRequest:requestID withError:error];
+}
+
+- (void)mediaControlChannel:(GCKMediaControlChannel *)mediaControlChannel
+     didCancelRequestWithID:(NSInteger)requestID {
+    [self completeQueueRequest:requestID
+                     withError:[NSError errorWithDomain:kGCKErrorDomain code:GCKErrorCodeCancelled userInfo:nil]];
+}
+
+- (void)mediaControlChannel:(GCKMediaControlChannel *)mediaControlChannel
+    didReplaceRequestWithID:(NSInteger)requestID {
+    [self completeQueueRequest:requestID
+                     withError:[NSError errorWithDomain:kGCKErrorDomain code:GCKErrorCodeReplaced userInfo:nil]];
+}
+
 - (void)mediaControlChannelDidUpdatePreloadStatus:(GCKMediaControlChannel *)mediaControlChannel {
     NSLog(@"Preloading status changed");
     
@@ -520,6 +567,29 @@ GCKMediaControlChannelDelegate
     }
 }
 
+- (void)mediaPlayAll:(NSArray<GCKMediaInformation *> *)media
+        playPosition:(NSTimeInterval)playPosition
+          completion:(void (^)(NSTimeInterval elapsed, NSError *error))completion {
+    NSMutableArray<GCKMediaQueueItem *> *items = [NSMutableArray arrayWithCapacity:media.count];
+    for (GCKMediaInformation *information in media) {
+        [items addObject:[[GCKMediaQueueItem alloc] initWithMediaInformation:information
+                                                                    autoplay:YES
+                                                                   startTime:0
+                                                                 preloadTime:kPreloadTime
+                                                              activeTrackIDs:nil
+                                                                  customData:nil]];
+    }
+    self.queueLoadGeneration++;
+    [self sendQueueItems:items
+              fromOffset:0
+            playPosition:playPosition
+              generation:self.queueLoadGeneration
+               startTime:CFAbsoluteTimeGetCurrent()
+              completion:completion];
+    // drop volume a bit to avoid deafening
+    [self.deviceManager setVolume:0.7];
+}
+
 - (UIBarButtonItem *)queueItemForController:(UIViewController *)controller {
     _controller = controller;
     if (!controller) {
@@ -546,4 +616,98 @@ GCKMediaControlChannelDelegate
     self.streamPositionUpdateTimer = nil;
 }
 
+/**
+ *  Sends the chunk of queue items starting at offset and the rest of chunks once the receiver
+ *  confirmed it. The first chunk replaces the queue, the next ones are appended to its end.
+ */
+- (void)sendQueueItems:(NSArray<GCKMediaQueueItem *> *)items
+            fromOffset:(NSUInteger)offset
+          playPosition:(NSTimeInterval)playPosition
+            generation:(NSUInteger)generation
+             startTime:(CFAbsoluteTime)startTime
+            completion:(void (^)(NSTimeInterval elapsed, NSError *error))completion {
+    void (^finish)(NSError *) = ^(NSError *error) {
+        NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - startTime;
+        if (error) {
+            NSLog(@"Failed to load queue of %lu items after %lu, reason: %@",
+                  (unsigned long)items.count, (unsigned long)offset, error);
+        } else {
+            NSLog(@"Loaded queue of %lu items in %.3f sec", (unsigned long)items.count, elapsed);
+            [[NSNotificationCenter defaultCenter] postNotificationName:kCastItemQueuedNotification
+                                                                object:self];
+        }
+        if (completion) {
+            completion(elapsed, error);
+        }
+    };
+    if (generation != self.queueLoadGeneration) {
+        finish([NSError errorWithDomain:kGCKErrorDomain code:GCKErrorCodeReplaced userInfo:nil]);
+        return;
+    }
+    if (items.count == 0) {
+        finish(nil);
+        return;
+    }
+    
+    NSRange range = NSMakeRange(offset, MIN(kQueueChunkSize, items.count - offset));
+    NSArray<GCKMediaQueueItem *> *chunk = [items subarrayWithRange:range];
+    NSInteger requestID;
+    if (offset == 0) {
+        requestID = [_mediaControlChannel queueLoadItems:chunk
+                                              startIndex:0
+                                            playPosition:playPosition
+                                              repeatMode:GCKMediaRepeatModeOff
+                                              customData:nil];
+    } else {
+        requestID = [_mediaControlChannel queueInsertItems:chunk
+                                          beforeItemWithID:kGCKMediaQueueInvalidItemID
+                                                customData:nil];
+    }
+    if (requestID == kGCKInvalidRequestID) {
+        finish([NSError errorWithDomain:kGCKErrorDomain code:GCKErrorCodeInvalidRequest userInfo:nil]);
+        return;
+    }
+    
+    __weak CastDeviceController *weakSelf = self;
+    self.pendingQueueRequests[@(requestID)] = ^(NSError *error) {
+        if (error || NSMaxRange(range) == items.count) {
+            finish(error);
+        } else {
+            [weakSelf sendQueueItems:items
+                          fromOffset:NSMaxRange(range)
+                        playPosition:playPosition
+                          generation:generation
+                           startTime:startTime
+                          completion:completion];
+        }
+    };
+}
+
+/**
+ *  Updates queue mirror and tells delegate what changed, if anything.
+ */
+- (void)updateQueueMirrorWithStatus:(GCKMediaStatus *)status {
+    CastQueueChangeSet *changes = [_queueMirror updateWithMediaStatus:status];
+    if (![changes isEmpty] && [self.delegate respondsToSelector:@selector(didUpdateQueueWithChanges:)]) {
+        [self.delegate didUpdateQueueWithChanges:changes];
+    }
+}
+
+- (void)completeQueueRequest:(NSInteger)requestID withError:(NSError *)error {
+    void (^handler)(NSError *) = self.pendingQueueRequests[@(requestID)];
+    if (handler) {
+        [self.pendingQueueRequests removeObjectForKey:@(requestID)];
+        handler(error);
+    }
+}
+
+- (void)failPendingQueueRequestsWithCode:(GCKErrorCode)code {
+    NSArray<void (^)(NSError *)> *handlers = [self.pendingQueueRequests allValues];
+    [self.pendingQueueRequests removeAllObjects];
+    NSError *error = [NSError errorWithDomain:kGCKErrorDomain code:code userInfo:nil];
+    for (void (^handler)(NSError *) in handlers) {
+        handler(error);
+    }
+}
+
 @end
@@ -0,0 +1,76 @@
+//
+//  CastQueueMirror.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <UIKit/UIKit.h>
+
+@class GCKMediaQueueItem;
+@class GCKMediaStatus;
+
+/**
+ * The changes of queue between two updates of mirror, as rows of single table section. Deleted rows
+ * and sources of moves are old index paths, inserted rows, targets of moves and updated rows are new
+ * ones. Deletions, insertions and moves are meant for single batch of table updates, updated rows
+ * are reloaded after the batch.
+ */
+@interface CastQueueChangeSet : NSObject
+
+@property (nonatomic, strong, readonly) NSArray<NSIndexPath *> *__nonnull deleted;
+@property (nonatomic, strong, readonly) NSArray<NSIndexPath *> *__nonnull inserted;
+// The pairs of source and target index paths
+@property (nonatomic, strong, readonly) NSArray<NSArray<NSIndexPath *> *> *__nonnull moved;
+// The rows of items which content changed
+@property (nonatomic, strong, readonly) NSArray<NSIndexPath *> *__nonnull updated;
+// The index of current item before and after update or NSNotFound
+@property (nonatomic, assign, readonly) NSUInteger previousCurrentIndex;
+@property (nonatomic, assign, readonly) NSUInteger currentIndex;
+
+/**
+ * Checks whether neither rows nor current item changed
+ */
+- (BOOL) isEmpty;
+
+/**
+ * Checks whether rows were deleted, inserted, moved or updated
+ */
+- (BOOL) hasRowChanges;
+
+@end
+
+/**
+ * The local copy of the receiver queue. Items are indexed by item ID, so position of any item and of
+ * the current one is found without scanning the queue. The mirror is updated from every media status
+ * and returns changes since the previous status, items are matched by ID and rows are reloaded only
+ * when shown content of item changed.
+ */
+@interface CastQueueMirror : NSObject
+
+// The queue items in order
+@property (nonatomic, strong, readonly) NSArray<GCKMediaQueueItem *> *__nonnull items;
+// The ID of current item or kGCKMediaQueueInvalidItemID
+@property (nonatomic, assign, readonly) NSUInteger currentItemID;
+// The index of current item or NSNotFound
+@property (nonatomic, assign, readonly) NSUInteger currentIndex;
+
+/*!
+ Updates mirror with the queue of media status.
+
+ @param status The media status or nil when disconnected, which empties the queue
+ @return The changes since the previous update
+ */
+- (CastQueueChangeSet *__nonnull) updateWithMediaStatus: (GCKMediaStatus *__nullable)status;
+
+/*!
+ Returns index of item with specified ID or NSNotFound
+ */
+- (NSUInteger) indexOfItemWithID: (NSUInteger)itemID;
+
+/*!
+ Returns item at index or nil if out of queue
+ */
+- (GCKMediaQueueItem *__nullable) itemAtIndex: (NSUInteger)index;
+
+@end
@@ -0,0 +1,111 @@
+//
+//  CastQueueMirror.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "CastQueueMirror.h"
+
+#import <GoogleCast/GoogleCast.h>
+
+#import "KeyedListDiff.h"
+
+@interface CastQueueChangeSet ()
+
+@property (nonatomic, strong, readwrite) NSArray<NSIndexPath *> *deleted;
+@property (nonatomic, strong, readwrite) NSArray<NSIndexPath *> *inserted;
+@property (nonatomic, strong, readwrite) NSArray<NSArray<NSIndexPath *> *> *moved;
+@property (nonatomic, strong, readwrite) NSArray<NSIndexPath *> *updated;
+@property (nonatomic, assign, readwrite) NSUInteger previousCurrentIndex;
+@property (nonatomic, assign, readwrite) NSUInteger currentIndex;
+
+@end
+
+@implementation CastQueueChangeSet
+
+- (BOOL) isEmpty {
+    return ![self hasRowChanges] && self.previousCurrentIndex == self.currentIndex;
+}
+
+- (BOOL) hasRowChanges {
+    return self.deleted.count > 0 || self.inserted.count > 0 || self.moved.count > 0 || self.updated.count > 0;
+}
+
+@end
+
+/**
+ * Returns the part of item shown by queue row, item is reloaded only when it changes
+ */
+static NSString *QueueItemSignature(GCKMediaQueueItem *item) {
+    GCKMediaInformation *info = item.mediaInformation;
+    GCKImage *image = info.metadata.images.firstObject;
+    return [NSString stringWithFormat:@"%@\n%@\n%@\n%@", info.contentID ?: @"",
+            [info.metadata stringForKey:kGCKMetadataKeyTitle] ?: @"",
+            [info.metadata stringForKey:kGCKMetadataKeySubtitle] ?: @"",
+            image.URL.absoluteString ?: @""];
+}
+
+@implementation CastQueueMirror {
+    // The item IDs and shown content in queue order
+    NSArray<NSNumber *> *_itemIDs;
+    NSArray<NSString *> *_signatures;
+    // The indexes of items keyed by item ID
+    NSDictionary<NSNumber *, NSNumber *> *_indexes;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if (self) {
+        _items = @[];
+        _itemIDs = @[];
+        _signatures = @[];
+        _indexes = @{};
+        _currentItemID = kGCKMediaQueueInvalidItemID;
+        _currentIndex = NSNotFound;
+    }
+    return self;
+}
+
+- (NSUInteger) indexOfItemWithID: (NSUInteger)itemID {
+    NSNumber *index = _indexes[@(itemID)];
+    return index ? [index unsignedIntegerValue] : NSNotFound;
+}
+
+- (GCKMediaQueueItem *) itemAtIndex: (NSUInteger)index {
+    return index < _items.count ? _items[index] : nil;
+}
+
+- (CastQueueChangeSet *) updateWithMediaStatus: (GCKMediaStatus *)status {
+    NSUInteger count = [status queueItemCount];
+    NSMutableArray<GCKMediaQueueItem *> *items = [NSMutableArray arrayWithCapacity:count];
+    NSMutableArray<NSNumber *> *itemIDs = [NSMutableArray arrayWithCapacity:count];
+    NSMutableArray<NSString *> *signatures = [NSMutableArray arrayWithCapacity:count];
+    NSMutableDictionary<NSNumber *, NSNumber *> *indexes = [NSMutableDictionary dictionaryWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        GCKMediaQueueItem *item = [status queueItemAtIndex:i];
+        [items addObject:item];
+        [itemIDs addObject:@(item.itemID)];
+        [signatures addObject:QueueItemSignature(item)];
+        indexes[@(item.itemID)] = @(i);
+    }
+
+    CastQueueChangeSet *changes = [[CastQueueChangeSet alloc] init];
+    changes.previousCurrentIndex = _currentIndex;
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys:_itemIDs contents:_signatures toKeys:itemIDs contents:signatures];
+    changes.deleted = diff.deleted;
+    changes.inserted = diff.inserted;
+    changes.moved = diff.moved;
+    changes.updated = diff.updated;
+
+    _items = items;
+    _itemIDs = itemIDs;
+    _signatures = signatures;
+    _indexes = indexes;
+    _currentItemID = status ? status.currentItemID : kGCKMediaQueueInvalidItemID;
+    _currentIndex = [self indexOfItemWithID:_currentItemID];
+    changes.currentIndex = _currentIndex;
+    return changes;
+}
+
+@end
@@ -16,7 +16,7 @@
 #import "CastViewController.h"
 #import "CastDeviceController.h"
 #import "NotificationConstants.h"
-#import "SimpleImageFetcher.h"
+#import "ImageLoader.h"
 #import "TracksTableViewController.h"
 
 #import <GoogleCast/GCKDevice.h>
@@ -44,6 +44,8 @@ NSString * const kCastComponentPosterURL = @"castComponentPosterURL";
 
 /* The image of the current media. */
 @property IBOutlet UIImageView *thumbnailImage;
+/* The request of the current media image. */
+@property(nonatomic, strong) ImageLoadToken *thumbnailToken;
 /* The label displaying the currently connected device. */
 @property IBOutlet UILabel *castingToLabel;
 /* The label displaying the currently playing media. */
@@ -188,6 +190,9 @@ NSString * const kCastComponentPosterURL = @"castComponentPosterURL";
     
     [self.navigationController.navigationBar setBackgroundImage:nil
                                                   forBarMetrics:UIBarMetricsDefault];
+    
+    [self.thumbnailToken cancel];
+    self.thumbnailToken = nil;
     [super viewWillDisappear:animated];
 }
 
@@ -356,36 +361,29 @@ NSString * const kCastComponentPosterURL = @"castComponentPosterURL";
     NSLog(@"Configured view with media: %@", media);
     
     // Loading thumbnail async.
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        NSString *posterURL = [media.metadata stringForKey:kCastComponentPosterURL];
-        if (posterURL) {
-            UIImage *image = [UIImage
-                              imageWithData:[SimpleImageFetcher getDataFromImageURL:[NSURL URLWithString:posterURL]]];
-            
-            dispatch_async(dispatch_get_main_queue(), ^{
-                NSLog(@"Loaded thumbnail image");
-                self.thumbnailImage.image = image;
-                [self.view setNeedsLayout];
-            });
-        }
-    });
+    [self.thumbnailToken cancel];
+    self.thumbnailToken = nil;
+    NSString *posterURL = [media.metadata stringForKey:kCastComponentPosterURL];
+    if (posterURL) {
+        __weak CastViewController *weakSelf = self;
+        self.thumbnailToken = [[ImageLoader sharedLoader] loadImageFromURL:[NSURL URLWithString:posterURL]
+                                                                  priority:ImageLoadPriorityNormal
+                                                                completion:^(UIImage * _Nullable image) {
+            NSLog(@"Loaded thumbnail image");
+            weakSelf.thumbnailToken = nil;
+            weakSelf.thumbnailImage.image = image;
+            [weakSelf.view setNeedsLayout];
+        }];
+    }
     
     self.cc.enabled = media.mediaTracks.count > 0;
     
-    // Dance to find our position in the queue, and enable/disable buttons
+    // Find our position in the queue from its mirror, and enable/disable buttons
     // as required.
-    GCKMediaStatus *mediaStatus = _castDeviceController.mediaControlChannel.mediaStatus;
-    GCKMediaQueueItem *currentItem = [mediaStatus queueItemWithItemID:mediaStatus.currentItemID];
-    BOOL hasPrevious = YES;
-    BOOL hasNext = NO;
-    NSInteger count = [mediaStatus queueItemCount];
-    for (NSInteger i = 0; i < count; ++i) {
-        GCKMediaQueueItem *item = [mediaStatus queueItemAtIndex:i];
-        if (currentItem == item) {
-            hasPrevious = (i > 0);
-            hasNext = (i < count - 1);
-        }
-    }
+    CastQueueMirror *queue = _castDeviceController.queueMirror;
+    NSUInteger currentIndex = queue.currentIndex;
+    BOOL hasPrevious = currentIndex == NSNotFound || currentIndex > 0;
+    BOOL hasNext = currentIndex != NSNotFound && currentIndex + 1 < queue.items.count;
     self.nextButton.enabled = hasNext;
     self.previousButton.enabled = hasPrevious;
     
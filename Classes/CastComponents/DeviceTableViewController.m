@@ -154,10 +154,9 @@ static NSString * const kVersionFooter = @"v";
         
         dispatch_async(queue, ^{
             GCKImage *mediaImage = [_delegate.mediaInformation.metadata.images objectAtIndex:0];
-            UIImage *image = [UIImage imageWithData:[SimpleImageFetcher getDataFromImageURL:mediaImage.URL]];
-            
             CGSize itemSize = CGSizeMake(40, 40);
-            UIImage *thumbnailImage = [SimpleImageFetcher scaleImage:image toSize:itemSize];
+            UIImage *thumbnailImage = [SimpleImageFetcher getImageFromURL:mediaImage.URL
+                                                                pixelSize:[SimpleImageFetcher pixelSizeForPointSize:itemSize]];
             
             dispatch_sync(dispatch_get_main_queue(), ^{
                 UIImageView *mediaThumb = cell.imageView;
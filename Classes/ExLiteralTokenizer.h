@@ -0,0 +1,61 @@
+//
+//  ExLiteralTokenizer.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The slice of tokenizer input bytes. Strings are referenced without quotes and
+ * are unescaped only when materialized.
+ */
+typedef struct {
+    const uint8_t *__nullable bytes;
+    NSUInteger length;
+    // Indicates whether slice is a quoted string
+    BOOL quoted;
+    // Indicates whether quoted string contains escape sequences
+    BOOL escaped;
+} ExLiteralSlice;
+
+/**
+ Checks whether slice holds exactly the specified ASCII string
+ */
+FOUNDATION_EXPORT BOOL ExLiteralSliceEquals(ExLiteralSlice slice, const char *__nonnull string);
+
+/**
+ * The tokenizer for lenient JavaScript object literals as found in Ex.ua player scripts, i.e.
+ * comma separated list of objects with unquoted or quoted keys, single or double quoted strings
+ * and escape sequences. The list may be bare, as in page scripts, or wrapped in array brackets.
+ * It works over the original bytes without intermediate copies.
+ */
+@interface ExLiteralTokenizer : NSObject
+
+/*!
+ Creates tokenizer over bytes which must stay valid while tokenizer is used.
+
+ @param bytes The literal bytes
+ @param length The number of bytes
+ @param encoding The encoding used to decode string values
+ */
+- (instancetype __nonnull) initWithBytes:(const uint8_t *__nullable)bytes
+                                  length:(NSUInteger)length
+                                encoding:(NSStringEncoding)encoding;
+
+/*!
+ Enumerates key/value pairs of every top level object, or of every object of the leading
+ array. Nested objects and arrays are reported as raw slices.
+
+ @param block The block invoked for every field with index of the object it belongs to
+ @return NO if literal is malformed, fields reported before the error remain valid
+ */
+- (BOOL) enumerateFieldsUsingBlock:(void (^__nonnull)(NSUInteger objectIndex, ExLiteralSlice key, ExLiteralSlice value, BOOL *__nonnull stop))block;
+
+/*!
+ Materializes slice as string resolving escape sequences.
+ */
+- (NSString *__nullable) stringFromSlice:(ExLiteralSlice)slice;
+
+@end
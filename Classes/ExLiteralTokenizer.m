@@ -0,0 +1,311 @@
+//
+//  ExLiteralTokenizer.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ExLiteralTokenizer.h"
+
+#import <string.h>
+
+BOOL ExLiteralSliceEquals(ExLiteralSlice slice, const char *string) {
+    size_t length = strlen(string);
+    return !slice.escaped && slice.length == length && memcmp(slice.bytes, string, length) == 0;
+}
+
+static inline BOOL ExIsLiteralSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline BOOL ExIsIdentifierChar(uint8_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+        || c == '_' || c == '$' || c == '.' || c == '-' || c == '+' || c >= 0x80;
+}
+
+static inline int ExHexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+@implementation ExLiteralTokenizer {
+    const uint8_t *_bytes;
+    NSUInteger _length;
+    NSUInteger _pos;
+    NSStringEncoding _encoding;
+}
+
+- (instancetype) initWithBytes:(const uint8_t *)bytes length:(NSUInteger)length encoding:(NSStringEncoding)encoding {
+    self = [super init];
+    if (self) {
+        _bytes = bytes;
+        _length = bytes ? length : 0;
+        _encoding = encoding;
+    }
+    return self;
+}
+
+- (BOOL) enumerateFieldsUsingBlock:(void (^)(NSUInteger, ExLiteralSlice, ExLiteralSlice, BOOL *))block {
+    _pos = 0;
+    NSUInteger objectIndex = 0;
+    BOOL stop = NO;
+    // the list may come wrapped in array brackets, objects inside are enumerated
+    [self skipSpaces];
+    BOOL inArray = _pos < _length && _bytes[_pos] == '[';
+    if (inArray) {
+        _pos++;
+    }
+    while (!stop) {
+        [self skipSeparators];
+        if (_pos >= _length) {
+            // unterminated array
+            return !inArray;
+        }
+        if (inArray && _bytes[_pos] == ']') {
+            _pos++;
+            inArray = NO;
+            continue;
+        }
+        if (_bytes[_pos] != '{') {
+            // top level scalars are not expected, skip them
+            ExLiteralSlice ignored;
+            if (![self readValue:&ignored]) {
+                return NO;
+            }
+            continue;
+        }
+        // read object fields
+        _pos++;
+        while (!stop) {
+            [self skipSeparators];
+            if (_pos >= _length) {
+                return NO;
+            }
+            if (_bytes[_pos] == '}') {
+                _pos++;
+                break;
+            }
+            ExLiteralSlice key;
+            if (![self readKey:&key]) {
+                return NO;
+            }
+            [self skipSpaces];
+            if (_pos >= _length || _bytes[_pos] != ':') {
+                return NO;
+            }
+            _pos++;
+            [self skipSpaces];
+            ExLiteralSlice value;
+            if (![self readValue:&value]) {
+                return NO;
+            }
+            block(objectIndex, key, value, &stop);
+        }
+        objectIndex++;
+    }
+    return YES;
+}
+
+- (NSString *) stringFromSlice:(ExLiteralSlice)slice {
+    if (!slice.escaped) {
+        return [self decodeBytes:slice.bytes length:slice.length];
+    }
+    NSMutableString *res = [NSMutableString stringWithCapacity:slice.length];
+    const uint8_t *bytes = slice.bytes;
+    NSUInteger runStart = 0;
+    NSUInteger i = 0;
+    while (i < slice.length) {
+        if (bytes[i] != '\\' || i + 1 >= slice.length) {
+            i++;
+            continue;
+        }
+        if (i > runStart) {
+            NSString *run = [self decodeBytes:bytes + runStart length:i - runStart];
+            if (!run) {
+                return nil;
+            }
+            [res appendString:run];
+        }
+        uint8_t c = bytes[i + 1];
+        i += 2;
+        unichar ch = 0;
+        BOOL append = YES;
+        switch (c) {
+            case 'n': ch = '\n'; break;
+            case 't': ch = '\t'; break;
+            case 'r': ch = '\r'; break;
+            case 'b': ch = '\b'; break;
+            case 'f': ch = '\f'; break;
+            case 'v': ch = '\v'; break;
+            case '0': ch = 0; break;
+            case '\n':
+                // line continuation
+                append = NO;
+                break;
+            case '\r':
+                // line continuation of CR or CRLF line end
+                append = NO;
+                if (i < slice.length && bytes[i] == '\n') {
+                    i++;
+                }
+                break;
+            case 'u':
+            case 'x': {
+                NSUInteger digits = (c == 'u') ? 4 : 2;
+                int value = 0;
+                NSUInteger j = 0;
+                for (; j < digits && i + j < slice.length; j++) {
+                    int hex = ExHexValue(bytes[i + j]);
+                    if (hex < 0) {
+                        break;
+                    }
+                    value = value * 16 + hex;
+                }
+                if (j == digits) {
+                    ch = (unichar)value;
+                    i += digits;
+                } else {
+                    // not an escape, keep the letter
+                    ch = c;
+                }
+                break;
+            }
+            default:
+                // \' \" \\ \/ and any other char stand for themselves
+                if (c < 0x80) {
+                    ch = c;
+                } else {
+                    // multibyte char - keep its bytes in the next run
+                    append = NO;
+                    i -= 1;
+                }
+                break;
+        }
+        if (append) {
+            [res appendFormat:@"%C", ch];
+        }
+        runStart = i;
+    }
+    if (runStart < slice.length) {
+        NSString *run = [self decodeBytes:bytes + runStart length:slice.length - runStart];
+        if (!run) {
+            return nil;
+        }
+        [res appendString:run];
+    }
+    return res;
+}
+
+#pragma mark - private
+
+- (NSString *) decodeBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    if (length == 0) {
+        return @"";
+    }
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:_encoding];
+}
+
+- (void) skipSpaces {
+    while (_pos < _length && ExIsLiteralSpace(_bytes[_pos])) {
+        _pos++;
+    }
+}
+
+- (void) skipSeparators {
+    while (_pos < _length && (ExIsLiteralSpace(_bytes[_pos]) || _bytes[_pos] == ',' || _bytes[_pos] == ';')) {
+        _pos++;
+    }
+}
+
+- (BOOL) readKey:(ExLiteralSlice *)key {
+    uint8_t c = _bytes[_pos];
+    if (c == '"' || c == '\'') {
+        return [self readString:key];
+    }
+    NSUInteger start = _pos;
+    while (_pos < _length && ExIsIdentifierChar(_bytes[_pos])) {
+        _pos++;
+    }
+    if (_pos == start) {
+        return NO;
+    }
+    *key = (ExLiteralSlice){_bytes + start, _pos - start, NO, NO};
+    return YES;
+}
+
+- (BOOL) readString:(ExLiteralSlice *)slice {
+    uint8_t quote = _bytes[_pos];
+    NSUInteger start = ++_pos;
+    BOOL escaped = NO;
+    while (_pos < _length) {
+        uint8_t c = _bytes[_pos];
+        if (c == '\\') {
+            escaped = YES;
+            _pos += 2;
+            continue;
+        }
+        if (c == quote) {
+            *slice = (ExLiteralSlice){_bytes + start, _pos - start, YES, escaped};
+            _pos++;
+            return YES;
+        }
+        _pos++;
+    }
+    return NO;
+}
+
+- (BOOL) readValue:(ExLiteralSlice *)value {
+    if (_pos >= _length) {
+        return NO;
+    }
+    uint8_t c = _bytes[_pos];
+    if (c == '"' || c == '\'') {
+        return [self readString:value];
+    }
+    NSUInteger start = _pos;
+    if (c == '{' || c == '[') {
+        // skip nested structure keeping track of strings
+        NSUInteger depth = 0;
+        while (_pos < _length) {
+            c = _bytes[_pos];
+            if (c == '"' || c == '\'') {
+                ExLiteralSlice ignored;
+                if (![self readString:&ignored]) {
+                    return NO;
+                }
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                depth--;
+                if (depth == 0) {
+                    _pos++;
+                    *value = (ExLiteralSlice){_bytes + start, _pos - start, NO, NO};
+                    return YES;
+                }
+            }
+            _pos++;
+        }
+        return NO;
+    }
+    // number, boolean, null or identifier
+    while (_pos < _length && ExIsIdentifierChar(_bytes[_pos])) {
+        _pos++;
+    }
+    if (_pos == start) {
+        return NO;
+    }
+    *value = (ExLiteralSlice){_bytes + start, _pos - start, NO, NO};
+    return YES;
+}
+
+@end
@@ -8,6 +8,7 @@
 #import <Foundation/Foundation.h>
 
 @class ExMediaTrack;
+@class ExPageScanner;
 
 /**
  * The media object able to read from Ex.ua
@@ -25,7 +26,8 @@
 @property(nonatomic, strong) NSArray<ExMediaTrack *> *__nullable tracks;
 
 /*!
- Creates a Media object given a page URL.
+ Creates a Media object given a page URL. The page is parsed while it downloads and the rest of
+ transfer is cancelled as soon as title, thumbnail and track list are known.
 
  @param url The media page URL
  @param completeBlock The completion handler which will be invoked on main queue
@@ -33,5 +35,66 @@
 + (void) mediaFromExURL:(NSURL *__nonnull)url
         withCompletion:(void (^__nonnull)(ExMedia* __nullable media, NSError * __nullable error))completeBlock;
 
+/*!
+ Creates a Media object from already downloaded page body. The page is read by single pass
+ streaming scanner and DOM parser is used only as fallback when scanner failed to find title.
+
+ @param url The media page URL
+ @param data The page body
+ @param contentType The value of Content-Type header of the page response, may be nil
+ */
++ (ExMedia *__nonnull) mediaWithPageURL:(NSURL *__nonnull)url
+                                   data:(NSData *__nonnull)data
+                      contentTypeHeader:(NSString *__nullable)contentType;
+
+/*!
+ Creates a Media object from page body already fed to scanner. Scanner results are used when
+ title was found, otherwise the body is parsed by DOM parser.
+
+ @param url The media page URL
+ @param scanner The scanner which consumed the whole page body, finished by this method
+ @param data The page body
+ @param contentType The value of Content-Type header of the page response, may be nil
+ */
++ (ExMedia *__nonnull) mediaWithPageURL:(NSURL *__nonnull)url
+                                scanner:(ExPageScanner *__nonnull)scanner
+                                   data:(NSData *__nonnull)data
+                      contentTypeHeader:(NSString *__nullable)contentType;
+
+/*!
+ Creates a Media object from results of page scanner.
+
+ @param url The media page URL
+ @param scanner The scanner which already consumed page body
+ */
++ (ExMedia *__nonnull) mediaWithPageURL:(NSURL *__nonnull)url
+                                scanner:(ExPageScanner *__nonnull)scanner;
+
+/*!
+ Builds media tracks from the literals declared on player_list and player_info script lines.
+
+ @param playerList The text between quotes of player_list line
+ @param playerInfo The text between parenthesis of player_info line, may be nil
+ @return The list of video tracks found, may be empty
+ */
++ (NSArray<ExMediaTrack *> *__nonnull) tracksFromPlayerList:(NSString *__nullable)playerList
+                                                 playerInfo:(NSString *__nullable)playerInfo;
+
+/*!
+ Builds media tracks from raw bytes of player_list and player_info literals without
+ intermediate string copies.
+
+ @param listBytes The bytes between quotes of player_list line
+ @param listLength The number of player_list bytes
+ @param infoBytes The bytes between parenthesis of player_info line, may be NULL
+ @param infoLength The number of player_info bytes
+ @param encoding The page encoding
+ @return The list of video tracks found, may be empty
+ */
++ (NSArray<ExMediaTrack *> *__nonnull) tracksFromPlayerListBytes:(const uint8_t *__nullable)listBytes
+                                                          length:(NSUInteger)listLength
+                                                 playerInfoBytes:(const uint8_t *__nullable)infoBytes
+                                                          length:(NSUInteger)infoLength
+                                                        encoding:(NSStringEncoding)encoding;
 
 @end
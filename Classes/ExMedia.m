@@ -8,6 +8,14 @@
 
 #import "ExMedia.h"
 #import "ExMediaTrack.h"
+#import "ExPageScanner.h"
+#import "ExMediaLoader.h"
+#import "ExLiteralTokenizer.h"
+
+// Set to 1 to cross check results of page scanner against DOM parser
+#ifndef EX_MEDIA_VERIFY_SCANNER
+#define EX_MEDIA_VERIFY_SCANNER 0
+#endif
 
 @interface mediaInfo : NSObject
 @property (strong, nonatomic) NSURL *url;
@@ -17,39 +25,67 @@
 @implementation mediaInfo
 @end
 
-@interface ExMedia()
-- (NSArray *)arrayFromJSONString: (NSString *)jsonString error:(NSError**)error;
-@end
-
 @implementation ExMedia
 
 + (void)mediaFromExURL:(NSURL *__nonnull)url
         withCompletion:(void (^__nonnull)(ExMedia* __nullable media, NSError * __nullable error))completeBlock {
-    // Load a web page.
-    NSURLSession *session = [NSURLSession sharedSession];
-    [[session dataTaskWithRequest:[NSURLRequest requestWithURL:url]
-                completionHandler:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
-                    // parse response
-                    if (error) {
-                        // error occured
-                        completeBlock(nil, error);
-                        return;
-                    }
-                    NSString *contentType = nil;
-                    if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
-                        NSDictionary *headers = [(NSHTTPURLResponse *)response allHeaderFields];
-                        contentType = headers[@"Content-Type"];
-                    }
-                    HTMLDocument *home = [HTMLDocument documentWithData:data
-                                                      contentTypeHeader:contentType];
-                    ExMedia *m = [[ExMedia alloc] init];
-                    m.subtitle = [url absoluteString];
-                    m.pageUrl = url;
-                    // load media info
-                    [m loadFromHTMLDocument:home];
-                    
-                    completeBlock(m, nil);
-                }] resume];
+    // Load a web page parsing it on the fly.
+    [[ExMediaLoader sharedLoader] loadMediaFromURL:url withCompletion:
+     ^(ExMedia * _Nullable media, ExMediaLoadMetrics * _Nonnull metrics, NSError * _Nullable error) {
+         completeBlock(media, error);
+     }];
+}
+
++ (ExMedia *)mediaWithPageURL:(NSURL *)url data:(NSData *)data contentTypeHeader:(NSString *)contentType {
+    // scan page bytes in one pass
+    ExPageScanner *scanner = [[ExPageScanner alloc] initWithContentTypeHeader:contentType];
+    [scanner appendData:data];
+    return [ExMedia mediaWithPageURL:url scanner:scanner data:data contentTypeHeader:contentType];
+}
+
++ (ExMedia *)mediaWithPageURL:(NSURL *)url
+                      scanner:(ExPageScanner *)scanner
+                         data:(NSData *)data
+            contentTypeHeader:(NSString *)contentType {
+    [scanner finish];
+    ExMedia *m;
+    if (scanner.title) {
+        m = [ExMedia mediaWithPageURL:url scanner:scanner];
+    } else {
+        // fall back to DOM parsing
+        NSLog(@"Page scanner failed to find title, parsing DOM of: %@", url);
+        m = [[ExMedia alloc] init];
+        m.subtitle = [url absoluteString];
+        m.pageUrl = url;
+        HTMLDocument *home = [HTMLDocument documentWithData:data
+                                          contentTypeHeader:contentType];
+        [m loadFromHTMLDocument:home];
+    }
+    
+#if EX_MEDIA_VERIFY_SCANNER
+    // cross check scanner results against DOM parser
+    ExMedia *reference = [[ExMedia alloc] init];
+    [reference loadFromHTMLDocument:[HTMLDocument documentWithData:data contentTypeHeader:contentType]];
+    if (![m hasSameContentAs:reference]) {
+        NSLog(@"Page scanner results differ from DOM parser for: %@", url);
+    }
+#endif
+    return m;
+}
+
++ (ExMedia *)mediaWithPageURL:(NSURL *)url scanner:(ExPageScanner *)scanner {
+    ExMedia *m = [[ExMedia alloc] init];
+    m.subtitle = [url absoluteString];
+    m.pageUrl = url;
+    m.title = scanner.title;
+    m.thumbnailURL = scanner.thumbnailURL;
+    m.posterURL = m.thumbnailURL;
+    if (scanner.tracks.count > 0) {
+        m.tracks = scanner.tracks;
+    }
+    m.mimeType = @"video/mp4";
+    
+    return m;
 }
 
 - (void)loadFromHTMLDocument:(HTMLDocument *) document {
@@ -84,9 +120,8 @@
 - (NSArray *)findMediaInElement:(HTMLElement*) script {
     NSString *text = [script textContent];
     // extract media URLs
-    NSMutableArray *urls = [NSMutableArray array];
+    __block NSString *playerList = nil;
     if ([text containsString:@"player_list"]) {
-        // extract video URLs
         [text enumerateLinesUsingBlock:^(NSString * _Nonnull line, BOOL * _Nonnull stop) {
             NSRange startRange = [line rangeOfString:@"player_list"];
             if (startRange.length > 0) {
@@ -95,20 +130,7 @@
                 NSUInteger end = [line rangeOfString:@"'"
                                              options:NSLiteralSearch
                                                range:NSMakeRange(start + 1, line.length - start - 1)].location;
-                NSString *jsonStr = [NSString stringWithFormat:@"[%@]", [line substringWithRange:NSMakeRange(start + 1, end - start - 1)]];
-                NSError *error;
-                NSArray *array = [self arrayFromJSONString:jsonStr error:&error];
-                if (array) {
-                    for (NSDictionary *dict in array) {
-                        // check object type
-                        if ([[dict objectForKey:@"type"] isEqualToString:@"video"]) {
-                            // get URL
-                            [urls addObject: [NSURL URLWithString: [dict objectForKey:@"url"]]];
-                        }
-                    }
-                } else {
-                    NSLog(@"Failed to parse JSON string: [%@], reason: %@", jsonStr, error);
-                }
+                playerList = [line substringWithRange:NSMakeRange(start + 1, end - start - 1)];
                 
                 // no need to enumerate any further
                 *stop = YES;
@@ -116,7 +138,7 @@
         }];
     }
     // extract media names
-    NSMutableArray *info = [NSMutableArray array];
+    __block NSString *playerInfo = nil;
     if ([text containsString:@"player_info"]) {
         [text enumerateLinesUsingBlock:^(NSString * _Nonnull line, BOOL * _Nonnull stop) {
             NSRange startRange = [line rangeOfString:@"player_info"];
@@ -126,51 +148,116 @@
                 NSUInteger end = [line rangeOfString:@")"
                                              options:NSLiteralSearch
                                                range:NSMakeRange(start + 1, line.length - start - 1)].location;
-                NSString *jsonStr = [NSString stringWithFormat:@"[%@]", [line substringWithRange:NSMakeRange(start + 1, end - start - 1)]];
-                jsonStr = [jsonStr stringByReplacingOccurrencesOfString:@"pos" withString:@"\"pos\""];
-                jsonStr = [jsonStr stringByReplacingOccurrencesOfString:@"title" withString:@"\"title\""];
-                jsonStr = [jsonStr stringByReplacingOccurrencesOfString:@"'" withString:@"\""];
-                
-                NSError *error;
-                NSArray *array = [self arrayFromJSONString:jsonStr error:&error];
-                if (array) {
-                    for (NSDictionary *dict in array) {
-                        [info addObject:[dict objectForKey:@"title"]];
-                    }
-                } else {
-                    NSLog(@"Failed to parse JSON string: [%@], reason: %@", jsonStr, error);
-                }
+                playerInfo = [line substringWithRange:NSMakeRange(start + 1, end - start - 1)];
                 
                 // no need to enumerate any further
                 *stop = YES;
             }
         }];
     }
-    // prepare results
-    NSMutableArray *res = [NSMutableArray array];
-    for (int i = 0; i < urls.count; i++) {
-        // store
-        ExMediaTrack *track = [[ExMediaTrack alloc]init];
-        track.identifier = i;
-        track.url = [urls objectAtIndex:i];
-        track.mimeType = @"video/mp4";
+    
+    return [ExMedia tracksFromPlayerList:playerList playerInfo:playerInfo];
+}
+
++ (NSArray<ExMediaTrack *> *)tracksFromPlayerList:(NSString *)playerList playerInfo:(NSString *)playerInfo {
+    NSData *listData = [playerList dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *infoData = [playerInfo dataUsingEncoding:NSUTF8StringEncoding];
+    return [self tracksFromPlayerListBytes:listData.bytes
+                                    length:listData.length
+                           playerInfoBytes:infoData.bytes
+                                    length:infoData.length
+                                  encoding:NSUTF8StringEncoding];
+}
 
-        if (i < info.count) {
-            track.name = [info objectAtIndex:i];
++ (NSArray<ExMediaTrack *> *)tracksFromPlayerListBytes:(const uint8_t *)listBytes
+                                                length:(NSUInteger)listLength
+                                       playerInfoBytes:(const uint8_t *)infoBytes
+                                                length:(NSUInteger)infoLength
+                                              encoding:(NSStringEncoding)encoding {
+    NSMutableArray<ExMediaTrack *> *res = [NSMutableArray array];
+    if (!listBytes) {
+        return res;
+    }
+    // extract video URLs
+    ExLiteralTokenizer *list = [[ExLiteralTokenizer alloc] initWithBytes:listBytes length:listLength encoding:encoding];
+    __block NSUInteger currentObject = 0;
+    __block BOOL isVideo = NO;
+    __block NSString *urlString = nil;
+    void (^addTrack)(void) = ^{
+        NSURL *url = (isVideo && urlString) ? [NSURL URLWithString:urlString] : nil;
+        if (url) {
+            ExMediaTrack *track = [[ExMediaTrack alloc] init];
+            track.identifier = res.count;
+            track.url = url;
+            track.mimeType = @"video/mp4";
+            [res addObject:track];
+        }
+        isVideo = NO;
+        urlString = nil;
+    };
+    BOOL parsed = [list enumerateFieldsUsingBlock:^(NSUInteger objectIndex, ExLiteralSlice key, ExLiteralSlice value, BOOL *stop) {
+        if (objectIndex != currentObject) {
+            addTrack();
+            currentObject = objectIndex;
+        }
+        if (ExLiteralSliceEquals(key, "type")) {
+            isVideo = ExLiteralSliceEquals(value, "video");
+        } else if (ExLiteralSliceEquals(key, "url")) {
+            urlString = [list stringFromSlice:value];
+        }
+    }];
+    addTrack();
+    if (!parsed) {
+        NSLog(@"Failed to parse player list literal: [%@]", [[NSString alloc] initWithBytes:listBytes length:listLength encoding:encoding]);
+    }
+    
+    // extract media names
+    if (infoBytes && res.count > 0) {
+        ExLiteralTokenizer *info = [[ExLiteralTokenizer alloc] initWithBytes:infoBytes length:infoLength encoding:encoding];
+        parsed = [info enumerateFieldsUsingBlock:^(NSUInteger objectIndex, ExLiteralSlice key, ExLiteralSlice value, BOOL *stop) {
+            if (objectIndex >= res.count) {
+                *stop = YES;
+                return;
+            }
+            if (ExLiteralSliceEquals(key, "title")) {
+                res[objectIndex].name = [info stringFromSlice:value];
+            }
+        }];
+        if (!parsed) {
+            NSLog(@"Failed to parse player info literal: [%@]", [[NSString alloc] initWithBytes:infoBytes length:infoLength encoding:encoding]);
         }
+    }
+    for (ExMediaTrack *track in res) {
         if (! track.name) {
             track.name = [track.url absoluteString];
         }
-        
-        [res addObject:track];
     }
     
     return res;
 }
 
 #pragma mark - private
-- (NSArray *)arrayFromJSONString: (NSString *)jsonString error:(NSError**)error {
-    NSData *data = [jsonString dataUsingEncoding:NSUTF8StringEncoding];
-    return (NSArray *)[NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingMutableContainers error:error];
+#if EX_MEDIA_VERIFY_SCANNER
+- (BOOL)hasSameContentAs:(ExMedia *)other {
+    if (!(self.title == other.title || [self.title isEqualToString:other.title])) {
+        return NO;
+    }
+    if (!(self.thumbnailURL == other.thumbnailURL || [self.thumbnailURL isEqual:other.thumbnailURL])) {
+        return NO;
+    }
+    if (self.tracks.count != other.tracks.count) {
+        return NO;
+    }
+    for (NSUInteger i = 0; i < self.tracks.count; i++) {
+        ExMediaTrack *track = self.tracks[i];
+        ExMediaTrack *otherTrack = other.tracks[i];
+        if (track.identifier != otherTrack.identifier
+            || ![track.url isEqual:otherTrack.url]
+            || ![track.name isEqualToString:otherTrack.name]) {
+            return NO;
+        }
+    }
+    return YES;
 }
+#endif
 @end
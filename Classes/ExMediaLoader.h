@@ -0,0 +1,79 @@
+//
+//  ExMediaLoader.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+@class ExMedia;
+@class ExPageCache;
+
+/**
+ * The metrics collected while loading single media page
+ */
+@interface ExMediaLoadMetrics : NSObject
+
+// The page URL
+@property (nonatomic, strong) NSURL *__nullable pageUrl;
+// The number of body bytes received before transfer was finished or cancelled
+@property (nonatomic, assign) int64_t bytesReceived;
+// The expected body length as reported by server or -1 if unknown
+@property (nonatomic, assign) int64_t bytesExpected;
+// The number of bytes not downloaded due to early cancel or 0 if body length is unknown
+@property (nonatomic, assign, readonly) int64_t bytesSaved;
+// The time from request start till the track list was extracted or -1 if no tracks found
+@property (nonatomic, assign) NSTimeInterval timeToFirstTrack;
+// The time from request start till media was ready
+@property (nonatomic, assign) NSTimeInterval totalTime;
+// Indicates whether transfer was cancelled once all media info was extracted
+@property (nonatomic, assign) BOOL cancelledEarly;
+// Indicates whether server reported page as not modified and media was taken from page cache
+@property (nonatomic, assign) BOOL notModified;
+
+@end
+
+/**
+ * The loader which parses Ex.ua pages while they download and cancels the rest of transfer
+ * as soon as title, thumbnail and track list are known. Previously loaded pages are revalidated
+ * with conditional requests and served from page cache when not modified.
+ */
+@interface ExMediaLoader : NSObject
+
+// The total number of pages loaded
+@property (nonatomic, assign, readonly) NSUInteger pagesLoaded;
+// The number of pages which transfer was cancelled early
+@property (nonatomic, assign, readonly) NSUInteger pagesCancelledEarly;
+// The total number of body bytes received
+@property (nonatomic, assign, readonly) int64_t totalBytesReceived;
+// The total number of body bytes not downloaded due to early cancel
+@property (nonatomic, assign, readonly) int64_t totalBytesSaved;
+// The cache of parsed pages used for revalidation
+@property (nonatomic, strong, readonly) ExPageCache *__nonnull pageCache;
+
+/**
+ * Returns shared loader instance
+ */
++ (instancetype __nonnull) sharedLoader;
+
+/*!
+ Creates loader with specified session configuration and page cache.
+
+ @param configuration The configuration of loader's session, its URL cache is disabled so that
+        304 responses are delivered to loader
+ @param pageCache The cache of parsed pages
+ */
+- (instancetype __nonnull) initWithSessionConfiguration:(NSURLSessionConfiguration *__nonnull)configuration
+                                              pageCache:(ExPageCache *__nonnull)pageCache;
+
+/*!
+ Loads media from specified page URL.
+
+ @param url The media page URL
+ @param completeBlock The completion handler which will be invoked on the loader's private queue
+ */
+- (void) loadMediaFromURL:(NSURL *__nonnull)url
+           withCompletion:(void (^__nonnull)(ExMedia *__nullable media, ExMediaLoadMetrics *__nonnull metrics, NSError *__nullable error))completeBlock;
+
+@end
@@ -0,0 +1,249 @@
+//
+//  ExMediaLoader.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ExMediaLoader.h"
+
+#import "ExMedia.h"
+#import "ExPageCache.h"
+#import "ExPageScanner.h"
+
+// Set to 1 to log metrics of every loaded page
+#ifndef EX_MEDIA_LOADER_LOG
+#define EX_MEDIA_LOADER_LOG 0
+#endif
+
+@implementation ExMediaLoadMetrics
+
+- (int64_t) bytesSaved {
+    if (!self.cancelledEarly || self.bytesExpected <= 0) {
+        return 0;
+    }
+    return MAX(self.bytesExpected - self.bytesReceived, 0);
+}
+
+- (NSString *) description {
+    return [NSString stringWithFormat:@"received: %lld of %lld bytes, saved: %lld bytes, first track: %.3f s, total: %.3f s, cancelled early: %@, not modified: %@",
+            self.bytesReceived, self.bytesExpected, self.bytesSaved, self.timeToFirstTrack, self.totalTime,
+            self.cancelledEarly ? @"YES" : @"NO", self.notModified ? @"YES" : @"NO"];
+}
+
+@end
+
+/**
+ * The state of single page load
+ */
+@interface ExMediaLoadOperation : NSObject
+
+@property (strong, nonatomic) NSURL *url;
+@property (strong, nonatomic) NSString *contentType;
+@property (strong, nonatomic) NSHTTPURLResponse *response;
+@property (strong, nonatomic) ExPageScanner *scanner;
+@property (strong, nonatomic) NSMutableData *data;
+@property (strong, nonatomic) ExMediaLoadMetrics *metrics;
+@property (assign, nonatomic) CFAbsoluteTime startTime;
+@property (copy, nonatomic) void (^completeBlock)(ExMedia *media, ExMediaLoadMetrics *metrics, NSError *error);
+
+@end
+
+@implementation ExMediaLoadOperation
+@end
+
+@interface ExMediaLoader () <NSURLSessionDataDelegate>
+
+@property (nonatomic, assign, readwrite) NSUInteger pagesLoaded;
+@property (nonatomic, assign, readwrite) NSUInteger pagesCancelledEarly;
+@property (nonatomic, assign, readwrite) int64_t totalBytesReceived;
+@property (nonatomic, assign, readwrite) int64_t totalBytesSaved;
+
+@end
+
+@implementation ExMediaLoader {
+    // The session delivering body chunks to this loader
+    NSURLSession *_session;
+    // The operations in progress keyed by task identifier
+    NSMutableDictionary<NSNumber *, ExMediaLoadOperation *> *_operations;
+}
+
++ (instancetype) sharedLoader {
+    static dispatch_once_t p = 0;
+    __strong static id _sharedLoader = nil;
+
+    dispatch_once(&p, ^{
+        _sharedLoader = [[self alloc] init];
+    });
+
+    return _sharedLoader;
+}
+
+- (instancetype) init {
+    return [self initWithSessionConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]
+                                    pageCache:[ExPageCache sharedCache]];
+}
+
+- (instancetype) initWithSessionConfiguration:(NSURLSessionConfiguration *)configuration pageCache:(ExPageCache *)pageCache {
+    self = [super init];
+    if (self) {
+        _operations = [NSMutableDictionary dictionary];
+        _pageCache = pageCache;
+        // revalidation is done by page cache, URL cache would hide 304 responses from us
+        NSURLSessionConfiguration *config = [configuration copy];
+        config.URLCache = nil;
+        config.requestCachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+        NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+        queue.maxConcurrentOperationCount = 1;
+        queue.name = @"ExMediaLoader";
+        _session = [NSURLSession sessionWithConfiguration:config
+                                                 delegate:self
+                                            delegateQueue:queue];
+    }
+    return self;
+}
+
+- (void) loadMediaFromURL:(NSURL *)url
+           withCompletion:(void (^)(ExMedia *media, ExMediaLoadMetrics *metrics, NSError *error))completeBlock {
+    ExMediaLoadOperation *operation = [[ExMediaLoadOperation alloc] init];
+    operation.url = url;
+    operation.data = [NSMutableData data];
+    operation.metrics = [[ExMediaLoadMetrics alloc] init];
+    operation.metrics.pageUrl = url;
+    operation.metrics.bytesExpected = -1;
+    operation.metrics.timeToFirstTrack = -1;
+    operation.completeBlock = completeBlock;
+    operation.startTime = CFAbsoluteTimeGetCurrent();
+
+    [self startOperation:operation withRequest:[self.pageCache requestForURL:url]];
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    ExMediaLoadOperation *operation = [self operationForTask:dataTask];
+    if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+        operation.response = (NSHTTPURLResponse *)response;
+        operation.contentType = [operation.response allHeaderFields][@"Content-Type"];
+        if (operation && operation.response.statusCode == 304) {
+            [self removeOperationForTask:dataTask];
+            completionHandler(NSURLSessionResponseCancel);
+
+            ExMedia *media = [self.pageCache mediaForNotModifiedURL:operation.url];
+            if (media) {
+                operation.metrics.notModified = YES;
+                [self completeOperation:operation withMedia:media error:nil];
+            } else {
+                // entry was evicted meanwhile - load the whole page
+                [self startOperation:operation withRequest:[NSURLRequest requestWithURL:operation.url]];
+            }
+            return;
+        }
+    }
+    operation.metrics.bytesExpected = response.expectedContentLength;
+    // reset state in case of redirect with body
+    operation.data = [NSMutableData data];
+    operation.scanner = [[ExPageScanner alloc] initWithContentTypeHeader:operation.contentType];
+
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    ExMediaLoadOperation *operation = [self operationForTask:dataTask];
+    if (!operation) {
+        return;
+    }
+    [operation.data appendData:data];
+    operation.metrics.bytesReceived += data.length;
+
+    [operation.scanner appendData:data];
+    if (operation.scanner.tracks && operation.metrics.timeToFirstTrack < 0) {
+        operation.metrics.timeToFirstTrack = CFAbsoluteTimeGetCurrent() - operation.startTime;
+    }
+    if (operation.scanner.complete) {
+        // everything we need is known - skip the rest of the page
+        operation.metrics.cancelledEarly = YES;
+        [self removeOperationForTask:dataTask];
+        [dataTask cancel];
+
+        [operation.scanner finish];
+        ExMedia *media = [ExMedia mediaWithPageURL:operation.url scanner:operation.scanner];
+        [self completeOperation:operation withMedia:media error:nil];
+        [self storeMedia:media forOperation:operation];
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    ExMediaLoadOperation *operation = [self removeOperationForTask:task];
+    if (!operation) {
+        // already completed
+        return;
+    }
+    if (error) {
+        [self completeOperation:operation withMedia:nil error:error];
+        return;
+    }
+    // the full parser deals with pages scanner could not read
+    ExMedia *media = [ExMedia mediaWithPageURL: operation.url
+                                       scanner: operation.scanner
+                                          data: operation.data
+                             contentTypeHeader: operation.contentType];
+    [self completeOperation:operation withMedia:media error:nil];
+    [self storeMedia:media forOperation:operation];
+}
+
+#pragma mark - private
+
+- (void) startOperation:(ExMediaLoadOperation *)operation withRequest:(NSURLRequest *)request {
+    NSURLSessionDataTask *task = [_session dataTaskWithRequest:request];
+    @synchronized (_operations) {
+        _operations[@(task.taskIdentifier)] = operation;
+    }
+    [task resume];
+}
+
+- (void) storeMedia:(ExMedia *)media forOperation:(ExMediaLoadOperation *)operation {
+    // only complete pages which have title are worth revalidation
+    if (media.title && operation.response.statusCode == 200) {
+        [self.pageCache storeMedia:media forResponse:operation.response];
+    }
+}
+
+- (ExMediaLoadOperation *) operationForTask:(NSURLSessionTask *)task {
+    @synchronized (_operations) {
+        return _operations[@(task.taskIdentifier)];
+    }
+}
+
+- (ExMediaLoadOperation *) removeOperationForTask:(NSURLSessionTask *)task {
+    @synchronized (_operations) {
+        NSNumber *key = @(task.taskIdentifier);
+        ExMediaLoadOperation *operation = _operations[key];
+        [_operations removeObjectForKey:key];
+        return operation;
+    }
+}
+
+- (void) completeOperation:(ExMediaLoadOperation *)operation withMedia:(ExMedia *)media error:(NSError *)error {
+    ExMediaLoadMetrics *metrics = operation.metrics;
+    metrics.totalTime = CFAbsoluteTimeGetCurrent() - operation.startTime;
+    if (!error) {
+        self.pagesLoaded += 1;
+        if (metrics.cancelledEarly) {
+            self.pagesCancelledEarly += 1;
+        }
+    }
+    self.totalBytesReceived += metrics.bytesReceived;
+    self.totalBytesSaved += metrics.bytesSaved;
+
+#if EX_MEDIA_LOADER_LOG
+    NSLog(@"Loaded media page: %@, %@", operation.url, metrics);
+#endif
+
+    operation.completeBlock(media, metrics, error);
+}
+
+@end
@@ -0,0 +1,73 @@
+//
+//  ExPageCache.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+@class ExMedia;
+
+/**
+ * The persistent cache of parsed Ex.ua pages keyed by page URL. Every entry holds HTTP validators
+ * (ETag and Last-Modified) of the page response along with extracted title, thumbnail and
+ * track list, so that conditional request answered with 304 can be served without parsing.
+ */
+@interface ExPageCache : NSObject
+
+// The number of lookups which found entry and produced conditional request
+@property (nonatomic, assign, readonly) NSUInteger hits;
+// The number of lookups which found nothing and produced plain request
+@property (nonatomic, assign, readonly) NSUInteger misses;
+// The number of 304 responses answered from cache
+@property (nonatomic, assign, readonly) NSUInteger notModifiedResponses;
+
+/**
+ * Returns shared cache instance which stores entries in application caches directory
+ */
++ (instancetype __nonnull) sharedCache;
+
+/*!
+ Creates cache which stores entries in specified directory.
+
+ @param directory The directory URL, it will be created if missing
+ */
+- (instancetype __nonnull) initWithDirectory:(NSURL *__nonnull)directory;
+
+/*!
+ Creates request for the page. If page was cached the request is made conditional with
+ If-None-Match and If-Modified-Since headers. Counts as either hit or miss.
+
+ @param url The media page URL
+ */
+- (NSURLRequest *__nonnull) requestForURL:(NSURL *__nonnull)url;
+
+/*!
+ Returns media stored for the page which server reported as not modified and counts 304 response.
+
+ @param url The media page URL
+ @return The cached media or nil if entry is gone
+ */
+- (ExMedia *__nullable) mediaForNotModifiedURL:(NSURL *__nonnull)url;
+
+/*!
+ Stores media extracted from the page. Entry is saved only when response carries validators,
+ otherwise previous entry for the page is dropped.
+
+ @param media The media extracted from the page
+ @param response The page response
+ */
+- (void) storeMedia:(ExMedia *__nonnull)media forResponse:(NSHTTPURLResponse *__nonnull)response;
+
+/*!
+ Removes entry for specified page URL.
+ */
+- (void) removeEntryForURL:(NSURL *__nonnull)url;
+
+/*!
+ Removes all entries and resets counters.
+ */
+- (void) removeAllEntries;
+
+@end
@@ -0,0 +1,276 @@
+//
+//  ExPageCache.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ExPageCache.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+#import "ExMedia.h"
+#import "ExMediaTrack.h"
+
+static NSString *const kTrackNameKey = @"name";
+static NSString *const kTrackURLKey = @"url";
+static NSString *const kTrackIdentifierKey = @"identifier";
+static NSString *const kTrackMimeTypeKey = @"mimeType";
+
+/**
+ * The cached results of single page
+ */
+@interface ExPageCacheEntry : NSObject <NSCoding>
+
+@property (strong, nonatomic) NSURL *pageUrl;
+@property (copy, nonatomic) NSString *etag;
+@property (copy, nonatomic) NSString *lastModified;
+@property (copy, nonatomic) NSString *title;
+@property (strong, nonatomic) NSURL *thumbnailURL;
+// The list of tracks as dictionaries with identifier, MIME type, name and url
+@property (strong, nonatomic) NSArray<NSDictionary *> *tracks;
+
+@end
+
+@implementation ExPageCacheEntry
+
+- (instancetype) initWithCoder:(NSCoder *)aDecoder {
+    self = [super init];
+    if (self) {
+        _pageUrl = [aDecoder decodeObjectForKey:@"pageUrl"];
+        _etag = [aDecoder decodeObjectForKey:@"etag"];
+        _lastModified = [aDecoder decodeObjectForKey:@"lastModified"];
+        _title = [aDecoder decodeObjectForKey:@"title"];
+        _thumbnailURL = [aDecoder decodeObjectForKey:@"thumbnailURL"];
+        _tracks = [aDecoder decodeObjectForKey:@"tracks"];
+    }
+    return self;
+}
+
+- (void) encodeWithCoder:(NSCoder *)aCoder {
+    [aCoder encodeObject:self.pageUrl forKey:@"pageUrl"];
+    [aCoder encodeObject:self.etag forKey:@"etag"];
+    [aCoder encodeObject:self.lastModified forKey:@"lastModified"];
+    [aCoder encodeObject:self.title forKey:@"title"];
+    [aCoder encodeObject:self.thumbnailURL forKey:@"thumbnailURL"];
+    [aCoder encodeObject:self.tracks forKey:@"tracks"];
+}
+
+- (ExMedia *) media {
+    ExMedia *m = [[ExMedia alloc] init];
+    m.subtitle = [self.pageUrl absoluteString];
+    m.pageUrl = self.pageUrl;
+    m.title = self.title;
+    m.thumbnailURL = self.thumbnailURL;
+    m.posterURL = m.thumbnailURL;
+    if (self.tracks.count > 0) {
+        NSMutableArray *tracks = [NSMutableArray arrayWithCapacity:self.tracks.count];
+        for (NSDictionary *info in self.tracks) {
+            ExMediaTrack *track = [[ExMediaTrack alloc] init];
+            // entries written before identifier and MIME type were stored get defaults of page scanner
+            NSNumber *identifier = info[kTrackIdentifierKey];
+            track.identifier = identifier ? [identifier integerValue] : tracks.count;
+            track.mimeType = info[kTrackMimeTypeKey] ?: @"video/mp4";
+            track.name = info[kTrackNameKey];
+            track.url = info[kTrackURLKey];
+            [tracks addObject:track];
+        }
+        m.tracks = tracks;
+    }
+    m.mimeType = @"video/mp4";
+
+    return m;
+}
+
+@end
+
+@interface ExPageCache ()
+
+@property (nonatomic, assign, readwrite) NSUInteger hits;
+@property (nonatomic, assign, readwrite) NSUInteger misses;
+@property (nonatomic, assign, readwrite) NSUInteger notModifiedResponses;
+
+@end
+
+@implementation ExPageCache {
+    // The directory holding archived entries
+    NSURL *_directory;
+    // The entries already read from disk keyed by page URL string
+    NSCache<NSString *, ExPageCacheEntry *> *_memoryCache;
+}
+
++ (instancetype) sharedCache {
+    static dispatch_once_t p = 0;
+    __strong static id _sharedCache = nil;
+
+    dispatch_once(&p, ^{
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        NSURL *directory = [[[fileManager URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] lastObject]
+                            URLByAppendingPathComponent:@"pages"];
+        _sharedCache = [[self alloc] initWithDirectory:directory];
+    });
+
+    return _sharedCache;
+}
+
+- (instancetype) initWithDirectory:(NSURL *)directory {
+    self = [super init];
+    if (self) {
+        _directory = directory;
+        _memoryCache = [[NSCache alloc] init];
+        _memoryCache.countLimit = 200;
+
+        NSError *error;
+        if (![[NSFileManager defaultManager] createDirectoryAtURL:directory
+                                      withIntermediateDirectories:YES
+                                                       attributes:nil
+                                                            error:&error]) {
+            NSLog(@"Failed to create page cache directory, reason: %@", error);
+        }
+    }
+    return self;
+}
+
+- (NSURLRequest *) requestForURL:(NSURL *)url {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
+    ExPageCacheEntry *entry = [self entryForURL:url];
+    @synchronized (self) {
+        if (entry) {
+            self.hits += 1;
+        } else {
+            self.misses += 1;
+        }
+    }
+    if (entry.etag) {
+        [request setValue:entry.etag forHTTPHeaderField:@"If-None-Match"];
+    }
+    if (entry.lastModified) {
+        [request setValue:entry.lastModified forHTTPHeaderField:@"If-Modified-Since"];
+    }
+    return request;
+}
+
+- (ExMedia *) mediaForNotModifiedURL:(NSURL *)url {
+    ExPageCacheEntry *entry = [self entryForURL:url];
+    if (!entry) {
+        return nil;
+    }
+    @synchronized (self) {
+        self.notModifiedResponses += 1;
+    }
+    return [entry media];
+}
+
+- (void) storeMedia:(ExMedia *)media forResponse:(NSHTTPURLResponse *)response {
+    NSDictionary *headers = [response allHeaderFields];
+    NSString *etag = headers[@"ETag"];
+    NSString *lastModified = headers[@"Last-Modified"];
+    if (!etag && !lastModified) {
+        // nothing to revalidate with
+        [self removeEntryForURL:media.pageUrl];
+        return;
+    }
+
+    ExPageCacheEntry *entry = [[ExPageCacheEntry alloc] init];
+    entry.pageUrl = media.pageUrl;
+    entry.etag = etag;
+    entry.lastModified = lastModified;
+    entry.title = media.title;
+    entry.thumbnailURL = media.thumbnailURL;
+    NSMutableArray *tracks = [NSMutableArray arrayWithCapacity:media.tracks.count];
+    for (ExMediaTrack *track in media.tracks) {
+        if (track.url) {
+            NSMutableDictionary *info = [NSMutableDictionary dictionaryWithCapacity:4];
+            info[kTrackIdentifierKey] = @(track.identifier);
+            info[kTrackMimeTypeKey] = track.mimeType;
+            info[kTrackNameKey] = track.name ? track.name : [track.url absoluteString];
+            info[kTrackURLKey] = track.url;
+            [tracks addObject:info];
+        }
+    }
+    entry.tracks = tracks;
+
+    NSString *key = [media.pageUrl absoluteString];
+    [_memoryCache setObject:entry forKey:key];
+    @synchronized (self) {
+        if (![NSKeyedArchiver archiveRootObject:entry toFile:[[self fileURLForKey:key] path]]) {
+            NSLog(@"Failed to write page cache entry for: %@", media.pageUrl);
+        }
+    }
+}
+
+- (void) removeEntryForURL:(NSURL *)url {
+    NSString *key = [url absoluteString];
+    [_memoryCache removeObjectForKey:key];
+    @synchronized (self) {
+        NSURL *fileURL = [self fileURLForKey:key];
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        if ([fileManager fileExistsAtPath:[fileURL path]]) {
+            NSError *error;
+            if (![fileManager removeItemAtURL:fileURL error:&error]) {
+                NSLog(@"Failed to delete page cache entry, reason: %@", error);
+            }
+        }
+    }
+}
+
+- (void) removeAllEntries {
+    [_memoryCache removeAllObjects];
+    @synchronized (self) {
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        NSArray *files = [fileManager contentsOfDirectoryAtURL:_directory
+                                    includingPropertiesForKeys:nil
+                                                       options:0
+                                                         error:nil];
+        for (NSURL *fileURL in files) {
+            NSError *error;
+            if (![fileManager removeItemAtURL:fileURL error:&error]) {
+                NSLog(@"Failed to delete page cache entry, reason: %@", error);
+            }
+        }
+        self.hits = 0;
+        self.misses = 0;
+        self.notModifiedResponses = 0;
+    }
+}
+
+#pragma mark - private
+
+- (ExPageCacheEntry *) entryForURL:(NSURL *)url {
+    NSString *key = [url absoluteString];
+    ExPageCacheEntry *entry = [_memoryCache objectForKey:key];
+    if (entry) {
+        return entry;
+    }
+    @synchronized (self) {
+        NSString *path = [[self fileURLForKey:key] path];
+        if (![[NSFileManager defaultManager] fileExistsAtPath:path]) {
+            return nil;
+        }
+        @try {
+            entry = [NSKeyedUnarchiver unarchiveObjectWithFile:path];
+        } @catch (NSException *exception) {
+            NSLog(@"Failed to read page cache entry for: %@, reason: %@", url, exception);
+            entry = nil;
+        }
+    }
+    if (![entry isKindOfClass:[ExPageCacheEntry class]] || ![entry.pageUrl isEqual:url]) {
+        return nil;
+    }
+    [_memoryCache setObject:entry forKey:key];
+    return entry;
+}
+
+- (NSURL *) fileURLForKey:(NSString *)key {
+    NSData *data = [key dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1([data bytes], (CC_LONG)[data length], digest);
+
+    NSMutableString *hash = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+        [hash appendFormat:@"%02x", digest[i]];
+    }
+    return [_directory URLByAppendingPathComponent:hash];
+}
+
+@end
@@ -0,0 +1,50 @@
+//
+//  ExPageScanner.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+@class ExMediaTrack;
+
+/**
+ * The streaming scanner able to extract media info from raw Ex.ua page bytes without building DOM.
+ * It makes single forward pass over the data and may be fed with page body chunk by chunk as
+ * it arrives from network.
+ */
+@interface ExPageScanner : NSObject
+
+// The page title (text content of the first h1 element) or nil if not found yet
+@property (nonatomic, copy, readonly) NSString *__nullable title;
+// The thumbnail URL (src of the first img with alt equal to the title) or nil
+@property (nonatomic, strong, readonly) NSURL *__nullable thumbnailURL;
+// The media tracks found in the first script declaring player_list
+@property (nonatomic, strong, readonly) NSArray<ExMediaTrack *> *__nullable tracks;
+// Indicates whether title, thumbnail and tracks are all resolved and rest of page may be skipped
+@property (nonatomic, assign, readonly, getter=isComplete) BOOL complete;
+// The number of bytes consumed by scanner so far
+@property (nonatomic, assign, readonly) NSUInteger bytesScanned;
+
+/*!
+ Creates scanner for page served with specified Content-Type header.
+
+ @param contentType The value of Content-Type header used to detect page encoding, may be nil
+ */
+- (instancetype __nonnull) initWithContentTypeHeader:(NSString *__nullable)contentType;
+
+/*!
+ Scans next chunk of the page body. Markup split across chunks is kept until the rest arrives.
+ Does nothing when scanner is already complete.
+
+ @param data The next chunk of page bytes
+ */
+- (void) appendData:(NSData *__nonnull)data;
+
+/*!
+ Signals the end of the page body and flushes any pending state.
+ */
+- (void) finish;
+
+@end
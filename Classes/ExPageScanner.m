@@ -0,0 +1,529 @@
+//
+//  ExPageScanner.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ExPageScanner.h"
+
+#import <string.h>
+#import <HTMLReader/HTMLReader.h>
+
+#import "ExMedia.h"
+#import "ExMediaTrack.h"
+
+// The longest tag name we care about
+#define kMaxTagNameLength 8
+
+static const char kPlayerListMarker[] = "player_list";
+static const char kPlayerInfoMarker[] = "player_info";
+// The raw text elements which content is not markup
+static const char kScriptTag[] = "script";
+static const char kStyleTag[] = "style";
+
+#pragma mark - byte helpers
+
+static inline BOOL ExIsSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static inline BOOL ExIsAlpha(uint8_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline uint8_t ExToLower(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+}
+
+// Compares ASCII bytes case insensitively with lower case pattern
+static BOOL ExMatchesLowercase(const uint8_t *bytes, NSUInteger length, const char *pattern) {
+    size_t patternLength = strlen(pattern);
+    if (length < patternLength) {
+        return NO;
+    }
+    for (size_t i = 0; i < patternLength; i++) {
+        if (ExToLower(bytes[i]) != (uint8_t)pattern[i]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+// Finds position of "</name" followed by delimiter or NSNotFound
+static NSUInteger ExFindClosingTag(const uint8_t *bytes, NSUInteger from, NSUInteger length, const char *name) {
+    size_t nameLength = strlen(name);
+    NSUInteger pos = from;
+    while (pos < length) {
+        const uint8_t *lt = memchr(bytes + pos, '<', length - pos);
+        if (!lt) {
+            return NSNotFound;
+        }
+        NSUInteger start = lt - bytes;
+        // need "</" + name + delimiter
+        if (start + 2 + nameLength >= length) {
+            return NSNotFound;
+        }
+        if (bytes[start + 1] == '/' && ExMatchesLowercase(bytes + start + 2, nameLength, name)) {
+            uint8_t next = bytes[start + 2 + nameLength];
+            if (ExIsSpace(next) || next == '/' || next == '>') {
+                return start;
+            }
+        }
+        pos = start + 1;
+    }
+    return NSNotFound;
+}
+
+#pragma mark - text helpers
+
+static NSStringEncoding ExEncodingFromCharset(NSString *charset) {
+    if (charset.length == 0) {
+        return 0;
+    }
+    CFStringEncoding cfEncoding = CFStringConvertIANACharSetNameToEncoding((__bridge CFStringRef)charset);
+    if (cfEncoding == kCFStringEncodingInvalidId) {
+        return 0;
+    }
+    return CFStringConvertEncodingToNSStringEncoding(cfEncoding);
+}
+
+// Extracts value of charset parameter from header or meta content
+static NSString *ExCharsetFromString(NSString *string) {
+    if (!string) {
+        return nil;
+    }
+    NSRange range = [string rangeOfString:@"charset=" options:NSCaseInsensitiveSearch];
+    if (range.location == NSNotFound) {
+        return nil;
+    }
+    NSCharacterSet *stops = [NSCharacterSet characterSetWithCharactersInString:@"; \t\"'"];
+    NSString *rest = [[string substringFromIndex:NSMaxRange(range)]
+                      stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"\"' "]];
+    NSRange end = [rest rangeOfCharacterFromSet:stops];
+    return end.location == NSNotFound ? rest : [rest substringToIndex:end.location];
+}
+
+// Decodes character references found in text and attribute values the same way DOM parser does,
+// using its full table of named references
+static NSString *ExDecodeEntities(NSString *text) {
+    if ([text rangeOfString:@"&"].location == NSNotFound) {
+        return text;
+    }
+    return [text html_stringByUnescapingHTML];
+}
+
+@interface ExPageScanner ()
+
+@property (nonatomic, copy, readwrite) NSString *title;
+@property (nonatomic, strong, readwrite) NSURL *thumbnailURL;
+@property (nonatomic, strong, readwrite) NSArray<ExMediaTrack *> *tracks;
+@property (nonatomic, assign, readwrite) NSUInteger bytesScanned;
+
+@end
+
+@implementation ExPageScanner {
+    // The bytes received but not consumed yet
+    NSMutableData *_buffer;
+    // The position of first not consumed byte in buffer
+    NSUInteger _pos;
+    // The raw text element we are inside of (script or style) or NULL
+    const char *_rawTag;
+    // The position to resume closing tag search from inside raw text
+    NSUInteger _rawSearchFrom;
+    // The title capturing state
+    BOOL _capturingTitle;
+    BOOL _titleResolved;
+    NSMutableData *_titleBytes;
+    // The img [alt, src] pairs met before title was known
+    NSMutableArray<NSArray<NSString *> *> *_pendingImages;
+    BOOL _thumbnailResolved;
+    BOOL _tracksResolved;
+    // The page encoding
+    NSStringEncoding _encoding;
+    BOOL _encodingKnown;
+    BOOL _finished;
+}
+
+- (instancetype) initWithContentTypeHeader:(NSString *)contentType {
+    self = [super init];
+    if (self) {
+        _buffer = [NSMutableData data];
+        _titleBytes = [NSMutableData data];
+        _pendingImages = [NSMutableArray array];
+        _encoding = ExEncodingFromCharset(ExCharsetFromString(contentType));
+        _encodingKnown = _encoding != 0;
+        if (!_encodingKnown) {
+            _encoding = NSUTF8StringEncoding;
+        }
+    }
+    return self;
+}
+
+- (BOOL) isComplete {
+    return _titleResolved && _thumbnailResolved && _tracksResolved;
+}
+
+- (void) appendData:(NSData *)data {
+    if (_finished || self.complete) {
+        return;
+    }
+    [_buffer appendData:data];
+    [self scan];
+    [self compact];
+}
+
+- (void) finish {
+    if (_finished) {
+        return;
+    }
+    _finished = YES;
+    if (!self.complete) {
+        // unterminated script runs up to the end of the page
+        if (_rawTag == kScriptTag && !_tracksResolved) {
+            [self processScriptBytes:(const uint8_t *)_buffer.bytes + _pos length:_buffer.length - _pos];
+        }
+        // unterminated heading runs up to the end of the page
+        if (_capturingTitle) {
+            if (!_rawTag && _pos < _buffer.length) {
+                const uint8_t *bytes = _buffer.bytes;
+                const uint8_t *lt = memchr(bytes + _pos, '<', _buffer.length - _pos);
+                NSUInteger end = lt ? lt - bytes : _buffer.length;
+                [_titleBytes appendBytes:bytes + _pos length:end - _pos];
+            }
+            [self resolveTitle];
+        }
+    }
+    self.bytesScanned += _buffer.length - _pos;
+    _buffer = nil;
+    _pendingImages = nil;
+}
+
+#pragma mark - scanning
+
+- (void) scan {
+    const uint8_t *bytes = _buffer.bytes;
+    NSUInteger length = _buffer.length;
+    while (_pos < length && !self.complete) {
+        if (_rawTag) {
+            NSUInteger end = ExFindClosingTag(bytes, _rawSearchFrom, length, _rawTag);
+            if (end == NSNotFound) {
+                // keep the tail which may hold beginning of closing tag
+                NSUInteger keep = strlen(_rawTag) + 2;
+                _rawSearchFrom = MAX(_rawSearchFrom, length > keep ? length - keep : 0);
+                return;
+            }
+            if (_rawTag == kScriptTag && !_tracksResolved) {
+                [self processScriptBytes:bytes + _pos length:end - _pos];
+            }
+            _pos = end;
+            _rawTag = NULL;
+            continue;
+        }
+        const uint8_t *lt = memchr(bytes + _pos, '<', length - _pos);
+        NSUInteger textEnd = lt ? lt - bytes : length;
+        if (_capturingTitle && textEnd > _pos) {
+            [_titleBytes appendBytes:bytes + _pos length:textEnd - _pos];
+        }
+        _pos = textEnd;
+        if (!lt) {
+            return;
+        }
+        NSUInteger consumed = [self scanMarkup:bytes + _pos length:length - _pos];
+        if (consumed == 0) {
+            // wait for the rest of markup
+            return;
+        }
+        _pos += consumed;
+        if (_rawTag) {
+            // raw text starts right after the tag
+            _rawSearchFrom = _pos;
+        }
+    }
+}
+
+// Drops consumed bytes from buffer
+- (void) compact {
+    if (_pos == 0) {
+        return;
+    }
+    self.bytesScanned += _pos;
+    if (self.complete) {
+        _buffer = [NSMutableData data];
+        _pos = 0;
+        return;
+    }
+    [_buffer replaceBytesInRange:NSMakeRange(0, _pos) withBytes:NULL length:0];
+    _rawSearchFrom = _rawSearchFrom > _pos ? _rawSearchFrom - _pos : 0;
+    _pos = 0;
+}
+
+// Scans markup starting with '<' and returns number of consumed bytes or 0 if more data needed
+- (NSUInteger) scanMarkup:(const uint8_t *)bytes length:(NSUInteger)length {
+    if (length < 2) {
+        return 0;
+    }
+    uint8_t next = bytes[1];
+    if (next == '!') {
+        if (length < 4) {
+            return 0;
+        }
+        if (bytes[2] == '-' && bytes[3] == '-') {
+            const uint8_t *end = memmem(bytes + 4, length - 4, "-->", 3);
+            return end ? (end - bytes) + 3 : 0;
+        }
+        const uint8_t *gt = memchr(bytes, '>', length);
+        return gt ? (gt - bytes) + 1 : 0;
+    }
+    if (next == '?') {
+        const uint8_t *gt = memchr(bytes, '>', length);
+        return gt ? (gt - bytes) + 1 : 0;
+    }
+    BOOL closing = (next == '/');
+    NSUInteger nameStart = closing ? 2 : 1;
+    if (nameStart >= length) {
+        return 0;
+    }
+    if (!ExIsAlpha(bytes[nameStart])) {
+        // not a tag - just text
+        if (_capturingTitle) {
+            [_titleBytes appendBytes:bytes length:1];
+        }
+        return 1;
+    }
+    // find end of tag respecting quoted attribute values
+    NSUInteger end = nameStart;
+    uint8_t quote = 0;
+    while (end < length) {
+        uint8_t c = bytes[end];
+        if (quote) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            break;
+        }
+        end++;
+    }
+    if (end >= length) {
+        return 0;
+    }
+    NSUInteger nameEnd = nameStart;
+    while (nameEnd < end && !ExIsSpace(bytes[nameEnd]) && bytes[nameEnd] != '/' && bytes[nameEnd] != '>') {
+        nameEnd++;
+    }
+    char name[kMaxTagNameLength + 1];
+    NSUInteger nameLength = nameEnd - nameStart;
+    if (nameLength <= kMaxTagNameLength) {
+        for (NSUInteger i = 0; i < nameLength; i++) {
+            name[i] = (char)ExToLower(bytes[nameStart + i]);
+        }
+        name[nameLength] = '\0';
+        if (closing) {
+            [self handleClosingTag:name];
+        } else {
+            [self handleOpeningTag:name attributes:bytes + nameEnd length:end - nameEnd];
+        }
+    }
+    return end + 1;
+}
+
+- (void) handleClosingTag:(const char *)name {
+    if (_capturingTitle && strcmp(name, "h1") == 0) {
+        [self resolveTitle];
+    }
+}
+
+- (void) handleOpeningTag:(const char *)name attributes:(const uint8_t *)bytes length:(NSUInteger)length {
+    if (strcmp(name, "h1") == 0) {
+        if (!_titleResolved && !_capturingTitle) {
+            _capturingTitle = YES;
+        }
+    } else if (strcmp(name, "img") == 0) {
+        if (!_thumbnailResolved) {
+            NSDictionary<NSString *, NSString *> *attributes = [self parseAttributes:bytes length:length];
+            NSString *alt = attributes[@"alt"];
+            if (alt) {
+                [self handleImageWithAlt:alt src:attributes[@"src"]];
+            }
+        }
+    } else if (strcmp(name, kScriptTag) == 0) {
+        _rawTag = kScriptTag;
+    } else if (strcmp(name, kStyleTag) == 0) {
+        _rawTag = kStyleTag;
+    } else if (strcmp(name, "meta") == 0 && !_encodingKnown) {
+        NSDictionary<NSString *, NSString *> *attributes = [self parseAttributes:bytes length:length];
+        NSString *charset = attributes[@"charset"] ?: ExCharsetFromString(attributes[@"content"]);
+        NSStringEncoding encoding = ExEncodingFromCharset(charset);
+        if (encoding) {
+            _encoding = encoding;
+            _encodingKnown = YES;
+        }
+    }
+}
+
+// Parses attributes of the tag into dictionary with lower case names
+- (NSDictionary<NSString *, NSString *> *) parseAttributes:(const uint8_t *)bytes length:(NSUInteger)length {
+    NSMutableDictionary<NSString *, NSString *> *res = [NSMutableDictionary dictionary];
+    NSUInteger pos = 0;
+    while (pos < length) {
+        while (pos < length && (ExIsSpace(bytes[pos]) || bytes[pos] == '/')) {
+            pos++;
+        }
+        NSUInteger nameStart = pos;
+        while (pos < length && !ExIsSpace(bytes[pos]) && bytes[pos] != '=' && bytes[pos] != '/') {
+            pos++;
+        }
+        if (pos == nameStart) {
+            break;
+        }
+        NSString *name = [[[NSString alloc] initWithBytes:bytes + nameStart
+                                                   length:pos - nameStart
+                                                 encoding:NSASCIIStringEncoding] lowercaseString];
+        while (pos < length && ExIsSpace(bytes[pos])) {
+            pos++;
+        }
+        NSString *value = @"";
+        if (pos < length && bytes[pos] == '=') {
+            pos++;
+            while (pos < length && ExIsSpace(bytes[pos])) {
+                pos++;
+            }
+            NSUInteger valueStart = pos;
+            NSUInteger valueEnd;
+            if (pos < length && (bytes[pos] == '"' || bytes[pos] == '\'')) {
+                uint8_t quote = bytes[pos];
+                valueStart = ++pos;
+                while (pos < length && bytes[pos] != quote) {
+                    pos++;
+                }
+                valueEnd = pos;
+                pos++;
+            } else {
+                while (pos < length && !ExIsSpace(bytes[pos])) {
+                    pos++;
+                }
+                valueEnd = pos;
+            }
+            value = ExDecodeEntities([self stringFromBytes:bytes + valueStart length:valueEnd - valueStart]) ?: @"";
+        }
+        // the first attribute with the same name wins
+        if (name && !res[name]) {
+            res[name] = value;
+        }
+    }
+    return res;
+}
+
+- (void) handleImageWithAlt:(NSString *)alt src:(NSString *)src {
+    if (!_titleResolved) {
+        // compare later when title is known
+        [_pendingImages addObject:@[alt, src ?: @""]];
+        return;
+    }
+    if ([alt isEqualToString:self.title]) {
+        self.thumbnailURL = src.length > 0 ? [NSURL URLWithString:src] : nil;
+        _thumbnailResolved = YES;
+    }
+}
+
+- (void) resolveTitle {
+    _capturingTitle = NO;
+    _titleResolved = YES;
+    self.title = ExDecodeEntities([self stringFromBytes:_titleBytes.bytes length:_titleBytes.length]);
+    _titleBytes = nil;
+    // check images met so far
+    NSArray<NSArray<NSString *> *> *pending = _pendingImages;
+    _pendingImages = nil;
+    for (NSArray<NSString *> *image in pending) {
+        [self handleImageWithAlt:image[0] src:image[1]];
+        if (_thumbnailResolved) {
+            break;
+        }
+    }
+}
+
+// Extracts player_list and player_info literals from the script body and builds tracks if any
+- (void) processScriptBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    const uint8_t *listBytes, *infoBytes;
+    NSUInteger listLength, infoLength;
+    if (![self findLiteralOnLineWithMarker:kPlayerListMarker
+                                      open:'\''
+                                     close:'\''
+                                   inBytes:bytes
+                                    length:length
+                                    result:&listBytes
+                                    length:&listLength]) {
+        return;
+    }
+    if (![self findLiteralOnLineWithMarker:kPlayerInfoMarker
+                                      open:'('
+                                     close:')'
+                                   inBytes:bytes
+                                    length:length
+                                    result:&infoBytes
+                                    length:&infoLength]) {
+        infoBytes = NULL;
+        infoLength = 0;
+    }
+    NSArray<ExMediaTrack *> *tracks = [ExMedia tracksFromPlayerListBytes:listBytes
+                                                                  length:listLength
+                                                         playerInfoBytes:infoBytes
+                                                                  length:infoLength
+                                                                encoding:_encoding];
+    if (tracks.count > 0) {
+        self.tracks = tracks;
+        _tracksResolved = YES;
+    }
+}
+
+// Finds bytes between the first open and the following close char on the first line holding marker
+- (BOOL) findLiteralOnLineWithMarker:(const char *)marker
+                                open:(uint8_t)open
+                               close:(uint8_t)close
+                             inBytes:(const uint8_t *)bytes
+                              length:(NSUInteger)length
+                              result:(const uint8_t **)result
+                              length:(NSUInteger *)resultLength {
+    const uint8_t *found = memmem(bytes, length, marker, strlen(marker));
+    if (!found) {
+        return NO;
+    }
+    const uint8_t *lineStart = found;
+    while (lineStart > bytes && lineStart[-1] != '\n' && lineStart[-1] != '\r') {
+        lineStart--;
+    }
+    const uint8_t *end = bytes + length;
+    const uint8_t *lineEnd = found;
+    while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') {
+        lineEnd++;
+    }
+    const uint8_t *start = memchr(lineStart, open, lineEnd - lineStart);
+    if (!start) {
+        return NO;
+    }
+    start++;
+    const uint8_t *stop = memchr(start, close, lineEnd - start);
+    if (!stop) {
+        return NO;
+    }
+    *result = start;
+    *resultLength = stop - start;
+    return YES;
+}
+
+- (NSString *) stringFromBytes:(const void *)bytes length:(NSUInteger)length {
+    if (length == 0) {
+        return @"";
+    }
+    NSString *res = [[NSString alloc] initWithBytes:bytes length:length encoding:_encoding];
+    if (!res && !_encodingKnown) {
+        // legacy pages are served in Cyrillic code page
+        res = [[NSString alloc] initWithBytes:bytes length:length encoding:NSWindowsCP1251StringEncoding];
+    }
+    return res;
+}
+
+@end
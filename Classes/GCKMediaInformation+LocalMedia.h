@@ -24,4 +24,9 @@
 
 + (GCKMediaInformation *)mediaInformationFromTrack:(CVMediaTrack *)media forRecord: (CVMediaRecordMO *)record;
 
+/**
+ * Converts the range of record's tracks, e.g. the rest of series to queue at once.
+ */
++ (NSArray<GCKMediaInformation *> *)mediaInformationFromTracksInRange:(NSRange)range forRecord: (CVMediaRecordMO *)record;
+
 @end
@@ -21,6 +21,18 @@
 #import "GCKMediaInformation+LocalMedia.h"
 #import "CVMediaTrack.h"
 
+/**
+ * Returns the type reported by server when it names media, e.g. not application/octet-stream of
+ * misconfigured file host, otherwise the type of record
+ */
+static NSString *ContentTypeOfTrack(CVMediaTrack *track, CVMediaRecordMO *record) {
+    NSString *type = [track.contentType lowercaseString];
+    if ([type hasPrefix:@"video/"] || [type hasPrefix:@"audio/"]) {
+        return track.contentType;
+    }
+    return record.mimeType;
+}
+
 @implementation GCKMediaInformation (LocalMedia)
 
 + (GCKMediaInformation *)mediaInformationFromTrack:(CVMediaTrack *)media forRecord: (CVMediaRecordMO *)record {
@@ -39,9 +51,9 @@
     }
     
     GCKMediaInformation *mi =
-    [[GCKMediaInformation alloc] initWithContentID: media.address
+    [[GCKMediaInformation alloc] initWithContentID: [[media playbackURL] absoluteString]
                                         streamType: GCKMediaStreamTypeNone
-                                       contentType: record.mimeType
+                                       contentType: ContentTypeOfTrack(media, record)
                                           metadata: metadata
                                     streamDuration: 0
                                        mediaTracks: nil
@@ -50,6 +62,14 @@
     return mi;
 }
 
++ (NSArray<GCKMediaInformation *> *)mediaInformationFromTracksInRange:(NSRange)range forRecord: (CVMediaRecordMO *)record {
+    NSMutableArray<GCKMediaInformation *> *media = [NSMutableArray arrayWithCapacity:range.length];
+    for (CVMediaTrack *track in [record.tracks objectsAtIndexes:[NSIndexSet indexSetWithIndexesInRange:range]]) {
+        [media addObject:[self mediaInformationFromTrack:track forRecord:record]];
+    }
+    return media;
+}
+
 + (GCKMediaTrackType)trackTypeFrom:(NSString *)string {
     if ([string isEqualToString:@"audio"]) {
         return GCKMediaTrackTypeAudio;
@@ -0,0 +1,65 @@
+//
+//  ImageDiskCache.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The size-bounded disk cache of image files. Files are spread over sharded subdirectories by
+ * the first byte of SHA-1 of the key. The index of cached files (key hash, size and last access time)
+ * is loaded once and persisted in background, so lookups never touch the file system for missing
+ * entries. When total size exceeds the byte limit the least recently used files are evicted.
+ */
+@interface ImageDiskCache : NSObject
+
+// The maximal number of bytes to keep on disk, setting lower value schedules eviction
+@property (nonatomic, assign) unsigned long long byteLimit;
+// The number of bytes currently stored
+@property (nonatomic, assign, readonly) unsigned long long totalBytes;
+// The number of files currently stored
+@property (nonatomic, assign, readonly) NSUInteger count;
+// The number of files evicted to stay within byte limit
+@property (nonatomic, assign, readonly) NSUInteger evictions;
+
+/*!
+ Creates cache in specified directory loading its index. If index is missing it is rebuilt from
+ files found in directory, files stored before sharding was introduced are moved to their shards.
+ Otherwise shards modified after index was written are listed, so files stored or removed since the
+ last index write are accounted for.
+
+ @param directory The cache directory, it will be created if missing
+ @param byteLimit The maximal number of bytes to keep on disk
+ */
+- (instancetype __nonnull) initWithDirectory:(NSURL *__nonnull)directory
+                                   byteLimit:(unsigned long long)byteLimit;
+
+/*!
+ Reads data stored for the key and marks it as most recently used.
+
+ @param key The key, usually image URL string
+ @return The data or nil if nothing stored
+ */
+- (NSData *__nullable) dataForKey:(NSString *__nonnull)key;
+
+/*!
+ Stores data for the key replacing previous one. Eviction runs in background if byte limit exceeded.
+
+ @return YES if data was written
+ */
+- (BOOL) storeData:(NSData *__nonnull)data forKey:(NSString *__nonnull)key;
+
+/*!
+ Removes data stored for the key.
+ */
+- (void) removeDataForKey:(NSString *__nonnull)key;
+
+/*!
+ Writes index to disk if it was changed since last write. Normally index is written in background
+ shortly after changes and when application enters background.
+ */
+- (void) synchronize;
+
+@end
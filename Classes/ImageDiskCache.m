@@ -0,0 +1,493 @@
+//
+//  ImageDiskCache.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ImageDiskCache.h"
+
+#import <UIKit/UIKit.h>
+#import <CommonCrypto/CommonDigest.h>
+
+// The name of index file in cache directory
+static NSString *const kIndexFileName = @"index.bin";
+// The index file signature followed by format version
+static const uint32_t kIndexMagic = 0x43495845; // 'EXIC'
+static const uint32_t kIndexVersion = 1;
+// The size of index record: SHA-1 digest, file size and last access time
+static const NSUInteger kIndexRecordLength = CC_SHA1_DIGEST_LENGTH + sizeof(uint64_t) + sizeof(double);
+// The delay before changed index is written
+static const NSTimeInterval kIndexWriteDelay = 5.0;
+// The fraction of byte limit to trim cache down to, keeps eviction from running on every store
+static const double kEvictionTargetRatio = 0.9;
+// The coarsest modification time resolution of file systems, shards changed that close to index write are rescanned
+static const NSTimeInterval kModificationTimeSlack = 2.0;
+
+/**
+ * The index record of cached file
+ */
+@interface ImageDiskCacheEntry : NSObject
+
+@property (assign, nonatomic) unsigned long long size;
+@property (assign, nonatomic) NSTimeInterval lastAccess;
+
+@end
+
+@implementation ImageDiskCacheEntry
+@end
+
+@interface ImageDiskCache ()
+
+@property (nonatomic, assign, readwrite) unsigned long long totalBytes;
+@property (nonatomic, assign, readwrite) NSUInteger evictions;
+
+@end
+
+@implementation ImageDiskCache {
+    NSURL *_directory;
+    // The index records keyed by hex SHA-1 of the key
+    NSMutableDictionary<NSString *, ImageDiskCacheEntry *> *_entries;
+    // The hex SHA-1 of recently used keys
+    NSCache<NSString *, NSString *> *_hashes;
+    // The shard directories known to exist
+    NSMutableSet<NSString *> *_shards;
+    // The queue running index writes and eviction
+    dispatch_queue_t _ioQueue;
+    BOOL _indexDirty;
+    BOOL _indexWriteScheduled;
+    BOOL _evictionScheduled;
+}
+
+- (instancetype) initWithDirectory:(NSURL *)directory byteLimit:(unsigned long long)byteLimit {
+    self = [super init];
+    if (self) {
+        _directory = directory;
+        _byteLimit = byteLimit;
+        _entries = [NSMutableDictionary dictionary];
+        _hashes = [[NSCache alloc] init];
+        _hashes.countLimit = 500;
+        _shards = [NSMutableSet set];
+        _ioQueue = dispatch_queue_create("ImageDiskCache", DISPATCH_QUEUE_SERIAL);
+
+        NSError *error;
+        if (![[NSFileManager defaultManager] createDirectoryAtURL:directory
+                                      withIntermediateDirectories:YES
+                                                       attributes:nil
+                                                            error:&error]) {
+            NSLog(@"Failed to create image cache directory, reason: %@", error);
+        }
+        if (![self readIndex]) {
+            [self rebuildIndex];
+        } else {
+            [self reconcileIndex];
+        }
+        if (self.totalBytes > byteLimit) {
+            [self scheduleEviction];
+        }
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(synchronize)
+                                                     name:UIApplicationDidEnterBackgroundNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (NSData *) dataForKey:(NSString *)key {
+    NSString *hash = [self hashForKey:key];
+    @synchronized (self) {
+        if (!_entries[hash]) {
+            return nil;
+        }
+    }
+    NSData *data = [[NSData alloc] initWithContentsOfURL:[self fileURLForHash:hash]
+                                                 options:NSDataReadingMappedIfSafe
+                                                   error:nil];
+    @synchronized (self) {
+        ImageDiskCacheEntry *entry = _entries[hash];
+        if (!data) {
+            // file was purged behind our back
+            if (entry) {
+                [_entries removeObjectForKey:hash];
+                self.totalBytes -= entry.size;
+                [self scheduleIndexWrite];
+            }
+            return nil;
+        }
+        entry.lastAccess = [NSDate timeIntervalSinceReferenceDate];
+        [self scheduleIndexWrite];
+    }
+    return data;
+}
+
+- (BOOL) storeData:(NSData *)data forKey:(NSString *)key {
+    NSString *hash = [self hashForKey:key];
+    NSString *shard = [hash substringToIndex:2];
+    BOOL shardExists;
+    @synchronized (self) {
+        shardExists = [_shards containsObject:shard];
+    }
+    NSError *error;
+    if (!shardExists) {
+        if (![[NSFileManager defaultManager] createDirectoryAtURL:[_directory URLByAppendingPathComponent:shard]
+                                      withIntermediateDirectories:YES
+                                                       attributes:nil
+                                                            error:&error]) {
+            NSLog(@"Received an error trying to create a directory %@", [error localizedDescription]);
+            return NO;
+        }
+        @synchronized (self) {
+            [_shards addObject:shard];
+        }
+    }
+    if (![data writeToURL:[self fileURLForHash:hash] options:NSDataWritingAtomic error:&error]) {
+        NSLog(@"Received an error trying to save a cached file %@", [error localizedDescription]);
+        return NO;
+    }
+
+    @synchronized (self) {
+        ImageDiskCacheEntry *entry = _entries[hash];
+        if (entry) {
+            self.totalBytes -= entry.size;
+        } else {
+            entry = [[ImageDiskCacheEntry alloc] init];
+            _entries[hash] = entry;
+        }
+        entry.size = data.length;
+        entry.lastAccess = [NSDate timeIntervalSinceReferenceDate];
+        self.totalBytes += entry.size;
+        [self scheduleIndexWrite];
+        if (self.totalBytes > self.byteLimit) {
+            [self scheduleEviction];
+        }
+    }
+    return YES;
+}
+
+- (void) removeDataForKey:(NSString *)key {
+    NSString *hash = [self hashForKey:key];
+    @synchronized (self) {
+        ImageDiskCacheEntry *entry = _entries[hash];
+        if (!entry) {
+            return;
+        }
+        [_entries removeObjectForKey:hash];
+        self.totalBytes -= entry.size;
+        [self scheduleIndexWrite];
+    }
+    NSError *error;
+    if (![[NSFileManager defaultManager] removeItemAtURL:[self fileURLForHash:hash] error:&error]) {
+        NSLog(@"Failed to delete cache record, reason: %@", error);
+    }
+}
+
+- (void) synchronize {
+    dispatch_sync(_ioQueue, ^{
+        [self writeIndex];
+    });
+}
+
+- (void) setByteLimit:(unsigned long long)byteLimit {
+    @synchronized (self) {
+        _byteLimit = byteLimit;
+        if (self.totalBytes > byteLimit) {
+            [self scheduleEviction];
+        }
+    }
+}
+
+- (NSUInteger) count {
+    @synchronized (self) {
+        return _entries.count;
+    }
+}
+
+#pragma mark - private
+
+- (NSString *) hashForKey:(NSString *)key {
+    NSString *hash = [_hashes objectForKey:key];
+    if (hash) {
+        return hash;
+    }
+    NSData *data = [key dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1([data bytes], (CC_LONG)[data length], digest);
+    hash = [self hexStringWithDigest:digest];
+    [_hashes setObject:hash forKey:key];
+    return hash;
+}
+
+- (NSString *) hexStringWithDigest:(const uint8_t *)digest {
+    NSMutableString *hash = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+        [hash appendFormat:@"%02x", digest[i]];
+    }
+    return hash;
+}
+
+- (BOOL) digest:(uint8_t *)digest fromHexString:(NSString *)hash {
+    const char *hex = [hash UTF8String];
+    if (strlen(hex) != CC_SHA1_DIGEST_LENGTH * 2) {
+        return NO;
+    }
+    for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+        unsigned int byte;
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1) {
+            return NO;
+        }
+        digest[i] = (uint8_t)byte;
+    }
+    return YES;
+}
+
+- (NSURL *) fileURLForHash:(NSString *)hash {
+    return [[_directory URLByAppendingPathComponent:[hash substringToIndex:2]] URLByAppendingPathComponent:hash];
+}
+
+- (NSURL *) indexURL {
+    return [_directory URLByAppendingPathComponent:kIndexFileName];
+}
+
+- (BOOL) readIndex {
+    NSData *index = [NSData dataWithContentsOfURL:[self indexURL]];
+    if (index.length < 2 * sizeof(uint32_t)) {
+        return NO;
+    }
+    const uint8_t *bytes = index.bytes;
+    uint32_t magic, version;
+    memcpy(&magic, bytes, sizeof(magic));
+    memcpy(&version, bytes + sizeof(magic), sizeof(version));
+    NSUInteger offset = sizeof(magic) + sizeof(version);
+    if (magic != kIndexMagic || version != kIndexVersion || (index.length - offset) % kIndexRecordLength != 0) {
+        NSLog(@"Image cache index is corrupted, rebuilding");
+        return NO;
+    }
+    unsigned long long totalBytes = 0;
+    for (; offset < index.length; offset += kIndexRecordLength) {
+        uint64_t size;
+        double lastAccess;
+        memcpy(&size, bytes + offset + CC_SHA1_DIGEST_LENGTH, sizeof(size));
+        memcpy(&lastAccess, bytes + offset + CC_SHA1_DIGEST_LENGTH + sizeof(size), sizeof(lastAccess));
+
+        ImageDiskCacheEntry *entry = [[ImageDiskCacheEntry alloc] init];
+        entry.size = size;
+        entry.lastAccess = lastAccess;
+        NSString *hash = [self hexStringWithDigest:bytes + offset];
+        _entries[hash] = entry;
+        [_shards addObject:[hash substringToIndex:2]];
+        totalBytes += size;
+    }
+    self.totalBytes = totalBytes;
+    return YES;
+}
+
+- (void) rebuildIndex {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSArray *keys = @[NSURLIsDirectoryKey, NSURLFileSizeKey, NSURLContentModificationDateKey];
+    NSDirectoryEnumerator *enumerator = [fileManager enumeratorAtURL:_directory
+                                          includingPropertiesForKeys:keys
+                                                             options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                        errorHandler:nil];
+    unsigned long long totalBytes = 0;
+    for (NSURL *fileURL in enumerator) {
+        NSDictionary *values = [fileURL resourceValuesForKeys:keys error:nil];
+        NSString *hash = [fileURL lastPathComponent];
+        uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+        if ([values[NSURLIsDirectoryKey] boolValue] || ![self digest:digest fromHexString:hash] || _entries[hash]) {
+            // not a cached file or the one already moved to its shard
+            continue;
+        }
+        NSURL *shardedURL = [self fileURLForHash:hash];
+        if (![[fileURL URLByDeletingLastPathComponent].lastPathComponent isEqualToString:[hash substringToIndex:2]]) {
+            // flat file from before sharding
+            NSError *error;
+            [fileManager createDirectoryAtURL:[shardedURL URLByDeletingLastPathComponent]
+                  withIntermediateDirectories:YES
+                                   attributes:nil
+                                        error:nil];
+            if (![fileManager moveItemAtURL:fileURL toURL:shardedURL error:&error]) {
+                NSLog(@"Failed to move cached file to its shard, reason: %@", error);
+                [fileManager removeItemAtURL:fileURL error:nil];
+                continue;
+            }
+        }
+        ImageDiskCacheEntry *entry = [[ImageDiskCacheEntry alloc] init];
+        entry.size = [values[NSURLFileSizeKey] unsignedLongLongValue];
+        entry.lastAccess = [values[NSURLContentModificationDateKey] timeIntervalSinceReferenceDate];
+        _entries[hash] = entry;
+        [_shards addObject:[hash substringToIndex:2]];
+        totalBytes += entry.size;
+    }
+    self.totalBytes = totalBytes;
+    _indexDirty = YES;
+    [self writeIndex];
+}
+
+/**
+ * Brings index read from disk in line with files stored or removed after it was written, e.g. before
+ * crash. Only shards modified after index are listed, unknown files found there are adopted and
+ * entries of missing files are dropped.
+ */
+- (void) reconcileIndex {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDate *indexDate = nil;
+    [[self indexURL] getResourceValue:&indexDate forKey:NSURLContentModificationDateKey error:nil];
+    NSArray *keys = @[NSURLIsDirectoryKey, NSURLFileSizeKey, NSURLContentModificationDateKey];
+    NSArray<NSURL *> *shardURLs = [fileManager contentsOfDirectoryAtURL:_directory
+                                             includingPropertiesForKeys:keys
+                                                                options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                  error:nil];
+    NSMutableSet<NSString *> *shards = [NSMutableSet set];
+    NSMutableSet<NSString *> *changedShards = [NSMutableSet set];
+    for (NSURL *shardURL in shardURLs) {
+        NSDictionary *values = [shardURL resourceValuesForKeys:keys error:nil];
+        if (![values[NSURLIsDirectoryKey] boolValue]) {
+            continue;
+        }
+        NSString *shard = [shardURL lastPathComponent];
+        [shards addObject:shard];
+        NSDate *shardDate = values[NSURLContentModificationDateKey];
+        if (!indexDate || !shardDate || [shardDate timeIntervalSinceDate:indexDate] > -kModificationTimeSlack) {
+            [changedShards addObject:shard];
+        }
+    }
+
+    unsigned long long totalBytes = self.totalBytes;
+    NSUInteger adopted = 0, dropped = 0;
+    NSMutableSet<NSString *> *found = [NSMutableSet set];
+    for (NSString *shard in changedShards) {
+        NSArray<NSURL *> *fileURLs = [fileManager contentsOfDirectoryAtURL:[_directory URLByAppendingPathComponent:shard]
+                                                includingPropertiesForKeys:keys
+                                                                   options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                     error:nil];
+        for (NSURL *fileURL in fileURLs) {
+            NSDictionary *values = [fileURL resourceValuesForKeys:keys error:nil];
+            NSString *hash = [fileURL lastPathComponent];
+            uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+            if ([values[NSURLIsDirectoryKey] boolValue] || ![self digest:digest fromHexString:hash] || ![hash hasPrefix:shard]) {
+                // leftover of interrupted write or not a cached file
+                [fileManager removeItemAtURL:fileURL error:nil];
+                continue;
+            }
+            [found addObject:hash];
+            if (_entries[hash]) {
+                continue;
+            }
+            ImageDiskCacheEntry *entry = [[ImageDiskCacheEntry alloc] init];
+            entry.size = [values[NSURLFileSizeKey] unsignedLongLongValue];
+            entry.lastAccess = [values[NSURLContentModificationDateKey] timeIntervalSinceReferenceDate];
+            _entries[hash] = entry;
+            totalBytes += entry.size;
+            adopted++;
+        }
+    }
+    for (NSString *hash in [_entries allKeys]) {
+        NSString *shard = [hash substringToIndex:2];
+        if (![shards containsObject:shard] || ([changedShards containsObject:shard] && ![found containsObject:hash])) {
+            totalBytes -= _entries[hash].size;
+            [_entries removeObjectForKey:hash];
+            dropped++;
+        }
+    }
+    [_shards intersectSet:shards];
+    if (adopted > 0 || dropped > 0) {
+        NSLog(@"Image cache index is outdated, adopted %lu files, dropped %lu entries",
+              (unsigned long)adopted, (unsigned long)dropped);
+        self.totalBytes = totalBytes;
+        @synchronized (self) {
+            [self scheduleIndexWrite];
+        }
+    }
+}
+
+- (void) writeIndex {
+    NSMutableData *index;
+    @synchronized (self) {
+        if (!_indexDirty) {
+            return;
+        }
+        _indexDirty = NO;
+        index = [NSMutableData dataWithCapacity:2 * sizeof(uint32_t) + _entries.count * kIndexRecordLength];
+        [index appendBytes:&kIndexMagic length:sizeof(kIndexMagic)];
+        [index appendBytes:&kIndexVersion length:sizeof(kIndexVersion)];
+        [_entries enumerateKeysAndObjectsUsingBlock:^(NSString *hash, ImageDiskCacheEntry *entry, BOOL *stop) {
+            uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+            if (![self digest:digest fromHexString:hash]) {
+                return;
+            }
+            uint64_t size = entry.size;
+            double lastAccess = entry.lastAccess;
+            [index appendBytes:digest length:sizeof(digest)];
+            [index appendBytes:&size length:sizeof(size)];
+            [index appendBytes:&lastAccess length:sizeof(lastAccess)];
+        }];
+    }
+    NSError *error;
+    if (![index writeToURL:[self indexURL] options:NSDataWritingAtomic error:&error]) {
+        NSLog(@"Failed to write image cache index, reason: %@", error);
+    }
+}
+
+// Must be called while synchronized on self
+- (void) scheduleIndexWrite {
+    _indexDirty = YES;
+    if (_indexWriteScheduled) {
+        return;
+    }
+    _indexWriteScheduled = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kIndexWriteDelay * NSEC_PER_SEC)), _ioQueue, ^{
+        @synchronized (self) {
+            _indexWriteScheduled = NO;
+        }
+        [self writeIndex];
+    });
+}
+
+// Must be called while synchronized on self
+- (void) scheduleEviction {
+    if (_evictionScheduled) {
+        return;
+    }
+    _evictionScheduled = YES;
+    dispatch_async(_ioQueue, ^{
+        [self evict];
+    });
+}
+
+- (void) evict {
+    NSMutableArray<NSString *> *victims = [NSMutableArray array];
+    @synchronized (self) {
+        _evictionScheduled = NO;
+        unsigned long long target = (unsigned long long)(self.byteLimit * kEvictionTargetRatio);
+        NSArray<NSString *> *hashes = [_entries keysSortedByValueUsingComparator:
+                                       ^NSComparisonResult(ImageDiskCacheEntry *e1, ImageDiskCacheEntry *e2) {
+                                           if (e1.lastAccess < e2.lastAccess) {
+                                               return NSOrderedAscending;
+                                           }
+                                           return e1.lastAccess > e2.lastAccess ? NSOrderedDescending : NSOrderedSame;
+                                       }];
+        for (NSString *hash in hashes) {
+            if (self.totalBytes <= target) {
+                break;
+            }
+            self.totalBytes -= _entries[hash].size;
+            [_entries removeObjectForKey:hash];
+            [victims addObject:hash];
+        }
+        self.evictions += victims.count;
+        if (victims.count > 0) {
+            [self scheduleIndexWrite];
+        }
+    }
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    for (NSString *hash in victims) {
+        [fileManager removeItemAtURL:[self fileURLForHash:hash] error:nil];
+    }
+}
+
+@end
@@ -0,0 +1,90 @@
+//
+//  ImageLoader.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <UIKit/UIKit.h>
+
+/**
+ * The priority of image request
+ */
+typedef NS_ENUM(NSInteger, ImageLoadPriority) {
+    // The image which may be needed soon, e.g. row just outside of screen
+    ImageLoadPriorityLow = 0,
+    // The image of the regular view
+    ImageLoadPriorityNormal,
+    // The image on visible row of the list
+    ImageLoadPriorityHigh
+};
+
+/**
+ * The handle of single image request. Cancelled request never calls its completion handler.
+ */
+@interface ImageLoadToken : NSObject
+
+// The URL of requested image
+@property (nonatomic, strong, readonly) NSURL *__nonnull url;
+// The bounding pixel size of requested variant or CGSizeZero for original image
+@property (nonatomic, assign, readonly) CGSize pixelSize;
+// The priority of the request, may be changed while request waits for a free connection
+@property (nonatomic, assign) ImageLoadPriority priority;
+// Indicates whether request was cancelled
+@property (nonatomic, assign, readonly, getter=isCancelled) BOOL cancelled;
+
+/*!
+ Cancels request. Download is aborted when no other request waits for the same image.
+ */
+- (void) cancel;
+
+@end
+
+/**
+ * The asynchronous image loader backed by SimpleImageFetcher caches. At most maxConcurrentLoads images
+ * are read or downloaded at once, waiting requests are started in order of priority. Requests for the
+ * same URL share single download. It must be used from main queue.
+ */
+@interface ImageLoader : NSObject
+
+// The maximal number of images read or downloaded at once
+@property (nonatomic, assign) NSUInteger maxConcurrentLoads;
+// The number of requests which joined a load already in flight
+@property (nonatomic, assign, readonly) NSUInteger coalescedRequests;
+// The number of requests cancelled before completion
+@property (nonatomic, assign, readonly) NSUInteger cancelledRequests;
+
+/**
+ * Returns shared loader instance
+ */
++ (instancetype __nonnull) sharedLoader;
+
+/*!
+ Loads image from specified URL. When decoded image is held in memory the completion handler is
+ invoked before this method returns and no token is created.
+
+ @param url The image URL
+ @param priority The priority of the request
+ @param completeBlock The completion handler invoked on main queue, image is nil if load failed
+ @return The token to cancel request or nil if request was completed immediately
+ */
+- (ImageLoadToken *__nullable) loadImageFromURL:(NSURL *__nonnull)url
+                                       priority:(ImageLoadPriority)priority
+                                     completion:(void (^__nonnull)(UIImage *__nullable image))completeBlock;
+
+/*!
+ Loads variant of image scaled to fit specified pixel size. Variant is produced in background
+ once and only the variant is cached.
+
+ @param url The image URL
+ @param pixelSize The bounding size of variant in pixels, CGSizeZero to load original image
+ @param priority The priority of the request
+ @param completeBlock The completion handler invoked on main queue, image is nil if load failed
+ @return The token to cancel request or nil if request was completed immediately
+ */
+- (ImageLoadToken *__nullable) loadImageFromURL:(NSURL *__nonnull)url
+                                      pixelSize:(CGSize)pixelSize
+                                       priority:(ImageLoadPriority)priority
+                                     completion:(void (^__nonnull)(UIImage *__nullable image))completeBlock;
+
+@end
@@ -0,0 +1,265 @@
+//
+//  ImageLoader.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ImageLoader.h"
+
+#import "SimpleImageFetcher.h"
+
+// The default number of images read or downloaded at once
+static const NSUInteger kDefaultMaxConcurrentLoads = 4;
+
+@class ImageLoadJob;
+
+@interface ImageLoader ()
+
+@property (nonatomic, assign, readwrite) NSUInteger coalescedRequests;
+@property (nonatomic, assign, readwrite) NSUInteger cancelledRequests;
+
+- (void) cancelToken:(ImageLoadToken *)token;
+
+@end
+
+@interface ImageLoadToken ()
+
+@property (nonatomic, strong, readwrite) NSURL *url;
+@property (nonatomic, assign, readwrite) CGSize pixelSize;
+@property (nonatomic, assign, readwrite, getter=isCancelled) BOOL cancelled;
+@property (nonatomic, weak) ImageLoader *loader;
+@property (nonatomic, weak) ImageLoadJob *job;
+@property (nonatomic, copy) void (^completeBlock)(UIImage *image);
+
+@end
+
+@implementation ImageLoadToken
+
+- (void) cancel {
+    [self.loader cancelToken:self];
+}
+
+@end
+
+/**
+ * The load of single image shared by all requests for its URL
+ */
+@interface ImageLoadJob : NSObject
+
+@property (strong, nonatomic) NSURL *url;
+@property (assign, nonatomic) CGSize pixelSize;
+@property (copy, nonatomic) NSString *key;
+@property (strong, nonatomic) NSMutableArray<ImageLoadToken *> *tokens;
+@property (strong, nonatomic) NSURLSessionDataTask *task;
+// The order of job creation used to keep requests of equal priority first in first out
+@property (assign, nonatomic) NSUInteger sequence;
+@property (assign, nonatomic) BOOL running;
+@property (assign, nonatomic) BOOL cancelled;
+
+@end
+
+@implementation ImageLoadJob
+
+- (ImageLoadPriority) priority {
+    ImageLoadPriority priority = ImageLoadPriorityLow;
+    for (ImageLoadToken *token in self.tokens) {
+        priority = MAX(priority, token.priority);
+    }
+    return priority;
+}
+
+@end
+
+@implementation ImageLoader {
+    // The jobs waiting or running keyed by URL string and pixel size
+    NSMutableDictionary<NSString *, ImageLoadJob *> *_jobs;
+    // The jobs waiting for a free slot
+    NSMutableArray<ImageLoadJob *> *_pending;
+    // The number of jobs running
+    NSUInteger _activeLoads;
+    // The sequence number of the next job
+    NSUInteger _sequence;
+    // The session downloading images
+    NSURLSession *_session;
+    // The queue reading and decoding images
+    dispatch_queue_t _workQueue;
+}
+
++ (instancetype) sharedLoader {
+    static dispatch_once_t p = 0;
+    __strong static id _sharedLoader = nil;
+
+    dispatch_once(&p, ^{
+        _sharedLoader = [[self alloc] init];
+    });
+
+    return _sharedLoader;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if (self) {
+        _maxConcurrentLoads = kDefaultMaxConcurrentLoads;
+        _jobs = [NSMutableDictionary dictionary];
+        _pending = [NSMutableArray array];
+        _workQueue = dispatch_queue_create("ImageLoader", DISPATCH_QUEUE_CONCURRENT);
+        dispatch_set_target_queue(_workQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+
+        // images are kept by SimpleImageFetcher caches
+        NSURLSessionConfiguration *config = [NSURLSessionConfiguration defaultSessionConfiguration];
+        config.URLCache = nil;
+        config.HTTPMaximumConnectionsPerHost = kDefaultMaxConcurrentLoads;
+        _session = [NSURLSession sessionWithConfiguration:config];
+    }
+    return self;
+}
+
+- (ImageLoadToken *) loadImageFromURL:(NSURL *)url
+                             priority:(ImageLoadPriority)priority
+                           completion:(void (^)(UIImage *image))completeBlock {
+    return [self loadImageFromURL:url pixelSize:CGSizeZero priority:priority completion:completeBlock];
+}
+
+- (ImageLoadToken *) loadImageFromURL:(NSURL *)url
+                            pixelSize:(CGSize)pixelSize
+                             priority:(ImageLoadPriority)priority
+                           completion:(void (^)(UIImage *image))completeBlock {
+    UIImage *image = [SimpleImageFetcher cachedImageForURL:url pixelSize:pixelSize];
+    if (image) {
+        completeBlock(image);
+        return nil;
+    }
+
+    ImageLoadToken *token = [[ImageLoadToken alloc] init];
+    token.url = url;
+    token.pixelSize = pixelSize;
+    token.priority = priority;
+    token.loader = self;
+    token.completeBlock = completeBlock;
+
+    NSString *key = [NSString stringWithFormat:@"%@#%.0fx%.0f", [url absoluteString], pixelSize.width, pixelSize.height];
+    ImageLoadJob *job = _jobs[key];
+    if (job) {
+        self.coalescedRequests += 1;
+    } else {
+        job = [[ImageLoadJob alloc] init];
+        job.url = url;
+        job.pixelSize = pixelSize;
+        job.key = key;
+        job.tokens = [NSMutableArray array];
+        job.sequence = _sequence++;
+        _jobs[key] = job;
+        [_pending addObject:job];
+    }
+    [job.tokens addObject:token];
+    token.job = job;
+
+    [self startPendingLoads];
+    return token;
+}
+
+- (void) setMaxConcurrentLoads:(NSUInteger)maxConcurrentLoads {
+    _maxConcurrentLoads = MAX(maxConcurrentLoads, 1);
+    [self startPendingLoads];
+}
+
+- (void) cancelToken:(ImageLoadToken *)token {
+    if (token.cancelled || !token.job) {
+        // already cancelled or completed
+        return;
+    }
+    token.cancelled = YES;
+    token.completeBlock = nil;
+    self.cancelledRequests += 1;
+
+    ImageLoadJob *job = token.job;
+    token.job = nil;
+    [job.tokens removeObject:token];
+    if (job.tokens.count > 0) {
+        return;
+    }
+    // nobody waits for the image anymore
+    job.cancelled = YES;
+    [_jobs removeObjectForKey:job.key];
+    if (job.running) {
+        [job.task cancel];
+    } else {
+        [_pending removeObject:job];
+    }
+}
+
+#pragma mark - private
+
+- (void) startPendingLoads {
+    while (_activeLoads < self.maxConcurrentLoads && _pending.count > 0) {
+        ImageLoadJob *next = nil;
+        ImageLoadPriority nextPriority = ImageLoadPriorityLow;
+        for (ImageLoadJob *job in _pending) {
+            ImageLoadPriority priority = [job priority];
+            if (!next || priority > nextPriority || (priority == nextPriority && job.sequence < next.sequence)) {
+                next = job;
+                nextPriority = priority;
+            }
+        }
+        [_pending removeObject:next];
+        next.running = YES;
+        _activeLoads++;
+        [self runJob:next];
+    }
+}
+
+- (void) runJob:(ImageLoadJob *)job {
+    dispatch_async(_workQueue, ^{
+        UIImage *image = [SimpleImageFetcher getImageFromDiskCacheForURL:job.url pixelSize:job.pixelSize];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (image || job.cancelled) {
+                [self finishJob:job withImage:image];
+                return;
+            }
+            job.task = [_session dataTaskWithURL:job.url completionHandler:
+                        ^(NSData *data, NSURLResponse *response, NSError *error) {
+                            NSInteger status = [response isKindOfClass:[NSHTTPURLResponse class]] ?
+                                [(NSHTTPURLResponse *)response statusCode] : 200;
+                            if (error || !data || status != 200) {
+                                if (error.code != NSURLErrorCancelled) {
+                                    NSLog(@"Failed to load image: %@, status: %ld, error: %@", job.url, (long)status, error);
+                                }
+                                dispatch_async(dispatch_get_main_queue(), ^{
+                                    [self finishJob:job withImage:nil];
+                                });
+                                return;
+                            }
+                            dispatch_async(_workQueue, ^{
+                                UIImage *downloadedImage = [SimpleImageFetcher storeDownloadedData:data
+                                                                                            forURL:job.url
+                                                                                         pixelSize:job.pixelSize];
+                                dispatch_async(dispatch_get_main_queue(), ^{
+                                    [self finishJob:job withImage:downloadedImage];
+                                });
+                            });
+                        }];
+            [job.task resume];
+        });
+    });
+}
+
+- (void) finishJob:(ImageLoadJob *)job withImage:(UIImage *)image {
+    _activeLoads--;
+    if (_jobs[job.key] == job) {
+        [_jobs removeObjectForKey:job.key];
+    }
+    NSArray<ImageLoadToken *> *tokens = [job.tokens copy];
+    [job.tokens removeAllObjects];
+    for (ImageLoadToken *token in tokens) {
+        void (^completeBlock)(UIImage *) = token.completeBlock;
+        token.completeBlock = nil;
+        token.job = nil;
+        if (completeBlock) {
+            completeBlock(image);
+        }
+    }
+    [self startPendingLoads];
+}
+
+@end
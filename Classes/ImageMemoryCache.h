@@ -0,0 +1,64 @@
+//
+//  ImageMemoryCache.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <UIKit/UIKit.h>
+
+/**
+ * The in-memory cache of decoded images with byte-cost budget and least recently used eviction.
+ * The cost of image is the size of its decoded bitmap. It is safe to use from any thread.
+ */
+@interface ImageMemoryCache : NSObject
+
+// The maximal number of decoded bytes to keep, setting lower value evicts images immediately
+@property (nonatomic, assign) NSUInteger costLimit;
+// The number of decoded bytes currently held
+@property (nonatomic, assign, readonly) NSUInteger residentBytes;
+// The number of images currently held
+@property (nonatomic, assign, readonly) NSUInteger count;
+// The number of lookups which found image
+@property (nonatomic, assign, readonly) NSUInteger hits;
+// The number of lookups which found nothing
+@property (nonatomic, assign, readonly) NSUInteger misses;
+// The number of images evicted to stay within cost limit
+@property (nonatomic, assign, readonly) NSUInteger evictions;
+// The ratio of hits to all lookups or 0 if there were no lookups
+@property (nonatomic, assign, readonly) double hitRatio;
+
+/*!
+ Creates cache with specified budget. The cache is purged on memory warning.
+
+ @param costLimit The maximal number of decoded bytes to keep
+ */
+- (instancetype __nonnull) initWithCostLimit:(NSUInteger)costLimit;
+
+/*!
+ Returns image for the key marking it as most recently used.
+ */
+- (UIImage *__nullable) imageForKey:(NSString *__nonnull)key;
+
+/*!
+ Stores image for the key and evicts least recently used images if budget is exceeded.
+ Image which alone exceeds the budget is not stored.
+ */
+- (void) setImage:(UIImage *__nonnull)image forKey:(NSString *__nonnull)key;
+
+/*!
+ Removes image for the key.
+ */
+- (void) removeImageForKey:(NSString *__nonnull)key;
+
+/*!
+ Removes all images, counters are kept.
+ */
+- (void) removeAllImages;
+
+/*!
+ Returns the number of bytes taken by decoded bitmap of the image.
+ */
++ (NSUInteger) costForImage:(UIImage *__nonnull)image;
+
+@end
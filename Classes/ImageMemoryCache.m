@@ -0,0 +1,192 @@
+//
+//  ImageMemoryCache.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ImageMemoryCache.h"
+
+/**
+ * The node of recency list
+ */
+@interface ImageMemoryCacheNode : NSObject
+
+@property (copy, nonatomic) NSString *key;
+@property (strong, nonatomic) UIImage *image;
+@property (assign, nonatomic) NSUInteger cost;
+// The more recently used node
+@property (unsafe_unretained, nonatomic) ImageMemoryCacheNode *prev;
+// The less recently used node
+@property (unsafe_unretained, nonatomic) ImageMemoryCacheNode *next;
+
+@end
+
+@implementation ImageMemoryCacheNode
+@end
+
+@interface ImageMemoryCache ()
+
+@property (nonatomic, assign, readwrite) NSUInteger residentBytes;
+@property (nonatomic, assign, readwrite) NSUInteger hits;
+@property (nonatomic, assign, readwrite) NSUInteger misses;
+@property (nonatomic, assign, readwrite) NSUInteger evictions;
+
+@end
+
+@implementation ImageMemoryCache {
+    // The nodes keyed by image key, it owns the nodes
+    NSMutableDictionary<NSString *, ImageMemoryCacheNode *> *_nodes;
+    // The most recently used node
+    ImageMemoryCacheNode *_head;
+    // The least recently used node
+    ImageMemoryCacheNode *_tail;
+}
+
+- (instancetype) initWithCostLimit:(NSUInteger)costLimit {
+    self = [super init];
+    if (self) {
+        _costLimit = costLimit;
+        _nodes = [NSMutableDictionary dictionary];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(removeAllImages)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (UIImage *) imageForKey:(NSString *)key {
+    @synchronized (self) {
+        ImageMemoryCacheNode *node = _nodes[key];
+        if (!node) {
+            self.misses += 1;
+            return nil;
+        }
+        self.hits += 1;
+        [self moveToHead:node];
+        return node.image;
+    }
+}
+
+- (void) setImage:(UIImage *)image forKey:(NSString *)key {
+    NSUInteger cost = [ImageMemoryCache costForImage:image];
+    @synchronized (self) {
+        ImageMemoryCacheNode *node = _nodes[key];
+        if (node) {
+            [self unlinkNode:node];
+            [_nodes removeObjectForKey:key];
+        }
+        if (cost > _costLimit) {
+            return;
+        }
+        node = [[ImageMemoryCacheNode alloc] init];
+        node.key = key;
+        node.image = image;
+        node.cost = cost;
+        _nodes[key] = node;
+        [self linkAtHead:node];
+        [self trimToCost:_costLimit];
+    }
+}
+
+- (void) removeImageForKey:(NSString *)key {
+    @synchronized (self) {
+        ImageMemoryCacheNode *node = _nodes[key];
+        if (node) {
+            [self unlinkNode:node];
+            [_nodes removeObjectForKey:key];
+        }
+    }
+}
+
+- (void) removeAllImages {
+    @synchronized (self) {
+        [_nodes removeAllObjects];
+        _head = nil;
+        _tail = nil;
+        self.residentBytes = 0;
+    }
+}
+
+- (void) setCostLimit:(NSUInteger)costLimit {
+    @synchronized (self) {
+        _costLimit = costLimit;
+        [self trimToCost:costLimit];
+    }
+}
+
+- (NSUInteger) count {
+    @synchronized (self) {
+        return _nodes.count;
+    }
+}
+
+- (double) hitRatio {
+    @synchronized (self) {
+        NSUInteger lookups = self.hits + self.misses;
+        return lookups > 0 ? (double)self.hits / lookups : 0;
+    }
+}
+
++ (NSUInteger) costForImage:(UIImage *)image {
+    CGImageRef cgImage = image.CGImage;
+    if (!cgImage) {
+        return (NSUInteger)(image.size.width * image.scale * image.size.height * image.scale * 4);
+    }
+    return CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage);
+}
+
+#pragma mark - private
+
+- (void) trimToCost:(NSUInteger)cost {
+    while (self.residentBytes > cost && _tail) {
+        ImageMemoryCacheNode *node = _tail;
+        [self unlinkNode:node];
+        [_nodes removeObjectForKey:node.key];
+        self.evictions += 1;
+    }
+}
+
+- (void) linkAtHead:(ImageMemoryCacheNode *)node {
+    node.prev = nil;
+    node.next = _head;
+    if (_head) {
+        _head.prev = node;
+    }
+    _head = node;
+    if (!_tail) {
+        _tail = node;
+    }
+    self.residentBytes += node.cost;
+}
+
+- (void) unlinkNode:(ImageMemoryCacheNode *)node {
+    if (node.prev) {
+        node.prev.next = node.next;
+    } else {
+        _head = node.next;
+    }
+    if (node.next) {
+        node.next.prev = node.prev;
+    } else {
+        _tail = node.prev;
+    }
+    node.prev = nil;
+    node.next = nil;
+    self.residentBytes -= node.cost;
+}
+
+- (void) moveToHead:(ImageMemoryCacheNode *)node {
+    if (_head == node) {
+        return;
+    }
+    [self unlinkNode:node];
+    [self linkAtHead:node];
+}
+
+@end
@@ -0,0 +1,40 @@
+//
+//  ImageScaler.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+
+/**
+ * The producer of reduced image variants. Implementations must not depend on UIKit drawing so that
+ * they can run on any queue and without application.
+ */
+@protocol ImageScaling <NSObject>
+
+/*!
+ Produces encoded variant of the image which fits into specified pixel size keeping aspect ratio.
+ Images already smaller than the size are re-encoded without upscaling.
+
+ @param data The encoded source image
+ @param pixelSize The bounding size in pixels
+ @return The encoded variant or nil if source can not be decoded
+ */
+- (NSData *__nullable) scaledDataWithImageData:(NSData *__nonnull)data toPixelSize:(CGSize)pixelSize;
+
+@end
+
+/**
+ * The scaler based on ImageIO. Source is decoded directly at reduced size, so full size bitmap is never
+ * created. Thumbnail which still exceeds the bounding size is redrawn into small bitmap context, which
+ * is CoreGraphics only and safe on any queue. Variant is encoded as JPEG, or as PNG when the source has
+ * alpha channel, so transparent parts stay transparent.
+ */
+@interface ImageIOScaler : NSObject <ImageScaling>
+
+// The JPEG compression quality of opaque variants in range [0, 1]
+@property (nonatomic, assign) CGFloat compressionQuality;
+
+@end
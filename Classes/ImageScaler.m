@@ -0,0 +1,94 @@
+//
+//  ImageScaler.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "ImageScaler.h"
+
+#import <ImageIO/ImageIO.h>
+#import <MobileCoreServices/MobileCoreServices.h>
+
+// The default JPEG quality of variants, thumbnails do not need more
+static const CGFloat kDefaultCompressionQuality = 0.7;
+
+@implementation ImageIOScaler
+
+- (instancetype) init {
+    self = [super init];
+    if (self) {
+        _compressionQuality = kDefaultCompressionQuality;
+    }
+    return self;
+}
+
+- (NSData *) scaledDataWithImageData:(NSData *)data toPixelSize:(CGSize)pixelSize {
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (!source) {
+        return nil;
+    }
+    NSDictionary *options = @{(__bridge NSString *)kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+                              (__bridge NSString *)kCGImageSourceCreateThumbnailWithTransform : @YES,
+                              (__bridge NSString *)kCGImageSourceShouldCacheImmediately : @YES,
+                              (__bridge NSString *)kCGImageSourceThumbnailMaxPixelSize : @(MAX(pixelSize.width, pixelSize.height))};
+    CGImageRef thumbnail = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    CFRelease(source);
+    if (!thumbnail) {
+        return nil;
+    }
+    CGImageAlphaInfo alphaInfo = CGImageGetAlphaInfo(thumbnail);
+    BOOL opaque = alphaInfo == kCGImageAlphaNone || alphaInfo == kCGImageAlphaNoneSkipFirst ||
+        alphaInfo == kCGImageAlphaNoneSkipLast;
+    // fit the smaller side as well
+    CGFloat ratio = MIN(pixelSize.width / CGImageGetWidth(thumbnail), pixelSize.height / CGImageGetHeight(thumbnail));
+    if (ratio < 1) {
+        CGImageRef fitted = [self createImageFromImage:thumbnail
+                                              withSize:CGSizeMake(floor(CGImageGetWidth(thumbnail) * ratio),
+                                                                  floor(CGImageGetHeight(thumbnail) * ratio))
+                                                opaque:opaque];
+        if (fitted) {
+            CGImageRelease(thumbnail);
+            thumbnail = fitted;
+        }
+    }
+
+    NSMutableData *result = [NSMutableData data];
+    // JPEG has no alpha channel, transparent sources keep lossless PNG
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)result,
+                                                                         opaque ? kUTTypeJPEG : kUTTypePNG, 1, NULL);
+    if (!destination) {
+        CGImageRelease(thumbnail);
+        return nil;
+    }
+    NSDictionary *properties = opaque ? @{(__bridge NSString *)kCGImageDestinationLossyCompressionQuality : @(self.compressionQuality)} : nil;
+    CGImageDestinationAddImage(destination, thumbnail, (__bridge CFDictionaryRef)properties);
+    BOOL finalized = CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    CGImageRelease(thumbnail);
+
+    return finalized ? result : nil;
+}
+
+#pragma mark - private
+
+- (CGImageRef) createImageFromImage:(CGImageRef)image withSize:(CGSize)size opaque:(BOOL)opaque CF_RETURNS_RETAINED {
+    if (size.width < 1 || size.height < 1) {
+        return NULL;
+    }
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, size.width, size.height, 8, 0, colorSpace,
+                                                 kCGBitmapByteOrder32Host |
+                                                 (opaque ? kCGImageAlphaNoneSkipFirst : kCGImageAlphaPremultipliedFirst));
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        return NULL;
+    }
+    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+    CGContextDrawImage(context, CGRectMake(0, 0, size.width, size.height), image);
+    CGImageRef result = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    return result;
+}
+
+@end
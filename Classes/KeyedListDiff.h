@@ -0,0 +1,47 @@
+//
+//  KeyedListDiff.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <UIKit/UIKit.h>
+
+/**
+ * The row changes turning old list into new one within single table section. Items are matched by
+ * key, the longest run of kept items keeping their relative order stays in place and the rest is moved.
+ * Deleted rows and sources of moves are old index paths, inserted rows, targets of moves and updated rows
+ * are new ones. Deletions, insertions and moves are meant for single batch of table updates, updated
+ * rows are reloaded after the batch, as row can not be moved and reloaded in the same batch.
+ */
+@interface KeyedListDiff : NSObject
+
+@property (nonatomic, strong, readonly) NSArray<NSIndexPath *> *__nonnull deleted;
+@property (nonatomic, strong, readonly) NSArray<NSIndexPath *> *__nonnull inserted;
+// The pairs of source and target index paths
+@property (nonatomic, strong, readonly) NSArray<NSArray<NSIndexPath *> *> *__nonnull moved;
+// The rows of kept items which content changed
+@property (nonatomic, strong, readonly) NSArray<NSIndexPath *> *__nonnull updated;
+
+/*!
+ Computes changes between lists of unique keys.
+ */
++ (instancetype __nonnull) diffFromKeys: (NSArray *__nonnull)oldKeys toKeys: (NSArray *__nonnull)newKeys;
+
+/*!
+ Computes changes between lists of unique keys, kept items are updated when their contents differ.
+
+ @param oldContents The contents of old items in the same order as old keys
+ @param newContents The contents of new items in the same order as new keys
+ */
++ (instancetype __nonnull) diffFromKeys: (NSArray *__nonnull)oldKeys
+                               contents: (NSArray *__nullable)oldContents
+                                 toKeys: (NSArray *__nonnull)newKeys
+                               contents: (NSArray *__nullable)newContents;
+
+/**
+ * Checks whether rows were deleted, inserted, moved or updated
+ */
+- (BOOL) hasChanges;
+
+@end
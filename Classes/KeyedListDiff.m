@@ -0,0 +1,109 @@
+//
+//  KeyedListDiff.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "KeyedListDiff.h"
+
+@interface KeyedListDiff ()
+
+@property (nonatomic, strong, readwrite) NSArray<NSIndexPath *> *deleted;
+@property (nonatomic, strong, readwrite) NSArray<NSIndexPath *> *inserted;
+@property (nonatomic, strong, readwrite) NSArray<NSArray<NSIndexPath *> *> *moved;
+@property (nonatomic, strong, readwrite) NSArray<NSIndexPath *> *updated;
+
+@end
+
+@implementation KeyedListDiff
+
++ (instancetype) diffFromKeys: (NSArray *)oldKeys toKeys: (NSArray *)newKeys {
+    return [self diffFromKeys:oldKeys contents:nil toKeys:newKeys contents:nil];
+}
+
++ (instancetype) diffFromKeys: (NSArray *)oldKeys
+                     contents: (NSArray *)oldContents
+                       toKeys: (NSArray *)newKeys
+                     contents: (NSArray *)newContents {
+    NSMutableArray<NSIndexPath *> *deleted = [NSMutableArray array];
+    NSMutableArray<NSIndexPath *> *inserted = [NSMutableArray array];
+    NSMutableArray<NSArray<NSIndexPath *> *> *moved = [NSMutableArray array];
+    NSMutableArray<NSIndexPath *> *updated = [NSMutableArray array];
+    BOOL compareContents = oldContents && newContents;
+
+    // keys need not be copyable, e.g. managed objects
+    NSMapTable<id, NSNumber *> *oldIndexes = [NSMapTable strongToStrongObjectsMapTable];
+    [oldKeys enumerateObjectsUsingBlock:^(id key, NSUInteger idx, BOOL *stop) {
+        [oldIndexes setObject:@(idx) forKey:key];
+    }];
+    NSMapTable<id, NSNumber *> *newIndexes = [NSMapTable strongToStrongObjectsMapTable];
+    // old indexes of kept items in new order
+    NSMutableArray<NSNumber *> *sources = [NSMutableArray arrayWithCapacity:newKeys.count];
+    NSMutableArray<NSNumber *> *targets = [NSMutableArray arrayWithCapacity:newKeys.count];
+    [newKeys enumerateObjectsUsingBlock:^(id key, NSUInteger idx, BOOL *stop) {
+        [newIndexes setObject:@(idx) forKey:key];
+        NSNumber *oldIndex = [oldIndexes objectForKey:key];
+        if (!oldIndex) {
+            [inserted addObject:[NSIndexPath indexPathForRow:idx inSection:0]];
+            return;
+        }
+        [sources addObject:oldIndex];
+        [targets addObject:@(idx)];
+        if (compareContents && ![oldContents[[oldIndex unsignedIntegerValue]] isEqual:newContents[idx]]) {
+            [updated addObject:[NSIndexPath indexPathForRow:idx inSection:0]];
+        }
+    }];
+    [oldKeys enumerateObjectsUsingBlock:^(id key, NSUInteger idx, BOOL *stop) {
+        if (![newIndexes objectForKey:key]) {
+            [deleted addObject:[NSIndexPath indexPathForRow:idx inSection:0]];
+        }
+    }];
+
+    // longest increasing subsequence of old indexes, patience sorting with back links
+    NSUInteger count = sources.count;
+    NSMutableArray<NSNumber *> *tails = [NSMutableArray arrayWithCapacity:count];
+    NSMutableArray<NSNumber *> *previous = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSUInteger value = [sources[i] unsignedIntegerValue];
+        NSUInteger low = 0, high = tails.count;
+        while (low < high) {
+            NSUInteger mid = (low + high) / 2;
+            if ([sources[[tails[mid] unsignedIntegerValue]] unsignedIntegerValue] < value) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        [previous addObject:low > 0 ? tails[low - 1] : @(NSNotFound)];
+        if (low == tails.count) {
+            [tails addObject:@(i)];
+        } else {
+            tails[low] = @(i);
+        }
+    }
+    NSMutableIndexSet *stable = [NSMutableIndexSet indexSet];
+    for (NSUInteger i = tails.count > 0 ? [[tails lastObject] unsignedIntegerValue] : NSNotFound;
+         i != NSNotFound; i = [previous[i] unsignedIntegerValue]) {
+        [stable addIndex:i];
+    }
+    for (NSUInteger i = 0; i < count; i++) {
+        if (![stable containsIndex:i]) {
+            [moved addObject:@[[NSIndexPath indexPathForRow:[sources[i] unsignedIntegerValue] inSection:0],
+                               [NSIndexPath indexPathForRow:[targets[i] unsignedIntegerValue] inSection:0]]];
+        }
+    }
+
+    KeyedListDiff *diff = [[KeyedListDiff alloc] init];
+    diff.deleted = deleted;
+    diff.inserted = inserted;
+    diff.moved = moved;
+    diff.updated = updated;
+    return diff;
+}
+
+- (BOOL) hasChanges {
+    return self.deleted.count > 0 || self.inserted.count > 0 || self.moved.count > 0 || self.updated.count > 0;
+}
+
+@end
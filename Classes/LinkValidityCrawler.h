@@ -0,0 +1,102 @@
+//
+//  LinkValidityCrawler.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+#import <Bolts/Bolts.h>
+
+#import "CVCoreDataController.h"
+
+/**
+ * The state of checked link
+ */
+typedef NS_ENUM(NSInteger, LinkState) {
+    // The link could not be checked, e.g. server kept failing
+    LinkStateUnknown = 0,
+    // The server answered with content
+    LinkStateAlive,
+    // The server reported link as gone or host does not exist anymore
+    LinkStateDead
+};
+
+/**
+ * The token bucket limiting rate of requests to single host. Tokens are reserved in advance, so
+ * every request gets fixed delay and requests are spread evenly once burst is spent.
+ */
+@interface HostRateLimiter : NSObject
+
+// The number of tokens added per second
+@property (nonatomic, assign, readonly) double rate;
+// The maximal number of tokens, i.e. requests sent at once
+@property (nonatomic, assign, readonly) double burst;
+
+- (instancetype __nonnull) initWithRate: (double)rate burst: (double)burst;
+
+/*!
+ Reserves token for request and returns delay before it may be sent.
+
+ @param now The current time
+ */
+- (NSTimeInterval) reserveAtTime: (CFAbsoluteTime)now;
+
+@end
+
+/**
+ * The background job revalidating page and track URLs of every media record. Requests are rate limited
+ * per host and failing requests are retried with exponential backoff. Results are committed to records
+ * validity by batches together with the cursor of the last checked record, so stopped crawl resumes
+ * where it stopped. Record is marked invalid when its page or some of its tracks is dead, and valid when
+ * all of them are alive, records with links which could not be checked keep their state.
+ */
+@interface LinkValidityCrawler : NSObject
+
+// The number of records checked and committed together, 20 by default
+@property (nonatomic, assign) NSUInteger batchSize;
+// The number of requests per second to single host, 1 by default
+@property (nonatomic, assign) double requestsPerSecond;
+// The number of requests sent to single host at once, 3 by default
+@property (nonatomic, assign) NSUInteger burst;
+// The number of retries of failed request, 3 by default
+@property (nonatomic, assign) NSUInteger maxRetries;
+// The delay before the first retry, doubled with every next one, 2 sec by default
+@property (nonatomic, assign) NSTimeInterval initialBackoff;
+// The minimal interval between complete passes over library, one day by default
+@property (nonatomic, assign) NSTimeInterval passInterval;
+// Indicates whether crawl is in progress
+@property (nonatomic, assign, readonly, getter=isRunning) BOOL running;
+// The source of current time for rate limiting and pass scheduling, CFAbsoluteTimeGetCurrent by default
+@property (nonatomic, copy) CFAbsoluteTime (^__nonnull clock)(void);
+
+/*!
+ Creates crawler.
+
+ @param dataController The controller of stored records
+ @param configuration The configuration of session to check links with
+ @param stateURL The location of persisted cursor
+ */
+- (instancetype __nonnull) initWithDataController: (CVCoreDataController *__nonnull)dataController
+                             sessionConfiguration: (NSURLSessionConfiguration *__nonnull)configuration
+                                         stateURL: (NSURL *__nonnull)stateURL;
+
+/*!
+ Starts or resumes the pass over library unless the last pass finished less than passInterval ago.
+ Joining the pass still running cancels the stop requested before.
+ @return BFTask completed when pass finished or was stopped, with number of records checked
+ */
+- (BFTask *__nonnull) start;
+
+/*!
+ Stops crawl after the batch in progress is committed
+ */
+- (void) stop;
+
+/*!
+ Checks single URL with retries.
+ @return BFTask completed with LinkState number
+ */
+- (BFTask *__nonnull) checkURL: (NSURL *__nonnull)url;
+
+@end
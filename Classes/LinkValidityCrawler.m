@@ -0,0 +1,383 @@
+//
+//  LinkValidityCrawler.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "LinkValidityCrawler.h"
+
+#import "CVMediaRecordMO+CoreDataProperties.h"
+#import "CVMediaTrack+CoreDataProperties.h"
+
+// The defaults of crawler
+static const NSUInteger kDefaultBatchSize = 20;
+static const double kDefaultRequestsPerSecond = 1.0;
+static const NSUInteger kDefaultBurst = 3;
+static const NSUInteger kDefaultMaxRetries = 3;
+static const NSTimeInterval kDefaultInitialBackoff = 2.0;
+static const NSTimeInterval kDefaultPassInterval = 24 * 60 * 60;
+// The timeout of single check
+static const NSTimeInterval kRequestTimeout = 20.0;
+// The keys of persisted state
+static NSString *const kCursorDateKey = @"cursorDateAdded";
+static NSString *const kCursorURLKey = @"cursorPageUrl";
+static NSString *const kLastPassKey = @"lastPassDate";
+// The keys of checked record
+static NSString *const kItemIDKey = @"id";
+static NSString *const kItemURLKey = @"pageUrl";
+static NSString *const kItemDateKey = @"dateAdded";
+static NSString *const kItemTracksKey = @"tracks";
+
+@implementation HostRateLimiter {
+    double _tokens;
+    CFAbsoluteTime _updated;
+    BOOL _started;
+}
+
+- (instancetype) initWithRate: (double)rate burst: (double)burst {
+    self = [super init];
+    if (self) {
+        _rate = MAX(rate, 0.001);
+        _burst = MAX(burst, 1);
+        _tokens = _burst;
+    }
+    return self;
+}
+
+- (NSTimeInterval) reserveAtTime: (CFAbsoluteTime)now {
+    if (_started && now > _updated) {
+        _tokens = MIN(_burst, _tokens + (now - _updated) * _rate);
+    }
+    _updated = MAX(now, _updated);
+    _started = YES;
+    // debt of reserved tokens is paid by waiting
+    _tokens -= 1;
+    return _tokens >= 0 ? 0 : -_tokens / _rate;
+}
+
+@end
+
+@interface LinkValidityCrawler () <NSURLSessionDataDelegate>
+
+@end
+
+@implementation LinkValidityCrawler {
+    CVCoreDataController *_dataController;
+    NSURLSession *_session;
+    NSURL *_stateURL;
+    // The queue of all crawler state and session callbacks
+    dispatch_queue_t _queue;
+    BFExecutor *_executor;
+    // The persisted cursor and time of the last complete pass
+    NSMutableDictionary *_state;
+    // The rate limiters keyed by host
+    NSMutableDictionary<NSString *, HostRateLimiter *> *_limiters;
+    // The handlers and responses of running checks keyed by task identifier
+    NSMutableDictionary<NSNumber *, void (^)(NSHTTPURLResponse *, NSError *)> *_handlers;
+    NSMutableDictionary<NSNumber *, NSHTTPURLResponse *> *_responses;
+    // The pass in progress
+    BFTaskCompletionSource *_pass;
+    NSUInteger _checked;
+    BOOL _stopped;
+}
+
+- (instancetype) initWithDataController: (CVCoreDataController *)dataController
+                   sessionConfiguration: (NSURLSessionConfiguration *)configuration
+                               stateURL: (NSURL *)stateURL {
+    self = [super init];
+    if (self) {
+        _dataController = dataController;
+        _stateURL = stateURL;
+        _batchSize = kDefaultBatchSize;
+        _requestsPerSecond = kDefaultRequestsPerSecond;
+        _burst = kDefaultBurst;
+        _maxRetries = kDefaultMaxRetries;
+        _initialBackoff = kDefaultInitialBackoff;
+        _passInterval = kDefaultPassInterval;
+        _clock = ^CFAbsoluteTime {
+            return CFAbsoluteTimeGetCurrent();
+        };
+        _queue = dispatch_queue_create("LinkValidityCrawler", DISPATCH_QUEUE_SERIAL);
+        _executor = [BFExecutor executorWithDispatchQueue:_queue];
+        _state = [NSMutableDictionary dictionaryWithContentsOfURL:stateURL] ?: [NSMutableDictionary dictionary];
+        _limiters = [NSMutableDictionary dictionary];
+        _handlers = [NSMutableDictionary dictionary];
+        _responses = [NSMutableDictionary dictionary];
+
+        NSURLSessionConfiguration *config = [configuration copy];
+        config.URLCache = nil;
+        NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+        delegateQueue.underlyingQueue = _queue;
+        delegateQueue.maxConcurrentOperationCount = 1;
+        _session = [NSURLSession sessionWithConfiguration:config delegate:self delegateQueue:delegateQueue];
+    }
+    return self;
+}
+
+- (BOOL) isRunning {
+    __block BOOL running;
+    dispatch_sync(_queue, ^{
+        running = _pass != nil;
+    });
+    return running;
+}
+
+- (BFTask *) start {
+    __block BFTask *task;
+    dispatch_sync(_queue, ^{
+        if (_pass) {
+            // stop requested by going to background is outdated once application is back
+            _stopped = NO;
+            task = _pass.task;
+            return;
+        }
+        NSDate *lastPass = _state[kLastPassKey];
+        if (!_state[kCursorDateKey] && lastPass &&
+            self.clock() - [lastPass timeIntervalSinceReferenceDate] < self.passInterval) {
+            task = [BFTask taskWithResult:@0];
+            return;
+        }
+        _pass = [BFTaskCompletionSource taskCompletionSource];
+        _checked = 0;
+        _stopped = NO;
+        task = _pass.task;
+        [self crawlNextBatch];
+    });
+    return task;
+}
+
+- (void) stop {
+    dispatch_async(_queue, ^{
+        _stopped = YES;
+    });
+}
+
+- (BFTask *) checkURL: (NSURL *)url {
+    return [self checkURL:url attempt:0];
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+        _responses[@(dataTask.taskIdentifier)] = (NSHTTPURLResponse *)response;
+    }
+    // status is enough, media files are not downloaded
+    completionHandler(NSURLSessionResponseCancel);
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    NSNumber *taskID = @(task.taskIdentifier);
+    void (^handler)(NSHTTPURLResponse *, NSError *) = _handlers[taskID];
+    NSHTTPURLResponse *response = _responses[taskID];
+    [_handlers removeObjectForKey:taskID];
+    [_responses removeObjectForKey:taskID];
+    if (handler) {
+        handler(response, response ? nil : error);
+    }
+}
+
+#pragma mark - private
+
+/**
+ * Loads the next batch of records after cursor, must be called on crawler queue
+ */
+- (void) crawlNextBatch {
+    if (_stopped) {
+        [self finishPass];
+        return;
+    }
+    NSDate *cursorDate = _state[kCursorDateKey];
+    NSString *cursorURL = _state[kCursorURLKey] ?: @"";
+    NSUInteger batchSize = MAX(self.batchSize, 1);
+    [[[_dataController performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+        if (cursorDate) {
+            [request setPredicate:[NSPredicate predicateWithFormat:@"dateAdded > %@ OR (dateAdded == %@ AND pageUrl > %@)",
+                                   cursorDate, cursorDate, cursorURL]];
+        }
+        [request setSortDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"dateAdded" ascending:YES],
+                                      [NSSortDescriptor sortDescriptorWithKey:@"pageUrl" ascending:YES]]];
+        [request setFetchLimit:batchSize];
+        [request setRelationshipKeyPathsForPrefetching:@[@"tracks"]];
+        NSArray<CVMediaRecordMO *> *records = [context executeFetchRequest:request error:error];
+        if (!records) {
+            return nil;
+        }
+        // plain values cross the queue boundary, records are not touched while links are checked
+        NSMutableArray<NSDictionary *> *items = [NSMutableArray arrayWithCapacity:records.count];
+        for (CVMediaRecordMO *record in records) {
+            NSMutableArray<NSString *> *addresses = [NSMutableArray arrayWithCapacity:record.tracks.count];
+            for (CVMediaTrack *track in record.tracks) {
+                if (track.address) {
+                    [addresses addObject:track.address];
+                }
+            }
+            [items addObject:@{kItemIDKey: record.objectID,
+                               kItemURLKey: record.pageUrl ?: @"",
+                               kItemDateKey: record.dateAdded ?: [NSDate distantPast],
+                               kItemTracksKey: addresses}];
+        }
+        return items;
+    }] continueWithExecutor:_executor withBlock:^id (BFTask *task) {
+        if (task.faulted) {
+            NSLog(@"Failed to load media records to check, reason: %@", task.error ?: task.exception);
+            [self finishPass];
+            return nil;
+        }
+        NSArray<NSDictionary *> *items = task.result;
+        if (items.count == 0) {
+            // the whole library was checked, the next pass starts from the beginning
+            [_state removeObjectForKey:kCursorDateKey];
+            [_state removeObjectForKey:kCursorURLKey];
+            _state[kLastPassKey] = [NSDate dateWithTimeIntervalSinceReferenceDate:self.clock()];
+            [self saveState];
+            NSLog(@"Checked links of %lu media records", (unsigned long)_checked);
+            [self finishPass];
+            return nil;
+        }
+        return [[self checkItems:items] continueWithExecutor:_executor withSuccessBlock:^id (BFTask *checkTask) {
+            return [self commitStates:checkTask.result forItems:items];
+        }];
+    }] continueWithExecutor:_executor withBlock:^id (BFTask *task) {
+        if (task.faulted) {
+            NSLog(@"Failed to check links of media records, reason: %@", task.error ?: task.exception);
+            [self finishPass];
+        }
+        return nil;
+    }];
+}
+
+/**
+ * Checks page and track URLs of records, completes with LinkState per record
+ */
+- (BFTask *) checkItems: (NSArray<NSDictionary *> *)items {
+    NSMutableArray<BFTask *> *recordTasks = [NSMutableArray arrayWithCapacity:items.count];
+    for (NSDictionary *item in items) {
+        NSMutableArray<BFTask *> *linkTasks = [NSMutableArray arrayWithCapacity:[item[kItemTracksKey] count] + 1];
+        for (NSString *address in [@[item[kItemURLKey]] arrayByAddingObjectsFromArray:item[kItemTracksKey]]) {
+            NSURL *url = [NSURL URLWithString:address];
+            [linkTasks addObject:url ? [self checkURL:url] : [BFTask taskWithResult:@(LinkStateDead)]];
+        }
+        [recordTasks addObject:[[BFTask taskForCompletionOfAllTasksWithResults:linkTasks] continueWithSuccessBlock:^id (BFTask *task) {
+            LinkState state = LinkStateAlive;
+            for (NSNumber *linkState in task.result) {
+                if ([linkState integerValue] == LinkStateDead) {
+                    return @(LinkStateDead);
+                } else if ([linkState integerValue] == LinkStateUnknown) {
+                    state = LinkStateUnknown;
+                }
+            }
+            return @(state);
+        }]];
+    }
+    return [BFTask taskForCompletionOfAllTasksWithResults:recordTasks];
+}
+
+/**
+ * Writes validity of checked records and advances cursor past them
+ */
+- (BFTask *) commitStates: (NSArray<NSNumber *> *)states forItems: (NSArray<NSDictionary *> *)items {
+    return [[_dataController performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSUInteger changed = 0;
+        for (NSUInteger i = 0; i < items.count; i++) {
+            LinkState state = [states[i] integerValue];
+            if (state == LinkStateUnknown) {
+                continue;
+            }
+            CVMediaRecordMO *record = [context existingObjectWithID:items[i][kItemIDKey] error:nil];
+            NSNumber *valid = @(state == LinkStateAlive);
+            if (record && ![record.valid isEqualToNumber:valid]) {
+                record.valid = valid;
+                changed++;
+            }
+        }
+        return @(changed);
+    }] continueWithExecutor:_executor withSuccessBlock:^id (BFTask *task) {
+        NSDictionary *last = [items lastObject];
+        _state[kCursorDateKey] = last[kItemDateKey];
+        _state[kCursorURLKey] = last[kItemURLKey];
+        [self saveState];
+        _checked += items.count;
+        [self crawlNextBatch];
+        return nil;
+    }];
+}
+
+- (BFTask *) checkURL: (NSURL *)url attempt: (NSUInteger)attempt {
+    BFTaskCompletionSource *source = [BFTaskCompletionSource taskCompletionSource];
+    dispatch_async(_queue, ^{
+        if (!url.host) {
+            [source setResult:@(LinkStateDead)];
+            return;
+        }
+        HostRateLimiter *limiter = _limiters[url.host];
+        if (!limiter) {
+            limiter = [[HostRateLimiter alloc] initWithRate:self.requestsPerSecond burst:self.burst];
+            _limiters[url.host] = limiter;
+        }
+        NSTimeInterval delay = [limiter reserveAtTime:self.clock()];
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+            NSURLRequest *request = [NSURLRequest requestWithURL: url
+                                                     cachePolicy: NSURLRequestReloadIgnoringLocalCacheData
+                                                 timeoutInterval: kRequestTimeout];
+            NSURLSessionDataTask *task = [_session dataTaskWithRequest:request];
+            _handlers[@(task.taskIdentifier)] = ^(NSHTTPURLResponse *response, NSError *error) {
+                [self completeCheckOfURL:url attempt:attempt response:response error:error source:source];
+            };
+            [task resume];
+        });
+    });
+    return source.task;
+}
+
+- (void) completeCheckOfURL: (NSURL *)url
+                    attempt: (NSUInteger)attempt
+                   response: (NSHTTPURLResponse *)response
+                      error: (NSError *)error
+                     source: (BFTaskCompletionSource *)source {
+    NSInteger status = response.statusCode;
+    if (response && status < 400) {
+        [source setResult:@(LinkStateAlive)];
+        return;
+    }
+    if (status == 404 || status == 410) {
+        [source setResult:@(LinkStateDead)];
+        return;
+    }
+    BOOL hostMissing = [error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCannotFindHost;
+    BOOL retriable = status == 408 || status == 429 || status >= 500 ||
+        (error && !(error.code == NSURLErrorNotConnectedToInternet && [error.domain isEqualToString:NSURLErrorDomain]));
+    if (!retriable || attempt >= self.maxRetries) {
+        // host which is not found after retries is gone, other failures tell nothing
+        [source setResult:@(hostMissing ? LinkStateDead : LinkStateUnknown)];
+        return;
+    }
+    NSTimeInterval backoff = self.initialBackoff * (double)(1 << MIN(attempt, 16));
+    NSTimeInterval retryAfter = [[response allHeaderFields][@"Retry-After"] doubleValue];
+    NSTimeInterval delay = MAX(backoff, retryAfter);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+        [[self checkURL:url attempt:attempt + 1] continueWithBlock:^id (BFTask *task) {
+            [source setResult:task.result];
+            return nil;
+        }];
+    });
+}
+
+- (void) saveState {
+    if (![_state writeToURL:_stateURL atomically:YES]) {
+        NSLog(@"Failed to save link crawler state to: %@", _stateURL);
+    }
+}
+
+- (void) finishPass {
+    BFTaskCompletionSource *pass = _pass;
+    _pass = nil;
+    [pass setResult:@(_checked)];
+}
+
+@end
@@ -13,8 +13,9 @@
 // limitations under the License.
 
 #import "LocalPlayerView.h"
-#import "SimpleImageFetcher.h"
+#import "ImageLoader.h"
 #import "CVMediaTrack.h"
+#import "AppDelegate.h"
 
 #import <AVFoundation/AVFoundation.h>
 
@@ -38,6 +39,8 @@ static NSInteger kToolbarHeight = 44;
 @property(nonatomic) LPVState state;
 /* The splash image to display before playback or while casting. */
 @property UIImageView *splashImage;
+/* The request of the splash image. */
+@property(nonatomic) ImageLoadToken *splashImageToken;
 /* AVPlayer used to play locally. */
 @property(nonatomic) AVPlayer *moviePlayer;
 /* The CALayer on which the video plays. */
@@ -150,7 +153,7 @@ static NSInteger kToolbarHeight = 44;
     }
     
     // set playback time
-    self.playbackTime = [[[self.mediaRecord.tracks objectAtIndex:track] playTime] integerValue];
+    self.playbackTime = (NSInteger)[[[AppDelegate sharedInstance] positionStore] positionForTrack:[self.mediaRecord.tracks objectAtIndex:track]];
     
     self.translatesAutoresizingMaskIntoConstraints = NO;
     _state = LPVSplash;
@@ -240,21 +243,26 @@ static NSInteger kToolbarHeight = 44;
 
 /* Asynchronously load the splash screen image. */
 - (void)loadMovieImage {
-    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0);
+    [self.splashImageToken cancel];
+    self.splashImageToken = nil;
+    NSURL *thumbnailURL = [self.mediaRecord thumbnailURL];
+    if (!thumbnailURL) {
+        return;
+    }
     
-    dispatch_async(queue, ^{
-        UIImage *image = [UIImage imageWithData:[SimpleImageFetcher getDataFromImageURL:[self.mediaRecord thumbnailURL]]];
-        
-        dispatch_sync(dispatch_get_main_queue(), ^{
-            _splashImage.image = image;
-            [_splashImage setNeedsLayout];
-        });
-    });
+    __weak LocalPlayerView *weakSelf = self;
+    self.splashImageToken = [[ImageLoader sharedLoader] loadImageFromURL:thumbnailURL
+                                                                priority:ImageLoadPriorityHigh
+                                                              completion:^(UIImage * _Nullable image) {
+        weakSelf.splashImageToken = nil;
+        weakSelf.splashImage.image = image;
+        [weakSelf.splashImage setNeedsLayout];
+    }];
 }
 
 - (void)loadMoviePlayer {
     if (!self.moviePlayer) {
-        self.moviePlayer = [AVPlayer playerWithURL: [[self.mediaRecord trackAtIndex:self.trackIndex] trackURL]];
+        self.moviePlayer = [AVPlayer playerWithURL: [[self.mediaRecord trackAtIndex:self.trackIndex] playbackURL]];
         self.playerLayer = [AVPlayerLayer playerLayerWithPlayer:self.moviePlayer];
         [self.playerLayer setFrame:[self fullFrame]];
         [self.playerLayer setBackgroundColor:[[UIColor blackColor] CGColor]];
@@ -347,7 +355,8 @@ static NSInteger kToolbarHeight = 44;
         self.currTime.text = [NSString stringWithFormat:@"%02ld:%02ld", (long)mins, (long)secs];
     }
     // store for current track
-    [[self.mediaRecord.tracks objectAtIndex:self.trackIndex] setPlayTime:[NSNumber numberWithInteger:self.playbackTime]];
+    [[[AppDelegate sharedInstance] positionStore] setPosition:self.playbackTime
+                                                     forTrack:[self.mediaRecord.tracks objectAtIndex:self.trackIndex]];
 }
 
 
@@ -144,6 +144,17 @@
         self.trackIndex = track;
         self.playbackEnabled = YES;
         [self syncTextToMedia];
+        [self probeTracks];
+    }
+}
+
+/**
+ * Resolves URLs of the track to play and the next one, so playback starts without redirects
+ */
+- (void)probeTracks {
+    TrackURLProbe *probe = [[AppDelegate sharedInstance] trackProbe];
+    for (NSInteger index = self.trackIndex; index < MIN(self.trackIndex + 2, (NSInteger)self.mediaRecord.tracks.count); index++) {
+        [probe probeTrack:[self.mediaRecord trackAtIndex:index]];
     }
 }
 
@@ -203,7 +214,7 @@
 - (BOOL)continueAfterPlayButtonClicked {
     CastDeviceController *controller = [CastDeviceController sharedInstance];
     CVMediaTrack *track = [self.mediaRecord trackAtIndex:self.trackIndex];
-    NSTimeInterval pos = [[track playTime] doubleValue];
+    NSTimeInterval pos = [[[AppDelegate sharedInstance] positionStore] positionForTrack:track];
     self.mediaRecord.neverPlayed = [NSNumber numberWithBool: NO];// mark as already played
     if (controller.deviceManager.applicationConnectionState != GCKConnectionStateConnected) {
         if (pos > 0) {
@@ -231,6 +242,19 @@
         }
     }];
     
+    // Play All queues the rest of series at once, starting from this track.
+    NSUInteger remaining = self.mediaRecord.tracks.count - self.trackIndex;
+    if (remaining > 1) {
+        CVMediaRecordMO *record = self.mediaRecord;
+        NSRange range = NSMakeRange(self.trackIndex, remaining);
+        [helper addAction:NSLocalizedString(@"Play All", nil) handler:^{
+            // media of whole series is built only if it is going to be played
+            NSArray<GCKMediaInformation *> *series =
+            [GCKMediaInformation mediaInformationFromTracksInRange:range forRecord:record];
+            [controller mediaPlayAll:series playPosition:pos completion:nil];
+        }];
+    }
+    
     // Play Next is available if something is currently being played.
     if (controller.mediaInformation) {
         [helper addAction:NSLocalizedString(@"Play Next", nil) handler:^{
@@ -303,9 +327,9 @@
 
 - (void)didUpdateStreamPosition:(NSTimeInterval)position streamID: (NSString* )streamId {
     CVMediaTrack *track = [self.mediaRecord trackAtIndex:self.trackIndex];
-    if (streamId && [track.address isEqualToString:streamId]) {
+    if (streamId && [track matchesStreamID:streamId]) {
         // to avoid setting time from previous track before new track is starting
-        [track setPlayTime:[NSNumber numberWithDouble:position]];
+        [[[AppDelegate sharedInstance] positionStore] setPosition:position forTrack:track];
     }
 }
 
@@ -0,0 +1,55 @@
+//
+//  MediaPrefetcher.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <UIKit/UIKit.h>
+
+#import "PrefetchScheduler.h"
+#import "CVMediaRecordMO.h"
+
+@class ExMedia;
+
+/**
+ * The prefetcher of media list resources driven by scrolling. It warms image loader with thumbnails of
+ * records about to appear and loads track lists of records which are likely to be opened, i.e. visible
+ * when scrolling stops. It must be used from main queue.
+ */
+@interface MediaPrefetcher : NSObject
+
+// The scheduler of prefetch requests
+@property (nonatomic, strong, readonly) PrefetchScheduler *__nonnull scheduler;
+// The pixel size of prefetched thumbnails
+@property (nonatomic, assign) CGSize thumbnailPixelSize;
+// The number of visible records which track lists are loaded when scrolling stops, 3 by default
+@property (nonatomic, assign) NSUInteger trackListLimit;
+
+/**
+ * Returns shared prefetcher instance
+ */
++ (instancetype __nonnull) sharedPrefetcher;
+
+/*!
+ Updates prefetch requests for new scroll position.
+
+ @param records The records of the list
+ @param visibleRange The range of visible records
+ @param velocity The scrolling velocity in rows per second, positive towards the end of list, zero when still
+ */
+- (void) updateWithRecords: (NSArray<CVMediaRecordMO *> *__nonnull)records
+              visibleRange: (NSRange)visibleRange
+                  velocity: (double)velocity;
+
+/*!
+ Returns prefetched media of the page and forgets it, so the next request loads page again.
+ */
+- (ExMedia *__nullable) takeMediaForURL: (NSURL *__nonnull)pageURL;
+
+/*!
+ Cancels all prefetches, e.g. when list is not shown anymore
+ */
+- (void) cancelAll;
+
+@end
@@ -0,0 +1,132 @@
+//
+//  MediaPrefetcher.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "MediaPrefetcher.h"
+
+#import "ImageLoader.h"
+#import "ExMedia.h"
+#import "ExMediaLoader.h"
+
+// The default number of track lists loaded when scrolling stops
+static const NSUInteger kDefaultTrackListLimit = 3;
+// The number of prefetched media kept in memory
+static const NSUInteger kMediaCacheLimit = 20;
+// The minimal number of rows prefetched ahead
+static const NSUInteger kMinLookahead = 4;
+// The velocity in rows per second below which list is considered still
+static const double kStillVelocity = 0.5;
+// The base priorities of requests, track lists of visible rows go before thumbnails
+static const double kTrackListPriority = 2000;
+static const double kThumbnailPriority = 1000;
+
+@implementation MediaPrefetcher {
+    // The prefetched media keyed by page URL
+    NSCache<NSString *, ExMedia *> *_media;
+}
+
++ (instancetype) sharedPrefetcher {
+    static MediaPrefetcher *sharedPrefetcher;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedPrefetcher = [[MediaPrefetcher alloc] init];
+    });
+    return sharedPrefetcher;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if (self) {
+        _scheduler = [[PrefetchScheduler alloc] init];
+        _trackListLimit = kDefaultTrackListLimit;
+        _media = [[NSCache alloc] init];
+        _media.countLimit = kMediaCacheLimit;
+    }
+    return self;
+}
+
+- (void) updateWithRecords: (NSArray<CVMediaRecordMO *> *)records
+              visibleRange: (NSRange)visibleRange
+                  velocity: (double)velocity {
+    NSArray<NSNumber *> *indexes = [PrefetchScheduler indexesToPrefetchForVisibleRange: visibleRange
+                                                                              velocity: velocity
+                                                                             itemCount: records.count
+                                                                             lookahead: MAX(visibleRange.length, kMinLookahead)];
+    NSMutableArray<PrefetchRequest *> *requests = [NSMutableArray arrayWithCapacity:indexes.count + self.trackListLimit];
+    BOOL still = fabs(velocity) < kStillVelocity;
+    NSUInteger trackLists = 0;
+    for (NSUInteger position = 0; position < indexes.count; position++) {
+        CVMediaRecordMO *record = records[[indexes[position] unsignedIntegerValue]];
+        NSURL *thumbnailURL = [record thumbnailURL];
+        if (thumbnailURL.absoluteString.length > 0) {
+            [requests addObject:[self thumbnailRequestForURL:thumbnailURL priority:kThumbnailPriority - position]];
+        }
+        // stored tracks are shown without loading page
+        if (still && position < visibleRange.length && trackLists < self.trackListLimit && record.tracks.count == 0) {
+            NSURL *pageURL = [record pageURL];
+            if (pageURL && ![_media objectForKey:pageURL.absoluteString]) {
+                [requests addObject:[self trackListRequestForURL:pageURL priority:kTrackListPriority - position]];
+                trackLists++;
+            }
+        }
+    }
+    [self.scheduler scheduleRequests:requests];
+}
+
+- (ExMedia *) takeMediaForURL: (NSURL *)pageURL {
+    NSString *key = pageURL.absoluteString;
+    ExMedia *media = [_media objectForKey:key];
+    if (media) {
+        [_media removeObjectForKey:key];
+        [self.scheduler invalidateKey:[@"tracks:" stringByAppendingString:key]];
+    }
+    return media;
+}
+
+- (void) cancelAll {
+    [self.scheduler cancelAll];
+}
+
+#pragma mark - private
+
+- (PrefetchRequest *) thumbnailRequestForURL: (NSURL *)url priority: (double)priority {
+    CGSize pixelSize = self.thumbnailPixelSize;
+    return [PrefetchRequest requestWithKey: [@"thumbnail:" stringByAppendingString:url.absoluteString]
+                                  priority: priority
+                                      work: ^PrefetchCancelBlock (void (^completion)(void)) {
+        // image stays in loader caches, cell request finds it there
+        ImageLoadToken *token = [[ImageLoader sharedLoader] loadImageFromURL: url
+                                                                   pixelSize: pixelSize
+                                                                    priority: ImageLoadPriorityLow
+                                                                  completion: ^(UIImage * _Nullable image) {
+            completion();
+        }];
+        return token ? ^{
+            [token cancel];
+        } : nil;
+    }];
+}
+
+- (PrefetchRequest *) trackListRequestForURL: (NSURL *)url priority: (double)priority {
+    NSCache<NSString *, ExMedia *> *mediaCache = _media;
+    return [PrefetchRequest requestWithKey: [@"tracks:" stringByAppendingString:url.absoluteString]
+                                  priority: priority
+                                      work: ^PrefetchCancelBlock (void (^completion)(void)) {
+        [[ExMediaLoader sharedLoader] loadMediaFromURL:url withCompletion:
+         ^(ExMedia * _Nullable media, ExMediaLoadMetrics * _Nonnull metrics, NSError * _Nullable error) {
+             dispatch_async(dispatch_get_main_queue(), ^{
+                 if (media) {
+                     [mediaCache setObject:media forKey:url.absoluteString];
+                 }
+                 completion();
+             });
+         }];
+        // page load is short and can not be aborted, its result is kept even if not wanted anymore
+        return nil;
+    }];
+}
+
+@end
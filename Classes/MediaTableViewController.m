@@ -20,38 +20,57 @@
 #import "MediaTracksTableViewController.h"
 #import "NotificationConstants.h"
 #import "SimpleImageFetcher.h"
+#import "ImageLoader.h"
 #import "AlertHelper.h"
 #import "CVMediaRecordMO.h"
+#import "CVMediaRecordsController.h"
+#import "MediaPrefetcher.h"
 
 #import <GoogleCast/GCKDeviceManager.h>
 #import <GoogleCast/GCKMediaControlChannel.h>
 
 #define kDefaultRowHeight 40
 #define kMediaRowHeight 80
+// The minimal interval between prefetch updates while scrolling
+#define kPrefetchUpdateInterval 0.1
 
 static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
 
-@interface MediaTableViewController () <CastDeviceControllerDelegate>
+@interface MediaTableViewController () <CastDeviceControllerDelegate, CVMediaRecordsControllerDelegate>
 
 /** The queue button. */
 @property(nonatomic, strong) UIBarButtonItem *showQueueButton;
 
-/** The media records */
-@property (nonatomic, strong) NSMutableArray<CVMediaRecordMO*>* records;
+/** The controller of loaded media records */
+@property (nonatomic, strong) CVMediaRecordsController *recordsController;
 
 @end
 
 @implementation MediaTableViewController {
     UIBarButtonItem *editItem;
     UIBarButtonItem *doneItem;
+    UIBarButtonItem *filterItem;
+    // The thumbnail requests of cells on screen
+    NSMapTable<UITableViewCell *, ImageLoadToken *> *imageLoadTokens;
+    // The scroll position and time of the last prefetch update
+    CGFloat lastScrollOffset;
+    CFAbsoluteTime lastScrollTime;
 }
 
 - (void)viewDidLoad {
     [super viewDidLoad];
     
+    imageLoadTokens = [NSMapTable weakToStrongObjectsMapTable];
+    [MediaPrefetcher sharedPrefetcher].thumbnailPixelSize =
+        [SimpleImageFetcher pixelSizeForPointSize:CGSizeMake(kMediaRowHeight, kMediaRowHeight)];
+    
     // create toolbar
     editItem = [[UIBarButtonItem alloc]initWithBarButtonSystemItem:UIBarButtonSystemItemEdit target:self action:@selector(editTableItems:)];
     doneItem = [[UIBarButtonItem alloc] initWithBarButtonSystemItem:UIBarButtonSystemItemDone target:self action:@selector(doneEditTableItems:)];
+    filterItem = [[UIBarButtonItem alloc] initWithTitle:NSLocalizedString(@"All genres", nil)
+                                                  style:UIBarButtonItemStylePlain
+                                                 target:self
+                                                 action:@selector(filterByGenre:)];
     [self initToolbarInEditMode:YES];
     
     // Show stylized application title as a left-aligned image.
@@ -68,14 +87,17 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
     [self.refreshControl addTarget:self
                             action:@selector(reloadMediaList)
                   forControlEvents:UIControlEventValueChanged];
+    
+    // the list follows changes of records, so it is loaded only once
+    self.recordsController = [[CVMediaRecordsController alloc] initWithManagedObjectContext:
+                              [[[AppDelegate sharedInstance] dataController] managedObjectContext]];
+    self.recordsController.delegate = self;
+    [self reloadMediaList];
 }
 
 - (void)viewWillAppear:(BOOL)animated {
     [super viewWillAppear:animated];
     
-    // reload media list to update
-    [self reloadMediaList];
-    
     // show toobar
     self.navigationController.toolbarHidden = NO;
     
@@ -98,6 +120,50 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
     [super viewWillDisappear:animated];
     
     [[NSNotificationCenter defaultCenter] removeObserver:self];
+    // thumbnails of the list are not needed anymore, page loads keep running for details screen
+    [[MediaPrefetcher sharedPrefetcher] cancelAll];
+}
+
+#pragma mark - UIScrollViewDelegate
+
+- (void)scrollViewDidScroll:(UIScrollView *)scrollView {
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    double elapsed = now - lastScrollTime;
+    if (elapsed < kPrefetchUpdateInterval) {
+        return;
+    }
+    CGFloat offset = scrollView.contentOffset.y;
+    // rows per second, position of long ago tells nothing about velocity
+    double velocity = elapsed < 1.0 ? (offset - lastScrollOffset) / elapsed / kMediaRowHeight : 0;
+    lastScrollOffset = offset;
+    lastScrollTime = now;
+    [self updatePrefetchWithVelocity:velocity];
+}
+
+- (void)scrollViewDidEndDragging:(UIScrollView *)scrollView willDecelerate:(BOOL)decelerate {
+    if (!decelerate) {
+        [self updatePrefetchWithVelocity:0];
+    }
+}
+
+- (void)scrollViewDidEndDecelerating:(UIScrollView *)scrollView {
+    [self updatePrefetchWithVelocity:0];
+}
+
+- (void) updatePrefetchWithVelocity:(double)velocity {
+    NSArray<NSIndexPath *> *visibleRows = [self.tableView indexPathsForVisibleRows];
+    if (visibleRows.count == 0) {
+        return;
+    }
+    NSUInteger first = NSUIntegerMax;
+    NSUInteger last = 0;
+    for (NSIndexPath *indexPath in visibleRows) {
+        first = MIN(first, (NSUInteger)indexPath.row);
+        last = MAX(last, (NSUInteger)indexPath.row);
+    }
+    [[MediaPrefetcher sharedPrefetcher] updateWithRecords: self.recordsController.records
+                                             visibleRange: NSMakeRange(first, last - first + 1)
+                                                 velocity: velocity];
 }
 
 #pragma mark - CastDeviceControllerDelegate
@@ -119,7 +185,7 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
 - (void)prepareForSegue:(UIStoryboardSegue *)segue sender:(id)sender {
     if ([segue.identifier isEqualToString: kShowMediaTracksSegue]) {
         NSIndexPath *indexPath = [self.tableView indexPathForSelectedRow];
-        CVMediaRecordMO *media = [self.records objectAtIndex:indexPath.row];
+        CVMediaRecordMO *media = [self.recordsController.records objectAtIndex:indexPath.row];
         // Pass the currently selected media to the next controller if it needs it.
         MediaTracksTableViewController *vc = (MediaTracksTableViewController*)[segue destinationViewController];
         vc.mediaToPlay = media;
@@ -147,7 +213,7 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
 #pragma mark - Table View
 
 - (CGFloat)tableView:(UITableView *)tableView heightForRowAtIndexPath:(NSIndexPath *)indexPath {
-    if (indexPath.row < [self.records count]) {
+    if (indexPath.row < [self.recordsController.records count]) {
         return kMediaRowHeight;
     } else {
         return kDefaultRowHeight;
@@ -155,7 +221,7 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
 }
 
 - (CGFloat)tableView:(UITableView *)tableView estimatedHeightForRowAtIndexPath:(NSIndexPath *)indexPath {
-    if (indexPath.row < [self.records count]) {
+    if (indexPath.row < [self.recordsController.records count]) {
         return kMediaRowHeight;
     } else {
         return kDefaultRowHeight;
@@ -167,12 +233,12 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
 }
 
 - (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section {
-    return [self.records count];
+    return [self.recordsController.records count];
 }
 
 - (UITableViewCell *)tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath {
     UITableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:@"Cell" forIndexPath:indexPath];
-    CVMediaRecordMO *media = [self.records objectAtIndex:indexPath.row];
+    CVMediaRecordMO *media = [self.recordsController.records objectAtIndex:indexPath.row];
     
     cell.textLabel.numberOfLines = 2;
     cell.textLabel.text = media.title;
@@ -184,20 +250,50 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
         cell.textLabel.font = [UIFont systemFontOfSize:16];
     }
     
+    // Drop request of the row previously shown in reused cell
+    [[imageLoadTokens objectForKey:cell] cancel];
+    [imageLoadTokens removeObjectForKey:cell];
+    cell.imageView.image = nil;
+    
     // Asynchronously load the table view image
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        UIImage *image = [UIImage imageWithData:[SimpleImageFetcher getDataFromImageURL: [media thumbnailURL]]];
-        
-        dispatch_sync(dispatch_get_main_queue(), ^{
-            UIImageView *mediaThumb = cell.imageView;
-            [mediaThumb setImage:image];
+    NSURL *thumbnailURL = [media thumbnailURL];
+    if (thumbnailURL) {
+        CGSize thumbnailSize = [SimpleImageFetcher pixelSizeForPointSize:CGSizeMake(kMediaRowHeight, kMediaRowHeight)];
+        ImageLoadToken *token = [[ImageLoader sharedLoader] loadImageFromURL:thumbnailURL
+                                                                   pixelSize:thumbnailSize
+                                                                    priority:ImageLoadPriorityHigh
+                                                                  completion:^(UIImage * _Nullable image) {
+            [imageLoadTokens removeObjectForKey:cell];
+            [cell.imageView setImage:image];
             [cell setNeedsLayout];
-        });
-    });
+        }];
+        if (token) {
+            [imageLoadTokens setObject:token forKey:cell];
+        }
+    }
     
     return cell;
 }
 
+- (void)tableView:(UITableView *)tableView willDisplayCell:(UITableViewCell *)cell forRowAtIndexPath:(NSIndexPath *)indexPath {
+    // load the next page before user reaches the end of the list
+    if (self.recordsController.hasMoreRecords &&
+        indexPath.row + self.recordsController.pageSize / 2 >= [self.recordsController.records count]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            NSError *error;
+            if (![self.recordsController loadNextPage:&error]) {
+                NSLog(@"Failed to load media records page, reason: %@", error);
+            }
+        });
+    }
+}
+
+- (void)tableView:(UITableView *)tableView didEndDisplayingCell:(UITableViewCell *)cell forRowAtIndexPath:(NSIndexPath *)indexPath {
+    // Row left the screen, its thumbnail is not needed anymore
+    [[imageLoadTokens objectForKey:cell] cancel];
+    [imageLoadTokens removeObjectForKey:cell];
+}
+
 - (void)tableView:(UITableView *)tableView didSelectRowAtIndexPath:(NSIndexPath *)indexPath {
     // Display the media details view.
     [self performSegueWithIdentifier:kShowMediaTracksSegue sender:self];
@@ -207,16 +303,13 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
 - (void)tableView:(UITableView *)tableView commitEditingStyle:(UITableViewCellEditingStyle)editingStyle forRowAtIndexPath:(NSIndexPath *)indexPath {
     if (editingStyle == UITableViewCellEditingStyleDelete) {
         // remove from data source and local cache
-        CVMediaRecordMO *item = [self.records objectAtIndex:indexPath.row];
+        CVMediaRecordMO *item = [self.recordsController.records objectAtIndex:indexPath.row];
+        NSURL *thumbnailURL = [item thumbnailURL];
         [[[[AppDelegate sharedInstance] dataController] deleteMediaRecordAsync:item]
         continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
-            //
+            // the row is removed by records controller when deletion is merged
             if (!task.faulted) {
-                [self.records removeObject:item];
-                [SimpleImageFetcher removeCacheHitForURL: [item thumbnailURL]];
-                
-                // notify table
-                [tableView deleteRowsAtIndexPaths:@[indexPath] withRowAnimation:UITableViewRowAnimationFade];
+                [SimpleImageFetcher removeCacheHitForURL: thumbnailURL];
             } else {
                 AlertHelper *alert = [[AlertHelper alloc] init];
                 alert.title = NSLocalizedString(@"Failed to delete", nil);
@@ -231,42 +324,132 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
     }
 }
 
+#pragma mark - CVMediaRecordsControllerDelegate
+
+- (void) recordsControllerWillChangeContent:(CVMediaRecordsController *)controller {
+    [self.tableView beginUpdates];
+}
+
+- (void) recordsController:(CVMediaRecordsController *)controller
+           didChangeRecord:(CVMediaRecordMO *)record
+                   atIndex:(NSUInteger)index
+             forChangeType:(CVMediaRecordChangeType)type
+                  newIndex:(NSUInteger)newIndex {
+    NSIndexPath *indexPath = [NSIndexPath indexPathForRow:index inSection:0];
+    NSIndexPath *newIndexPath = [NSIndexPath indexPathForRow:newIndex inSection:0];
+    switch (type) {
+        case CVMediaRecordChangeInsert:
+            [self.tableView insertRowsAtIndexPaths:@[newIndexPath] withRowAnimation:UITableViewRowAnimationFade];
+            break;
+        case CVMediaRecordChangeDelete:
+            [self.tableView deleteRowsAtIndexPaths:@[indexPath] withRowAnimation:UITableViewRowAnimationFade];
+            break;
+        case CVMediaRecordChangeMove:
+            // moved row is reconfigured as well
+            [self.tableView deleteRowsAtIndexPaths:@[indexPath] withRowAnimation:UITableViewRowAnimationFade];
+            [self.tableView insertRowsAtIndexPaths:@[newIndexPath] withRowAnimation:UITableViewRowAnimationFade];
+            break;
+        case CVMediaRecordChangeUpdate:
+            [self.tableView reloadRowsAtIndexPaths:@[indexPath] withRowAnimation:UITableViewRowAnimationNone];
+            break;
+    }
+}
+
+- (void) recordsControllerDidChangeContent:(CVMediaRecordsController *)controller {
+    [self.tableView endUpdates];
+    // refresh toolbar
+    if (!self.tableView.editing) {
+        [self initToolbarInEditMode:YES];
+    }
+}
+
+- (void) recordsControllerDidReloadContent:(CVMediaRecordsController *)controller {
+    [self.tableView reloadData];
+    // visible rows are known after layout
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self updatePrefetchWithVelocity:0];
+    });
+}
+
 #pragma mark - manage table content
 - (void) reloadMediaList {
-    // show refresh control if appropriate
-    if (!self.refreshControl.refreshing) {
-        [self.refreshControl beginRefreshing];
+    // load the first page of media list
+    NSError *error;
+    if (![self.recordsController reload:&error]) {
+        AlertHelper *alert = [[AlertHelper alloc] init];
+        alert.title = NSLocalizedString(@"Failed to load media", nil);
+        alert.message = NSLocalizedString(@"Failed to load list of media records!", nil);
+        alert.cancelButtonTitle = NSLocalizedString(@"OK", nil);
+        [alert showOnController:self sourceView:self.tableView];
+        
+        NSLog(@"Failed to load media records, reason: %@", error);
     }
     
-    // load media list
-    [[[[AppDelegate sharedInstance] dataController] listMediaRecordsAsync]
-    continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
-        // store and refresh table view
-        if (!task.faulted) {
-            self.records = [NSMutableArray arrayWithArray: task.result];
-            
-        } else {
-            AlertHelper *alert = [[AlertHelper alloc] init];
-            alert.title = NSLocalizedString(@"Failed to load media", nil);
-            alert.message = NSLocalizedString(@"Failed to load list of media records!", nil);
-            alert.cancelButtonTitle = NSLocalizedString(@"OK", nil);
-            [alert showOnController:self sourceView:self.tableView];
-            
-            NSLog(@"Failed to load media records, reason: %@", task.error);
+    // refresh toolbar
+    [self initToolbarInEditMode:YES];
+    
+    // close refresh control
+    if (self.refreshControl.refreshing) {
+        [self.refreshControl endRefreshing];
+    }
+}
+
+- (void) filterByGenre:(id)sender {
+    // counts are maintained with records, so the menu is built without walking the library
+    [[[[AppDelegate sharedInstance] dataController] genreCountsAsync] continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id(BFTask *task) {
+        if (task.faulted) {
+            NSLog(@"Failed to count media records by genre, reason: %@", task.error ?: task.exception);
+            return nil;
         }
-        
-        [self.tableView reloadData];
-        // refresh toolbar
-        [self initToolbarInEditMode:YES];
-        
-        // close refresh control
-        if (self.refreshControl.refreshing) {
-            [self.refreshControl endRefreshing];
+        NSDictionary<NSString *, NSNumber *> *counts = task.result;
+        UIAlertController *menu = [UIAlertController alertControllerWithTitle:NSLocalizedString(@"Show genre", nil)
+                                                                      message:nil
+                                                               preferredStyle:UIAlertControllerStyleActionSheet];
+        [menu addAction:[UIAlertAction actionWithTitle:NSLocalizedString(@"All genres", nil)
+                                                 style:UIAlertActionStyleDefault
+                                               handler:^(UIAlertAction *action) {
+                                                   [self showRecordsInGenre:nil];
+                                               }]];
+        // records which page or tracks link checker found gone
+        [menu addAction:[UIAlertAction actionWithTitle:NSLocalizedString(@"Dead links", nil)
+                                                 style:UIAlertActionStyleDefault
+                                               handler:^(UIAlertAction *action) {
+                                                   [self showRecordsMatching:[NSPredicate predicateWithFormat:@"valid == NO"]
+                                                                       title:NSLocalizedString(@"Dead links", nil)];
+                                               }]];
+        for (NSString *genre in [[counts allKeys] sortedArrayUsingSelector:@selector(localizedCaseInsensitiveCompare:)]) {
+            NSInteger count = [counts[genre] integerValue];
+            if (count == 0) {
+                continue;
+            }
+            NSString *title = [NSString stringWithFormat:@"%@ (%ld)", genre, (long)count];
+            [menu addAction:[UIAlertAction actionWithTitle:title
+                                                     style:UIAlertActionStyleDefault
+                                                   handler:^(UIAlertAction *action) {
+                                                       [self showRecordsInGenre:genre];
+                                                   }]];
         }
+        [menu addAction:[UIAlertAction actionWithTitle:NSLocalizedString(@"Cancel", nil)
+                                                 style:UIAlertActionStyleCancel
+                                               handler:nil]];
+        menu.popoverPresentationController.barButtonItem = filterItem;
+        [self presentViewController:menu animated:YES completion:nil];
         return nil;
     }];
 }
 
+- (void) showRecordsInGenre:(NSString *)genre {
+    CVCoreDataController *dataController = [[AppDelegate sharedInstance] dataController];
+    [self showRecordsMatching:genre ? [dataController predicateForRecordsInGenres:@[genre]] : nil
+                        title:genre ?: NSLocalizedString(@"All genres", nil)];
+}
+
+- (void) showRecordsMatching:(NSPredicate *)predicate title:(NSString *)title {
+    self.recordsController.predicate = predicate;
+    filterItem.title = title;
+    [self reloadMediaList];
+}
+
 - (void) editTableItems:(id)sender {
     [self.tableView setEditing:YES animated:YES];
     [self initToolbarInEditMode:NO];
@@ -279,8 +462,8 @@ static NSString *const kShowMediaTracksSegue = @"showMediaTracks";
 
 - (void) initToolbarInEditMode:(BOOL) edit {
     if (edit) {
-        self.toolbarItems = @[[[UIBarButtonItem alloc]initWithBarButtonSystemItem:UIBarButtonSystemItemFlexibleSpace target:nil action:nil], editItem];
-        self.toolbarItems[0].enabled = ([self.records count] > 0);
+        self.toolbarItems = @[filterItem, [[UIBarButtonItem alloc]initWithBarButtonSystemItem:UIBarButtonSystemItemFlexibleSpace target:nil action:nil], editItem];
+        editItem.enabled = ([self.recordsController.records count] > 0);
     } else {
         self.toolbarItems = @[[[UIBarButtonItem alloc]initWithBarButtonSystemItem:UIBarButtonSystemItemFlexibleSpace target:nil action:nil], doneItem];
     }
@@ -17,10 +17,15 @@
 #import "LocalPlayerViewController.h"
 #import "AppDelegate.h"
 #import "CVMediaTrack.h"
+#import "MediaPrefetcher.h"
+#import "KeyedListDiff.h"
 
 #import <GoogleCast/GCKDeviceManager.h>
 #import <GoogleCast/GCKMediaControlChannel.h>
 
+// The number of leading tracks which URLs are resolved when list is shown
+static const NSUInteger kProbedTracksCount = 2;
+
 @interface MediaTracksTableViewController () <CastDeviceControllerDelegate>
 
 @property (weak, nonatomic) IBOutlet UIImageView *posterImage;
@@ -32,7 +37,12 @@
 
 @end
 
-@implementation MediaTracksTableViewController
+@implementation MediaTracksTableViewController {
+    // The tracks shown by table, replaced only together with row animations
+    NSArray<CVMediaTrack *> *displayedTracks;
+    // The names of shown tracks, to find rows which content changed
+    NSArray<NSString *> *displayedNames;
+}
 
 - (void)viewDidLoad {
     [super viewDidLoad];
@@ -40,7 +50,7 @@
     self.mediaTitleLbl.text = self.mediaToPlay.title;
     // load poster image
     dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
-        UIImage *image = [UIImage imageWithData:[SimpleImageFetcher getDataFromImageURL:[NSURL URLWithString:self.mediaToPlay.thumbnailUrl]]];
+        UIImage *image = [SimpleImageFetcher getImageFromURL:[NSURL URLWithString:self.mediaToPlay.thumbnailUrl]];
         dispatch_sync(dispatch_get_main_queue(), ^{
             self.posterImage.image = image;
             [self.posterImage setNeedsLayout];
@@ -57,8 +67,20 @@
                             action: @selector(loadMediaTracks)
                   forControlEvents: UIControlEventValueChanged];
     
-    if ([self.mediaToPlay.tracks count] == 0) {
-        [self loadMediaTracks];
+    // stored tracks are shown at once and revalidated in background
+    [self snapshotTracks];
+    [self probeLeadingTracks];
+    if ([displayedTracks count] == 0) {
+        // page prefetched while list was shown is used instead of loading it again
+        ExMedia *media = [[MediaPrefetcher sharedPrefetcher] takeMediaForURL:[self.mediaToPlay pageURL]];
+        if (media) {
+            self.mediaToPlay.valid = [NSNumber numberWithBool:YES];
+            [self onRemoteFetchComplete: media];
+        } else {
+            [self loadMediaTracks];
+        }
+    } else {
+        [self revalidateMediaTracks];
     }
 }
 
@@ -98,14 +120,14 @@
 }
 
 - (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section {
-    return self.mediaToPlay.tracks.count;
+    return displayedTracks.count;
 }
 
 - (UITableViewCell *)tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath {
     UITableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:@"cell" forIndexPath:indexPath];
     
     // Configure the cell...
-    CVMediaTrack *track = [self.mediaToPlay.tracks objectAtIndex:indexPath.row];
+    CVMediaTrack *track = [displayedTracks objectAtIndex:indexPath.row];
     cell.textLabel.text = track.name;
     cell.detailTextLabel.text = track.address;
 
@@ -114,19 +136,34 @@
 
 - (void)tableView:(UITableView *)tableView didSelectRowAtIndexPath:(NSIndexPath *)indexPath {
     // Display the media details view.
-    [self performSegueWithIdentifier:@"playMedia" sender:self];
+    if ([self shouldPerformSegueWithIdentifier:@"playMedia" sender:self]) {
+        [self performSegueWithIdentifier:@"playMedia" sender:self];
+    } else {
+        [tableView deselectRowAtIndexPath:indexPath animated:YES];
+    }
 }
 
 
 #pragma mark - Navigation
 
+- (BOOL)shouldPerformSegueWithIdentifier:(NSString *)identifier sender:(id)sender {
+    if ([identifier isEqualToString:@"playMedia"]) {
+        // the selected row may show track which was replaced since the last snapshot
+        return [self selectedTrackIndex] != NSNotFound;
+    }
+    return YES;
+}
+
 // In a storyboard-based application, you will often want to do a little preparation before navigation
 - (void)prepareForSegue:(UIStoryboardSegue *)segue sender:(id)sender {
     if ([segue.identifier isEqualToString:@"playMedia"]) {
-        NSIndexPath *indexPath = [self.tableView indexPathForSelectedRow];
-        
+        NSUInteger trackIndex = [self selectedTrackIndex];
+        if (trackIndex == NSNotFound) {
+            NSLog(@"Selected track is not in media record: %@", self.mediaToPlay.pageUrl);
+            return;
+        }
         // Pass the currently selected media to the next controller if it needs it.
-        [[segue destinationViewController] setMediaTrack:indexPath.row fromRecord:self.mediaToPlay];
+        [[segue destinationViewController] setMediaTrack:trackIndex fromRecord:self.mediaToPlay];
     }
 }
 
@@ -163,18 +200,30 @@
 }
 
 #pragma mark - private 
-- (void) onRemoteFetchComplete: (ExMedia *) media {
-    for (ExMediaTrack *track in media.tracks) {
-        [[[[AppDelegate sharedInstance] dataController] createTrackWithURL:track.url title:track.name forRecord:self.mediaToPlay]
-         continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
-             //
-             if (task.faulted) {
-                 NSLog(@"Failed to store media track, reason: %@", task.error);
-             }
-             
-             return nil;
-         }];
+
+/**
+ * Returns index of the selected track in media record or NSNotFound if nothing is selected or track is gone
+ */
+- (NSUInteger) selectedTrackIndex {
+    NSIndexPath *indexPath = [self.tableView indexPathForSelectedRow];
+    if (!indexPath || indexPath.row >= displayedTracks.count) {
+        return NSNotFound;
     }
+    return [self.mediaToPlay.tracks indexOfObject:displayedTracks[indexPath.row]];
+}
+
+- (void) onRemoteFetchComplete: (ExMedia *) media {
+    [[[[AppDelegate sharedInstance] dataController] replaceTracks:media.tracks forRecord:self.mediaToPlay]
+     continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
+         if (task.faulted) {
+             NSLog(@"Failed to store media tracks, reason: %@", task.error);
+         } else {
+             [self showChangedTracks];
+             [self probeLeadingTracks];
+         }
+         
+         return nil;
+     }];
 }
 
 - (void) loadMediaTracks {
@@ -185,27 +234,66 @@
         [self.refreshControl beginRefreshing];
     }
     
-    // remove existing tracks
-    [[[[AppDelegate sharedInstance] dataController] deleteMediaTracksForRecordAsync:self.mediaToPlay]
-     continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
-         if (!task.faulted) {
-             [self.tableView reloadData];
-             // load new tracks
-             [self loadRemote];
-         } else {
-             NSLog(@"Failed to delete media tracks, reason: %@", task.error);
-         }
-         
-         return nil;
-     }];
+    // existing tracks are replaced in one transaction when new ones are loaded
+    [self loadRemoteReportingErrors:YES];
 }
 
-- (void) loadRemote {
+- (void) revalidateMediaTracks {
+    [self initToolbarWithProgress: YES];
+    
+    // stored tracks stay on screen, failure is only logged
+    [self loadRemoteReportingErrors:NO];
+}
+
+/**
+ * Resolves URLs of the first tracks, which are likely to be played
+ */
+- (void) probeLeadingTracks {
+    TrackURLProbe *probe = [[AppDelegate sharedInstance] trackProbe];
+    for (NSUInteger i = 0; i < MIN(kProbedTracksCount, displayedTracks.count); i++) {
+        [probe probeTrack:displayedTracks[i]];
+    }
+}
+
+- (void) snapshotTracks {
+    displayedTracks = [self.mediaToPlay.tracks array] ?: @[];
+    displayedNames = [displayedTracks valueForKey:@"name"];
+}
+
+/**
+ * Animates only rows of tracks inserted, removed, moved or renamed since last snapshot
+ */
+- (void) showChangedTracks {
+    NSArray<CVMediaTrack *> *oldTracks = displayedTracks;
+    NSArray<NSString *> *oldNames = displayedNames;
+    [self snapshotTracks];
+    
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys:oldTracks contents:oldNames toKeys:displayedTracks contents:displayedNames];
+    if (![diff hasChanges]) {
+        return;
+    }
+    
+    [self.tableView beginUpdates];
+    [self.tableView deleteRowsAtIndexPaths:diff.deleted withRowAnimation:UITableViewRowAnimationAutomatic];
+    [self.tableView insertRowsAtIndexPaths:diff.inserted withRowAnimation:UITableViewRowAnimationAutomatic];
+    for (NSArray<NSIndexPath *> *move in diff.moved) {
+        [self.tableView moveRowAtIndexPath:move[0] toIndexPath:move[1]];
+    }
+    [self.tableView endUpdates];
+    // row can not be moved and reloaded in the same batch
+    if (diff.updated.count > 0) {
+        [self.tableView reloadRowsAtIndexPaths:diff.updated withRowAnimation:UITableViewRowAnimationNone];
+    }
+}
+
+- (void) loadRemoteReportingErrors: (BOOL)reportErrors {
     [ExMedia mediaFromExURL: [self.mediaToPlay pageURL] withCompletion:
      ^(ExMedia * _Nullable media, NSError * _Nullable error) {
          dispatch_async(dispatch_get_main_queue(), ^{
              // execute on main UI thread
-             if (error) {
+             if (error && !reportErrors) {
+                 NSLog(@"Failed to revalidate media tracks, reason: %@", error);
+             } else if (error) {
                  NSLog(@"Failed to load data, reason: %@", error);
                  AlertHelper *alert = [[AlertHelper alloc] init];
                  alert.title = NSLocalizedString(@"Failed to load remote media", nil);
@@ -221,8 +309,6 @@
                  [self onRemoteFetchComplete: media];
              }
              
-             [self.tableView reloadData];
-             
              // close refresh control
              if (self.refreshControl.refreshing) {
                  [self.refreshControl endRefreshing];
@@ -0,0 +1,56 @@
+//
+//  PlaybackPositionStore.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+#import <Bolts/Bolts.h>
+
+#import "CVCoreDataController.h"
+#import "CVMediaTrack.h"
+
+/**
+ * The write-behind store of playback positions. Positions are appended to memory mapped journal keyed
+ * by track address, which is cheap enough to do on every player tick, and written to Core Data in
+ * single background transaction at intervals, when played track changes and when flush is requested.
+ * Journal survives application crash and is replayed into Core Data on next launch.
+ * It must be used from main queue.
+ */
+@interface PlaybackPositionStore : NSObject
+
+// The maximal delay of writing position to Core Data in seconds
+@property (nonatomic, assign) NSTimeInterval flushInterval;
+// The number of positions not yet written to Core Data
+@property (nonatomic, assign, readonly) NSUInteger pendingCount;
+// The number of completed writes to Core Data
+@property (nonatomic, assign, readonly) NSUInteger flushes;
+
+/*!
+ Creates store and replays positions left in journal by previous run.
+
+ @param journalURL The location of journal file
+ @param dataController The controller to write positions with
+ */
+- (instancetype __nonnull) initWithJournalURL:(NSURL *__nonnull)journalURL
+                               dataController:(CVCoreDataController *__nonnull)dataController;
+
+/*!
+ Records playback position of the track. Switching to another track triggers flush of pending positions.
+ */
+- (void) setPosition:(NSTimeInterval)position forTrack:(CVMediaTrack *__nonnull)track;
+
+/*!
+ Returns the latest position of the track including positions not yet written to Core Data
+ */
+- (NSTimeInterval) positionForTrack:(CVMediaTrack *__nonnull)track;
+
+/*!
+ Writes pending positions to Core Data and compacts journal.
+
+ @return BFTask completed on main queue when positions were written
+ */
+- (BFTask *__nonnull) flush;
+
+@end
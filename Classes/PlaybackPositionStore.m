@@ -0,0 +1,360 @@
+//
+//  PlaybackPositionStore.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "PlaybackPositionStore.h"
+
+#import "CVMediaTrack+CoreDataProperties.h"
+
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+// The journal header
+static const uint32_t kJournalMagic = 0x4A505845; // 'EXPJ'
+static const uint32_t kJournalVersion = 1;
+static const size_t kJournalHeaderSize = 2 * sizeof(uint32_t);
+// The marker of completely written record
+static const uint32_t kRecordMarker = 0x534F5050; // 'PPOS'
+// The initial size of mapped journal, enough for about thousand positions
+static const size_t kInitialJournalCapacity = 64 * 1024;
+// The default delay of writing positions to Core Data
+static const NSTimeInterval kDefaultFlushInterval = 15.0;
+
+/**
+ * The journal record header followed by UTF-8 track address padded to 8 bytes
+ */
+typedef struct {
+    uint32_t marker;
+    uint16_t length;
+    uint16_t reserved;
+    double position;
+} PositionRecordHeader;
+
+static inline size_t PositionRecordSize(size_t addressLength) {
+    return (sizeof(PositionRecordHeader) + addressLength + 7) & ~(size_t)7;
+}
+
+/**
+ * Writes record at offset of mapped journal and returns offset of the next one
+ */
+static size_t WritePositionRecord(uint8_t *journal, size_t offset, double position, NSData *bytes) {
+    PositionRecordHeader *record = (PositionRecordHeader *)(journal + offset);
+    memcpy(journal + offset + sizeof(PositionRecordHeader), bytes.bytes, bytes.length);
+    record->length = (uint16_t)bytes.length;
+    record->reserved = 0;
+    record->position = position;
+    // marker is stored last, so record torn by crash is not replayed
+    __atomic_store_n(&record->marker, kRecordMarker, __ATOMIC_RELEASE);
+    return offset + PositionRecordSize(bytes.length);
+}
+
+@interface PlaybackPositionStore ()
+
+@property (nonatomic, assign, readwrite) NSUInteger flushes;
+
+@end
+
+@implementation PlaybackPositionStore {
+    // The controller to write positions with
+    CVCoreDataController *_dataController;
+    // The journal location
+    NSString *_journalPath;
+    // The journal file descriptor
+    int _fd;
+    // The mapped journal
+    uint8_t *_journal;
+    // The size of mapped journal
+    size_t _capacity;
+    // The offset of the next record
+    size_t _writeOffset;
+    // The positions not yet written to Core Data keyed by track address
+    NSMutableDictionary<NSString *, NSNumber *> *_pending;
+    // The address of the last recorded track
+    NSString *_lastAddress;
+    // The timer of delayed flush
+    NSTimer *_flushTimer;
+    // The flush in progress
+    BFTask *_flushTask;
+}
+
+- (instancetype) initWithJournalURL:(NSURL *)journalURL dataController:(CVCoreDataController *)dataController {
+    self = [super init];
+    if (self) {
+        _dataController = dataController;
+        _flushInterval = kDefaultFlushInterval;
+        _pending = [NSMutableDictionary dictionary];
+        _fd = -1;
+
+        if ([self openJournalAtPath:[journalURL path]]) {
+            [self replayJournal];
+            if (_pending.count > 0) {
+                NSLog(@"Replaying %lu playback positions from journal", (unsigned long)_pending.count);
+                [self flush];
+            }
+        }
+    }
+    return self;
+}
+
+- (void) dealloc {
+    [_flushTimer invalidate];
+    if (_journal) {
+        munmap(_journal, _capacity);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+- (NSUInteger) pendingCount {
+    return _pending.count;
+}
+
+- (void) setPosition:(NSTimeInterval)position forTrack:(CVMediaTrack *)track {
+    NSString *address = track.address;
+    if (!address) {
+        return;
+    }
+    BOOL trackChanged = _lastAddress && ![_lastAddress isEqualToString:address];
+    _lastAddress = address;
+
+    NSNumber *value = @(position);
+    if (![_pending[address] isEqualToNumber:value]) {
+        _pending[address] = value;
+        [self appendPosition:position forAddress:address];
+    }
+
+    if (trackChanged) {
+        [self flush];
+    } else if (_pending.count > 0 && !_flushTimer) {
+        _flushTimer = [NSTimer scheduledTimerWithTimeInterval:self.flushInterval
+                                                       target:self
+                                                     selector:@selector(flushTimerFired:)
+                                                     userInfo:nil
+                                                      repeats:NO];
+    }
+}
+
+- (NSTimeInterval) positionForTrack:(CVMediaTrack *)track {
+    NSNumber *position = track.address ? _pending[track.address] : nil;
+    return position ? [position doubleValue] : [track.playTime doubleValue];
+}
+
+- (BFTask *) flush {
+    [_flushTimer invalidate];
+    _flushTimer = nil;
+
+    if (_flushTask) {
+        // positions recorded meanwhile are written by the next flush
+        return [_flushTask continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *task) {
+            return [self flush];
+        }];
+    }
+    if (_pending.count == 0) {
+        return [BFTask taskWithResult:nil];
+    }
+
+    NSDictionary<NSString *, NSNumber *> *snapshot = [_pending copy];
+    _flushTask = [[_dataController performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaTrackEntityName];
+        [request setPredicate:[NSPredicate predicateWithFormat:@"address IN %@", [snapshot allKeys]]];
+        NSArray<CVMediaTrack *> *tracks = [context executeFetchRequest:request error:error];
+        if (!tracks) {
+            return nil;
+        }
+        for (CVMediaTrack *track in tracks) {
+            NSNumber *position = snapshot[track.address];
+            if (![track.playTime isEqualToNumber:position]) {
+                track.playTime = position;
+            }
+        }
+        return @(tracks.count);
+    }] continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *task) {
+        _flushTask = nil;
+        if (task.faulted) {
+            // journal keeps positions for the next attempt
+            NSLog(@"Failed to write playback positions, reason: %@", task.error ?: task.exception);
+            return task;
+        }
+        for (NSString *address in snapshot) {
+            if ([_pending[address] isEqualToNumber:snapshot[address]]) {
+                [_pending removeObjectForKey:address];
+            }
+        }
+        [self compactJournal];
+        self.flushes += 1;
+        return nil;
+    }];
+    return _flushTask;
+}
+
+#pragma mark - private
+
+- (void) flushTimerFired:(NSTimer *)timer {
+    _flushTimer = nil;
+    [self flush];
+}
+
+- (BOOL) openJournalAtPath:(NSString *)path {
+    if (!path) {
+        return NO;
+    }
+    _journalPath = path;
+    // compaction interrupted by crash leaves its file behind, the journal itself is intact
+    unlink([[path stringByAppendingPathExtension:@"compact"] fileSystemRepresentation]);
+    _fd = open([path fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) {
+        NSLog(@"Failed to open playback journal: %@, error: %d", path, errno);
+        return NO;
+    }
+    struct stat info;
+    size_t size = fstat(_fd, &info) == 0 ? (size_t)info.st_size : 0;
+    if (![self mapJournalWithCapacity:MAX(size, kInitialJournalCapacity)]) {
+        close(_fd);
+        _fd = -1;
+        return NO;
+    }
+    return YES;
+}
+
+- (BOOL) mapJournalWithCapacity:(size_t)capacity {
+    if (_journal) {
+        munmap(_journal, _capacity);
+        _journal = NULL;
+        _capacity = 0;
+    }
+    if (ftruncate(_fd, capacity) != 0) {
+        NSLog(@"Failed to resize playback journal to %zu bytes, error: %d", capacity, errno);
+        return NO;
+    }
+    void *journal = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (journal == MAP_FAILED) {
+        NSLog(@"Failed to map playback journal, error: %d", errno);
+        return NO;
+    }
+    _journal = journal;
+    _capacity = capacity;
+    return YES;
+}
+
+- (void) replayJournal {
+    uint32_t header[2];
+    memcpy(header, _journal, kJournalHeaderSize);
+    if (header[0] != kJournalMagic || header[1] != kJournalVersion) {
+        // new or unknown journal
+        memset(_journal, 0, _capacity);
+        header[0] = kJournalMagic;
+        header[1] = kJournalVersion;
+        memcpy(_journal, header, kJournalHeaderSize);
+        _writeOffset = kJournalHeaderSize;
+        return;
+    }
+
+    size_t offset = kJournalHeaderSize;
+    while (offset + sizeof(PositionRecordHeader) <= _capacity) {
+        PositionRecordHeader *record = (PositionRecordHeader *)(_journal + offset);
+        if (record->marker != kRecordMarker || offset + PositionRecordSize(record->length) > _capacity) {
+            // the end of journal or record torn by crash
+            break;
+        }
+        NSString *address = [[NSString alloc] initWithBytes:_journal + offset + sizeof(PositionRecordHeader)
+                                                     length:record->length
+                                                   encoding:NSUTF8StringEncoding];
+        if (address) {
+            _pending[address] = @(record->position);
+        }
+        offset += PositionRecordSize(record->length);
+    }
+    _writeOffset = offset;
+}
+
+- (void) appendPosition:(double)position forAddress:(NSString *)address {
+    if (!_journal) {
+        return;
+    }
+    NSData *bytes = [address dataUsingEncoding:NSUTF8StringEncoding];
+    if (bytes.length > UINT16_MAX) {
+        return;
+    }
+    if (_writeOffset + PositionRecordSize(bytes.length) > _capacity) {
+        // journal keeps only the latest position per track after compaction
+        [self compactJournal];
+        return;
+    }
+    [self writePosition:position withAddressBytes:bytes];
+}
+
+- (void) compactJournal {
+    if (!_journal) {
+        return;
+    }
+    // the latest positions are written to new file which atomically replaces journal, so crash at any
+    // moment leaves either the old or the new journal complete
+    NSMutableArray<NSData *> *addresses = [NSMutableArray arrayWithCapacity:_pending.count];
+    NSMutableArray<NSNumber *> *positions = [NSMutableArray arrayWithCapacity:_pending.count];
+    size_t required = kJournalHeaderSize;
+    for (NSString *address in _pending) {
+        NSData *bytes = [address dataUsingEncoding:NSUTF8StringEncoding];
+        if (bytes.length > UINT16_MAX) {
+            continue;
+        }
+        [addresses addObject:bytes];
+        [positions addObject:_pending[address]];
+        required += PositionRecordSize(bytes.length);
+    }
+    // keep room for appends, so the next compaction is not due at once
+    size_t capacity = kInitialJournalCapacity;
+    while (capacity < required * 2) {
+        capacity *= 2;
+    }
+
+    NSString *compactPath = [_journalPath stringByAppendingPathExtension:@"compact"];
+    int fd = open([compactPath fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        NSLog(@"Failed to create compacted playback journal: %@, error: %d", compactPath, errno);
+        return;
+    }
+    uint8_t *journal = MAP_FAILED;
+    if (ftruncate(fd, capacity) == 0) {
+        journal = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (journal == MAP_FAILED) {
+        NSLog(@"Failed to map compacted playback journal, error: %d", errno);
+        close(fd);
+        unlink([compactPath fileSystemRepresentation]);
+        return;
+    }
+    uint32_t header[2] = {kJournalMagic, kJournalVersion};
+    memcpy(journal, header, kJournalHeaderSize);
+    size_t offset = kJournalHeaderSize;
+    for (NSUInteger i = 0; i < addresses.count; i++) {
+        offset = WritePositionRecord(journal, offset, [positions[i] doubleValue], addresses[i]);
+    }
+    // new journal must be on disk before it replaces the old one
+    if (msync(journal, capacity, MS_SYNC) != 0 || rename([compactPath fileSystemRepresentation],
+                                                         [_journalPath fileSystemRepresentation]) != 0) {
+        NSLog(@"Failed to replace playback journal with compacted one, error: %d", errno);
+        munmap(journal, capacity);
+        close(fd);
+        unlink([compactPath fileSystemRepresentation]);
+        return;
+    }
+
+    munmap(_journal, _capacity);
+    close(_fd);
+    _fd = fd;
+    _journal = journal;
+    _capacity = capacity;
+    _writeOffset = offset;
+}
+
+- (void) writePosition:(double)position withAddressBytes:(NSData *)bytes {
+    _writeOffset = WritePositionRecord(_journal, _writeOffset, position, bytes);
+}
+
+@end
@@ -0,0 +1,88 @@
+//
+//  PrefetchScheduler.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+// The block cancelling started prefetch
+typedef void (^PrefetchCancelBlock)(void);
+// The block starting prefetch, it must call completion on scheduler queue when done and may return block
+// cancelling it
+typedef PrefetchCancelBlock __nullable (^PrefetchWorkBlock)(void (^__nonnull completion)(void));
+
+/**
+ * The single prefetch request
+ */
+@interface PrefetchRequest : NSObject
+
+// The key identifying prefetched resource, requests with the same key are the same prefetch
+@property (nonatomic, copy, readonly) NSString *__nonnull key;
+// The priority, greater is started first
+@property (nonatomic, assign, readonly) double priority;
+// The work to start
+@property (nonatomic, copy, readonly) PrefetchWorkBlock __nonnull work;
+
++ (instancetype __nonnull) requestWithKey: (NSString *__nonnull)key
+                                 priority: (double)priority
+                                     work: (PrefetchWorkBlock __nonnull)work;
+
+@end
+
+/**
+ * The scheduler of speculative loads. It is fed with complete set of wanted requests every time the
+ * prediction changes: pending requests are kept in priority order, requests no longer wanted are dropped
+ * and their running work is cancelled, requests over the budget are dropped starting from the lowest
+ * priority. At most maxConcurrentTasks works run at once.
+ *
+ * Scheduler does not depend on UI, it must be used from single queue, e.g. main queue.
+ */
+@interface PrefetchScheduler : NSObject
+
+// The maximal number of works running at once, 2 by default
+@property (nonatomic, assign) NSUInteger maxConcurrentTasks;
+// The maximal number of requests pending or running, 32 by default
+@property (nonatomic, assign) NSUInteger budget;
+// The number of pending requests
+@property (nonatomic, assign, readonly) NSUInteger pendingCount;
+// The number of running works
+@property (nonatomic, assign, readonly) NSUInteger runningCount;
+// The number of completed works
+@property (nonatomic, assign, readonly) NSUInteger completedCount;
+// The number of works cancelled while running
+@property (nonatomic, assign, readonly) NSUInteger cancelledCount;
+
+/*!
+ Returns indexes of list items to prefetch ordered from the most to the least wanted. Items ahead in
+ direction of scrolling come first, the faster the scrolling the farther the lookahead, few items
+ behind follow.
+
+ @param visibleRange The range of visible items
+ @param velocity The scrolling velocity in items per second, positive towards the end of list
+ @param itemCount The number of items in list
+ @param lookahead The number of items ahead to prefetch when list is still
+ */
++ (NSArray<NSNumber *> *__nonnull) indexesToPrefetchForVisibleRange: (NSRange)visibleRange
+                                                            velocity: (double)velocity
+                                                           itemCount: (NSUInteger)itemCount
+                                                           lookahead: (NSUInteger)lookahead;
+
+/*!
+ Replaces the set of wanted requests. Running works which keys are not requested anymore are cancelled,
+ requests already running or completed are not started again until they are dropped.
+ */
+- (void) scheduleRequests: (NSArray<PrefetchRequest *> *__nonnull)requests;
+
+/*!
+ Forgets completed request, so it may be started again
+ */
+- (void) invalidateKey: (NSString *__nonnull)key;
+
+/*!
+ Drops all pending requests and cancels running works
+ */
+- (void) cancelAll;
+
+@end
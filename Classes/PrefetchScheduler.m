@@ -0,0 +1,186 @@
+//
+//  PrefetchScheduler.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "PrefetchScheduler.h"
+
+// The default limits of scheduler
+static const NSUInteger kDefaultMaxConcurrentTasks = 2;
+static const NSUInteger kDefaultBudget = 32;
+// The time of scrolling ahead covered by prediction, in seconds
+static const double kPredictionHorizon = 1.0;
+// The maximal lookahead in screens
+static const double kMaxScreensAhead = 4.0;
+
+@implementation PrefetchRequest
+
++ (instancetype) requestWithKey: (NSString *)key priority: (double)priority work: (PrefetchWorkBlock)work {
+    PrefetchRequest *request = [[PrefetchRequest alloc] init];
+    request->_key = [key copy];
+    request->_priority = priority;
+    request->_work = [work copy];
+    return request;
+}
+
+@end
+
+/**
+ * The running work of request
+ */
+@interface PrefetchRun : NSObject
+
+@property (nonatomic, copy) PrefetchCancelBlock cancel;
+
+@end
+
+@implementation PrefetchRun
+@end
+
+@implementation PrefetchScheduler {
+    // The requests waiting to start, the highest priority first
+    NSMutableArray<PrefetchRequest *> *_pending;
+    // The running works keyed by request key
+    NSMutableDictionary<NSString *, PrefetchRun *> *_running;
+    // The keys of completed requests which are still wanted
+    NSMutableSet<NSString *> *_completed;
+}
+
++ (NSArray<NSNumber *> *) indexesToPrefetchForVisibleRange: (NSRange)visibleRange
+                                                  velocity: (double)velocity
+                                                 itemCount: (NSUInteger)itemCount
+                                                 lookahead: (NSUInteger)lookahead {
+    NSUInteger first = MIN(visibleRange.location, itemCount);
+    NSUInteger end = MIN(NSMaxRange(visibleRange), itemCount);
+    double maxAhead = kMaxScreensAhead * MAX(visibleRange.length, lookahead);
+    NSUInteger ahead = lookahead + (NSUInteger)MIN(fabs(velocity) * kPredictionHorizon, maxAhead);
+    NSUInteger behind = MAX(lookahead / 4, 1);
+    NSUInteger after = velocity >= 0 ? ahead : behind;
+    NSUInteger before = velocity >= 0 ? behind : ahead;
+
+    NSMutableArray<NSNumber *> *indexes = [NSMutableArray arrayWithCapacity:end - first + ahead + behind];
+    // visible items are the most likely to be opened
+    for (NSUInteger i = first; i < end; i++) {
+        [indexes addObject:@(i)];
+    }
+    NSMutableArray<NSNumber *> *afterIndexes = [NSMutableArray arrayWithCapacity:after];
+    for (NSUInteger i = end; i < MIN(end + after, itemCount); i++) {
+        [afterIndexes addObject:@(i)];
+    }
+    NSMutableArray<NSNumber *> *beforeIndexes = [NSMutableArray arrayWithCapacity:before];
+    for (NSUInteger i = first; i > 0 && first - i < before; i--) {
+        [beforeIndexes addObject:@(i - 1)];
+    }
+    [indexes addObjectsFromArray:velocity >= 0 ? afterIndexes : beforeIndexes];
+    [indexes addObjectsFromArray:velocity >= 0 ? beforeIndexes : afterIndexes];
+    return indexes;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if (self) {
+        _maxConcurrentTasks = kDefaultMaxConcurrentTasks;
+        _budget = kDefaultBudget;
+        _pending = [NSMutableArray array];
+        _running = [NSMutableDictionary dictionary];
+        _completed = [NSMutableSet set];
+    }
+    return self;
+}
+
+- (NSUInteger) pendingCount {
+    return _pending.count;
+}
+
+- (NSUInteger) runningCount {
+    return _running.count;
+}
+
+- (void) scheduleRequests: (NSArray<PrefetchRequest *> *)requests {
+    NSMutableDictionary<NSString *, PrefetchRequest *> *wanted = [NSMutableDictionary dictionaryWithCapacity:requests.count];
+    for (PrefetchRequest *request in requests) {
+        PrefetchRequest *existing = wanted[request.key];
+        if (!existing || existing.priority < request.priority) {
+            wanted[request.key] = request;
+        }
+    }
+
+    for (NSString *key in [_running allKeys]) {
+        if (!wanted[key]) {
+            [self cancelRunningKey:key];
+        }
+    }
+    [_completed intersectSet:[NSSet setWithArray:[wanted allKeys]]];
+
+    [_pending removeAllObjects];
+    for (PrefetchRequest *request in [wanted allValues]) {
+        if (!_running[request.key] && ![_completed containsObject:request.key]) {
+            [_pending addObject:request];
+        }
+    }
+    [_pending sortUsingComparator:^NSComparisonResult(PrefetchRequest *request1, PrefetchRequest *request2) {
+        if (request1.priority != request2.priority) {
+            return request1.priority > request2.priority ? NSOrderedAscending : NSOrderedDescending;
+        }
+        return [request1.key compare:request2.key];
+    }];
+    NSUInteger allowed = self.budget > _running.count ? self.budget - _running.count : 0;
+    if (_pending.count > allowed) {
+        [_pending removeObjectsInRange:NSMakeRange(allowed, _pending.count - allowed)];
+    }
+
+    [self startPending];
+}
+
+- (void) invalidateKey: (NSString *)key {
+    [_completed removeObject:key];
+}
+
+- (void) cancelAll {
+    [_pending removeAllObjects];
+    [_completed removeAllObjects];
+    for (NSString *key in [_running allKeys]) {
+        [self cancelRunningKey:key];
+    }
+}
+
+#pragma mark - private
+
+- (void) startPending {
+    while (_running.count < MAX(self.maxConcurrentTasks, 1) && _pending.count > 0) {
+        PrefetchRequest *request = _pending[0];
+        [_pending removeObjectAtIndex:0];
+
+        NSString *key = request.key;
+        PrefetchRun *run = [[PrefetchRun alloc] init];
+        _running[key] = run;
+        __weak PrefetchScheduler *weakSelf = self;
+        PrefetchCancelBlock cancel = request.work(^{
+            PrefetchScheduler *scheduler = weakSelf;
+            // completion of cancelled or replaced run is ignored
+            if (!scheduler || scheduler->_running[key] != run) {
+                return;
+            }
+            [scheduler->_running removeObjectForKey:key];
+            [scheduler->_completed addObject:key];
+            scheduler->_completedCount++;
+            [scheduler startPending];
+        });
+        if (_running[key] == run) {
+            run.cancel = cancel;
+        }
+    }
+}
+
+- (void) cancelRunningKey: (NSString *)key {
+    PrefetchRun *run = _running[key];
+    [_running removeObjectForKey:key];
+    _cancelledCount++;
+    if (run.cancel) {
+        run.cancel();
+    }
+}
+
+@end
@@ -15,6 +15,7 @@
 #import "QueueTableViewController.h"
 
 #import "CastDeviceController.h"
+#import "ImageLoader.h"
 #import "SimpleImageFetcher.h"
 
 #import <GoogleCast/GoogleCast.h>
@@ -22,6 +23,7 @@
 @interface QueueTableViewController () <CastDeviceControllerDelegate>
 
 @property(strong, nonatomic) GCKMediaControlChannel *mediaControlChannel;
+@property(strong, nonatomic) CastQueueMirror *queueMirror;
 @property(assign, nonatomic) NSInteger currentItemRow;
 
 @end
@@ -30,11 +32,17 @@
     UIBarButtonItem *editItem;
     UIBarButtonItem *deleteItem;
     UIBarButtonItem *doneItem;
+    // The thumbnail requests of cells on screen
+    NSMapTable<UITableViewCell *, ImageLoadToken *> *imageLoadTokens;
+    // Whether rows were reordered by user and table already shows the order receiver is about to send
+    BOOL reloadOnQueueChange;
 }
 
 - (void)viewDidLoad {
     [super viewDidLoad];
+    imageLoadTokens = [NSMapTable weakToStrongObjectsMapTable];
     _mediaControlChannel = [CastDeviceController sharedInstance].mediaControlChannel;
+    _queueMirror = [CastDeviceController sharedInstance].queueMirror;
     UILongPressGestureRecognizer *longPress =
     [[UILongPressGestureRecognizer alloc] initWithTarget:self
                                                   action:@selector(longPressGestureRecognized:)];
@@ -60,8 +68,8 @@
     controller.delegate = self;
     self.navigationItem.rightBarButtonItem = [controller queueItemForController:self];
     
-    [self.tableView reloadData];
     [self updateCurrentItem];
+    [self.tableView reloadData];
 }
 
 - (void)viewWillDisappear:(BOOL)animated {
@@ -72,15 +80,15 @@
 // Identify currentItemRow such that it can be indicated visually,
 // and grey out rows before this item.
 - (void)updateCurrentItem {
-    _currentItemRow = -1;
-    GCKMediaStatus *mediaStatus = _mediaControlChannel.mediaStatus;
-    NSInteger count = [mediaStatus queueItemCount];
-    for (NSInteger i = 0; i < count; ++i) {
-        GCKMediaQueueItem *item = [mediaStatus queueItemAtIndex:i];
-        if (item.itemID == mediaStatus.currentItemID) {
-            _currentItemRow = i;
-            break;
-        }
+    NSUInteger currentIndex = _queueMirror.currentIndex;
+    _currentItemRow = currentIndex == NSNotFound ? -1 : (NSInteger)currentIndex;
+}
+
+- (void)styleCell:(UITableViewCell *)cell atRow:(NSInteger)row {
+    if (row < _currentItemRow) {
+        cell.backgroundColor = [UIColor colorWithWhite:0.0 alpha:0.1];
+    } else {
+        cell.backgroundColor = nil;
     }
 }
 
@@ -94,9 +102,31 @@
 
 #pragma mark - CastDeviceControllerDelegate
 
-- (void)didUpdateQueueForDevice:(GCKDevice *)device {
-    [self.tableView reloadData];
+- (void)didUpdateQueueWithChanges:(CastQueueChangeSet *)changes {
     [self updateCurrentItem];
+    if (reloadOnQueueChange && [changes hasRowChanges]) {
+        reloadOnQueueChange = NO;
+        [self.tableView reloadData];
+        return;
+    }
+    
+    // only changed rows are touched, cells of other rows keep their thumbnails
+    if (changes.deleted.count > 0 || changes.inserted.count > 0 || changes.moved.count > 0) {
+        [self.tableView beginUpdates];
+        [self.tableView deleteRowsAtIndexPaths:changes.deleted withRowAnimation:UITableViewRowAnimationAutomatic];
+        [self.tableView insertRowsAtIndexPaths:changes.inserted withRowAnimation:UITableViewRowAnimationAutomatic];
+        for (NSArray<NSIndexPath *> *move in changes.moved) {
+            [self.tableView moveRowAtIndexPath:move[0] toIndexPath:move[1]];
+        }
+        [self.tableView endUpdates];
+    }
+    // row can not be moved and reloaded in the same batch
+    if (changes.updated.count > 0) {
+        [self.tableView reloadRowsAtIndexPaths:changes.updated withRowAnimation:UITableViewRowAnimationNone];
+    }
+    for (NSIndexPath *indexPath in [self.tableView indexPathsForVisibleRows]) {
+        [self styleCell:[self.tableView cellForRowAtIndexPath:indexPath] atRow:indexPath.row];
+    }
 }
 
 #pragma mark - UITableViewDataSource
@@ -106,7 +136,7 @@
 }
 
 - (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section {
-    return [_mediaControlChannel.mediaStatus queueItemCount];
+    return _queueMirror.items.count;
 }
 
 - (UITableViewCell *)tableView:(UITableView *)tableView
@@ -114,15 +144,10 @@
     // Load a queue item.
     UITableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:@"Cell" forIndexPath:indexPath];
     
-    GCKMediaStatus *mediaStatus = _mediaControlChannel.mediaStatus;
-    GCKMediaQueueItem *item = [mediaStatus queueItemAtIndex:indexPath.row];
+    GCKMediaQueueItem *item = [_queueMirror itemAtIndex:indexPath.row];
     GCKMediaInformation *info = item.mediaInformation;
     
-    if (indexPath.row < _currentItemRow) {
-        cell.backgroundColor = [UIColor colorWithWhite:0.0 alpha:0.1];
-    } else {
-        cell.backgroundColor = nil;
-    }
+    [self styleCell:cell atRow:indexPath.row];
     
     UILabel *mediaTitle = cell.textLabel;
     UILabel *mediaOwner = cell.detailTextLabel;
@@ -131,26 +156,41 @@
     mediaTitle.text = [info.metadata stringForKey:kGCKMetadataKeyTitle];
     mediaOwner.text = [info.metadata stringForKey:kGCKMetadataKeySubtitle];
     
+    // Drop request of the row previously shown in reused cell
+    [[imageLoadTokens objectForKey:cell] cancel];
+    [imageLoadTokens removeObjectForKey:cell];
+    mediaPreview.image = nil;
+    
     // Update the image, async.
-    GCKImage *img = [info.metadata.images objectAtIndex:0];
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        UIImage *image = [UIImage imageWithData:[SimpleImageFetcher getDataFromImageURL:img.URL]];
-        dispatch_async(dispatch_get_main_queue(), ^{
+    GCKImage *img = info.metadata.images.count > 0 ? [info.metadata.images objectAtIndex:0] : nil;
+    if (img.URL) {
+        // metadata declares the size image is meant to be shown at
+        CGSize thumbnailSize = (img.width > 0 && img.height > 0) ?
+            [SimpleImageFetcher pixelSizeForPointSize:CGSizeMake(img.width, img.height)] : CGSizeZero;
+        ImageLoadToken *token = [[ImageLoader sharedLoader] loadImageFromURL:img.URL
+                                                                   pixelSize:thumbnailSize
+                                                                    priority:ImageLoadPriorityHigh
+                                                                  completion:^(UIImage * _Nullable image) {
+            [imageLoadTokens removeObjectForKey:cell];
             mediaPreview.image = image;
             [cell setNeedsLayout];
-        });
-    });
+        }];
+        if (token) {
+            [imageLoadTokens setObject:token forKey:cell];
+        }
+    }
     
     return cell;
 }
 
+- (void)tableView:(UITableView *)tableView didEndDisplayingCell:(UITableViewCell *)cell forRowAtIndexPath:(NSIndexPath *)indexPath {
+    // Row left the screen, its thumbnail is not needed anymore
+    [[imageLoadTokens objectForKey:cell] cancel];
+    [imageLoadTokens removeObjectForKey:cell];
+}
+
 - (IBAction)didTapClearQueue:(id)sender {
-    NSInteger count = [_mediaControlChannel.mediaStatus queueItemCount];
-    NSMutableArray *items = [NSMutableArray arrayWithCapacity:count];
-    for (int i = 0; i < count; i++) {
-        [items addObject:@([_mediaControlChannel.mediaStatus queueItemAtIndex:i].itemID)];
-    }
-    [_mediaControlChannel queueRemoveItemsWithIDs:items];
+    [_mediaControlChannel queueRemoveItemsWithIDs:[_queueMirror.items valueForKey:@"itemID"]];
 }
 
 - (void) editTableItems:(id)sender {
@@ -169,8 +209,8 @@
     } else {
         self.toolbarItems = @[doneItem, [[UIBarButtonItem alloc]initWithBarButtonSystemItem:UIBarButtonSystemItemFlexibleSpace target:nil action:nil], deleteItem];
     }
-    self.toolbarItems[0].enabled = ([_mediaControlChannel.mediaStatus queueItemCount] > 0);
-    self.toolbarItems[2].enabled = ([_mediaControlChannel.mediaStatus queueItemCount] > 0);
+    self.toolbarItems[0].enabled = (_queueMirror.items.count > 0);
+    self.toolbarItems[2].enabled = (_queueMirror.items.count > 0);
 }
 
 
@@ -183,10 +223,7 @@
 // Override to support rearranging the table view.
 - (void)tableView:(UITableView *)tableView moveRowAtIndexPath:(NSIndexPath *)fromIndexPath
       toIndexPath:(NSIndexPath *)toIndexPath {
-    GCKMediaStatus *mediaStatus = _mediaControlChannel.mediaStatus;
-    
-    GCKMediaQueueItem *from =
-    [mediaStatus queueItemAtIndex:fromIndexPath.row];
+    GCKMediaQueueItem *from = [_queueMirror itemAtIndex:fromIndexPath.row];
     NSInteger toRow = toIndexPath.row;
     
     if (toIndexPath.row > fromIndexPath.row) {
@@ -195,14 +232,16 @@
     }
     
     NSUInteger beforeItemID;
-    if (toRow < [mediaStatus queueItemCount]) {
-        GCKMediaQueueItem *to = [mediaStatus queueItemAtIndex:toRow];
+    if (toRow < _queueMirror.items.count) {
+        GCKMediaQueueItem *to = [_queueMirror itemAtIndex:toRow];
         beforeItemID = to.itemID;
     } else {
         // Moving to the end.
         beforeItemID = kGCKMediaQueueInvalidItemID;
     }
     
+    // table already shows the new order, receiver's queue is taken as is
+    reloadOnQueueChange = YES;
     [_mediaControlChannel queueMoveItemWithID:from.itemID
                              beforeItemWithID:beforeItemID];
 }
@@ -213,8 +252,7 @@
 }
 
 - (void)tableView:(UITableView *)tableView commitEditingStyle:(UITableViewCellEditingStyle)editingStyle forRowAtIndexPath:(NSIndexPath *)indexPath {
-    GCKMediaStatus *mediaStatus = _mediaControlChannel.mediaStatus;
-    GCKMediaQueueItem *to = [mediaStatus queueItemAtIndex:indexPath.row];
+    GCKMediaQueueItem *to = [_queueMirror itemAtIndex:indexPath.row];
     if (editingStyle == UITableViewCellEditingStyleDelete) {
         [_mediaControlChannel queueRemoveItemWithID:to.itemID];
     }
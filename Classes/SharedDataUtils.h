@@ -27,6 +27,21 @@ static NSString * const kMediaRecordsDBFileExtension;
  */
 + (NSURL*) pathToMediaFile;
 
+/**
+ * Returns path to the journal of playback positions not yet written to Data Base
+ */
++ (NSURL*) pathToPlaybackJournal;
+
+/**
+ * Returns path to the persisted state of link validity crawler
+ */
++ (NSURL*) pathToLinkCrawlerState;
+
+/**
+ * Returns path to the full-text search index of media records
+ */
++ (NSURL*) pathToSearchIndex;
+
 /**
  * Returns path to the directory shared among group participants
  */
@@ -27,6 +27,21 @@ static NSString * const kCCSharedAppGroupIdentifier = @"group.ua.nologin.ChromeC
     return [docsDirectory URLByAppendingPathComponent:@"media.list"];
 }
 
++ (NSURL*) pathToPlaybackJournal {
+    NSURL *docsDirectory = [SharedDataUtils sharedGroupDataDirectory];
+    return [docsDirectory URLByAppendingPathComponent:@"positions.journal"];
+}
+
++ (NSURL*) pathToLinkCrawlerState {
+    NSURL *docsDirectory = [SharedDataUtils sharedGroupDataDirectory];
+    return [docsDirectory URLByAppendingPathComponent:@"linkcrawler.plist"];
+}
+
++ (NSURL*) pathToSearchIndex {
+    NSURL *docsDirectory = [SharedDataUtils sharedGroupDataDirectory];
+    return [docsDirectory URLByAppendingPathComponent:@"search.index"];
+}
+
 + (NSURL*) sharedGroupDataDirectory {
     NSFileManager *fm = [NSFileManager defaultManager];
     NSURL *dirPath = [fm containerURLForSecurityApplicationGroupIdentifier:kCCSharedAppGroupIdentifier];
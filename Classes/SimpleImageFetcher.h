@@ -14,10 +14,124 @@
 
 #import <Foundation/Foundation.h>
 
+@class ImageDiskCache;
+@class ImageMemoryCache;
+@protocol ImageScaling;
+
+/**
+ * The snapshot of image cache counters
+ */
+@interface ImageCacheStatistics : NSObject
+
+// The number of requests served by decoded images in memory
+@property (nonatomic, assign) NSUInteger memoryHits;
+// The number of requests served from disk cache
+@property (nonatomic, assign) NSUInteger diskHits;
+// The number of requests which downloaded image
+@property (nonatomic, assign) NSUInteger networkFetches;
+// The number of duplicate requests which joined a fetch already in flight
+@property (nonatomic, assign) NSUInteger coalescedRequests;
+// The number of decoded bytes held in memory
+@property (nonatomic, assign) NSUInteger residentBytes;
+// The budget of decoded bytes held in memory
+@property (nonatomic, assign) NSUInteger residentBytesLimit;
+// The number of bytes stored on disk
+@property (nonatomic, assign) unsigned long long diskBytes;
+// The budget of bytes stored on disk
+@property (nonatomic, assign) unsigned long long diskBytesLimit;
+// The number of files evicted from disk
+@property (nonatomic, assign) NSUInteger diskEvictions;
+// The number of scaled variants produced
+@property (nonatomic, assign) NSUInteger scaledVariants;
+// The number of source bytes variants were produced from
+@property (nonatomic, assign) unsigned long long variantSourceBytes;
+// The number of bytes of produced variants
+@property (nonatomic, assign) unsigned long long variantBytes;
+// The ratio of source bytes to variant bytes
+@property (nonatomic, assign, readonly) double variantCompressionRatio;
+// The ratio of memory hits to all requests
+@property (nonatomic, assign, readonly) double memoryHitRatio;
+// The ratio of disk hits to requests not served from memory
+@property (nonatomic, assign, readonly) double diskHitRatio;
+
+@end
+
 @interface SimpleImageFetcher : NSObject
 
 /**
- *  Retrieve an image from the network or local cache.
+ *  Retrieve a decoded image from memory, local cache or network in that order.
+ *  Blocks while reading disk or network, so call it off the main queue.
+ *
+ *  @param urlToFetch URL of an image.
+ *
+ *  @return The image ready for display or nil if it can not be loaded.
+ */
++ (UIImage *)getImageFromURL:(NSURL *)urlToFetch;
+
+/**
+ *  Retrieve a variant of image scaled to fit the pixel size. Variant is produced once by
+ *  scaler and cached under URL plus size, downloaded original is not kept. CGSizeZero stands
+ *  for the original image.
+ *
+ *  @param urlToFetch URL of an image.
+ *  @param pixelSize The bounding size of variant in pixels.
+ *
+ *  @return The image with screen scale or nil if it can not be loaded.
+ */
++ (UIImage *)getImageFromURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize;
+
+/**
+ *  Retrieve a decoded image only if it is held in memory. Safe to call on the main queue.
+ *
+ *  @param urlToFetch URL of an image.
+ *
+ *  @return The image or nil if it is not in memory.
+ */
++ (UIImage *)cachedImageForURL:(NSURL *)urlToFetch;
+
+/**
+ *  Retrieve a decoded variant only if it is held in memory.
+ */
++ (UIImage *)cachedImageForURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize;
+
+/**
+ *  Retrieve a decoded image from local cache only, the image is put in memory tier.
+ *
+ *  @param urlToFetch URL of an image.
+ *
+ *  @return The image or nil if it is not cached on disk.
+ */
++ (UIImage *)getImageFromDiskCacheForURL:(NSURL *)urlToFetch;
+
+/**
+ *  Retrieve a decoded variant from local cache only. Missing variant is produced from the
+ *  original image if the latter is cached.
+ */
++ (UIImage *)getImageFromDiskCacheForURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize;
+
+/**
+ *  Store image data downloaded by caller in local cache and decode it into memory tier.
+ *
+ *  @param data The downloaded bytes.
+ *  @param urlToFetch URL of an image.
+ *
+ *  @return The decoded image or nil if data is not an image.
+ */
++ (UIImage *)storeDownloadedData:(NSData *)data forURL:(NSURL *)urlToFetch;
+
+/**
+ *  Scale image data downloaded by caller to the pixel size and store the variant only.
+ */
++ (UIImage *)storeDownloadedData:(NSData *)data forURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize;
+
+/**
+ *  Convert size in points to size in pixels of the main screen.
+ */
++ (CGSize)pixelSizeForPointSize:(CGSize)pointSize;
+
+/**
+ *  Retrieve an image from the network or local cache. Concurrent requests for the same URL
+ *  share single download and cache write.
  *
  *  @param urlToFetch URL of an image.
  *
@@ -40,4 +154,29 @@
  */
 + (void) removeCacheHitForURL:(NSURL *)urlToFetch;
 
+/**
+ * Returns the memory tier of decoded images
+ */
++ (ImageMemoryCache *)memoryCache;
+
+/**
+ * Returns the disk tier of image files
+ */
++ (ImageDiskCache *)diskCache;
+
+/**
+ * Returns the scaler producing image variants
+ */
++ (id<ImageScaling>)scaler;
+
+/**
+ * Replaces the scaler producing image variants
+ */
++ (void)setScaler:(id<ImageScaling>)scaler;
+
+/**
+ * Returns the snapshot of cache counters
+ */
++ (ImageCacheStatistics *)statistics;
+
 @end
\ No newline at end of file
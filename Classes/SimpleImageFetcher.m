@@ -14,10 +14,331 @@
 
 #import "SimpleImageFetcher.h"
 
-#import <CommonCrypto/CommonDigest.h>
+#import "ImageDiskCache.h"
+#import "ImageMemoryCache.h"
+#import "ImageScaler.h"
+
+// The default budget of decoded images held in memory
+static const NSUInteger kMemoryCacheCostLimit = 32 * 1024 * 1024;
+// The default budget of image files kept on disk
+static const unsigned long long kDiskCacheByteLimit = 100 * 1024 * 1024;
+
+// The number of requests served from disk cache
+static NSUInteger diskHits = 0;
+// The number of requests which downloaded image
+static NSUInteger networkFetches = 0;
+// The number of requests which joined a fetch already in flight
+static NSUInteger coalescedRequests = 0;
+// The fetches in flight keyed by kind and URL
+static NSMutableDictionary<NSString *, id> *inFlightFetches = nil;
+// The number of variants produced by scaler
+static NSUInteger scaledVariants = 0;
+// The number of source bytes variants were produced from
+static unsigned long long variantSourceBytes = 0;
+// The number of bytes of produced variants
+static unsigned long long variantBytes = 0;
+// The pixel sizes of variants requested so far
+static NSMutableSet<NSValue *> *variantSizes = nil;
+// The scaler producing variants
+static id<ImageScaling> imageScaler = nil;
+
+/**
+ * The fetch shared by all concurrent callers requesting the same URL
+ */
+@interface ImageFetchInFlight : NSObject
+
+// The group left once result is ready
+@property (strong, nonatomic) dispatch_group_t group;
+@property (strong, nonatomic) id result;
+
+@end
+
+@implementation ImageFetchInFlight
+@end
+
+@implementation ImageCacheStatistics
+
+- (double) memoryHitRatio {
+    NSUInteger requests = self.memoryHits + self.diskHits + self.networkFetches;
+    return requests > 0 ? (double)self.memoryHits / requests : 0;
+}
+
+- (double) diskHitRatio {
+    NSUInteger requests = self.diskHits + self.networkFetches;
+    return requests > 0 ? (double)self.diskHits / requests : 0;
+}
+
+- (double) variantCompressionRatio {
+    return self.variantBytes > 0 ? (double)self.variantSourceBytes / self.variantBytes : 0;
+}
+
+- (NSString *) description {
+    return [NSString stringWithFormat:@"memory hits: %lu (%.2f), disk hits: %lu (%.2f), network: %lu, coalesced: %lu, resident: %lu of %lu bytes, disk: %llu of %llu bytes, disk evictions: %lu, variants: %lu (%.1fx smaller)",
+            (unsigned long)self.memoryHits, self.memoryHitRatio, (unsigned long)self.diskHits, self.diskHitRatio,
+            (unsigned long)self.networkFetches, (unsigned long)self.coalescedRequests,
+            (unsigned long)self.residentBytes, (unsigned long)self.residentBytesLimit,
+            self.diskBytes, self.diskBytesLimit, (unsigned long)self.diskEvictions,
+            (unsigned long)self.scaledVariants, self.variantCompressionRatio];
+}
+
+@end
 
 @implementation SimpleImageFetcher
 
++ (ImageMemoryCache *)memoryCache {
+    static dispatch_once_t p = 0;
+    __strong static ImageMemoryCache *_memoryCache = nil;
+
+    dispatch_once(&p, ^{
+        _memoryCache = [[ImageMemoryCache alloc] initWithCostLimit:kMemoryCacheCostLimit];
+    });
+
+    return _memoryCache;
+}
+
++ (ImageDiskCache *)diskCache {
+    static dispatch_once_t p = 0;
+    __strong static ImageDiskCache *_diskCache = nil;
+
+    dispatch_once(&p, ^{
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        NSURL *directory = [[[fileManager URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] lastObject]
+                            URLByAppendingPathComponent:@"thumbnails"];
+        _diskCache = [[ImageDiskCache alloc] initWithDirectory:directory byteLimit:kDiskCacheByteLimit];
+    });
+
+    return _diskCache;
+}
+
++ (ImageCacheStatistics *)statistics {
+    ImageCacheStatistics *statistics = [[ImageCacheStatistics alloc] init];
+    ImageMemoryCache *memoryCache = [self memoryCache];
+    statistics.memoryHits = memoryCache.hits;
+    statistics.residentBytes = memoryCache.residentBytes;
+    statistics.residentBytesLimit = memoryCache.costLimit;
+    ImageDiskCache *diskCache = [self diskCache];
+    statistics.diskBytes = diskCache.totalBytes;
+    statistics.diskBytesLimit = diskCache.byteLimit;
+    statistics.diskEvictions = diskCache.evictions;
+    @synchronized (self) {
+        statistics.diskHits = diskHits;
+        statistics.networkFetches = networkFetches;
+        statistics.coalescedRequests = coalescedRequests;
+        statistics.scaledVariants = scaledVariants;
+        statistics.variantSourceBytes = variantSourceBytes;
+        statistics.variantBytes = variantBytes;
+    }
+    return statistics;
+}
+
++ (id<ImageScaling>)scaler {
+    @synchronized (self) {
+        if (!imageScaler) {
+            imageScaler = [[ImageIOScaler alloc] init];
+        }
+        return imageScaler;
+    }
+}
+
++ (void)setScaler:(id<ImageScaling>)scaler {
+    @synchronized (self) {
+        imageScaler = scaler;
+    }
+}
+
++ (CGSize)pixelSizeForPointSize:(CGSize)pointSize {
+    CGFloat scale = [UIScreen mainScreen].scale;
+    return CGSizeMake(ceil(pointSize.width * scale), ceil(pointSize.height * scale));
+}
+
++ (UIImage *)cachedImageForURL:(NSURL *)urlToFetch {
+    return [self cachedImageForURL:urlToFetch pixelSize:CGSizeZero];
+}
+
++ (UIImage *)cachedImageForURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize {
+    if (!urlToFetch) {
+        return nil;
+    }
+    return [[self memoryCache] imageForKey:[self cacheKeyForURL:urlToFetch pixelSize:pixelSize]];
+}
+
++ (UIImage *)getImageFromURL:(NSURL *)urlToFetch {
+    return [self getImageFromURL:urlToFetch pixelSize:CGSizeZero];
+}
+
++ (UIImage *)getImageFromURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize {
+    if (!urlToFetch) {
+        return nil;
+    }
+    NSString *key = [self cacheKeyForURL:urlToFetch pixelSize:pixelSize];
+    UIImage *image = [[self memoryCache] imageForKey:key];
+    if (image) {
+        return image;
+    }
+    // concurrent callers share single read and decode
+    return [self coalescedResultForKey:[@"image:" stringByAppendingString:key] loader:^id{
+        if (!CGSizeEqualToSize(pixelSize, CGSizeZero)) {
+            UIImage *variant = [self getImageFromDiskCacheForURL:urlToFetch pixelSize:pixelSize];
+            if (variant) {
+                return variant;
+            }
+        }
+        if (CGSizeEqualToSize(pixelSize, CGSizeZero)) {
+            NSData *data = [self getDataFromImageURL:urlToFetch];
+            return data ? [self cacheDecodedImageWithData:data forKey:key scale:1] : nil;
+        }
+        // only the variant is kept, same as for images downloaded by ImageLoader
+        NSData *data = [self coalescedResultForKey:[@"download:" stringByAppendingString:[urlToFetch absoluteString]] loader:^id{
+            return [self downloadDataFromImageURL:urlToFetch];
+        }];
+        return data ? [self cacheVariantWithData:data forURL:urlToFetch pixelSize:pixelSize] : nil;
+    }];
+}
+
++ (UIImage *)getImageFromDiskCacheForURL:(NSURL *)urlToFetch {
+    return [self getImageFromDiskCacheForURL:urlToFetch pixelSize:CGSizeZero];
+}
+
++ (UIImage *)getImageFromDiskCacheForURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize {
+    if (!urlToFetch) {
+        return nil;
+    }
+    BOOL original = CGSizeEqualToSize(pixelSize, CGSizeZero);
+    NSString *key = [self cacheKeyForURL:urlToFetch pixelSize:pixelSize];
+    NSData *data = [[self diskCache] dataForKey:key];
+    if (data) {
+        @synchronized (self) {
+            diskHits += 1;
+        }
+        return [self cacheDecodedImageWithData:data forKey:key scale:original ? 1 : [UIScreen mainScreen].scale];
+    }
+    if (original) {
+        return nil;
+    }
+    // produce variant from original if some other view cached it
+    data = [[self diskCache] dataForKey:[urlToFetch absoluteString]];
+    if (!data) {
+        return nil;
+    }
+    @synchronized (self) {
+        diskHits += 1;
+    }
+    return [self cacheVariantWithData:data forURL:urlToFetch pixelSize:pixelSize];
+}
+
++ (UIImage *)storeDownloadedData:(NSData *)data forURL:(NSURL *)urlToFetch {
+    return [self storeDownloadedData:data forURL:urlToFetch pixelSize:CGSizeZero];
+}
+
++ (UIImage *)storeDownloadedData:(NSData *)data forURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize {
+    @synchronized (self) {
+        networkFetches += 1;
+    }
+    if (!CGSizeEqualToSize(pixelSize, CGSizeZero)) {
+        // only the variant is kept
+        return [self cacheVariantWithData:data forURL:urlToFetch pixelSize:pixelSize];
+    }
+    NSString *key = [urlToFetch absoluteString];
+    [[self diskCache] storeData:data forKey:key];
+    return [self cacheDecodedImageWithData:data forKey:key scale:1];
+}
+
++ (UIImage *)cacheVariantWithData:(NSData *)data forURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize {
+    NSData *variant = [[self scaler] scaledDataWithImageData:data toPixelSize:pixelSize];
+    if (!variant) {
+        NSLog(@"Failed to scale image: %@ to size: %@", urlToFetch, NSStringFromCGSize(pixelSize));
+        return nil;
+    }
+    @synchronized (self) {
+        scaledVariants += 1;
+        variantSourceBytes += data.length;
+        variantBytes += variant.length;
+    }
+    NSString *key = [self cacheKeyForURL:urlToFetch pixelSize:pixelSize];
+    [[self diskCache] storeData:variant forKey:key];
+    return [self cacheDecodedImageWithData:variant forKey:key scale:[UIScreen mainScreen].scale];
+}
+
++ (UIImage *)cacheDecodedImageWithData:(NSData *)data forKey:(NSString *)key scale:(CGFloat)scale {
+    // decode now so that main queue only blits the bitmap
+    UIImage *image = [self decodedImageWithData:data scale:scale];
+    if (image) {
+        [[self memoryCache] setImage:image forKey:key];
+    }
+    return image;
+}
+
++ (NSString *)cacheKeyForURL:(NSURL *)urlToFetch pixelSize:(CGSize)pixelSize {
+    if (CGSizeEqualToSize(pixelSize, CGSizeZero)) {
+        return [urlToFetch absoluteString];
+    }
+    @synchronized (self) {
+        if (!variantSizes) {
+            variantSizes = [NSMutableSet set];
+        }
+        [variantSizes addObject:[NSValue valueWithCGSize:pixelSize]];
+    }
+    return [NSString stringWithFormat:@"%@#%.0fx%.0f", [urlToFetch absoluteString], pixelSize.width, pixelSize.height];
+}
+
++ (id)coalescedResultForKey:(NSString *)key loader:(id (^)(void))loader {
+    ImageFetchInFlight *fetch;
+    BOOL leader = NO;
+    @synchronized (self) {
+        if (!inFlightFetches) {
+            inFlightFetches = [NSMutableDictionary dictionary];
+        }
+        fetch = inFlightFetches[key];
+        if (fetch) {
+            coalescedRequests += 1;
+        } else {
+            fetch = [[ImageFetchInFlight alloc] init];
+            fetch.group = dispatch_group_create();
+            dispatch_group_enter(fetch.group);
+            inFlightFetches[key] = fetch;
+            leader = YES;
+        }
+    }
+    if (!leader) {
+        // wait for the caller which started the fetch
+        dispatch_group_wait(fetch.group, DISPATCH_TIME_FOREVER);
+        return fetch.result;
+    }
+
+    fetch.result = loader();
+    @synchronized (self) {
+        [inFlightFetches removeObjectForKey:key];
+    }
+    dispatch_group_leave(fetch.group);
+    return fetch.result;
+}
+
++ (UIImage *)decodedImageWithData:(NSData *)data scale:(CGFloat)scale {
+    UIImage *image = [UIImage imageWithData:data scale:scale];
+    CGImageRef cgImage = image.CGImage;
+    if (!cgImage) {
+        return image;
+    }
+    size_t width = CGImageGetWidth(cgImage);
+    size_t height = CGImageGetHeight(cgImage);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace,
+                                                 kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        return image;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), cgImage);
+    CGImageRef decodedImage = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    if (!decodedImage) {
+        return image;
+    }
+    UIImage *result = [UIImage imageWithCGImage:decodedImage scale:image.scale orientation:image.imageOrientation];
+    CGImageRelease(decodedImage);
+    return result;
+}
+
 + (UIImage *)scaleImage:(UIImage *)image toSize:(CGSize)newSize {
     CGSize scaledSize = newSize;
     float scaleFactor = 1.0;
@@ -41,75 +362,63 @@
 }
 
 + (NSData *)getDataFromImageURL:(NSURL *)urlToFetch {
-    NSFileManager *fileManager = [NSFileManager defaultManager];
-    NSURL *cacheFileURL = [self cacheFileURL:urlToFetch];
-    
-    if ([fileManager fileExistsAtPath:[cacheFileURL path]]) {
+    if (!urlToFetch) {
+        return nil;
+    }
+    // concurrent callers share single download and cache write
+    return [self coalescedResultForKey:[@"data:" stringByAppendingString:[urlToFetch absoluteString]] loader:^id{
+        return [self loadDataFromImageURL:urlToFetch];
+    }];
+}
+
++ (NSData *)loadDataFromImageURL:(NSURL *)urlToFetch {
+    NSString *key = [urlToFetch absoluteString];
+    NSData *cachedData = [[self diskCache] dataForKey:key];
+    if (cachedData) {
         // Cache hit!
-        return [[NSData alloc] initWithContentsOfURL:cacheFileURL];
+        @synchronized (self) {
+            diskHits += 1;
+        }
+        return cachedData;
     }
     
-    // Retrieve the data from the internet
-    NSData *imageData = [[NSData alloc] initWithContentsOfURL:urlToFetch];
-    
-    // Create the cache directory, if needed
-    NSURL *cacheDirectory = [self cacheDirectory];
-    NSError *error;
-    if (![fileManager fileExistsAtPath:[cacheDirectory path]]) {
-        [fileManager createDirectoryAtURL:cacheDirectory
-              withIntermediateDirectories:YES
-                               attributes:nil
-                                    error:&error];
-        if (error) {
-            NSLog(@"Received an error trying to create a directory %@", [error localizedDescription]);
-        }
+    NSData *imageData = [self downloadDataFromImageURL:urlToFetch];
+    if (!imageData) {
+        return nil;
     }
-    error = nil;
     
     // Write the image to our cache
-    [imageData writeToURL:cacheFileURL options:NSDataWritingAtomic error:&error];
-    if (error) {
-        NSLog(@"Received an error trying to save a cached file %@", [error localizedDescription]);
-    }
+    [[self diskCache] storeData:imageData forKey:key];
     return imageData;
 }
 
-+ (void) removeCacheHitForURL:(NSURL *)urlToFetch {
-    NSFileManager *fileManager = [NSFileManager defaultManager];
-    NSURL *cacheFileURL = [self cacheFileURL:urlToFetch];
-    
-    if ([fileManager fileExistsAtPath:[cacheFileURL path]]) {
-        NSError *error;
-        if (![fileManager removeItemAtURL:cacheFileURL error:&error]) {
-            NSLog(@"Failed to delete cache record, reason: %@", error);
-        }
++ (NSData *)downloadDataFromImageURL:(NSURL *)urlToFetch {
+    // Retrieve the data from the internet
+    NSData *imageData = [[NSData alloc] initWithContentsOfURL:urlToFetch];
+    @synchronized (self) {
+        networkFetches += 1;
     }
+    return imageData;
 }
 
-+ (NSURL* ) cacheFileURL:(NSURL*)urlToFetch {
-    NSString *cacheFileName = [self sha1HashForString:[urlToFetch absoluteString]];
-    NSURL *cacheDirectory = [self cacheDirectory];
-    return [cacheDirectory URLByAppendingPathComponent:cacheFileName];
-}
-
-+ (NSURL* ) cacheDirectory {
-    NSFileManager *fileManager = [NSFileManager defaultManager];
-    return [[[fileManager URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] lastObject]
-     URLByAppendingPathComponent:@"thumbnails"];
-}
-
-+ (NSString *)sha1HashForString: (NSString *) input {
-    NSData *data = [input dataUsingEncoding:NSUTF8StringEncoding];
-    
-    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
-    
-    CC_SHA1([data bytes], (CC_LONG)[data length], digest);
++ (void) removeCacheHitForURL:(NSURL *)urlToFetch {
+    NSString *key = [urlToFetch absoluteString];
+    if (!key) {
+        return;
+    }
+    [[self memoryCache] removeImageForKey:key];
+    [[self diskCache] removeDataForKey:key];
     
-    NSMutableString *hash = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH*2];
-    for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
-        [hash appendFormat:@"%02x", digest[i]];
+    // variants of sizes not requested in this session are left to eviction
+    NSSet<NSValue *> *sizes;
+    @synchronized (self) {
+        sizes = [variantSizes copy];
+    }
+    for (NSValue *size in sizes) {
+        NSString *variantKey = [self cacheKeyForURL:urlToFetch pixelSize:[size CGSizeValue]];
+        [[self memoryCache] removeImageForKey:variantKey];
+        [[self diskCache] removeDataForKey:variantKey];
     }
-    return hash;
 }
 
 @end
\ No newline at end of file
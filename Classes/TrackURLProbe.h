@@ -0,0 +1,77 @@
+//
+//  TrackURLProbe.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+#import <Bolts/Bolts.h>
+
+#import "CVCoreDataController.h"
+#import "CVMediaTrack.h"
+
+/**
+ * The result of single URL probe
+ */
+@interface TrackProbeResult : NSObject
+
+// The probed URL
+@property (nonatomic, strong, readonly) NSURL *__nonnull URL;
+// The final URL after all redirects
+@property (nonatomic, strong, readonly) NSURL *__nonnull resolvedURL;
+// The length of content in bytes or zero if server did not tell it
+@property (nonatomic, assign, readonly) long long contentLength;
+// The MIME type of content
+@property (nonatomic, copy, readonly) NSString *__nullable contentType;
+// The time from sending request to receiving headers of the final response
+@property (nonatomic, assign, readonly) NSTimeInterval latency;
+
+@end
+
+/**
+ * The service resolving track addresses before playback. Every track URL is requested with
+ * Range: bytes=0-0, redirects are followed and the request is cancelled as soon as headers of the final
+ * response arrive, so the final URL, content length and type are known without downloading media.
+ * When several candidate URLs answer, the one with the lowest latency wins. Results are stored in
+ * media track and used as playback URL until they expire.
+ *
+ * Service may be used from any queue, tasks are completed on main queue.
+ */
+@interface TrackURLProbe : NSObject
+
+// The time while resolved URL is used for playback, one hour by default
+@property (nonatomic, assign) NSTimeInterval resolvedLifetime;
+// The timeout of single probe, 10 sec by default
+@property (nonatomic, assign) NSTimeInterval timeout;
+
+/*!
+ Creates probe service.
+
+ @param dataController The controller to store probe results with
+ @param configuration The configuration of session to probe URLs with
+ */
+- (instancetype __nonnull) initWithDataController: (CVCoreDataController *__nonnull)dataController
+                             sessionConfiguration: (NSURLSessionConfiguration *__nonnull)configuration;
+
+/*!
+ Probes single URL.
+ @return BFTask completed with TrackProbeResult or failed if URL does not lead to media
+ */
+- (BFTask *__nonnull) probeURL: (NSURL *__nonnull)url;
+
+/*!
+ Probes candidate URLs of the same content at once.
+ @return BFTask completed with the TrackProbeResult of the lowest latency or failed if none of URLs answered
+ */
+- (BFTask *__nonnull) probeURLs: (NSArray<NSURL *> *__nonnull)urls;
+
+/*!
+ Resolves track address unless track has fresh resolved URL and stores results in track. The track
+ address and its previously resolved URL are probed as candidates. Concurrent probes of the same track
+ are joined.
+ @return BFTask completed with TrackProbeResult or nil if track is fresh
+ */
+- (BFTask *__nonnull) probeTrack: (CVMediaTrack *__nonnull)track;
+
+@end
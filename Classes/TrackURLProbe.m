@@ -0,0 +1,258 @@
+//
+//  TrackURLProbe.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "TrackURLProbe.h"
+
+#import "CVMediaTrack+CoreDataProperties.h"
+
+// The defaults of probe
+static const NSTimeInterval kDefaultResolvedLifetime = 60 * 60;
+static const NSTimeInterval kDefaultTimeout = 10.0;
+
+static NSString *const kTrackURLProbeErrorDomain = @"TrackURLProbeError";
+
+@interface TrackProbeResult ()
+
+@property (nonatomic, strong, readwrite) NSURL *URL;
+@property (nonatomic, strong, readwrite) NSURL *resolvedURL;
+@property (nonatomic, assign, readwrite) long long contentLength;
+@property (nonatomic, copy, readwrite) NSString *contentType;
+@property (nonatomic, assign, readwrite) NSTimeInterval latency;
+
+@end
+
+@implementation TrackProbeResult
+
+- (NSString *) description {
+    return [NSString stringWithFormat:@"%@ -> %@, %lld bytes of %@ in %.3f sec",
+            self.URL, self.resolvedURL, self.contentLength, self.contentType, self.latency];
+}
+
+@end
+
+@interface TrackURLProbe () <NSURLSessionDataDelegate>
+
+@end
+
+@implementation TrackURLProbe {
+    CVCoreDataController *_dataController;
+    NSURLSession *_session;
+    // The queue of session callbacks and running probes
+    dispatch_queue_t _queue;
+    // The handlers, start times and responses of running probes keyed by task identifier
+    NSMutableDictionary<NSNumber *, void (^)(NSHTTPURLResponse *, CFAbsoluteTime, NSError *)> *_handlers;
+    NSMutableDictionary<NSNumber *, NSNumber *> *_startTimes;
+    NSMutableDictionary<NSNumber *, NSHTTPURLResponse *> *_responses;
+    NSMutableDictionary<NSNumber *, NSNumber *> *_responseTimes;
+    // The running probes of tracks keyed by object ID, used from main queue only
+    NSMutableDictionary<NSManagedObjectID *, BFTask *> *_trackProbes;
+}
+
+- (instancetype) initWithDataController: (CVCoreDataController *)dataController
+                   sessionConfiguration: (NSURLSessionConfiguration *)configuration {
+    self = [super init];
+    if (self) {
+        _dataController = dataController;
+        _resolvedLifetime = kDefaultResolvedLifetime;
+        _timeout = kDefaultTimeout;
+        _queue = dispatch_queue_create("TrackURLProbe", DISPATCH_QUEUE_SERIAL);
+        _handlers = [NSMutableDictionary dictionary];
+        _startTimes = [NSMutableDictionary dictionary];
+        _responses = [NSMutableDictionary dictionary];
+        _responseTimes = [NSMutableDictionary dictionary];
+        _trackProbes = [NSMutableDictionary dictionary];
+
+        NSURLSessionConfiguration *config = [configuration copy];
+        config.URLCache = nil;
+        NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+        delegateQueue.underlyingQueue = _queue;
+        delegateQueue.maxConcurrentOperationCount = 1;
+        _session = [NSURLSession sessionWithConfiguration:config delegate:self delegateQueue:delegateQueue];
+    }
+    return self;
+}
+
+- (BFTask *) probeURL: (NSURL *)url {
+    return [[self startProbeOfURL:url] continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *task) {
+        return task;
+    }];
+}
+
+- (BFTask *) probeURLs: (NSArray<NSURL *> *)urls {
+    NSMutableArray<BFTask *> *probes = [NSMutableArray arrayWithCapacity:urls.count];
+    for (NSURL *url in [[NSOrderedSet orderedSetWithArray:urls] array]) {
+        [probes addObject:[self startProbeOfURL:url]];
+    }
+    if (probes.count == 0) {
+        return [BFTask taskWithError:[self errorWithCode:NSURLErrorBadURL description:@"No URL to probe"]];
+    }
+    return [[BFTask taskForCompletionOfAllTasks:probes] continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *task) {
+        TrackProbeResult *fastest = nil;
+        NSError *lastError = nil;
+        for (BFTask *probe in probes) {
+            TrackProbeResult *result = probe.result;
+            if (!result) {
+                lastError = probe.error ?: lastError;
+            } else if (!fastest || result.latency < fastest.latency) {
+                fastest = result;
+            }
+        }
+        return fastest ? [BFTask taskWithResult:fastest] : [BFTask taskWithError:lastError];
+    }];
+}
+
+- (BFTask *) probeTrack: (CVMediaTrack *)track {
+    NSAssert([NSThread isMainThread], @"Tracks must be probed from main queue");
+    NSManagedObjectID *objectID = track.objectID;
+    BFTask *running = _trackProbes[objectID];
+    if (running) {
+        return running;
+    }
+    if ([track hasFreshResolvedURL] || ![track trackURL]) {
+        return [BFTask taskWithResult:nil];
+    }
+    NSMutableArray<NSURL *> *candidates = [NSMutableArray arrayWithObject:[track trackURL]];
+    NSURL *previousURL = track.resolvedAddress ? [NSURL URLWithString:track.resolvedAddress] : nil;
+    if (previousURL) {
+        // expired redirect target may still serve content and skip the redirect chain
+        [candidates addObject:previousURL];
+    }
+
+    NSTimeInterval lifetime = self.resolvedLifetime;
+    BFTask *probe = [[self probeURLs:candidates] continueWithSuccessBlock:^id (BFTask *task) {
+        TrackProbeResult *result = task.result;
+        return [[_dataController performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+            CVMediaTrack *probed = [context existingObjectWithID:objectID error:error];
+            if (!probed) {
+                return nil;
+            }
+            probed.resolvedAddress = result.resolvedURL.absoluteString;
+            probed.resolvedExpiry = [NSDate dateWithTimeIntervalSinceNow:lifetime];
+            if (result.contentLength > 0) {
+                probed.contentLength = @(result.contentLength);
+            }
+            if (result.contentType) {
+                probed.contentType = result.contentType;
+            }
+            return result;
+        }] continueWithSuccessBlock:^id (BFTask *stored) {
+            return result;
+        }];
+    }];
+    _trackProbes[objectID] = probe;
+    [probe continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *task) {
+        [_trackProbes removeObjectForKey:objectID];
+        if (task.faulted) {
+            NSLog(@"Failed to probe track: %@, reason: %@", candidates.firstObject, task.error ?: task.exception);
+        }
+        return nil;
+    }];
+    return probe;
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    NSNumber *taskID = @(dataTask.taskIdentifier);
+    if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+        _responses[taskID] = (NSHTTPURLResponse *)response;
+        _responseTimes[taskID] = @(CFAbsoluteTimeGetCurrent());
+    }
+    // headers of the final response is all we need, media is not downloaded
+    completionHandler(NSURLSessionResponseCancel);
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    NSNumber *taskID = @(task.taskIdentifier);
+    void (^handler)(NSHTTPURLResponse *, CFAbsoluteTime, NSError *) = _handlers[taskID];
+    NSHTTPURLResponse *response = _responses[taskID];
+    CFAbsoluteTime latency = [_responseTimes[taskID] doubleValue] - [_startTimes[taskID] doubleValue];
+    [_handlers removeObjectForKey:taskID];
+    [_startTimes removeObjectForKey:taskID];
+    [_responses removeObjectForKey:taskID];
+    [_responseTimes removeObjectForKey:taskID];
+    if (handler) {
+        handler(response, latency, response ? nil : error);
+    }
+}
+
+#pragma mark - private
+
+/**
+ * Starts probe of URL, the returned task is completed on probe queue
+ */
+- (BFTask *) startProbeOfURL: (NSURL *)url {
+    BFTaskCompletionSource *source = [BFTaskCompletionSource taskCompletionSource];
+    NSTimeInterval timeout = self.timeout;
+    dispatch_async(_queue, ^{
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL: url
+                                                               cachePolicy: NSURLRequestReloadIgnoringLocalCacheData
+                                                           timeoutInterval: timeout];
+        // servers which do not support HEAD still answer ranged GET, and range support is what player needs
+        [request setValue:@"bytes=0-0" forHTTPHeaderField:@"Range"];
+        NSURLSessionDataTask *task = [_session dataTaskWithRequest:request];
+        NSNumber *taskID = @(task.taskIdentifier);
+        _handlers[taskID] = ^(NSHTTPURLResponse *response, CFAbsoluteTime latency, NSError *error) {
+            [self completeProbeOfURL:url response:response latency:latency error:error source:source];
+        };
+        _startTimes[taskID] = @(CFAbsoluteTimeGetCurrent());
+        [task resume];
+    });
+    return source.task;
+}
+
+- (void) completeProbeOfURL: (NSURL *)url
+                   response: (NSHTTPURLResponse *)response
+                    latency: (CFAbsoluteTime)latency
+                      error: (NSError *)error
+                     source: (BFTaskCompletionSource *)source {
+    if (!response) {
+        [source setError:error ?: [self errorWithCode:NSURLErrorBadServerResponse description:@"No response"]];
+        return;
+    }
+    if (response.statusCode >= 400) {
+        [source setError:[self errorWithCode:NSURLErrorBadServerResponse
+                                 description:[NSHTTPURLResponse localizedStringForStatusCode:response.statusCode]]];
+        return;
+    }
+    // redirect to login or error page is not the media
+    if ([response.MIMEType hasPrefix:@"text/html"]) {
+        [source setError:[self errorWithCode:NSURLErrorCannotDecodeContentData description:@"Not a media content"]];
+        return;
+    }
+    TrackProbeResult *result = [[TrackProbeResult alloc] init];
+    result.URL = url;
+    result.resolvedURL = response.URL ?: url;
+    result.contentType = response.MIMEType;
+    result.latency = MAX(latency, 0);
+    result.contentLength = [self contentLengthOfResponse:response];
+    [source setResult:result];
+}
+
+/**
+ * Returns total length from Content-Range of partial response or length of the whole content
+ */
+- (long long) contentLengthOfResponse: (NSHTTPURLResponse *)response {
+    NSString *range = [response allHeaderFields][@"Content-Range"];
+    NSRange slash = range ? [range rangeOfString:@"/" options:NSBackwardsSearch] : NSMakeRange(NSNotFound, 0);
+    if (slash.location != NSNotFound) {
+        // total length is unknown if it is *
+        return MAX([[range substringFromIndex:NSMaxRange(slash)] longLongValue], 0);
+    }
+    return response.statusCode == 206 ? 0 : MAX(response.expectedContentLength, 0);
+}
+
+- (NSError *) errorWithCode: (NSInteger)code description: (NSString *)description {
+    return [NSError errorWithDomain: kTrackURLProbeErrorDomain
+                               code: code
+                           userInfo: @{NSLocalizedDescriptionKey: description}];
+}
+
+@end
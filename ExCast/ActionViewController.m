@@ -358,36 +358,34 @@ static int const kSubGenreRow = 3;
 }
 
 - (void) saveMediaRecord {
-    [self.extensionContext completeRequestReturningItems:self.extensionContext.inputItems completionHandler:^(BOOL expired) {
-        if (!expired) {
-            [[self.dataControler saveWithURL: self.pageUrl
-                                       title: self.media.title
-                                 description: [self.textView text]
-                                       genre: self.genres[self.mainGenreIndex]
-                                    subGenre: self.genres[self.subGenreIndex]
-                                thumbnailURL: self.media.thumbnailURL]
-             continueWithBlock:^id _Nullable(BFTask * _Nonnull task) {
-                 // check for error
-                 if (task.error) {
-                     NSLog(@"Failed to save media record, %@\n%@", [task.error localizedDescription], [task.error userInfo]);
-                     
-                     // show error alert
-                     [self showAlertWithTitle:NSLocalizedString(@"Failed to save media record", nil)
-                                      message:[task.error localizedDescription]
-                            completionHandler:^{
-                                // close screen
-                                [self closeScreen];
-                            }];
-                 } else {
-                     NSLog(@"New media record was saved: %@", task.result);
-                     // close screen
-                     [self closeScreen];
-                 }
-                 
-                 return nil;
-             }];
-        }
-    }];
+    // the request is completed only after record was written, the extension may be killed right after it
+    self.doneBarBtn.enabled = NO;
+    [[self.dataControler saveWithURL: self.pageUrl
+                               title: self.media.title
+                         description: [self.textView text]
+                               genre: self.genres[self.mainGenreIndex]
+                            subGenre: self.genres[self.subGenreIndex]
+                        thumbnailURL: self.media.thumbnailURL]
+     continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id _Nullable(BFTask * _Nonnull task) {
+         // check for error
+         if (task.faulted) {
+             NSLog(@"Failed to save media record, %@", task.error ?: task.exception);
+             
+             // show error alert
+             [self showAlertWithTitle:NSLocalizedString(@"Failed to save media record", nil)
+                              message:task.error ? [task.error localizedDescription] : task.exception.reason
+                    completionHandler:^{
+                        // close screen
+                        [self closeScreen];
+                    }];
+         } else {
+             NSLog(@"New media record was saved: %@", task.result);
+             // close screen
+             [self closeScreen];
+         }
+         
+         return nil;
+     }];
 }
 
 @end
@@ -0,0 +1,279 @@
+//
+//  CVCoreDataControllerTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+#import <libkern/OSAtomic.h>
+
+#import "CVCoreDataController.h"
+#import "CVGenreMO.h"
+#import "CVMediaRecordMO.h"
+#import "ExMediaTrack.h"
+#import "XCTestCase+Tasks.h"
+
+@interface CVCoreDataController (Lookups)
+
+- (CVMediaRecordMO *) findRecordByURL: (NSURL *) url inContext: (NSManagedObjectContext *)context;
+- (CVGenreMO *) findGenreByName: (NSString *) name inContext: (NSManagedObjectContext *)context;
+
+@end
+
+@interface CVCoreDataControllerTests : XCTestCase
+
+@end
+
+// The size of store of lookup benchmarks
+static const NSUInteger kLargeStoreRecords = 10000;
+static const NSUInteger kLargeStoreGenres = 40;
+
+@implementation CVCoreDataControllerTests {
+    NSURL *_storeURL;
+}
+
+- (void) setUp {
+    [super setUp];
+    _storeURL = [self temporaryFileURLWithExtension:@"sqlite"];
+}
+
+- (void) tearDown {
+    for (NSString *suffix in @[@"", @"-wal", @"-shm"]) {
+        NSString *path = [[_storeURL path] stringByAppendingString:suffix];
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    }
+    [super tearDown];
+}
+
+#pragma mark - genre counts
+
+- (void) testGenreCountsAreRecountedOnceAndPersisted {
+    CVCoreDataController *controller = [self controllerOfStore];
+    [self saveRecord:@"http://media.test/a" toController:controller genre:@"Drama" subGenre:@"Comedy"];
+    [self saveRecord:@"http://media.test/b" toController:controller genre:@"Drama" subGenre:@"Horror"];
+    [self saveRecord:@"http://media.test/c" toController:controller genre:@"Drama" subGenre:@"Comedy"];
+    // counts of store created before the model had them
+    [self waitForTask:[controller performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSArray<CVGenreMO *> *genres = [context executeFetchRequest:[NSFetchRequest fetchRequestWithEntityName:kGenreEntityName]
+                                                              error:error];
+        for (CVGenreMO *genre in genres) {
+            genre.recordCount = @0;
+        }
+        return genres;
+    }]];
+
+    XCTAssertEqualObjects([self waitForTask:[controller updateGenreCountsIfNeeded]].result, @YES);
+    NSDictionary *expected = @{@"Drama": @3, @"Comedy": @2, @"Horror": @1};
+    [self assertCounts:expected ofController:controller];
+    XCTAssertEqualObjects([self waitForTask:[controller updateGenreCountsIfNeeded]].result, @NO);
+
+    // recount is not repeated by the next launch
+    CVCoreDataController *reopened = [self controllerOfStore];
+    XCTAssertEqualObjects([self waitForTask:[reopened updateGenreCountsIfNeeded]].result, @NO);
+    [self assertCounts:expected ofController:reopened];
+}
+
+- (void) testConcurrentSavesKeepGenreCounts {
+    CVCoreDataController *controller = [self controllerOfStore];
+    // genres exist before, concurrent saves would create them twice otherwise
+    [self saveRecord:@"http://media.test/comedy" toController:controller genre:@"Drama" subGenre:@"Comedy"];
+    [self saveRecord:@"http://media.test/horror" toController:controller genre:@"Drama" subGenre:@"Horror"];
+    // sibling contexts save at once, all of them read the same counts
+    NSMutableArray<BFTask *> *saves = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 50; i++) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://media.test/%lu", (unsigned long)i]];
+        [saves addObject:[controller saveWithURL: url
+                                           title: url.absoluteString
+                                     description: nil
+                                           genre: @"Drama"
+                                        subGenre: i % 2 ? @"Comedy" : @"Horror"
+                                    thumbnailURL: [url URLByAppendingPathComponent:@"thumbnail.jpg"]]];
+    }
+    XCTAssertFalse([self waitForTask:[BFTask taskForCompletionOfAllTasks:saves]].faulted);
+    [self assertCounts:@{@"Drama": @52, @"Comedy": @26, @"Horror": @26} ofController:controller];
+
+    NSMutableArray<BFTask *> *deletes = [NSMutableArray array];
+    for (CVMediaRecordMO *record in [self waitForTask:[controller listMediaRecordsInGenresAsync:@[@"Horror"]]].result) {
+        [deletes addObject:[controller deleteMediaRecordAsync:record]];
+    }
+    XCTAssertEqual(deletes.count, 26);
+    XCTAssertFalse([self waitForTask:[BFTask taskForCompletionOfAllTasks:deletes]].faulted);
+    [self assertCounts:@{@"Drama": @26, @"Comedy": @26, @"Horror": @0} ofController:controller];
+}
+
+#pragma mark - lookups
+
+- (void) testRecordLookupPerformanceIn10kStore {
+    CVCoreDataController *controller = [self controllerOfLargeStore];
+    NSManagedObjectContext *context = [controller newBackgroundContext];
+    [self measureBlock:^{
+        [context performBlockAndWait:^{
+            for (NSUInteger i = 0; i < 1000; i++) {
+                NSUInteger index = (i * 7919) % kLargeStoreRecords;
+                NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://media.test/%lu", (unsigned long)index]];
+                XCTAssertNotNil([controller findRecordByURL:url inContext:context]);
+            }
+            [context reset];
+        }];
+    }];
+}
+
+- (void) testGenreLookupPerformanceIn10kStore {
+    CVCoreDataController *controller = [self controllerOfLargeStore];
+    NSManagedObjectContext *context = [controller newBackgroundContext];
+    [self measureBlock:^{
+        [context performBlockAndWait:^{
+            for (NSUInteger i = 0; i < 10000; i++) {
+                NSString *name = [NSString stringWithFormat:@"Genre %lu", (unsigned long)(i % kLargeStoreGenres)];
+                XCTAssertNotNil([controller findGenreByName:name inContext:context]);
+            }
+            [context reset];
+        }];
+    }];
+}
+
+#pragma mark - tracks
+
+- (void) testReplaceTracksPerformance {
+    CVCoreDataController *controller = [self controllerOfStore];
+    [self saveRecord:@"http://media.test/series" toController:controller genre:@"Drama" subGenre:@"Comedy"];
+    CVMediaRecordMO *record = [[self waitForTask:[controller listMediaRecordsAsync]].result firstObject];
+    // the next list of long series keeps half of tracks, renames a quarter and adds the rest
+    NSArray<ExMediaTrack *> *first = [self tracksFrom:0 count:500 named:@"Episode"];
+    NSArray<ExMediaTrack *> *second = [[[self tracksFrom:250 count:125 named:@"Episode"]
+                                        arrayByAddingObjectsFromArray:[self tracksFrom:375 count:125 named:@"Renamed"]]
+                                       arrayByAddingObjectsFromArray:[self tracksFrom:500 count:250 named:@"Episode"]];
+    const NSUInteger replacements = 10;
+    // the store of tracks one by one costs a transaction per track, so it is repeated less
+    const NSUInteger baselineReplacements = 2;
+    __block int32_t transactions = 0;
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName: NSManagedObjectContextDidSaveNotification
+                                                                    object: nil
+                                                                     queue: nil
+                                                                usingBlock: ^(NSNotification *notification) {
+        // only writer saves reach the store
+        if (![(NSManagedObjectContext *)notification.object parentContext]) {
+            OSAtomicIncrement32(&transactions);
+        }
+    }];
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        // baseline: delete all tracks and create every track in its own task, as tracks were stored before
+        transactions = 0;
+        CFAbsoluteTime started = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < baselineReplacements; i++) {
+            XCTAssertFalse([self waitForTask:[controller deleteMediaTracksForRecordAsync:record]].faulted);
+            NSMutableArray<BFTask *> *creates = [NSMutableArray array];
+            for (ExMediaTrack *track in i % 2 ? second : first) {
+                [creates addObject:[controller createTrackWithURL:track.url title:track.name forRecord:record]];
+            }
+            XCTAssertFalse([self waitForTask:[BFTask taskForCompletionOfAllTasks:creates] timeout:120].faulted);
+        }
+        CFAbsoluteTime baselineTime = (CFAbsoluteTimeGetCurrent() - started) / baselineReplacements;
+        int32_t baselineTransactions = transactions / (int32_t)baselineReplacements;
+
+        transactions = 0;
+        started = CFAbsoluteTimeGetCurrent();
+        [self startMeasuring];
+        for (NSUInteger i = 0; i < replacements; i++) {
+            BFTask *task = [self waitForTask:[controller replaceTracks:i % 2 ? second : first forRecord:record]];
+            XCTAssertNotNil(task.result, @"%@", task.error ?: task.exception);
+        }
+        [self stopMeasuring];
+        CFAbsoluteTime replaceTime = (CFAbsoluteTimeGetCurrent() - started) / replacements;
+        XCTAssertEqual(transactions, replacements, @"Every replacement is single store transaction");
+        XCTAssertGreaterThan(baselineTransactions, 1, @"Tracks stored one by one are stored in %d transactions", baselineTransactions);
+        XCTAssertLessThan(replaceTime, baselineTime, @"Replacement takes %.1f ms, storing tracks one by one takes %.1f ms",
+                          replaceTime * 1000, baselineTime * 1000);
+    }];
+    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+
+    NSNumber *count = [self waitForTask:[controller performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        CVMediaRecordMO *stored = [context existingObjectWithID:record.objectID error:error];
+        return @(stored.tracks.count);
+    }]].result;
+    XCTAssertEqualObjects(count, @500);
+}
+
+#pragma mark - private
+
+- (NSArray<ExMediaTrack *> *) tracksFrom: (NSUInteger)first count: (NSUInteger)count named: (NSString *)name {
+    NSMutableArray<ExMediaTrack *> *tracks = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = first; i < first + count; i++) {
+        ExMediaTrack *track = [[ExMediaTrack alloc] init];
+        track.identifier = i;
+        track.mimeType = @"video/mp4";
+        track.name = [NSString stringWithFormat:@"%@ %lu", name, (unsigned long)i];
+        track.url = [NSURL URLWithString:[NSString stringWithFormat:@"http://media.test/get/%lu", (unsigned long)i]];
+        [tracks addObject:track];
+    }
+    return tracks;
+}
+
+- (CVCoreDataController *) controllerOfStore {
+    return [[CVCoreDataController alloc] initWithStoreType:NSSQLiteStoreType URL:_storeURL];
+}
+
+/**
+ * Returns controller of store with kLargeStoreRecords records spread over kLargeStoreGenres genres
+ */
+- (CVCoreDataController *) controllerOfLargeStore {
+    CVCoreDataController *controller = [self controllerOfStore];
+    __block NSUInteger inserted = 0;
+    __block NSArray<NSManagedObjectID *> *genreIDs = nil;
+    BFTask *task = [self waitForTask:[controller performBatchedBackgroundTask:^BOOL (NSManagedObjectContext *context, BOOL *stop, NSError **error) {
+        // batches reset context, so genres of the first batch are refetched by ID
+        NSMutableArray<CVGenreMO *> *batchGenres = [NSMutableArray arrayWithCapacity:kLargeStoreGenres];
+        for (NSUInteger i = 0; i < kLargeStoreGenres; i++) {
+            CVGenreMO *genre = genreIDs ? [context existingObjectWithID:genreIDs[i] error:error] : nil;
+            if (!genre) {
+                genre = [NSEntityDescription insertNewObjectForEntityForName:kGenreEntityName inManagedObjectContext:context];
+                genre.name = [NSString stringWithFormat:@"Genre %lu", (unsigned long)i];
+            }
+            [batchGenres addObject:genre];
+        }
+        for (NSUInteger end = MIN(inserted + 1000, kLargeStoreRecords); inserted < end; inserted++) {
+            CVMediaRecordMO *record = [NSEntityDescription insertNewObjectForEntityForName:kMediaRecordEntityName
+                                                                    inManagedObjectContext:context];
+            record.pageUrl = [NSString stringWithFormat:@"http://media.test/%lu", (unsigned long)inserted];
+            record.title = record.pageUrl;
+            record.thumbnailUrl = [record.pageUrl stringByAppendingString:@"/thumbnail.jpg"];
+            record.mimeType = @"video/mp4";
+            record.dateAdded = [NSDate date];
+            record.genres = [NSOrderedSet orderedSetWithObject:batchGenres[inserted % kLargeStoreGenres]];
+        }
+        if (!genreIDs) {
+            if (![context obtainPermanentIDsForObjects:batchGenres error:error]) {
+                return NO;
+            }
+            genreIDs = [batchGenres valueForKey:@"objectID"];
+        }
+        *stop = inserted >= kLargeStoreRecords;
+        return YES;
+    }] timeout:120];
+    XCTAssertFalse(task.faulted, @"%@", task.error ?: task.exception);
+    return controller;
+}
+
+- (void) saveRecord: (NSString *)address
+       toController: (CVCoreDataController *)controller
+              genre: (NSString *)genre
+           subGenre: (NSString *)subGenre {
+    NSURL *url = [NSURL URLWithString:address];
+    BFTask *task = [self waitForTask:[controller saveWithURL: url
+                                                       title: address
+                                                 description: nil
+                                                       genre: genre
+                                                    subGenre: subGenre
+                                                thumbnailURL: [url URLByAppendingPathComponent:@"thumbnail.jpg"]]];
+    XCTAssertNotNil(task.result, @"%@", task.error ?: task.exception);
+}
+
+- (void) assertCounts: (NSDictionary<NSString *, NSNumber *> *)expected ofController: (CVCoreDataController *)controller {
+    NSDictionary<NSString *, NSNumber *> *counts = [self waitForTask:[controller genreCountsAsync]].result;
+    [expected enumerateKeysAndObjectsUsingBlock:^(NSString *genre, NSNumber *count, BOOL *stop) {
+        XCTAssertEqualObjects(counts[genre], count, @"count of %@", genre);
+    }];
+}
+
+@end
@@ -0,0 +1,170 @@
+//
+//  CVLibraryTransferTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "CVLibraryTransfer.h"
+#import "CVMediaRecordMO+CoreDataProperties.h"
+#import "CVMediaTrack+CoreDataProperties.h"
+#import "ExPageCache.h"
+#import "PlaybackPositionStore.h"
+#import "StubURLProtocol.h"
+#import "XCTestCase+Tasks.h"
+
+@interface CVLibraryTransferTests : XCTestCase
+
+@end
+
+@implementation CVLibraryTransferTests {
+    NSURL *_libraryURL;
+    NSURL *_cacheURL;
+}
+
+- (void) setUp {
+    [super setUp];
+    [StubURLProtocol reset];
+    _libraryURL = [self temporaryFileURLWithExtension:@"ndjson"];
+    _cacheURL = [self temporaryFileURLWithExtension:@"cache"];
+}
+
+- (void) tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:_libraryURL error:nil];
+    [[NSFileManager defaultManager] removeItemAtURL:_cacheURL error:nil];
+    [StubURLProtocol reset];
+    [super tearDown];
+}
+
+- (void) testStubRecordsAreCompletedFromTheirPages {
+    NSURL *page = [NSURL URLWithString:@"http://ex.test/view/1"];
+    NSURL *brokenPage = [NSURL URLWithString:@"http://ex.test/view/2"];
+    NSURL *basic = [[NSBundle bundleForClass:[self class]] URLForResource:@"basic" withExtension:@"html" subdirectory:@"Pages"];
+    [StubURLProtocol stubURL: page
+               withResponses: @[[StubResponse responseWithStatus: 200
+                                                         headers: @{@"Content-Type": @"text/html; charset=utf-8"}
+                                                            body: [NSData dataWithContentsOfURL:basic]]]];
+    [StubURLProtocol stubURL: brokenPage
+               withResponses: @[[StubResponse responseWithError:[NSError errorWithDomain: NSURLErrorDomain
+                                                                                   code: NSURLErrorTimedOut
+                                                                               userInfo: nil]]]];
+    CVCoreDataController *controller = [self scratchDataController];
+    CVLibraryTransfer *transfer = [self transferWithController:controller];
+    [self writeLibraryLines:@[@"{\"format\":\"castvideos-library\",\"version\":1}",
+                              [NSString stringWithFormat:@"{\"pageUrl\":\"%@\"}", page],
+                              [NSString stringWithFormat:@"{\"pageUrl\":\"%@\"}", brokenPage],
+                              @"{\"pageUrl\":\"http://ex.test/view/3\",\"title\":\"Known\",\"thumbnailUrl\":\"http://img.test/3.jpg\"}"]];
+    XCTAssertEqualObjects([self waitForTask:[transfer importFromURL:_libraryURL]].result, @3);
+
+    BFTask *completed = [self waitForTask:[transfer completeStubRecords]];
+    XCTAssertEqualObjects(completed.result, @1);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:[NSURL URLWithString:@"http://ex.test/view/3"]], 0,
+                   @"Complete records are not loaded");
+
+    NSDictionary *records = [self recordsOfController:controller];
+    XCTAssertEqualObjects(records[page.absoluteString], (@[@"Doctor Who", @"http://img.test/poster.jpg"]));
+    XCTAssertEqualObjects(records[brokenPage.absoluteString], (@[brokenPage.absoluteString, @""]),
+                          @"Record stays stub until its page loads");
+    XCTAssertEqualObjects(records[@"http://ex.test/view/3"], (@[@"Known", @"http://img.test/3.jpg"]));
+
+    // the next run loads only pages still missing
+    [StubURLProtocol reset];
+    [StubURLProtocol stubURL:brokenPage withResponses:@[[StubResponse responseWithStatus: 200
+                                                                                headers: @{@"Content-Type": @"text/html; charset=utf-8"}
+                                                                                   body: [NSData dataWithContentsOfURL:basic]]]];
+    XCTAssertEqualObjects([self waitForTask:[transfer completeStubRecords]].result, @1);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:page], 0);
+}
+
+- (void) testExportIncludesPendingPlaybackPositions {
+    CVCoreDataController *controller = [self scratchDataController];
+    CVLibraryTransfer *transfer = [self transferWithController:controller];
+    [self writeLibraryLines:@[@"{\"format\":\"castvideos-library\",\"version\":1}",
+                              @"{\"pageUrl\":\"http://ex.test/view/1\",\"title\":\"Record\",\"thumbnailUrl\":\"http://img.test/1.jpg\","
+                              "\"tracks\":[{\"name\":\"Track\",\"address\":\"http://media.test/1.mp4\",\"playTime\":1.5}]}"]];
+    XCTAssertEqualObjects([self waitForTask:[transfer importFromURL:_libraryURL]].result, @1);
+
+    NSURL *journalURL = [self temporaryFileURLWithExtension:@"journal"];
+    PlaybackPositionStore *store = [[PlaybackPositionStore alloc] initWithJournalURL:journalURL dataController:controller];
+    store.flushInterval = 60 * 60;
+    CVMediaTrack *track = [NSEntityDescription insertNewObjectForEntityForName:kMediaTrackEntityName
+                                                        inManagedObjectContext:controller.managedObjectContext];
+    track.address = @"http://media.test/1.mp4";
+    [store setPosition:42 forTrack:track];
+    XCTAssertEqual(store.pendingCount, 1);
+
+    transfer.positionStore = store;
+    XCTAssertEqualObjects([self waitForTask:[transfer exportToURL:_libraryURL]].result, @1);
+    XCTAssertEqual(store.pendingCount, 0);
+    NSArray<NSString *> *lines = [[NSString stringWithContentsOfURL:_libraryURL encoding:NSUTF8StringEncoding error:nil]
+                                  componentsSeparatedByString:@"\n"];
+    XCTAssertGreaterThan(lines.count, 1);
+    NSDictionary *item = [NSJSONSerialization JSONObjectWithData:[lines[1] dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil];
+    XCTAssertEqualObjects([item valueForKeyPath:@"tracks.playTime"], @[@42]);
+    [[NSFileManager defaultManager] removeItemAtURL:journalURL error:nil];
+}
+
+- (void) testImportThroughputOf50kRecords {
+    const NSUInteger count = 50000;
+    NSMutableArray<NSString *> *lines = [NSMutableArray arrayWithCapacity:count + 1];
+    [lines addObject:@"{\"format\":\"castvideos-library\",\"version\":1}"];
+    NSArray<NSString *> *genres = @[@"Drama", @"Comedy", @"Horror", @"Documentary", @"Cartoons"];
+    for (NSUInteger i = 0; i < count; i++) {
+        [lines addObject:[NSString stringWithFormat:
+                          @"{\"pageUrl\":\"http://ex.test/view/%lu\",\"title\":\"Record %lu\",\"thumbnailUrl\":\"http://img.test/%lu.jpg\","
+                          "\"dateAdded\":%lu,\"genres\":[\"%@\"],\"tracks\":[{\"name\":\"Track\",\"address\":\"http://media.test/%lu\",\"playTime\":1.5}]}",
+                          (unsigned long)i, (unsigned long)i, (unsigned long)i, (unsigned long)(1476700000 + i),
+                          genres[i % genres.count], (unsigned long)i]];
+    }
+    [self writeLibraryLines:lines];
+
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        // every pass imports into new SQLite store, which is what the app writes to
+        NSURL *storeURL = [self temporaryFileURLWithExtension:@"sqlite"];
+        CVCoreDataController *controller = [[CVCoreDataController alloc] initWithStoreType:NSSQLiteStoreType URL:storeURL];
+        CVLibraryTransfer *transfer = [[CVLibraryTransfer alloc] initWithDataController:controller];
+        // throughput is count divided by measured time
+        [self startMeasuring];
+        BFTask *task = [self waitForTask:[transfer importFromURL:_libraryURL] timeout:600];
+        [self stopMeasuring];
+        XCTAssertEqualObjects(task.result, @(count));
+        for (NSString *suffix in @[@"", @"-wal", @"-shm"]) {
+            [[NSFileManager defaultManager] removeItemAtPath:[[storeURL path] stringByAppendingString:suffix] error:nil];
+        }
+    }];
+}
+
+#pragma mark - private
+
+- (CVLibraryTransfer *) transferWithController: (CVCoreDataController *)controller {
+    CVLibraryTransfer *transfer = [[CVLibraryTransfer alloc] initWithDataController:controller];
+    ExPageCache *cache = [[ExPageCache alloc] initWithDirectory:_cacheURL];
+    transfer.mediaLoader = [[ExMediaLoader alloc] initWithSessionConfiguration:[StubURLProtocol sessionConfiguration]
+                                                                     pageCache:cache];
+    return transfer;
+}
+
+- (void) writeLibraryLines: (NSArray<NSString *> *)lines {
+    NSString *library = [[lines componentsJoinedByString:@"\n"] stringByAppendingString:@"\n"];
+    XCTAssertTrue([library writeToURL:_libraryURL atomically:YES encoding:NSUTF8StringEncoding error:nil]);
+}
+
+/**
+ * Returns title and thumbnail URL of records keyed by page URL
+ */
+- (NSDictionary<NSString *, NSArray<NSString *> *> *) recordsOfController: (CVCoreDataController *)controller {
+    NSMutableDictionary *records = [NSMutableDictionary dictionary];
+    [self waitForTask:[controller performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSArray<CVMediaRecordMO *> *stored = [context executeFetchRequest:[NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName]
+                                                                    error:error];
+        for (CVMediaRecordMO *record in stored) {
+            records[record.pageUrl] = @[record.title ?: @"", record.thumbnailUrl ?: @""];
+        }
+        return @(stored.count);
+    }]];
+    return records;
+}
+
+@end
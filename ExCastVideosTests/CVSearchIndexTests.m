@@ -0,0 +1,166 @@
+//
+//  CVSearchIndexTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "CVSearchIndex.h"
+#import "XCTestCase+Tasks.h"
+
+@interface CVSearchIndexTests : XCTestCase
+
+@end
+
+@implementation CVSearchIndexTests {
+    NSURL *_indexURL;
+    CVSearchIndex *_index;
+}
+
+- (void) setUp {
+    [super setUp];
+    _indexURL = [self temporaryFileURLWithExtension:@"index"];
+    _index = [[CVSearchIndex alloc] initWithFileURL:_indexURL];
+}
+
+- (void) tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:_indexURL error:nil];
+    [super tearDown];
+}
+
+#pragma mark - folding
+
+- (void) testCyrillicYoIsFoldedToYe {
+    XCTAssertEqualObjects([CVSearchIndex wordsFromString:@"Ёжик"], @[@"ежик"]);
+    XCTAssertEqualObjects([CVSearchIndex wordsFromString:@"ЁЛКИ"], @[@"елки"]);
+}
+
+- (void) testCyrillicShortIIsKept {
+    XCTAssertEqualObjects([CVSearchIndex wordsFromString:@"Йод"], @[@"йод"]);
+    XCTAssertEqualObjects([CVSearchIndex wordsFromString:@"ЧАЙ"], @[@"чай"]);
+}
+
+- (void) testLatinDiacriticsAreFolded {
+    XCTAssertEqualObjects([CVSearchIndex wordsFromString:@"Café Noël"], (@[@"cafe", @"noel"]));
+}
+
+- (void) testYoAndShortIInSearch {
+    [_index indexDocument:@"hedgehog" stamp:1 weightedTexts:@{@"Ёжик в тумане": @10}];
+    [_index indexDocument:@"iodine" stamp:1 weightedTexts:@{@"Йод": @10}];
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"ежик" limit:10], @[@"hedgehog"]);
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"ЁЖ" limit:10], @[@"hedgehog"]);
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"йо" limit:10], @[@"iodine"]);
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"иод" limit:10], @[], @"'й' is not 'и'");
+}
+
+#pragma mark - ranking
+
+- (void) testExactWordOutranksPrefixMatch {
+    [_index indexDocument:@"stargate" stamp:1 weightedTexts:@{@"Stargate": @10}];
+    [_index indexDocument:@"star" stamp:1 weightedTexts:@{@"Star": @10}];
+    [_index indexDocument:@"details" stamp:1 weightedTexts:@{@"Title": @10, @"about a star": @1}];
+    NSArray *expected = @[@"star", @"stargate", @"details"];
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"star" limit:10], expected);
+    // prefix matches of the same weight rank equally above lighter ones
+    NSArray<NSString *> *prefixed = [_index documentsMatchingQuery:@"sta" limit:10];
+    XCTAssertEqual(prefixed.count, 3);
+    XCTAssertEqualObjects([NSSet setWithArray:[prefixed subarrayWithRange:NSMakeRange(0, 2)]],
+                          ([NSSet setWithObjects:@"star", @"stargate", nil]));
+    XCTAssertEqualObjects(prefixed.lastObject, @"details");
+}
+
+- (void) testEveryQueryWordMustMatch {
+    [_index indexDocument:@"trek" stamp:1 weightedTexts:@{@"Star Trek": @10}];
+    [_index indexDocument:@"wars" stamp:1 weightedTexts:@{@"Star Wars": @10}];
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"star tr" limit:10], @[@"trek"]);
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"star x" limit:10], @[]);
+    XCTAssertEqual([_index documentsMatchingQuery:@"star" limit:1].count, 1);
+}
+
+- (void) testReindexedAndRemovedDocumentsDoNotMatch {
+    [_index indexDocument:@"movie" stamp:1 weightedTexts:@{@"Old title": @10}];
+    [_index indexDocument:@"movie" stamp:2 weightedTexts:@{@"New title": @10}];
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"old" limit:10], @[]);
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"new" limit:10], @[@"movie"]);
+    XCTAssertEqualObjects([_index documentStamps], @{@"movie": @2});
+
+    [_index removeDocument:@"movie"];
+    XCTAssertEqualObjects([_index documentsMatchingQuery:@"title" limit:10], @[]);
+    XCTAssertEqual(_index.wordCount, 0);
+}
+
+- (void) testIndexIsReadBackFromFile {
+    [_index indexDocument:@"hedgehog" stamp:7 weightedTexts:@{@"Ёжик в тумане": @10}];
+    [_index synchronize];
+
+    CVSearchIndex *reopened = [[CVSearchIndex alloc] initWithFileURL:_indexURL];
+    XCTAssertEqualObjects([reopened documentsMatchingQuery:@"туман" limit:10], @[@"hedgehog"]);
+    XCTAssertEqualObjects([reopened documentStamps], @{@"hedgehog": @7});
+}
+
+#pragma mark - performance
+
+- (void) testQueryPerformanceOnSyntheticCorpus {
+    NSArray<NSString *> *vocabulary = [self vocabulary];
+    [self indexCorpusOfSize:10000 vocabulary:vocabulary];
+    XCTAssertEqual(_index.documentCount, 10000);
+    [self measureBlock:^{
+        NSUInteger matched = 0;
+        for (NSUInteger i = 0; i < 500; i++) {
+            NSString *word = vocabulary[(i * 31) % vocabulary.count];
+            // short prefixes hit the most postings
+            NSString *query = [NSString stringWithFormat:@"%@ %@", [word substringToIndex:MIN(3, word.length)],
+                               vocabulary[(i * 17) % vocabulary.count]];
+            matched += [_index documentsMatchingQuery:query limit:20].count;
+        }
+        XCTAssertGreaterThan(matched, 0);
+    }];
+}
+
+- (void) testIndexingPerformanceOnSyntheticCorpus {
+    NSArray<NSString *> *vocabulary = [self vocabulary];
+    [self measureBlock:^{
+        _index = [[CVSearchIndex alloc] initWithFileURL:_indexURL];
+        [self indexCorpusOfSize:5000 vocabulary:vocabulary];
+        XCTAssertEqual(_index.documentCount, 5000);
+    }];
+}
+
+#pragma mark - private
+
+/**
+ * Returns words of synthetic titles, Latin and Cyrillic with 'ё' and 'й'
+ */
+- (NSArray<NSString *> *) vocabulary {
+    NSArray<NSString *> *stems = @[@"star", @"gate", @"doctor", @"house", @"night", @"river", @"ёлка", @"чайка",
+                                   @"город", @"ночь", @"мой", @"край", @"зима", @"лето", @"война", @"мир"];
+    NSMutableArray<NSString *> *words = [NSMutableArray array];
+    for (NSString *stem in stems) {
+        for (NSString *suffix in @[@"", @"s", @"er", @"ing", @"ов", @"ами", @"ой"]) {
+            [words addObject:[stem stringByAppendingString:suffix]];
+        }
+    }
+    return words;
+}
+
+- (void) indexCorpusOfSize: (NSUInteger)size vocabulary: (NSArray<NSString *> *)vocabulary {
+    srand48(42);
+    for (NSUInteger i = 0; i < size; i++) {
+        NSMutableArray<NSString *> *title = [NSMutableArray array];
+        NSMutableArray<NSString *> *details = [NSMutableArray array];
+        for (NSUInteger w = 0; w < 4; w++) {
+            [title addObject:vocabulary[lrand48() % vocabulary.count]];
+        }
+        for (NSUInteger w = 0; w < 20; w++) {
+            [details addObject:vocabulary[lrand48() % vocabulary.count]];
+        }
+        [_index indexDocument: [NSString stringWithFormat:@"record-%lu", (unsigned long)i]
+                        stamp: i
+                weightedTexts: @{[title componentsJoinedByString:@" "]: @10,
+                                 [details componentsJoinedByString:@" "]: @1}];
+    }
+}
+
+@end
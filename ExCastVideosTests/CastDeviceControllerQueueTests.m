@@ -0,0 +1,196 @@
+//
+//  CastDeviceControllerQueueTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+#import <GoogleCast/GoogleCast.h>
+
+#import "CastDeviceController.h"
+
+/**
+ * The media control channel recording queue requests instead of sending them to receiver
+ */
+@interface MockMediaControlChannel : GCKMediaControlChannel
+
+// The sent requests: "load" or "insert" with number of items and request ID
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *requests;
+// Whether requests are rejected as if channel was not connected
+@property (nonatomic, assign) BOOL rejectsRequests;
+
+@end
+
+@implementation MockMediaControlChannel {
+    NSInteger _lastRequestID;
+}
+
+- (instancetype) init {
+    self = [super init];
+    if (self) {
+        _requests = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (NSInteger) queueLoadItems: (NSArray<GCKMediaQueueItem *> *)queueItems
+                  startIndex: (NSUInteger)startIndex
+                playPosition: (NSTimeInterval)playPosition
+                  repeatMode: (GCKMediaRepeatMode)repeatMode
+                  customData: (id)customData {
+    return [self recordRequest:@"load" items:queueItems playPosition:playPosition];
+}
+
+- (NSInteger) queueInsertItems: (NSArray<GCKMediaQueueItem *> *)queueItems
+              beforeItemWithID: (NSUInteger)beforeItemID
+                    customData: (id)customData {
+    return [self recordRequest:@"insert" items:queueItems playPosition:0];
+}
+
+- (NSInteger) recordRequest: (NSString *)kind items: (NSArray<GCKMediaQueueItem *> *)items playPosition: (NSTimeInterval)playPosition {
+    if (self.rejectsRequests) {
+        return kGCKInvalidRequestID;
+    }
+    _lastRequestID++;
+    [self.requests addObject:@{@"kind": kind,
+                               @"count": @(items.count),
+                               @"first": items.firstObject.mediaInformation.contentID,
+                               @"position": @(playPosition),
+                               @"id": @(_lastRequestID)}];
+    return _lastRequestID;
+}
+
+@end
+
+@interface CastDeviceControllerQueueTests : XCTestCase
+
+@end
+
+@implementation CastDeviceControllerQueueTests {
+    CastDeviceController *_controller;
+    MockMediaControlChannel *_channel;
+    // The channel delegate the receiver answers are delivered to
+    id<GCKMediaControlChannelDelegate> _receiver;
+    // The results passed to completion of Play All
+    NSMutableArray *_results;
+}
+
+- (void) setUp {
+    [super setUp];
+    _controller = [[CastDeviceController alloc] init];
+    _channel = [[MockMediaControlChannel alloc] init];
+    _controller.mediaControlChannel = _channel;
+    _receiver = (id<GCKMediaControlChannelDelegate>)_controller;
+    _results = [NSMutableArray array];
+}
+
+- (void) testShortListIsLoadedBySingleRequest {
+    [self playAll:[self mediaNamed:@"short" count:5] position:12];
+    XCTAssertEqual(_channel.requests.count, 1);
+    XCTAssertEqualObjects(_channel.requests[0][@"kind"], @"load");
+    XCTAssertEqualObjects(_channel.requests[0][@"count"], @5);
+    XCTAssertEqualObjects(_channel.requests[0][@"position"], @12);
+    XCTAssertEqual(_results.count, 0, @"Completed only when receiver confirmed queue");
+
+    [self completeRequestAtIndex:0];
+    XCTAssertEqualObjects(_results, @[[NSNull null]]);
+}
+
+- (void) testLongListIsSentByChunksAfterConfirmation {
+    [self playAll:[self mediaNamed:@"long" count:45] position:0];
+    XCTAssertEqual(_channel.requests.count, 1, @"Next chunk waits for confirmation");
+
+    [self completeRequestAtIndex:0];
+    [self completeRequestAtIndex:1];
+    XCTAssertEqual(_results.count, 0);
+    [self completeRequestAtIndex:2];
+
+    NSArray *kinds = [_channel.requests valueForKey:@"kind"];
+    XCTAssertEqualObjects(kinds, (@[@"load", @"insert", @"insert"]));
+    XCTAssertEqualObjects([_channel.requests valueForKey:@"count"], (@[@20, @20, @5]));
+    XCTAssertEqualObjects([_channel.requests valueForKey:@"first"], (@[@"http://media.test/long/0",
+                                                                      @"http://media.test/long/20",
+                                                                      @"http://media.test/long/40"]));
+    XCTAssertEqualObjects(_results, @[[NSNull null]]);
+}
+
+- (void) testFailedChunkStopsLoad {
+    [self playAll:[self mediaNamed:@"failed" count:45] position:0];
+    [self completeRequestAtIndex:0];
+    [_receiver mediaControlChannel: _channel
+              requestDidFailWithID: [_channel.requests[1][@"id"] integerValue]
+                             error: [NSError errorWithDomain:kGCKErrorDomain code:GCKErrorCodeTimeout userInfo:nil]];
+
+    XCTAssertEqual(_channel.requests.count, 2);
+    XCTAssertEqual(_results.count, 1);
+    XCTAssertEqual([_results[0] code], GCKErrorCodeTimeout);
+}
+
+- (void) testReplacedRequestFailsLoad {
+    [self playAll:[self mediaNamed:@"replaced" count:5] position:0];
+    [_receiver mediaControlChannel:_channel didReplaceRequestWithID:[_channel.requests[0][@"id"] integerValue]];
+    XCTAssertEqual(_results.count, 1);
+    XCTAssertEqual([_results[0] code], GCKErrorCodeReplaced);
+
+    // answer of replaced request is ignored
+    [self completeRequestAtIndex:0];
+    XCTAssertEqual(_results.count, 1);
+}
+
+- (void) testUnknownRequestIsIgnored {
+    [self playAll:[self mediaNamed:@"unknown" count:5] position:0];
+    [_receiver mediaControlChannel:_channel requestDidCompleteWithID:[_channel.requests[0][@"id"] integerValue] + 100];
+    XCTAssertEqual(_results.count, 0);
+}
+
+- (void) testNewerLoadStopsChunksOfOlderOne {
+    [self playAll:[self mediaNamed:@"older" count:45] position:0];
+    [self playAll:[self mediaNamed:@"newer" count:3] position:0];
+    [self completeRequestAtIndex:0];
+    XCTAssertEqual(_channel.requests.count, 2, @"No chunk of older load is sent");
+    XCTAssertEqual(_results.count, 1);
+    XCTAssertEqual([_results[0] code], GCKErrorCodeReplaced);
+
+    [self completeRequestAtIndex:1];
+    XCTAssertEqual(_results.count, 2);
+    XCTAssertEqualObjects(_results[1], [NSNull null]);
+}
+
+- (void) testRejectedRequestFailsAtOnce {
+    _channel.rejectsRequests = YES;
+    [self playAll:[self mediaNamed:@"rejected" count:5] position:0];
+    XCTAssertEqual(_results.count, 1);
+    XCTAssertEqual([_results[0] code], GCKErrorCodeInvalidRequest);
+}
+
+#pragma mark - private
+
+- (void) playAll: (NSArray<GCKMediaInformation *> *)media position: (NSTimeInterval)position {
+    NSMutableArray *results = _results;
+    [_controller mediaPlayAll:media playPosition:position completion:^(NSTimeInterval elapsed, NSError *error) {
+        [results addObject:error ?: [NSNull null]];
+    }];
+}
+
+- (void) completeRequestAtIndex: (NSUInteger)index {
+    [_receiver mediaControlChannel:_channel requestDidCompleteWithID:[_channel.requests[index][@"id"] integerValue]];
+}
+
+- (NSArray<GCKMediaInformation *> *) mediaNamed: (NSString *)name count: (NSUInteger)count {
+    NSMutableArray<GCKMediaInformation *> *media = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSString *contentID = [NSString stringWithFormat:@"http://media.test/%@/%lu", name, (unsigned long)i];
+        [media addObject:[[GCKMediaInformation alloc] initWithContentID: contentID
+                                                             streamType: GCKMediaStreamTypeBuffered
+                                                            contentType: @"video/mp4"
+                                                               metadata: nil
+                                                         streamDuration: 0
+                                                            mediaTracks: nil
+                                                         textTrackStyle: nil
+                                                             customData: nil]];
+    }
+    return media;
+}
+
+@end
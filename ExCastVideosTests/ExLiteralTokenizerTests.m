@@ -0,0 +1,169 @@
+//
+//  ExLiteralTokenizerTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "ExLiteralTokenizer.h"
+#import "ExMedia.h"
+#import "ExMediaTrack.h"
+
+// The number of episodes in saved page of long series
+static const NSUInteger kSeriesEpisodes = 1000;
+
+@interface ExLiteralTokenizerTests : XCTestCase
+
+@end
+
+@implementation ExLiteralTokenizerTests
+
+- (void) testFieldsOfEveryObjectAreEnumerated {
+    NSArray *fields = [self fieldsOfLiteral:@"{url: \"http://media.test/1\", 'type': 'video'}, {\"url\": \"http://media.test/2\", size: 12, tags: [1, {a: \"}\"}]}"];
+    XCTAssertEqualObjects(fields, (@[@[@0, @"url", @"http://media.test/1"],
+                                     @[@0, @"type", @"video"],
+                                     @[@1, @"url", @"http://media.test/2"],
+                                     @[@1, @"size", @"12"],
+                                     @[@1, @"tags", @"[1, {a: \"}\"}]"]]));
+}
+
+- (void) testBareAndBracketedListsHaveSameFields {
+    NSString *list = @"{url: 'http://media.test/1', type: 'video'}, {url: 'http://media.test/2', type: 'video'}";
+    NSArray *expected = @[@[@0, @"url", @"http://media.test/1"],
+                          @[@0, @"type", @"video"],
+                          @[@1, @"url", @"http://media.test/2"],
+                          @[@1, @"type", @"video"]];
+    XCTAssertEqualObjects([self fieldsOfLiteral:list], expected);
+    XCTAssertEqualObjects([self fieldsOfLiteral:[NSString stringWithFormat:@"[%@]", list]], expected);
+    XCTAssertEqualObjects([self fieldsOfLiteral:[NSString stringWithFormat:@" \n[ %@, ];", list]], expected);
+}
+
+- (void) testNestedArraysOfBracketedListAreRawValues {
+    NSArray *fields = [self fieldsOfLiteral:@"[{tags: [1, 2]}, [3, 4], {url: 'http://media.test/1'}]"];
+    XCTAssertEqualObjects(fields, (@[@[@0, @"tags", @"[1, 2]"],
+                                     @[@1, @"url", @"http://media.test/1"]]));
+}
+
+- (void) testUnterminatedBracketedListIsMalformed {
+    NSMutableArray *fields = [NSMutableArray array];
+    XCTAssertFalse([self enumerateLiteral:@"[{url: 'http://media.test/1'}" intoFields:fields]);
+    XCTAssertEqualObjects(fields, (@[@[@0, @"url", @"http://media.test/1"]]));
+}
+
+- (void) testEscapesAreResolved {
+    NSArray *fields = [self fieldsOfLiteral:@"{title: 'It\\'s \\\"Q\\\" \\u0411\\x41\\/\\\\ \\q'}"];
+    XCTAssertEqualObjects(fields.firstObject[2], @"It's \"Q\" БA/\\ q");
+}
+
+- (void) testLineContinuationsAreRemoved {
+    for (NSString *lineEnd in @[@"\n", @"\r\n", @"\r"]) {
+        NSString *literal = [NSString stringWithFormat:@"{title: \"Doctor \\%@Who\"}", lineEnd];
+        XCTAssertEqualObjects([self fieldsOfLiteral:literal].firstObject[2], @"Doctor Who",
+                              @"Continuation of %@ line end", [lineEnd isEqualToString:@"\n"] ? @"LF" : @"CR");
+    }
+}
+
+- (void) testMalformedLiteralKeepsFieldsBeforeError {
+    NSMutableArray *fields = [NSMutableArray array];
+    BOOL parsed = [self enumerateLiteral:@"{url: 'http://media.test/1'}, {url: 'http://media.test/2" intoFields:fields];
+    XCTAssertFalse(parsed);
+    XCTAssertEqualObjects(fields, (@[@[@0, @"url", @"http://media.test/1"]]));
+}
+
+- (void) testTokenizerPerformance {
+    NSArray<NSString *> *literals = [self literalsOfSeriesPage];
+    [self measureBlock:^{
+        for (NSUInteger pass = 0; pass < 10; pass++) {
+            NSArray<ExMediaTrack *> *tracks = [ExMedia tracksFromPlayerList:literals[0] playerInfo:literals[1]];
+            XCTAssertEqual(tracks.count, kSeriesEpisodes);
+            XCTAssertEqualObjects(tracks.lastObject.name, @"Сезон 10, серия 100");
+        }
+    }];
+}
+
+- (void) testJSONSerializationBaselinePerformance {
+    NSArray<NSString *> *literals = [self literalsOfSeriesPage];
+    [self measureBlock:^{
+        for (NSUInteger pass = 0; pass < 10; pass++) {
+            NSArray<NSArray *> *tracks = [self JSONTracksFromPlayerList:literals[0] playerInfo:literals[1]];
+            XCTAssertEqual(tracks.count, kSeriesEpisodes);
+            XCTAssertEqualObjects(tracks.lastObject[1], @"Сезон 10, серия 100");
+        }
+    }];
+}
+
+#pragma mark - private
+
+/**
+ * Returns player_list and player_info literals of saved page of long series, cut from their lines
+ * the way page script is read
+ */
+- (NSArray<NSString *> *) literalsOfSeriesPage {
+    NSURL *url = [[NSBundle bundleForClass:[self class]] URLForResource:@"series" withExtension:@"html"];
+    NSString *page = [NSString stringWithContentsOfURL:url encoding:NSUTF8StringEncoding error:nil];
+    __block NSString *playerList = nil;
+    __block NSString *playerInfo = nil;
+    [page enumerateLinesUsingBlock:^(NSString *line, BOOL *stop) {
+        if ([line containsString:@"player_list"]) {
+            playerList = [self substringOfLine:line between:@"'" and:@"'"];
+        } else if ([line containsString:@"player_info"]) {
+            playerInfo = [self substringOfLine:line between:@"(" and:@")"];
+        }
+    }];
+    XCTAssertNotNil(playerList);
+    XCTAssertNotNil(playerInfo);
+    return @[playerList ?: @"", playerInfo ?: @""];
+}
+
+- (NSString *) substringOfLine: (NSString *)line between: (NSString *)open and: (NSString *)close {
+    NSUInteger start = [line rangeOfString:open].location + 1;
+    NSUInteger end = [line rangeOfString:close options:NSLiteralSearch range:NSMakeRange(start, line.length - start)].location;
+    return [line substringWithRange:NSMakeRange(start, end - start)];
+}
+
+/**
+ * Returns URL and name of video tracks the way they were parsed before the tokenizer, by turning
+ * literals into JSON arrays
+ */
+- (NSArray<NSArray *> *) JSONTracksFromPlayerList: (NSString *)playerList playerInfo: (NSString *)playerInfo {
+    NSString *listJSON = [NSString stringWithFormat:@"[%@]", playerList];
+    NSArray *list = [NSJSONSerialization JSONObjectWithData:[listJSON dataUsingEncoding:NSUTF8StringEncoding]
+                                                    options:NSJSONReadingMutableContainers
+                                                      error:nil];
+    NSString *infoJSON = [NSString stringWithFormat:@"[%@]", playerInfo];
+    infoJSON = [infoJSON stringByReplacingOccurrencesOfString:@"pos" withString:@"\"pos\""];
+    infoJSON = [infoJSON stringByReplacingOccurrencesOfString:@"title" withString:@"\"title\""];
+    infoJSON = [infoJSON stringByReplacingOccurrencesOfString:@"'" withString:@"\""];
+    NSArray *info = [NSJSONSerialization JSONObjectWithData:[infoJSON dataUsingEncoding:NSUTF8StringEncoding]
+                                                    options:NSJSONReadingMutableContainers
+                                                      error:nil];
+    NSMutableArray<NSArray *> *tracks = [NSMutableArray arrayWithCapacity:list.count];
+    for (NSDictionary *dict in list) {
+        if ([dict[@"type"] isEqualToString:@"video"]) {
+            NSURL *url = [NSURL URLWithString:dict[@"url"]];
+            NSString *name = tracks.count < info.count ? info[tracks.count][@"title"] : [url absoluteString];
+            [tracks addObject:@[url, name]];
+        }
+    }
+    return tracks;
+}
+
+- (NSArray *) fieldsOfLiteral: (NSString *)literal {
+    NSMutableArray *fields = [NSMutableArray array];
+    XCTAssertTrue([self enumerateLiteral:literal intoFields:fields], @"%@", literal);
+    return fields;
+}
+
+- (BOOL) enumerateLiteral: (NSString *)literal intoFields: (NSMutableArray *)fields {
+    NSData *data = [literal dataUsingEncoding:NSUTF8StringEncoding];
+    ExLiteralTokenizer *tokenizer = [[ExLiteralTokenizer alloc] initWithBytes:data.bytes
+                                                                       length:data.length
+                                                                     encoding:NSUTF8StringEncoding];
+    return [tokenizer enumerateFieldsUsingBlock:^(NSUInteger objectIndex, ExLiteralSlice key, ExLiteralSlice value, BOOL *stop) {
+        [fields addObject:@[@(objectIndex), [tokenizer stringFromSlice:key], [tokenizer stringFromSlice:value]]];
+    }];
+}
+
+@end
@@ -0,0 +1,141 @@
+//
+//  ExMediaTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+#import <HTMLReader/HTMLReader.h>
+
+#import "ExMedia.h"
+#import "ExMediaTrack.h"
+#import "ExPageScanner.h"
+
+@interface ExMedia (DOMParser)
+
+- (void)loadFromHTMLDocument:(HTMLDocument *)document;
+
+@end
+
+/**
+ * Compares streaming page scanner with DOM parser over the corpus of saved pages
+ */
+@interface ExMediaTests : XCTestCase
+
+@end
+
+@implementation ExMediaTests
+
+- (void) testScannerMatchesDOMParserOnCorpus {
+    NSArray<NSURL *> *pages = [self corpus];
+    XCTAssertGreaterThan(pages.count, 0);
+    for (NSURL *page in pages) {
+        NSData *data = [NSData dataWithContentsOfURL:page];
+        ExPageScanner *scanner = [[ExPageScanner alloc] initWithContentTypeHeader:nil];
+        [scanner appendData:data];
+        [scanner finish];
+        [self assertMedia:[ExMedia mediaWithPageURL:page scanner:scanner]
+             equalToMedia:[self DOMMediaWithData:data]
+                   ofPage:page];
+    }
+}
+
+- (void) testScannerMatchesDOMParserOnChunkedCorpus {
+    for (NSURL *page in [self corpus]) {
+        NSData *data = [NSData dataWithContentsOfURL:page];
+        ExPageScanner *scanner = [[ExPageScanner alloc] initWithContentTypeHeader:nil];
+        // markup, entities and multibyte characters split across chunks
+        for (NSUInteger offset = 0; offset < data.length; offset += 7) {
+            [scanner appendData:[data subdataWithRange:NSMakeRange(offset, MIN(7, data.length - offset))]];
+        }
+        [scanner finish];
+        [self assertMedia:[ExMedia mediaWithPageURL:page scanner:scanner]
+             equalToMedia:[self DOMMediaWithData:data]
+                   ofPage:page];
+    }
+}
+
+- (void) testEntitiesAreDecodedLikeDOMParser {
+    NSURL *page = [self pageNamed:@"entities"];
+    ExMedia *media = [ExMedia mediaWithPageURL:page data:[NSData dataWithContentsOfURL:page] contentTypeHeader:nil];
+    XCTAssertEqualObjects(media.title, @"Tom & Jerry «Classic» … БЖ café ½ ← ♠");
+    XCTAssertEqualObjects(media.thumbnailURL, [NSURL URLWithString:@"http://img.test/poster.jpg"]);
+}
+
+- (void) testPageEncodingIsTakenFromMeta {
+    NSURL *page = [self pageNamed:@"windows1251"];
+    ExMedia *media = [ExMedia mediaWithPageURL:page data:[NSData dataWithContentsOfURL:page] contentTypeHeader:nil];
+    XCTAssertEqualObjects(media.title, @"Брат 2 (2000)");
+    XCTAssertEqualObjects(media.tracks.firstObject.name, @"Серия 1");
+}
+
+- (void) testTracksOfCorpusMatchPlayerScripts {
+    // URL and name of every video track as written in player_list and player_info of the page,
+    // names are matched to video tracks by position the same way the site player does
+    NSDictionary<NSString *, NSArray<NSArray<NSString *> *> *> *expected = @{
+        @"basic": @[@[@"http://media.test/get/1", @"Episode 1"],
+                    @[@"http://media.test/get/2", @"Episode 2"],
+                    @[@"http://media.test/get/3", @"Episode 3"]],
+        @"cyrillic": @[@[@"http://media.test/get/20", @"Серия 1"],
+                       @[@"http://media.test/get/22", @"Саундтрек"]],
+        @"entities": @[@[@"http://media.test/get/10", @"Part &amp; one"]],
+        @"escapes": @[@[@"http://media.test/get/40?a=1&b=2", @"Quote \"q\""],
+                      @[@"http://media.test/get/41", @"Tab\tname"]],
+        @"nested": @[@[@"http://media.test/get/30", @"Pilot"]],
+        @"notracks": @[],
+        @"windows1251": @[@[@"http://media.test/get/50", @"Серия 1"]]};
+    XCTAssertEqual(expected.count, [self corpus].count, @"Every page of corpus has expected tracks");
+    for (NSString *name in expected) {
+        NSURL *page = [self pageNamed:name];
+        NSData *data = [NSData dataWithContentsOfURL:page];
+        ExMedia *media = [ExMedia mediaWithPageURL:page data:data contentTypeHeader:nil];
+        XCTAssertNotNil(media.title, @"title of %@", name);
+        [self assertTracks:media.tracks equalToTracks:expected[name] ofPage:name];
+        [self assertTracks:[self DOMMediaWithData:data].tracks equalToTracks:expected[name] ofPage:name];
+    }
+}
+
+#pragma mark - private
+
+- (NSArray<NSURL *> *) corpus {
+    return [[NSBundle bundleForClass:[self class]] URLsForResourcesWithExtension:@"html" subdirectory:@"Pages"];
+}
+
+- (NSURL *) pageNamed: (NSString *)name {
+    return [[NSBundle bundleForClass:[self class]] URLForResource:name withExtension:@"html" subdirectory:@"Pages"];
+}
+
+- (ExMedia *) DOMMediaWithData: (NSData *)data {
+    ExMedia *media = [[ExMedia alloc] init];
+    [media loadFromHTMLDocument:[HTMLDocument documentWithData:data contentTypeHeader:nil]];
+    return media;
+}
+
+- (void) assertTracks: (NSArray<ExMediaTrack *> *)tracks equalToTracks: (NSArray<NSArray<NSString *> *> *)expected ofPage: (NSString *)name {
+    XCTAssertEqual(tracks.count, expected.count, @"tracks of %@", name);
+    for (NSUInteger i = 0; i < MIN(tracks.count, expected.count); i++) {
+        ExMediaTrack *track = tracks[i];
+        XCTAssertEqual(track.identifier, (NSInteger)i, @"track %lu of %@", (unsigned long)i, name);
+        XCTAssertEqualObjects(track.url, [NSURL URLWithString:expected[i][0]], @"track %lu of %@", (unsigned long)i, name);
+        XCTAssertEqualObjects(track.name, expected[i][1], @"track %lu of %@", (unsigned long)i, name);
+        XCTAssertEqualObjects(track.mimeType, @"video/mp4", @"track %lu of %@", (unsigned long)i, name);
+    }
+}
+
+- (void) assertMedia: (ExMedia *)media equalToMedia: (ExMedia *)reference ofPage: (NSURL *)page {
+    NSString *name = page.lastPathComponent;
+    XCTAssertEqualObjects(media.title, reference.title, @"title of %@", name);
+    XCTAssertEqualObjects(media.thumbnailURL, reference.thumbnailURL, @"thumbnail of %@", name);
+    XCTAssertEqual(media.tracks.count, reference.tracks.count, @"tracks of %@", name);
+    for (NSUInteger i = 0; i < MIN(media.tracks.count, reference.tracks.count); i++) {
+        ExMediaTrack *track = media.tracks[i];
+        ExMediaTrack *referenceTrack = reference.tracks[i];
+        XCTAssertEqual(track.identifier, referenceTrack.identifier, @"track %lu of %@", (unsigned long)i, name);
+        XCTAssertEqualObjects(track.url, referenceTrack.url, @"track %lu of %@", (unsigned long)i, name);
+        XCTAssertEqualObjects(track.name, referenceTrack.name, @"track %lu of %@", (unsigned long)i, name);
+        XCTAssertEqualObjects(track.mimeType, referenceTrack.mimeType, @"track %lu of %@", (unsigned long)i, name);
+    }
+}
+
+@end
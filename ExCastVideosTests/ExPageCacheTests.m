@@ -0,0 +1,112 @@
+//
+//  ExPageCacheTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "ExMedia.h"
+#import "ExMediaLoader.h"
+#import "ExMediaTrack.h"
+#import "ExPageCache.h"
+#import "StubURLProtocol.h"
+#import "XCTestCase+Tasks.h"
+
+/**
+ * Checks that media revalidated by 304 response is the same as media loaded with the page
+ */
+@interface ExPageCacheTests : XCTestCase
+
+@end
+
+@implementation ExPageCacheTests {
+    NSURL *_cacheURL;
+    NSURL *_pageURL;
+    NSData *_page;
+}
+
+- (void) setUp {
+    [super setUp];
+    [StubURLProtocol reset];
+    _cacheURL = [self temporaryFileURLWithExtension:@"cache"];
+    _pageURL = [NSURL URLWithString:@"http://ex.test/view/1"];
+    NSURL *basic = [[NSBundle bundleForClass:[self class]] URLForResource:@"basic" withExtension:@"html" subdirectory:@"Pages"];
+    _page = [NSData dataWithContentsOfURL:basic];
+}
+
+- (void) tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:_cacheURL error:nil];
+    [StubURLProtocol reset];
+    [super tearDown];
+}
+
+- (void) testNotModifiedMediaMatchesLoadedMediaWithETag {
+    [self stubPageWithValidator:@{@"ETag": @"\"v1\""}];
+    ExMediaLoader *loader = [self loaderWithCache:[[ExPageCache alloc] initWithDirectory:_cacheURL]];
+
+    ExMedia *loaded = [self loadMediaWithLoader:loader notModified:NO];
+    ExMedia *revalidated = [self loadMediaWithLoader:loader notModified:YES];
+    XCTAssertEqualObjects([[StubURLProtocol lastRequestForURL:_pageURL] valueForHTTPHeaderField:@"If-None-Match"], @"\"v1\"");
+    [self assertMedia:revalidated equalToMedia:loaded];
+}
+
+- (void) testNotModifiedMediaMatchesLoadedMediaWithLastModified {
+    NSString *lastModified = @"Mon, 17 Oct 2016 10:00:00 GMT";
+    [self stubPageWithValidator:@{@"Last-Modified": lastModified}];
+    ExMedia *loaded = [self loadMediaWithLoader:[self loaderWithCache:[[ExPageCache alloc] initWithDirectory:_cacheURL]]
+                                    notModified:NO];
+
+    // new cache reads entry back from disk
+    ExPageCache *cache = [[ExPageCache alloc] initWithDirectory:_cacheURL];
+    ExMedia *revalidated = [self loadMediaWithLoader:[self loaderWithCache:cache] notModified:YES];
+    XCTAssertEqualObjects([[StubURLProtocol lastRequestForURL:_pageURL] valueForHTTPHeaderField:@"If-Modified-Since"], lastModified);
+    XCTAssertEqual(cache.notModifiedResponses, 1);
+    [self assertMedia:revalidated equalToMedia:loaded];
+}
+
+#pragma mark - private
+
+- (void) stubPageWithValidator: (NSDictionary<NSString *, NSString *> *)validator {
+    NSMutableDictionary *headers = [NSMutableDictionary dictionaryWithDictionary:validator];
+    headers[@"Content-Type"] = @"text/html; charset=utf-8";
+    [StubURLProtocol stubURL: _pageURL
+               withResponses: @[[StubResponse responseWithStatus:200 headers:headers body:_page],
+                                [StubResponse responseWithStatus:304 headers:validator body:nil]]];
+}
+
+- (ExMediaLoader *) loaderWithCache: (ExPageCache *)cache {
+    return [[ExMediaLoader alloc] initWithSessionConfiguration:[StubURLProtocol sessionConfiguration] pageCache:cache];
+}
+
+- (ExMedia *) loadMediaWithLoader: (ExMediaLoader *)loader notModified: (BOOL)notModified {
+    __block ExMedia *result = nil;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Media loaded"];
+    [loader loadMediaFromURL:_pageURL withCompletion:^(ExMedia *media, ExMediaLoadMetrics *metrics, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqual(metrics.notModified, notModified);
+        result = media;
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    return result;
+}
+
+- (void) assertMedia: (ExMedia *)media equalToMedia: (ExMedia *)expected {
+    XCTAssertNotNil(media);
+    XCTAssertEqualObjects(media.title, expected.title);
+    XCTAssertEqualObjects(media.thumbnailURL, expected.thumbnailURL);
+    XCTAssertEqual(media.tracks.count, 3);
+    XCTAssertEqual(media.tracks.count, expected.tracks.count);
+    for (NSUInteger i = 0; i < MIN(media.tracks.count, expected.tracks.count); i++) {
+        ExMediaTrack *track = media.tracks[i];
+        ExMediaTrack *expectedTrack = expected.tracks[i];
+        XCTAssertEqual(track.identifier, expectedTrack.identifier, @"Track %lu", (unsigned long)i);
+        XCTAssertEqualObjects(track.mimeType, expectedTrack.mimeType, @"Track %lu", (unsigned long)i);
+        XCTAssertEqualObjects(track.name, expectedTrack.name, @"Track %lu", (unsigned long)i);
+        XCTAssertEqualObjects(track.url, expectedTrack.url, @"Track %lu", (unsigned long)i);
+    }
+}
+
+@end
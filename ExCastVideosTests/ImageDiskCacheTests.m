@@ -0,0 +1,107 @@
+//
+//  ImageDiskCacheTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "ImageDiskCache.h"
+#import "XCTestCase+Tasks.h"
+
+/**
+ * Checks that cache reopened after crash accounts for files changed since its index was written
+ */
+@interface ImageDiskCacheTests : XCTestCase
+
+@end
+
+@implementation ImageDiskCacheTests {
+    NSURL *_directory;
+}
+
+- (void) setUp {
+    [super setUp];
+    _directory = [self temporaryFileURLWithExtension:@"cache"];
+}
+
+- (void) tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:_directory error:nil];
+    [super tearDown];
+}
+
+- (void) testFilesStoredAfterIndexWriteAreAdopted {
+    ImageDiskCache *cache = [[ImageDiskCache alloc] initWithDirectory:_directory byteLimit:1024 * 1024];
+    XCTAssertTrue([cache storeData:[self dataOfLength:100] forKey:@"http://ex.test/1.jpg"]);
+    [cache synchronize];
+    // index write of these is still pending when process dies
+    XCTAssertTrue([cache storeData:[self dataOfLength:200] forKey:@"http://ex.test/2.jpg"]);
+    XCTAssertTrue([cache storeData:[self dataOfLength:300] forKey:@"http://ex.test/3.jpg"]);
+
+    ImageDiskCache *reopened = [[ImageDiskCache alloc] initWithDirectory:_directory byteLimit:1024 * 1024];
+    XCTAssertEqual(reopened.count, 3);
+    XCTAssertEqual(reopened.totalBytes, 600);
+    XCTAssertEqualObjects([reopened dataForKey:@"http://ex.test/3.jpg"], [self dataOfLength:300]);
+}
+
+- (void) testAdoptedFilesAreEvicted {
+    ImageDiskCache *cache = [[ImageDiskCache alloc] initWithDirectory:_directory byteLimit:1024 * 1024];
+    [cache synchronize];
+    for (int i = 0; i < 10; i++) {
+        [cache storeData:[self dataOfLength:100] forKey:[NSString stringWithFormat:@"http://ex.test/%d.jpg", i]];
+    }
+
+    ImageDiskCache *reopened = [[ImageDiskCache alloc] initWithDirectory:_directory byteLimit:500];
+    [reopened synchronize];
+    XCTAssertLessThanOrEqual(reopened.totalBytes, 500);
+    XCTAssertGreaterThan(reopened.evictions, 0);
+    XCTAssertEqual([self filesInDirectory].count, reopened.count);
+}
+
+- (void) testEntriesOfRemovedFilesAndStrayFilesAreDropped {
+    ImageDiskCache *cache = [[ImageDiskCache alloc] initWithDirectory:_directory byteLimit:1024 * 1024];
+    [cache storeData:[self dataOfLength:100] forKey:@"http://ex.test/1.jpg"];
+    [cache storeData:[self dataOfLength:200] forKey:@"http://ex.test/2.jpg"];
+    [cache synchronize];
+    NSArray<NSURL *> *files = [self filesInDirectory];
+    XCTAssertEqual(files.count, 2);
+    NSURL *removed = files.firstObject;
+    NSURL *stray = [[removed URLByDeletingLastPathComponent] URLByAppendingPathComponent:@"unfinished.tmp"];
+    XCTAssertTrue([[NSFileManager defaultManager] removeItemAtURL:removed error:nil]);
+    XCTAssertTrue([[self dataOfLength:50] writeToURL:stray atomically:NO]);
+
+    ImageDiskCache *reopened = [[ImageDiskCache alloc] initWithDirectory:_directory byteLimit:1024 * 1024];
+    XCTAssertEqual(reopened.count, 1);
+    NSNumber *size;
+    [files.lastObject getResourceValue:&size forKey:NSURLFileSizeKey error:nil];
+    XCTAssertEqual(reopened.totalBytes, size.unsignedLongLongValue);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:stray.path]);
+}
+
+#pragma mark - private
+
+- (NSData *) dataOfLength: (NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    memset(data.mutableBytes, (int)(length % 251), length);
+    return data;
+}
+
+// Cached files in shards, index excluded
+- (NSArray<NSURL *> *) filesInDirectory {
+    NSMutableArray<NSURL *> *files = [NSMutableArray array];
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtURL:_directory
+                                                             includingPropertiesForKeys:@[NSURLIsDirectoryKey]
+                                                                                options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                           errorHandler:nil];
+    for (NSURL *fileURL in enumerator) {
+        NSNumber *isDirectory;
+        [fileURL getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:nil];
+        if (enumerator.level == 2 && ![isDirectory boolValue]) {
+            [files addObject:fileURL];
+        }
+    }
+    return files;
+}
+
+@end
@@ -0,0 +1,111 @@
+//
+//  ImageScalerTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+#import <ImageIO/ImageIO.h>
+#import <MobileCoreServices/MobileCoreServices.h>
+
+#import "ImageScaler.h"
+
+@interface ImageScalerTests : XCTestCase
+
+@end
+
+@implementation ImageScalerTests {
+    ImageIOScaler *_scaler;
+}
+
+- (void) setUp {
+    [super setUp];
+    _scaler = [[ImageIOScaler alloc] init];
+}
+
+- (void) testOpaqueImageIsScaledToJPEG {
+    NSData *source = [self imageDataWithSize:CGSizeMake(800, 400) opaque:YES type:kUTTypeJPEG];
+    NSData *variant = [_scaler scaledDataWithImageData:source toPixelSize:CGSizeMake(200, 200)];
+    XCTAssertEqualObjects([self typeOfImageData:variant], (__bridge NSString *)kUTTypeJPEG);
+    XCTAssertTrue(CGSizeEqualToSize([self sizeOfImageData:variant], CGSizeMake(200, 100)));
+}
+
+- (void) testTransparentImageKeepsAlphaInPNG {
+    NSData *source = [self imageDataWithSize:CGSizeMake(400, 800) opaque:NO type:kUTTypePNG];
+    NSData *variant = [_scaler scaledDataWithImageData:source toPixelSize:CGSizeMake(100, 100)];
+    XCTAssertEqualObjects([self typeOfImageData:variant], (__bridge NSString *)kUTTypePNG);
+    XCTAssertTrue(CGSizeEqualToSize([self sizeOfImageData:variant], CGSizeMake(50, 100)));
+    CGImageSourceRef source2 = CGImageSourceCreateWithData((__bridge CFDataRef)variant, NULL);
+    CGImageRef image = CGImageSourceCreateImageAtIndex(source2, 0, NULL);
+    CGImageAlphaInfo alpha = CGImageGetAlphaInfo(image);
+    XCTAssertFalse(alpha == kCGImageAlphaNone || alpha == kCGImageAlphaNoneSkipFirst || alpha == kCGImageAlphaNoneSkipLast);
+    CGImageRelease(image);
+    CFRelease(source2);
+}
+
+- (void) testSmallerSideIsFittedToo {
+    // max pixel size of thumbnail bounds the longer side only
+    NSData *source = [self imageDataWithSize:CGSizeMake(600, 500) opaque:YES type:kUTTypeJPEG];
+    NSData *variant = [_scaler scaledDataWithImageData:source toPixelSize:CGSizeMake(300, 100)];
+    CGSize size = [self sizeOfImageData:variant];
+    XCTAssertLessThanOrEqual(size.width, 300);
+    XCTAssertLessThanOrEqual(size.height, 100);
+}
+
+- (void) testSmallImageIsNotUpscaled {
+    NSData *source = [self imageDataWithSize:CGSizeMake(50, 40) opaque:YES type:kUTTypeJPEG];
+    NSData *variant = [_scaler scaledDataWithImageData:source toPixelSize:CGSizeMake(200, 200)];
+    XCTAssertTrue(CGSizeEqualToSize([self sizeOfImageData:variant], CGSizeMake(50, 40)));
+}
+
+- (void) testGarbageIsNotScaled {
+    NSData *garbage = [@"not an image" dataUsingEncoding:NSUTF8StringEncoding];
+    XCTAssertNil([_scaler scaledDataWithImageData:garbage toPixelSize:CGSizeMake(100, 100)]);
+}
+
+#pragma mark - private
+
+- (NSData *) imageDataWithSize: (CGSize)size opaque: (BOOL)opaque type: (CFStringRef)type {
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, size.width, size.height, 8, 0, colorSpace,
+                                                 kCGBitmapByteOrder32Host |
+                                                 (opaque ? kCGImageAlphaNoneSkipFirst : kCGImageAlphaPremultipliedFirst));
+    CGColorSpaceRelease(colorSpace);
+    CGContextSetRGBFillColor(context, 0.2, 0.4, 0.8, 1);
+    // transparent image has transparent half
+    CGContextFillRect(context, CGRectMake(0, 0, size.width, opaque ? size.height : size.height / 2));
+    CGImageRef image = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, type, 1, NULL);
+    CGImageDestinationAddImage(destination, image, NULL);
+    CGImageDestinationFinalize(destination);
+    CFRelease(destination);
+    CGImageRelease(image);
+    return data;
+}
+
+- (NSString *) typeOfImageData: (NSData *)data {
+    if (!data) {
+        return nil;
+    }
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    NSString *type = [(__bridge NSString *)CGImageSourceGetType(source) copy];
+    CFRelease(source);
+    return type;
+}
+
+- (CGSize) sizeOfImageData: (NSData *)data {
+    if (!data) {
+        return CGSizeZero;
+    }
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    NSDictionary *properties = (__bridge_transfer NSDictionary *)CGImageSourceCopyPropertiesAtIndex(source, 0, NULL);
+    CFRelease(source);
+    return CGSizeMake([properties[(__bridge NSString *)kCGImagePropertyPixelWidth] doubleValue],
+                      [properties[(__bridge NSString *)kCGImagePropertyPixelHeight] doubleValue]);
+}
+
+@end
@@ -0,0 +1,126 @@
+//
+//  KeyedListDiffTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "KeyedListDiff.h"
+
+@interface KeyedListDiffTests : XCTestCase
+
+@end
+
+@implementation KeyedListDiffTests
+
+- (void) testSameListHasNoChanges {
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys:@[@1, @2, @3] toKeys:@[@1, @2, @3]];
+    XCTAssertFalse([diff hasChanges]);
+}
+
+- (void) testDeletionsAndInsertions {
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys:@[@1, @2, @3, @4] toKeys:@[@5, @1, @3, @6]];
+    XCTAssertEqualObjects([self rowsOf:diff.deleted], (@[@1, @3]));
+    XCTAssertEqualObjects([self rowsOf:diff.inserted], (@[@0, @3]));
+    XCTAssertEqual(diff.moved.count, 0);
+    [self assertDiff:diff turns:@[@1, @2, @3, @4] into:@[@5, @1, @3, @6]];
+}
+
+- (void) testOnlyItemsOutOfOrderAreMoved {
+    // 1 2 4 5 keep their order, 3 jumps to the end
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys:@[@1, @2, @3, @4, @5] toKeys:@[@1, @2, @4, @5, @3]];
+    XCTAssertEqual(diff.moved.count, 1);
+    XCTAssertEqual(diff.moved[0][0].row, 2);
+    XCTAssertEqual(diff.moved[0][1].row, 4);
+    [self assertDiff:diff turns:@[@1, @2, @3, @4, @5] into:@[@1, @2, @4, @5, @3]];
+}
+
+- (void) testReversedListMovesAllButOne {
+    NSArray *old = @[@1, @2, @3, @4, @5, @6];
+    NSArray *reversed = [[old reverseObjectEnumerator] allObjects];
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys:old toKeys:reversed];
+    XCTAssertEqual(diff.moved.count, old.count - 1);
+    [self assertDiff:diff turns:old into:reversed];
+}
+
+- (void) testChangedContentsAreUpdatedAtNewRows {
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys: @[@"a", @"b", @"c"]
+                                             contents: @[@"A", @"B", @"C"]
+                                               toKeys: @[@"c", @"a", @"b"]
+                                             contents: @[@"C", @"A", @"B2"]];
+    XCTAssertEqualObjects([self rowsOf:diff.updated], (@[@2]));
+    [self assertDiff:diff turns:@[@"a", @"b", @"c"] into:@[@"c", @"a", @"b"]];
+}
+
+- (void) testKeysNeedNotBeCopyable {
+    NSObject *first = [[NSObject alloc] init], *second = [[NSObject alloc] init];
+    KeyedListDiff *diff = [KeyedListDiff diffFromKeys:@[first, second] toKeys:@[second, first]];
+    XCTAssertEqual(diff.moved.count, 1);
+}
+
+- (void) testRandomPermutationsAreReproduced {
+    srand48(17);
+    for (NSUInteger round = 0; round < 200; round++) {
+        NSMutableArray *old = [NSMutableArray array];
+        NSMutableArray *new = [NSMutableArray array];
+        for (NSUInteger i = 0; i < 30; i++) {
+            if (drand48() < 0.8) {
+                [old addObject:@(i)];
+            }
+            if (drand48() < 0.8) {
+                [new insertObject:@(i) atIndex:(NSUInteger)(drand48() * (new.count + 1))];
+            }
+        }
+        [self assertDiff:[KeyedListDiff diffFromKeys:old toKeys:new] turns:old into:new];
+    }
+}
+
+#pragma mark - private
+
+- (NSArray<NSNumber *> *) rowsOf: (NSArray<NSIndexPath *> *)indexPaths {
+    return [indexPaths valueForKey:@"row"];
+}
+
+/**
+ * Applies changes the way table batch updates do: deletions and move sources address old rows,
+ * insertions and move targets address new rows
+ */
+- (void) assertDiff: (KeyedListDiff *)diff turns: (NSArray *)old into: (NSArray *)new {
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:new.count];
+    for (NSUInteger i = 0; i < new.count; i++) {
+        [result addObject:[NSNull null]];
+    }
+    NSMutableIndexSet *leaving = [NSMutableIndexSet indexSet];
+    for (NSIndexPath *path in diff.deleted) {
+        [leaving addIndex:path.row];
+    }
+    NSMutableIndexSet *arriving = [NSMutableIndexSet indexSet];
+    for (NSIndexPath *path in diff.inserted) {
+        result[path.row] = new[path.row];
+        [arriving addIndex:path.row];
+    }
+    for (NSArray<NSIndexPath *> *move in diff.moved) {
+        result[move[1].row] = old[move[0].row];
+        [leaving addIndex:move[0].row];
+        [arriving addIndex:move[1].row];
+    }
+    // the rest keeps relative order
+    NSUInteger next = 0;
+    for (NSUInteger i = 0; i < old.count; i++) {
+        if ([leaving containsIndex:i]) {
+            continue;
+        }
+        while ([arriving containsIndex:next]) {
+            next++;
+        }
+        XCTAssertLessThan(next, new.count);
+        if (next < new.count) {
+            result[next++] = old[i];
+        }
+    }
+    XCTAssertEqualObjects(result, new);
+}
+
+@end
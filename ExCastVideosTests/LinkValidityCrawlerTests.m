@@ -0,0 +1,300 @@
+//
+//  LinkValidityCrawlerTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "LinkValidityCrawler.h"
+#import "CVMediaRecordMO.h"
+#import "StubURLProtocol.h"
+#import "XCTestCase+Tasks.h"
+
+// The latency of stub server in tests of timing
+static const NSTimeInterval kLatency = 0.05;
+// The tolerated early start of request scheduled by timer
+static const NSTimeInterval kTimerTolerance = 0.02;
+
+@interface LinkValidityCrawlerTests : XCTestCase
+
+@end
+
+@implementation LinkValidityCrawlerTests {
+    CVCoreDataController *_dataController;
+    LinkValidityCrawler *_crawler;
+    NSURL *_stateURL;
+    // The time returned by crawler clock
+    CFAbsoluteTime _now;
+}
+
+- (void) setUp {
+    [super setUp];
+    [StubURLProtocol reset];
+    _now = 1000;
+    _dataController = [self scratchDataController];
+    _stateURL = [self temporaryFileURLWithExtension:@"plist"];
+    _crawler = [[LinkValidityCrawler alloc] initWithDataController: _dataController
+                                              sessionConfiguration: [StubURLProtocol sessionConfiguration]
+                                                          stateURL: _stateURL];
+    _crawler.requestsPerSecond = 1000;
+    _crawler.initialBackoff = 0;
+    __weak LinkValidityCrawlerTests *weakSelf = self;
+    _crawler.clock = ^CFAbsoluteTime {
+        LinkValidityCrawlerTests *strongSelf = weakSelf;
+        return strongSelf ? strongSelf->_now : 0;
+    };
+}
+
+- (void) tearDown {
+    [_crawler stop];
+    [[NSFileManager defaultManager] removeItemAtURL:_stateURL error:nil];
+    [StubURLProtocol reset];
+    [super tearDown];
+}
+
+#pragma mark - rate limiter
+
+- (void) testRateLimiterSpendsBurstThenSpreadsRequests {
+    HostRateLimiter *limiter = [[HostRateLimiter alloc] initWithRate:1 burst:2];
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:0], 0, 1e-9);
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:0], 0, 1e-9);
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:0], 1, 1e-9);
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:0], 2, 1e-9);
+    // debt is paid off after three seconds and one more second refills a token
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:4], 0, 1e-9);
+    // refill never exceeds burst
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:100], 0, 1e-9);
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:100], 0, 1e-9);
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:100], 1, 1e-9);
+}
+
+- (void) testRateLimiterIgnoresClockGoingBack {
+    HostRateLimiter *limiter = [[HostRateLimiter alloc] initWithRate:2 burst:1];
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:10], 0, 1e-9);
+    XCTAssertEqualWithAccuracy([limiter reserveAtTime:5], 0.5, 1e-9);
+}
+
+#pragma mark - single links
+
+- (void) testAnsweringLinkIsAlive {
+    NSURL *url = [NSURL URLWithString:@"http://media.test/alive"];
+    [StubURLProtocol stubURL:url withResponses:@[[StubResponse responseWithStatus:200]]];
+    BFTask *task = [self waitForTask:[_crawler checkURL:url]];
+    XCTAssertEqual([task.result integerValue], LinkStateAlive);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:url], 1);
+}
+
+- (void) testGoneLinkIsDeadWithoutRetries {
+    NSURL *notFound = [NSURL URLWithString:@"http://media.test/404"];
+    NSURL *gone = [NSURL URLWithString:@"http://media.test/410"];
+    [StubURLProtocol stubURL:notFound withResponses:@[[StubResponse responseWithStatus:404]]];
+    [StubURLProtocol stubURL:gone withResponses:@[[StubResponse responseWithStatus:410]]];
+    XCTAssertEqual([[self waitForTask:[_crawler checkURL:notFound]].result integerValue], LinkStateDead);
+    XCTAssertEqual([[self waitForTask:[_crawler checkURL:gone]].result integerValue], LinkStateDead);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:notFound], 1);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:gone], 1);
+}
+
+- (void) testFailingLinkIsRetried {
+    NSURL *url = [NSURL URLWithString:@"http://media.test/flaky"];
+    [StubURLProtocol stubURL:url withResponses:@[[StubResponse responseWithStatus:500],
+                                                 [StubResponse responseWithStatus:503],
+                                                 [StubResponse responseWithStatus:200]]];
+    BFTask *task = [self waitForTask:[_crawler checkURL:url]];
+    XCTAssertEqual([task.result integerValue], LinkStateAlive);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:url], 3);
+}
+
+- (void) testLinkFailingAfterRetriesIsUnknown {
+    NSURL *url = [NSURL URLWithString:@"http://media.test/down"];
+    [StubURLProtocol stubURL:url withResponses:@[[StubResponse responseWithStatus:502]]];
+    _crawler.maxRetries = 2;
+    BFTask *task = [self waitForTask:[_crawler checkURL:url]];
+    XCTAssertEqual([task.result integerValue], LinkStateUnknown);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:url], 3);
+}
+
+- (void) testMissingHostIsDeadAfterRetries {
+    // URLs which are not stubbed fail as if host was not found
+    NSURL *url = [NSURL URLWithString:@"http://gone.test/page"];
+    _crawler.maxRetries = 1;
+    BFTask *task = [self waitForTask:[_crawler checkURL:url]];
+    XCTAssertEqual([task.result integerValue], LinkStateDead);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:url], 2);
+}
+
+- (void) testOfflineLinkIsNotRetried {
+    NSURL *url = [NSURL URLWithString:@"http://media.test/offline"];
+    NSError *offline = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:nil];
+    [StubURLProtocol stubURL:url withResponses:@[[StubResponse responseWithError:offline]]];
+    BFTask *task = [self waitForTask:[_crawler checkURL:url]];
+    XCTAssertEqual([task.result integerValue], LinkStateUnknown);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:url], 1);
+}
+
+#pragma mark - passes
+
+- (void) testPassMarksRecordsByTheirLinks {
+    [self saveRecordWithURL:@"http://media.test/a" status:200];
+    [self saveRecordWithURL:@"http://media.test/b" status:404];
+    [self saveRecordWithURL:@"http://media.test/c" status:200];
+
+    BFTask *pass = [self waitForTask:[_crawler start]];
+    XCTAssertEqualObjects(pass.result, @3);
+    NSDictionary<NSString *, NSNumber *> *validity = [self validityOfRecords];
+    XCTAssertEqualObjects(validity[@"http://media.test/a"], @YES);
+    XCTAssertEqualObjects(validity[@"http://media.test/b"], @NO);
+    XCTAssertEqualObjects(validity[@"http://media.test/c"], @YES);
+}
+
+- (void) testStartAfterStopResumesRunningPass {
+    [self saveRecordWithURL:@"http://media.test/a" status:200];
+    [self saveRecordWithURL:@"http://media.test/b" status:200];
+    [self saveRecordWithURL:@"http://media.test/c" status:200];
+    _crawler.batchSize = 1;
+
+    BFTask *first = [_crawler start];
+    // going to background and back before the first batch is committed
+    [_crawler stop];
+    BFTask *second = [_crawler start];
+    XCTAssertEqual(first, second);
+
+    BFTask *pass = [self waitForTask:second];
+    XCTAssertEqualObjects(pass.result, @3, @"pass must not stop after the first batch");
+    XCTAssertFalse([_crawler isRunning]);
+}
+
+- (void) testStopKeepsCursorForNextStart {
+    [self saveRecordWithURL:@"http://media.test/a" status:200];
+    [self saveRecordWithURL:@"http://media.test/b" status:200];
+    [self saveRecordWithURL:@"http://media.test/c" status:200];
+    _crawler.batchSize = 1;
+
+    BFTask *first = [_crawler start];
+    [_crawler stop];
+    XCTAssertEqualObjects([self waitForTask:first].result, @1);
+
+    BFTask *rest = [self waitForTask:[_crawler start]];
+    XCTAssertEqualObjects(rest.result, @2);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:[NSURL URLWithString:@"http://media.test/a"]], 1);
+}
+
+- (void) testNextPassWaitsForPassInterval {
+    [self saveRecordWithURL:@"http://media.test/a" status:200];
+    _crawler.passInterval = 60;
+    XCTAssertEqualObjects([self waitForTask:[_crawler start]].result, @1);
+
+    _now += 59;
+    XCTAssertEqualObjects([self waitForTask:[_crawler start]].result, @0);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:[NSURL URLWithString:@"http://media.test/a"]], 1);
+
+    _now += 1;
+    XCTAssertEqualObjects([self waitForTask:[_crawler start]].result, @1);
+    XCTAssertEqual([StubURLProtocol requestCountForURL:[NSURL URLWithString:@"http://media.test/a"]], 2);
+}
+
+#pragma mark - latency and failures
+
+- (void) testPassSpacesRequestsPerHostAndBacksOffUnderLatency {
+    [self useRealClock];
+    _crawler.requestsPerSecond = 10;
+    _crawler.burst = 1;
+    _crawler.initialBackoff = 0.2;
+    StubResponse *alive = [[StubResponse responseWithStatus:200] responseAfterDelay:kLatency];
+    for (NSUInteger i = 0; i < 4; i++) {
+        [self saveRecordWithURL:[NSString stringWithFormat:@"http://a.test/%lu", (unsigned long)i] responses:@[alive]];
+        [self saveRecordWithURL:[NSString stringWithFormat:@"http://b.test/%lu", (unsigned long)i] responses:@[alive]];
+    }
+    NSError *timeout = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil];
+    [self saveRecordWithURL: @"http://flaky.test/1"
+                  responses: @[[[StubResponse responseWithStatus:503] responseAfterDelay:kLatency],
+                               [[StubResponse responseWithError:timeout] responseAfterDelay:kLatency],
+                               alive]];
+
+    BFTask *pass = [self waitForTask:[_crawler start] timeout:30];
+    XCTAssertEqualObjects(pass.result, @9);
+    for (NSNumber *valid in [[self validityOfRecords] allValues]) {
+        XCTAssertEqualObjects(valid, @YES);
+    }
+
+    NSArray<NSNumber *> *hostA = [StubURLProtocol requestTimesForHost:@"a.test"];
+    NSArray<NSNumber *> *hostB = [StubURLProtocol requestTimesForHost:@"b.test"];
+    XCTAssertEqual(hostA.count, 4);
+    XCTAssertEqual(hostB.count, 4);
+    [self assertIntervalsOfTimes:hostA atLeast:0.1 - kTimerTolerance ofHost:@"a.test"];
+    [self assertIntervalsOfTimes:hostB atLeast:0.1 - kTimerTolerance ofHost:@"b.test"];
+    // hosts are limited independently
+    XCTAssertLessThan(fabs([hostA.firstObject doubleValue] - [hostB.firstObject doubleValue]), 0.1);
+
+    // retries wait for response and doubling backoff
+    NSArray<NSNumber *> *flaky = [StubURLProtocol requestTimesForHost:@"flaky.test"];
+    XCTAssertEqual(flaky.count, 3);
+    if (flaky.count == 3) {
+        XCTAssertGreaterThanOrEqual([flaky[1] doubleValue] - [flaky[0] doubleValue], kLatency + 0.2);
+        XCTAssertGreaterThanOrEqual([flaky[2] doubleValue] - [flaky[1] doubleValue], kLatency + 0.4);
+    }
+}
+
+- (void) testThrottledLinkIsRetriedAfterRetryAfter {
+    [self useRealClock];
+    _crawler.initialBackoff = 0.1;
+    NSURL *url = [NSURL URLWithString:@"http://busy.test/page"];
+    [StubURLProtocol stubURL: url
+               withResponses: @[[[StubResponse responseWithStatus:429 headers:@{@"Retry-After": @"1"} body:nil] responseAfterDelay:kLatency],
+                                [[StubResponse responseWithStatus:200] responseAfterDelay:kLatency]]];
+    BFTask *task = [self waitForTask:[_crawler checkURL:url]];
+    XCTAssertEqual([task.result integerValue], LinkStateAlive);
+    NSArray<NSNumber *> *times = [StubURLProtocol requestTimesForHost:@"busy.test"];
+    XCTAssertEqual(times.count, 2);
+    if (times.count == 2) {
+        XCTAssertGreaterThanOrEqual([times[1] doubleValue] - [times[0] doubleValue], kLatency + 1);
+    }
+}
+
+#pragma mark - private
+
+- (void) useRealClock {
+    _crawler.clock = ^CFAbsoluteTime {
+        return CFAbsoluteTimeGetCurrent();
+    };
+}
+
+- (void) assertIntervalsOfTimes: (NSArray<NSNumber *> *)times atLeast: (NSTimeInterval)interval ofHost: (NSString *)host {
+    for (NSUInteger i = 1; i < times.count; i++) {
+        NSTimeInterval spacing = [times[i] doubleValue] - [times[i - 1] doubleValue];
+        XCTAssertGreaterThanOrEqual(spacing, interval, @"request %lu to %@", (unsigned long)i, host);
+    }
+}
+
+- (void) saveRecordWithURL: (NSString *)address status: (NSInteger)status {
+    [self saveRecordWithURL:address responses:@[[StubResponse responseWithStatus:status]]];
+}
+
+- (void) saveRecordWithURL: (NSString *)address responses: (NSArray<StubResponse *> *)responses {
+    NSURL *url = [NSURL URLWithString:address];
+    [StubURLProtocol stubURL:url withResponses:responses];
+    BFTask *task = [self waitForTask:[_dataController saveWithURL: url
+                                                            title: address
+                                                      description: nil
+                                                            genre: @"Drama"
+                                                         subGenre: @"Comedy"
+                                                     thumbnailURL: [url URLByAppendingPathComponent:@"thumbnail.jpg"]]];
+    XCTAssertNil(task.error);
+}
+
+- (NSDictionary<NSString *, NSNumber *> *) validityOfRecords {
+    BFTask *task = [self waitForTask:[_dataController performBackgroundTask:^id (NSManagedObjectContext *context, NSError **error) {
+        NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:kMediaRecordEntityName];
+        NSArray<CVMediaRecordMO *> *records = [context executeFetchRequest:request error:error];
+        NSMutableDictionary<NSString *, NSNumber *> *validity = [NSMutableDictionary dictionary];
+        for (CVMediaRecordMO *record in records) {
+            validity[record.pageUrl] = record.valid;
+        }
+        return records ? validity : nil;
+    }]];
+    return task.result;
+}
+
+@end
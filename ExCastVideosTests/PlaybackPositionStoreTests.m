@@ -0,0 +1,108 @@
+//
+//  PlaybackPositionStoreTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "PlaybackPositionStore.h"
+#import "CVMediaTrack+CoreDataProperties.h"
+#import "XCTestCase+Tasks.h"
+
+@interface PlaybackPositionStoreTests : XCTestCase
+
+@end
+
+@implementation PlaybackPositionStoreTests {
+    NSURL *_journalURL;
+    CVCoreDataController *_dataController;
+}
+
+- (void) setUp {
+    [super setUp];
+    _journalURL = [self temporaryFileURLWithExtension:@"journal"];
+    _dataController = [self scratchDataController];
+}
+
+- (void) tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:_journalURL error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:[self compactPath] error:nil];
+    [super tearDown];
+}
+
+- (void) testPendingPositionsAreReplayedAfterRestart {
+    CVMediaTrack *first = [self trackWithAddress:@"http://media.test/1.mp4"];
+    PlaybackPositionStore *store = [self newStore];
+    [store setPosition:12.5 forTrack:first];
+    [store setPosition:13.5 forTrack:first];
+
+    PlaybackPositionStore *restarted = [self newStore];
+    XCTAssertEqual(restarted.pendingCount, 1);
+    XCTAssertEqual([restarted positionForTrack:first], 13.5);
+}
+
+- (void) testCompactionKeepsLatestPositions {
+    CVMediaTrack *track = [self trackWithAddress:@"http://media.test/compacted.mp4"];
+    PlaybackPositionStore *store = [self newStore];
+    // several times more records than initial journal holds
+    for (NSUInteger i = 1; i <= 5000; i++) {
+        [store setPosition:i forTrack:track];
+    }
+    XCTAssertEqual([store positionForTrack:track], 5000);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[self compactPath]]);
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[_journalURL path] error:nil];
+    XCTAssertEqual([attributes fileSize], 64 * 1024, @"Compacted journal must not grow");
+
+    PlaybackPositionStore *restarted = [self newStore];
+    XCTAssertEqual(restarted.pendingCount, 1);
+    XCTAssertEqual([restarted positionForTrack:track], 5000);
+}
+
+- (void) testInterruptedCompactionDoesNotLosePositions {
+    CVMediaTrack *track = [self trackWithAddress:@"http://media.test/interrupted.mp4"];
+    PlaybackPositionStore *store = [self newStore];
+    [store setPosition:42 forTrack:track];
+    // crash while compacted journal was written, before it replaced the journal
+    [[NSData dataWithBytes:"EXPJ" length:4] writeToFile:[self compactPath] atomically:NO];
+
+    PlaybackPositionStore *restarted = [self newStore];
+    XCTAssertEqual(restarted.pendingCount, 1);
+    XCTAssertEqual([restarted positionForTrack:track], 42);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[self compactPath]]);
+}
+
+- (void) testFlushCompactsJournal {
+    CVMediaTrack *track = [self trackWithAddress:@"http://media.test/flushed.mp4"];
+    PlaybackPositionStore *store = [self newStore];
+    [store setPosition:7 forTrack:track];
+    [self waitForTask:[store flush]];
+    XCTAssertEqual(store.pendingCount, 0);
+    XCTAssertEqual(store.flushes, 1);
+
+    PlaybackPositionStore *restarted = [self newStore];
+    XCTAssertEqual(restarted.pendingCount, 0);
+}
+
+#pragma mark - private
+
+- (PlaybackPositionStore *) newStore {
+    PlaybackPositionStore *store = [[PlaybackPositionStore alloc] initWithJournalURL:_journalURL
+                                                                      dataController:_dataController];
+    store.flushInterval = 60 * 60;
+    return store;
+}
+
+- (NSString *) compactPath {
+    return [[_journalURL path] stringByAppendingPathExtension:@"compact"];
+}
+
+- (CVMediaTrack *) trackWithAddress: (NSString *)address {
+    CVMediaTrack *track = [NSEntityDescription insertNewObjectForEntityForName:kMediaTrackEntityName
+                                                        inManagedObjectContext:_dataController.managedObjectContext];
+    track.address = address;
+    return track;
+}
+
+@end
@@ -0,0 +1,245 @@
+//
+//  PrefetchSchedulerTests.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "PrefetchScheduler.h"
+
+@interface PrefetchSchedulerTests : XCTestCase
+
+@end
+
+@implementation PrefetchSchedulerTests {
+    // The keys in order works were started
+    NSMutableArray<NSString *> *_started;
+    // The keys which works were cancelled
+    NSMutableArray<NSString *> *_cancelled;
+    // The completions of running works keyed by request key
+    NSMutableDictionary<NSString *, void (^)(void)> *_completions;
+}
+
+- (void) setUp {
+    [super setUp];
+    _started = [NSMutableArray array];
+    _cancelled = [NSMutableArray array];
+    _completions = [NSMutableDictionary dictionary];
+}
+
+#pragma mark - prediction
+
+- (void) testStillListPrefetchesVisibleThenAheadThenBehind {
+    NSArray *indexes = [PrefetchScheduler indexesToPrefetchForVisibleRange:NSMakeRange(10, 10)
+                                                                  velocity:0
+                                                                 itemCount:100
+                                                                 lookahead:6];
+    NSMutableArray *expected = [NSMutableArray array];
+    for (NSUInteger i = 10; i < 26; i++) {
+        [expected addObject:@(i)];
+    }
+    [expected addObject:@9];
+    XCTAssertEqualObjects(indexes, expected);
+}
+
+- (void) testFastScrollingLooksFartherAhead {
+    NSArray<NSNumber *> *slow = [PrefetchScheduler indexesToPrefetchForVisibleRange:NSMakeRange(10, 10)
+                                                                           velocity:5
+                                                                          itemCount:1000
+                                                                          lookahead:6];
+    NSArray<NSNumber *> *fast = [PrefetchScheduler indexesToPrefetchForVisibleRange:NSMakeRange(10, 10)
+                                                                           velocity:30
+                                                                          itemCount:1000
+                                                                          lookahead:6];
+    XCTAssertEqual(slow.count, 10 + 6 + 5 + 1);
+    XCTAssertEqual(fast.count, 10 + 6 + 30 + 1);
+    XCTAssertEqualObjects(fast[10 + 6 + 30 - 1], @55);
+    XCTAssertEqualObjects(fast.lastObject, @9);
+
+    // lookahead is limited to few screens however fast the list scrolls
+    NSArray<NSNumber *> *fling = [PrefetchScheduler indexesToPrefetchForVisibleRange:NSMakeRange(10, 10)
+                                                                            velocity:10000
+                                                                           itemCount:1000
+                                                                           lookahead:6];
+    XCTAssertEqual(fling.count, 10 + 6 + 40 + 1);
+}
+
+- (void) testScrollingUpPrefetchesItemsBeforeFirst {
+    NSArray *indexes = [PrefetchScheduler indexesToPrefetchForVisibleRange:NSMakeRange(10, 10)
+                                                                  velocity:-30
+                                                                 itemCount:100
+                                                                 lookahead:6];
+    NSMutableArray *expected = [NSMutableArray array];
+    for (NSUInteger i = 10; i < 20; i++) {
+        [expected addObject:@(i)];
+    }
+    for (NSInteger i = 9; i >= 0; i--) {
+        [expected addObject:@(i)];
+    }
+    [expected addObject:@20];
+    XCTAssertEqualObjects(indexes, expected);
+}
+
+- (void) testIndexesAreClampedToList {
+    NSArray *indexes = [PrefetchScheduler indexesToPrefetchForVisibleRange:NSMakeRange(18, 10)
+                                                                  velocity:0
+                                                                 itemCount:22
+                                                                 lookahead:6];
+    XCTAssertEqualObjects(indexes, (@[@18, @19, @20, @21, @17]));
+    XCTAssertEqualObjects([PrefetchScheduler indexesToPrefetchForVisibleRange:NSMakeRange(0, 10)
+                                                                     velocity:0
+                                                                    itemCount:0
+                                                                    lookahead:6], @[]);
+}
+
+- (void) testPredictionPerformance {
+    [self measureBlock:^{
+        NSUInteger total = 0;
+        for (NSUInteger i = 0; i < 10000; i++) {
+            total += [PrefetchScheduler indexesToPrefetchForVisibleRange: NSMakeRange(i * 7 % 100000, 12)
+                                                                velocity: (double)(i % 200) - 100
+                                                               itemCount: 100000
+                                                               lookahead: 8].count;
+        }
+        XCTAssertGreaterThan(total, 0);
+    }];
+}
+
+#pragma mark - scheduling
+
+- (void) testHighestPriorityStartsFirstWithinConcurrencyLimit {
+    PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+    scheduler.maxConcurrentTasks = 2;
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:1],
+                                  [self requestWithKey:@"b" priority:3],
+                                  [self requestWithKey:@"c" priority:2],
+                                  [self requestWithKey:@"d" priority:0]]];
+    XCTAssertEqualObjects(_started, (@[@"b", @"c"]));
+    XCTAssertEqual(scheduler.runningCount, 2);
+    XCTAssertEqual(scheduler.pendingCount, 2);
+
+    [self completeKey:@"c"];
+    XCTAssertEqualObjects(_started, (@[@"b", @"c", @"a"]));
+    XCTAssertEqual(scheduler.completedCount, 1);
+}
+
+- (void) testDuplicateKeysKeepHighestPriority {
+    PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+    scheduler.maxConcurrentTasks = 1;
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:1],
+                                  [self requestWithKey:@"b" priority:2],
+                                  [self requestWithKey:@"a" priority:5]]];
+    XCTAssertEqualObjects(_started, @[@"a"]);
+    XCTAssertEqual(scheduler.pendingCount, 1);
+}
+
+- (void) testRequestsOverBudgetAreDroppedByLowestPriority {
+    PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+    scheduler.maxConcurrentTasks = 1;
+    scheduler.budget = 3;
+    NSMutableArray<PrefetchRequest *> *requests = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 6; i++) {
+        [requests addObject:[self requestWithKey:[NSString stringWithFormat:@"%lu", (unsigned long)i] priority:i]];
+    }
+    [scheduler scheduleRequests:requests];
+    XCTAssertEqual(scheduler.runningCount + scheduler.pendingCount, 3);
+
+    for (NSUInteger i = 0; i < 3; i++) {
+        [self completeKey:_started.lastObject];
+    }
+    XCTAssertEqualObjects(_started, (@[@"5", @"4", @"3"]));
+    XCTAssertEqual(scheduler.pendingCount, 0);
+    XCTAssertEqual(scheduler.runningCount, 0);
+}
+
+- (void) testRunningWorkNotWantedAnymoreIsCancelled {
+    PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+    scheduler.maxConcurrentTasks = 2;
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:2], [self requestWithKey:@"b" priority:1]]];
+    void (^lateCompletion)(void) = _completions[@"a"];
+
+    [scheduler scheduleRequests:@[[self requestWithKey:@"b" priority:1], [self requestWithKey:@"c" priority:3]]];
+    XCTAssertEqualObjects(_cancelled, @[@"a"]);
+    XCTAssertEqual(scheduler.cancelledCount, 1);
+    XCTAssertEqualObjects(_started, (@[@"a", @"b", @"c"]), @"Running b is not started again");
+
+    // completion of cancelled work is ignored
+    lateCompletion();
+    XCTAssertEqual(scheduler.completedCount, 0);
+    XCTAssertEqual(scheduler.runningCount, 2);
+}
+
+- (void) testCompletedRequestIsNotRepeatedUntilInvalidated {
+    PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:1]]];
+    [self completeKey:@"a"];
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:1]]];
+    XCTAssertEqualObjects(_started, @[@"a"]);
+
+    [scheduler invalidateKey:@"a"];
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:1]]];
+    XCTAssertEqualObjects(_started, (@[@"a", @"a"]));
+}
+
+- (void) testDroppedCompletedRequestIsStartedAgain {
+    PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:1]]];
+    [self completeKey:@"a"];
+    [scheduler scheduleRequests:@[]];
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:1]]];
+    XCTAssertEqualObjects(_started, (@[@"a", @"a"]));
+}
+
+- (void) testCancelAllDropsPendingAndCancelsRunning {
+    PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+    scheduler.maxConcurrentTasks = 1;
+    [scheduler scheduleRequests:@[[self requestWithKey:@"a" priority:2], [self requestWithKey:@"b" priority:1]]];
+    [scheduler cancelAll];
+    XCTAssertEqualObjects(_cancelled, @[@"a"]);
+    XCTAssertEqual(scheduler.pendingCount, 0);
+    XCTAssertEqual(scheduler.runningCount, 0);
+}
+
+- (void) testSchedulingPerformance {
+    NSMutableArray<NSArray<PrefetchRequest *> *> *rounds = [NSMutableArray array];
+    for (NSUInteger round = 0; round < 200; round++) {
+        // the window of wanted items slides as list scrolls
+        NSMutableArray<PrefetchRequest *> *requests = [NSMutableArray array];
+        for (NSUInteger i = 0; i < 64; i++) {
+            NSString *key = [NSString stringWithFormat:@"%lu", (unsigned long)(round + i)];
+            [requests addObject:[PrefetchRequest requestWithKey:key priority:64.0 - i work:^PrefetchCancelBlock (void (^completion)(void)) {
+                return nil;
+            }]];
+        }
+        [rounds addObject:requests];
+    }
+    [self measureBlock:^{
+        PrefetchScheduler *scheduler = [[PrefetchScheduler alloc] init];
+        for (NSArray<PrefetchRequest *> *requests in rounds) {
+            [scheduler scheduleRequests:requests];
+        }
+        [scheduler cancelAll];
+    }];
+}
+
+#pragma mark - private
+
+- (PrefetchRequest *) requestWithKey: (NSString *)key priority: (double)priority {
+    return [PrefetchRequest requestWithKey:key priority:priority work:^PrefetchCancelBlock (void (^completion)(void)) {
+        [_started addObject:key];
+        _completions[key] = completion;
+        return ^{
+            [_cancelled addObject:key];
+        };
+    }];
+}
+
+- (void) completeKey: (NSString *)key {
+    void (^completion)(void) = _completions[key];
+    [_completions removeObjectForKey:key];
+    completion();
+}
+
+@end
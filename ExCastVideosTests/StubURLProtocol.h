@@ -0,0 +1,78 @@
+//
+//  StubURLProtocol.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The canned answer of stub HTTP server
+ */
+@interface StubResponse : NSObject
+
+// The status code, ignored if error is set
+@property (nonatomic, assign, readonly) NSInteger statusCode;
+// The response headers
+@property (nonatomic, copy, readonly) NSDictionary<NSString *, NSString *> *__nullable headers;
+// The response body
+@property (nonatomic, copy, readonly) NSData *__nullable body;
+// The transport error to fail request with
+@property (nonatomic, strong, readonly) NSError *__nullable error;
+// The time before response or error is delivered, i.e. the latency of server
+@property (nonatomic, assign, readonly) NSTimeInterval delay;
+
++ (instancetype __nonnull) responseWithStatus: (NSInteger)statusCode;
+
++ (instancetype __nonnull) responseWithStatus: (NSInteger)statusCode
+                                      headers: (NSDictionary<NSString *, NSString *> *__nullable)headers
+                                         body: (NSData *__nullable)body;
+
++ (instancetype __nonnull) responseWithError: (NSError *__nonnull)error;
+
+/*!
+ Returns copy of response delivered after specified delay
+ */
+- (instancetype __nonnull) responseAfterDelay: (NSTimeInterval)delay;
+
+@end
+
+/**
+ * The stub HTTP server answering requests of session in process. Every stubbed URL answers with its
+ * responses in order, the last one is repeated, after the delay of response. Requests to URLs which are
+ * not stubbed fail as if host was not found. Stubs are shared by all sessions, tests must reset them.
+ */
+@interface StubURLProtocol : NSURLProtocol
+
+/*!
+ Returns ephemeral session configuration served by stubs
+ */
++ (NSURLSessionConfiguration *__nonnull) sessionConfiguration;
+
+/*!
+ Sets responses of URL
+ */
++ (void) stubURL: (NSURL *__nonnull)url withResponses: (NSArray<StubResponse *> *__nonnull)responses;
+
+/*!
+ Returns number of requests received for URL
+ */
++ (NSUInteger) requestCountForURL: (NSURL *__nonnull)url;
+
+/*!
+ Returns the last request received for URL
+ */
++ (NSURLRequest *__nullable) lastRequestForURL: (NSURL *__nonnull)url;
+
+/*!
+ Returns times when requests to host were received, in order of arrival
+ */
++ (NSArray<NSNumber *> *__nonnull) requestTimesForHost: (NSString *__nonnull)host;
+
+/*!
+ Removes all stubs and counters
+ */
++ (void) reset;
+
+@end
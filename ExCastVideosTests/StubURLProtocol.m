@@ -0,0 +1,193 @@
+//
+//  StubURLProtocol.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "StubURLProtocol.h"
+
+@interface StubResponse ()
+
+@property (nonatomic, assign, readwrite) NSInteger statusCode;
+@property (nonatomic, copy, readwrite) NSDictionary<NSString *, NSString *> *headers;
+@property (nonatomic, copy, readwrite) NSData *body;
+@property (nonatomic, strong, readwrite) NSError *error;
+@property (nonatomic, assign, readwrite) NSTimeInterval delay;
+
+@end
+
+@implementation StubResponse
+
++ (instancetype) responseWithStatus: (NSInteger)statusCode {
+    return [self responseWithStatus:statusCode headers:nil body:nil];
+}
+
++ (instancetype) responseWithStatus: (NSInteger)statusCode
+                            headers: (NSDictionary<NSString *, NSString *> *)headers
+                               body: (NSData *)body {
+    StubResponse *response = [[StubResponse alloc] init];
+    response.statusCode = statusCode;
+    response.headers = headers;
+    response.body = body;
+    return response;
+}
+
++ (instancetype) responseWithError: (NSError *)error {
+    StubResponse *response = [[StubResponse alloc] init];
+    response.error = error;
+    return response;
+}
+
+- (instancetype) responseAfterDelay: (NSTimeInterval)delay {
+    StubResponse *response = [[StubResponse alloc] init];
+    response.statusCode = self.statusCode;
+    response.headers = self.headers;
+    response.body = self.body;
+    response.error = self.error;
+    response.delay = delay;
+    return response;
+}
+
+@end
+
+// The stubs, counters and last requests keyed by absolute URL, guarded by the class
+static NSMutableDictionary<NSString *, NSArray<StubResponse *> *> *stubs;
+static NSMutableDictionary<NSString *, NSNumber *> *requestCounts;
+static NSMutableDictionary<NSString *, NSURLRequest *> *lastRequests;
+// The arrival times of requests keyed by host, guarded by the class
+static NSMutableDictionary<NSString *, NSMutableArray<NSNumber *> *> *requestTimes;
+
+@implementation StubURLProtocol {
+    // The thread and run loop mode of loading, client is called on them only
+    NSThread *_clientThread;
+    NSString *_clientMode;
+    BOOL _stopped;
+}
+
++ (void) initialize {
+    if (self == [StubURLProtocol class]) {
+        stubs = [NSMutableDictionary dictionary];
+        requestCounts = [NSMutableDictionary dictionary];
+        lastRequests = [NSMutableDictionary dictionary];
+        requestTimes = [NSMutableDictionary dictionary];
+    }
+}
+
++ (NSURLSessionConfiguration *) sessionConfiguration {
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.protocolClasses = @[[StubURLProtocol class]];
+    return configuration;
+}
+
++ (void) stubURL: (NSURL *)url withResponses: (NSArray<StubResponse *> *)responses {
+    @synchronized (self) {
+        stubs[url.absoluteString] = [responses copy];
+    }
+}
+
++ (NSUInteger) requestCountForURL: (NSURL *)url {
+    @synchronized (self) {
+        return [requestCounts[url.absoluteString] unsignedIntegerValue];
+    }
+}
+
++ (NSURLRequest *) lastRequestForURL: (NSURL *)url {
+    @synchronized (self) {
+        return lastRequests[url.absoluteString];
+    }
+}
+
++ (NSArray<NSNumber *> *) requestTimesForHost: (NSString *)host {
+    @synchronized (self) {
+        return [requestTimes[host] copy] ?: @[];
+    }
+}
+
++ (void) reset {
+    @synchronized (self) {
+        [stubs removeAllObjects];
+        [requestCounts removeAllObjects];
+        [lastRequests removeAllObjects];
+        [requestTimes removeAllObjects];
+    }
+}
+
+#pragma mark - NSURLProtocol
+
++ (BOOL) canInitWithRequest: (NSURLRequest *)request {
+    NSString *scheme = request.URL.scheme.lowercaseString;
+    return [scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"];
+}
+
++ (NSURLRequest *) canonicalRequestForRequest: (NSURLRequest *)request {
+    return request;
+}
+
+- (void) startLoading {
+    NSString *key = self.request.URL.absoluteString;
+    NSString *host = self.request.URL.host ?: @"";
+    StubResponse *stub;
+    @synchronized ([StubURLProtocol class]) {
+        NSUInteger served = [requestCounts[key] unsignedIntegerValue];
+        NSArray<StubResponse *> *responses = stubs[key];
+        stub = responses.count > 0 ? responses[MIN(served, responses.count - 1)] : nil;
+        requestCounts[key] = @(served + 1);
+        lastRequests[key] = self.request;
+        if (!requestTimes[host]) {
+            requestTimes[host] = [NSMutableArray array];
+        }
+        [requestTimes[host] addObject:@(CFAbsoluteTimeGetCurrent())];
+    }
+    if (!stub) {
+        stub = [StubResponse responseWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                                   code:NSURLErrorCannotFindHost
+                                                               userInfo:nil]];
+    }
+    if (stub.delay <= 0) {
+        [self deliverResponse:stub];
+        return;
+    }
+    _clientThread = [NSThread currentThread];
+    _clientMode = [[NSRunLoop currentRunLoop] currentMode] ?: NSDefaultRunLoopMode;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(stub.delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self performSelector: @selector(deliverResponse:)
+                     onThread: _clientThread
+                   withObject: stub
+                waitUntilDone: NO
+                        modes: @[_clientMode]];
+    });
+}
+
+- (void) stopLoading {
+    // delayed answer of cancelled request is dropped
+    _stopped = YES;
+}
+
+#pragma mark - private
+
+/**
+ * Passes stubbed response or error to client, must be called on client thread
+ */
+- (void) deliverResponse: (StubResponse *)stub {
+    if (_stopped) {
+        return;
+    }
+    if (stub.error) {
+        [self.client URLProtocol:self didFailWithError:stub.error];
+        return;
+    }
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL: self.request.URL
+                                                              statusCode: stub.statusCode
+                                                             HTTPVersion: @"HTTP/1.1"
+                                                            headerFields: stub.headers];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    if (stub.body.length > 0 && !_stopped) {
+        [self.client URLProtocol:self didLoadData:stub.body];
+    }
+    if (!_stopped) {
+        [self.client URLProtocolDidFinishLoading:self];
+    }
+}
+
+@end
@@ -0,0 +1,36 @@
+//
+//  XCTestCase+Tasks.h
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import <XCTest/XCTest.h>
+#import <Bolts/Bolts.h>
+
+@class CVCoreDataController;
+
+@interface XCTestCase (Tasks)
+
+/*!
+ Waits for task while main queue keeps running and fails test if it did not complete in time.
+ @return The completed task
+ */
+- (BFTask *) waitForTask: (BFTask *)task timeout: (NSTimeInterval)timeout;
+
+/*!
+ Waits for task ten seconds at most
+ */
+- (BFTask *) waitForTask: (BFTask *)task;
+
+/*!
+ Returns data controller of new in-memory store
+ */
+- (CVCoreDataController *) scratchDataController;
+
+/*!
+ Returns URL of new file in temporary directory, test removes the file itself
+ */
+- (NSURL *) temporaryFileURLWithExtension: (NSString *)extension;
+
+@end
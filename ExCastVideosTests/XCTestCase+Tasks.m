@@ -0,0 +1,39 @@
+//
+//  XCTestCase+Tasks.m
+//  CastVideos
+//
+//  Created by Iaroslav Omelianenko on 10/17/16.
+//
+
+#import "XCTestCase+Tasks.h"
+
+#import <CoreData/CoreData.h>
+
+#import "CVCoreDataController.h"
+
+@implementation XCTestCase (Tasks)
+
+- (BFTask *) waitForTask: (BFTask *)task timeout: (NSTimeInterval)timeout {
+    XCTestExpectation *completed = [self expectationWithDescription:@"task completed"];
+    [task continueWithExecutor:[BFExecutor mainThreadExecutor] withBlock:^id (BFTask *t) {
+        [completed fulfill];
+        return nil;
+    }];
+    [self waitForExpectationsWithTimeout:timeout handler:nil];
+    return task;
+}
+
+- (BFTask *) waitForTask: (BFTask *)task {
+    return [self waitForTask:task timeout:10];
+}
+
+- (CVCoreDataController *) scratchDataController {
+    return [[CVCoreDataController alloc] initWithStoreType:NSInMemoryStoreType URL:nil];
+}
+
+- (NSURL *) temporaryFileURLWithExtension: (NSString *)extension {
+    NSString *name = [[[NSUUID UUID] UUIDString] stringByAppendingPathExtension:extension];
+    return [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+}
+
+@end